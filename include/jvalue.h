@@ -2,11 +2,15 @@
 
 #include <algorithm>
 #include <vector>
-#include <map>
 #include <string>
 #include <cstdio>
 #include <deque>
-#include <iostream>
+#include <ostream>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "jvalue_arena.h"
 
 namespace NJValue {
 
@@ -19,8 +23,378 @@ namespace NJValue {
     using string_t = std::string;
     using integer_t = long;
     using double_t = double;
-    using array_t = std::deque<IJValue *>;
-    using map_t = std::map<string_t, IJValue *>;
+    using array_t = std::deque<IJValue *, TJAllocator<IJValue *>>;
+    class TJMap;
+    using map_t = TJMap;
+
+    // Instrumentation. Built with JVALUE_STATS, every value event is counted per type
+    // and can be read back with GetStats(); built with JVALUE_TRACE, it is also passed
+    // to the hook set by SetTraceHook(). Without either define the hooks compile to nothing.
+    enum EJTraceEvent { JTRACE_CONSTRUCT = 0, JTRACE_COPY, JTRACE_MOVE, JTRACE_CONVERT, JTRACE_DESTROY, JTRACE_ALLOCATE };
+
+    // constructed counts every value created; copies, moves and conversions
+    // (values built from another type) are counted again in their own field
+    struct TJTypeStats {
+        uint64_t constructed;
+        uint64_t copied;
+        uint64_t moved;
+        uint64_t converted;
+        uint64_t destroyed;
+        uint64_t bytesAllocated;
+    };
+
+    // bytes is set for JTRACE_ALLOCATE only
+    typedef void (*TJTraceHook)(EJTraceEvent event, EJValueType type, size_t bytes);
+
+    TJTypeStats GetStats(EJValueType type);
+    void ResetStats();
+    void SetTraceHook(TJTraceHook hook);
+
+    namespace NPrivate {
+        static const size_t STATS_TYPES = JMAP + 1;
+        static const size_t STATS_EVENTS = JTRACE_ALLOCATE + 1;
+
+        extern std::atomic<uint64_t> Stats[STATS_TYPES][STATS_EVENTS];
+        extern std::atomic<TJTraceHook> TraceHook;
+    }
+
+    inline void JTrace(EJTraceEvent event, EJValueType type, size_t bytes = 0) {
+#ifdef JVALUE_STATS
+        NPrivate::Stats[type][event].fetch_add(event == JTRACE_ALLOCATE ? bytes : 1, std::memory_order_relaxed);
+#endif
+#ifdef JVALUE_TRACE
+        TJTraceHook hook = NPrivate::TraceHook.load(std::memory_order_relaxed);
+        if (hook != nullptr) {
+            hook(event, type, bytes);
+        }
+#endif
+    }
+
+    class TJParseError: public std::runtime_error {
+        string_t message;
+        size_t offset;
+
+        public:
+        TJParseError(const string_t & message, size_t offset)
+            : std::runtime_error(message + " at offset " + std::to_string(offset))
+            , message(message), offset(offset)
+        { }
+
+        // Message without the offset
+        inline const string_t & GetMessage() const { return message; }
+        inline size_t GetOffset() const { return offset; }
+    };
+
+    inline int HexDigit(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    // Encodes code point cp at out, returns the end of the written bytes
+    inline char * WriteUtf8(char * out, uint32_t cp) {
+        if (cp < 0x80) {
+            *out++ = static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            *out++ = static_cast<char>(0xC0 | (cp >> 6));
+            *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            *out++ = static_cast<char>(0xE0 | (cp >> 12));
+            *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            *out++ = static_cast<char>(0xF0 | (cp >> 18));
+            *out++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        return out;
+    }
+
+    // Decodes the JSON escapes of a string body into out, which needs size bytes.
+    // With out == nullptr only validates. Returns the decoded size; throws
+    // TJParseError reporting offset plus the position of a bad escape.
+    size_t UnescapeString(const char * data, size_t size, char * out, size_t offset = 0);
+
+    // Outcome of ParseInteger()/ParseDouble(). JNUMBER_PARTIAL: a number followed by
+    // other characters, the value holds the number. JNUMBER_RANGE: too large or
+    // too small, the value is saturated. JNUMBER_INVALID: no number, the value is 0.
+    enum EJNumberStatus { JNUMBER_OK = 0, JNUMBER_PARTIAL, JNUMBER_RANGE, JNUMBER_INVALID };
+
+    // Locale-independent decimal number parsing that never throws. Leading whitespace
+    // and a sign are accepted like std::stol/std::stod do; doubles are correctly
+    // rounded and may also be inf, infinity or nan. consumed gets the length of the number.
+    EJNumberStatus ParseInteger(const char * data, size_t size, integer_t & value, size_t * consumed = nullptr);
+    EJNumberStatus ParseDouble(const char * data, size_t size, double_t & value, size_t * consumed = nullptr);
+
+    // JDOUBLE_SHORTEST: fewest digits that read back to the same double, with a ".0"
+    // on integral values and an exponent outside 1e-6..1e21. JDOUBLE_FIXED: the
+    // legacy std::to_string() format with six decimals.
+    enum EJDoubleFormat { JDOUBLE_SHORTEST = 0, JDOUBLE_FIXED };
+
+    // Buffer sizes FormatInteger() and FormatDouble() may write to
+    static const size_t FORMAT_INTEGER_MAX = 20;
+    static const size_t FORMAT_DOUBLE_MAX = 32;
+    static const size_t FORMAT_FIXED_MAX = 320;
+
+    // Write the number at out without a terminating zero and return the end
+    char * FormatInteger(char * out, integer_t value);
+    char * FormatDouble(char * out, double_t value, EJDoubleFormat format = JDOUBLE_SHORTEST);
+
+    // SIMD implementations of the parser's structural index and the numeric
+    // kernels. JKERNEL_AUTO picks the widest one the CPU supports.
+    enum EJSimdKernel { JKERNEL_AUTO = 0, JKERNEL_SCALAR, JKERNEL_SSE42, JKERNEL_AVX2 };
+
+    EJSimdKernel DetectKernel();
+
+    // String values are bytes to the library. JUTF8_STRICT rejects strings that
+    // are not well-formed UTF-8 (RFC 3629: no overlong forms, surrogates or code
+    // points above U+10FFFF), JUTF8_LENIENT passes any bytes through.
+    enum EJUtf8Mode { JUTF8_LENIENT = 0, JUTF8_STRICT };
+
+    namespace NPrivate {
+        // Keys and short values are checked inline, the vector kernels only pay
+        // off on longer runs
+        const size_t SHORT_RUN = 16;
+
+        size_t FindInvalidUtf8Kernel(const char * data, size_t size, EJSimdKernel kernel);
+        size_t FindEscapeKernel(const char * data, size_t size, EJSimdKernel kernel);
+    }
+
+    // Offset of the first byte that does not start a well-formed UTF-8 sequence
+    // or starts a truncated one; size if all of data is well-formed
+    inline size_t FindInvalidUtf8(const char * data, size_t size, EJSimdKernel kernel = JKERNEL_AUTO) {
+        if (size < NPrivate::SHORT_RUN) {
+            unsigned char bits = 0;
+            for (size_t i = 0; i < size; ++i) {
+                bits |= static_cast<unsigned char>(data[i]);
+            }
+            if (bits < 0x80) {
+                return size;
+            }
+        }
+        return NPrivate::FindInvalidUtf8Kernel(data, size, kernel);
+    }
+
+    inline bool IsValidUtf8(const char * data, size_t size, EJSimdKernel kernel = JKERNEL_AUTO) {
+        return FindInvalidUtf8(data, size, kernel) == size;
+    }
+
+    // Offset of the first '"', '\\' or control character, the bytes a JSON
+    // string has to escape; size if there is none
+    inline size_t FindEscape(const char * data, size_t size, EJSimdKernel kernel = JKERNEL_AUTO) {
+        size_t limit = size < NPrivate::SHORT_RUN ? size : NPrivate::SHORT_RUN;
+        for (size_t i = 0; i < limit; ++i) {
+            unsigned char c = static_cast<unsigned char>(data[i]);
+            if (c < 0x20 || c == '"' || c == '\\') {
+                return i;
+            }
+        }
+        return limit == size ? size : limit + NPrivate::FindEscapeKernel(data + limit, size - limit, kernel);
+    }
+
+    // Non-owning reference to string bytes, valid while the value it came from is
+    class TJStringView {
+        const char * ptr;
+        size_t len;
+
+        public:
+        TJStringView() : ptr(""), len(0) { }
+        TJStringView(const char * data, size_t size) : ptr(data), len(size) { }
+        TJStringView(const string_t & str) : ptr(str.data()), len(str.size()) { }
+
+        inline const char * data() const { return ptr; }
+        inline size_t size() const { return len; }
+        inline bool empty() const { return len == 0; }
+        inline const char * begin() const { return ptr; }
+        inline const char * end() const { return ptr + len; }
+        inline char operator[](size_t i) const { return ptr[i]; }
+
+        inline string_t ToString() const { return string_t(ptr, len); }
+
+        inline bool operator==(const TJStringView & view) const {
+            return len == view.len && std::memcmp(ptr, view.ptr, len) == 0;
+        }
+        inline bool operator!=(const TJStringView & view) const { return !(*this == view); }
+    };
+
+    inline bool operator==(const TJStringView & view, const char * str) { return view == TJStringView(str, std::strlen(str)); }
+    inline bool operator==(const char * str, const TJStringView & view) { return view == str; }
+
+    inline std::ostream & operator<<(std::ostream & out, const TJStringView & view) {
+        return out.write(view.data(), view.size());
+    }
+
+    // Non-owning reference to contiguous numbers, see IJSON_VALUE::AsIntegerSpan()
+    template<class T>
+    class TJSpan {
+        const T * ptr;
+        size_t len;
+
+        public:
+        TJSpan() : ptr(nullptr), len(0) { }
+        TJSpan(const T * data, size_t size) : ptr(data), len(size) { }
+        TJSpan(const std::vector<T> & values) : ptr(values.data()), len(values.size()) { }
+
+        inline const T * data() const { return ptr; }
+        inline size_t size() const { return len; }
+        inline bool empty() const { return len == 0; }
+        inline const T * begin() const { return ptr; }
+        inline const T * end() const { return ptr + len; }
+        inline const T & operator[](size_t i) const { return ptr[i]; }
+    };
+
+    // String body kept with its escapes and decoded into the arena on first access
+    struct TJLazyString {
+        const char * raw;
+        size_t rawSize;
+        TJArena * arena;
+        mutable const char * data;
+        mutable size_t size;
+
+        inline void Materialize() const {
+            if (data == nullptr) {
+                char * out = static_cast<char *>(arena->Allocate(rawSize, 1));
+                size = UnescapeString(raw, rawSize, out);
+                data = out;
+            }
+        }
+    };
+
+    // Heap payload of a long owned string, the bytes right after it in one
+    // pooled block. Also remembers the results of AsInteger()/AsDouble() and
+    // Hash(), so a string is parsed or hashed once.
+    struct TJOwnedString {
+        static const unsigned char CACHED_INTEGER = 1;
+        static const unsigned char CACHED_DOUBLE = 2;
+        static const unsigned char CACHED_HASH = 4;
+
+        size_t size;
+        mutable std::atomic<unsigned char> cached;
+        mutable std::atomic<integer_t> integerValue;
+        mutable std::atomic<double_t> doubleValue;
+        mutable std::atomic<uint64_t> hashValue;
+
+        explicit TJOwnedString(size_t size)
+            : size(size), cached(0), integerValue(0), doubleValue(0.0), hashValue(0)
+        { }
+
+        inline const char * Data() const { return reinterpret_cast<const char *>(this + 1); }
+
+        inline static TJOwnedString * New(const char * data, size_t size) {
+            TJOwnedString * owned = new (TJPool::Allocate(sizeof(TJOwnedString) + size + 1)) TJOwnedString(size);
+            char * bytes = reinterpret_cast<char *>(owned + 1);
+            std::memcpy(bytes, data, size);
+            bytes[size] = '\0';
+            return owned;
+        }
+
+        inline static void Delete(TJOwnedString * owned) {
+            size_t size = owned->size;
+            owned->~TJOwnedString();
+            TJPool::Deallocate(owned, sizeof(TJOwnedString) + size + 1);
+        }
+    };
+
+    // Heap payload of an owned array. Copies of the value share it and count
+    // references; the first change made through a copy that is not the only one
+    // gives that copy storage of its own (copy-on-write). Elements added by value
+    // belong to the storage and are deleted with it, elements added as pointers,
+    // array_t ones included, stay the caller's.
+    struct TJSharedArray : TJPooled {
+        mutable std::atomic<size_t> refs;
+        array_t items;
+        std::vector<bool, TJAllocator<bool>> owned;     // per element of items
+
+        explicit TJSharedArray(const array_t & items)
+            : refs(1), items(items), owned(items.size(), false)
+        { }
+
+        explicit TJSharedArray(array_t && items)
+            : refs(1), items(std::move(items)), owned(this->items.size(), false)
+        { }
+
+        // Owned elements are copied, so the copy does not depend on the original
+        TJSharedArray(const TJSharedArray & array);
+        ~TJSharedArray();
+
+        TJSharedArray & operator=(const TJSharedArray &) = delete;
+
+        static IJValue * Adopt(const IJValue & item);
+        static void Drop(IJValue * item);
+
+        // Storage owning a copy of each of the items; nullptr items stay nullptr
+        static TJSharedArray * Copy(IJValue * const * items, size_t size);
+    };
+
+    // Heap payload of an owned array whose elements are all integers or all
+    // doubles: the numbers themselves, without a node each. Shared between
+    // copies and detached on change like TJSharedArray. At() needs nodes, which
+    // are built for all elements on first use and dropped by the next change,
+    // as is the structural hash.
+    struct TJPackedArray : TJPooled {
+        mutable std::atomic<size_t> refs;
+        EJValueType itemType;                   // JINTEGER or JDOUBLE
+        std::vector<integer_t> integers;        // may be a buffer moved in by the caller, so not pooled
+        std::vector<double_t> doubles;
+        mutable std::atomic<IJValue *> nodes;
+        mutable std::atomic<uint64_t> hash;     // 0 until computed
+
+        explicit TJPackedArray(EJValueType itemType)
+            : refs(1), itemType(itemType), nodes(nullptr), hash(0)
+        { }
+
+        TJPackedArray(const TJPackedArray & array)
+            : refs(1), itemType(array.itemType), integers(array.integers), doubles(array.doubles), nodes(nullptr), hash(0)
+        { }
+
+        ~TJPackedArray() { DropNodes(); }
+
+        TJPackedArray & operator=(const TJPackedArray &) = delete;
+
+        inline size_t Size() const { return itemType == JINTEGER ? integers.size() : doubles.size(); }
+        inline size_t GetMemoryUsed() const {
+            return sizeof(TJPackedArray) + integers.capacity() * sizeof(integer_t) + doubles.capacity() * sizeof(double_t);
+        }
+
+        IJValue * Node(size_t index) const;
+        void DropNodes();
+
+        // Generic storage owning a node per element
+        TJSharedArray * Unpack() const;
+
+        // Numbers of items if they are all integers or all doubles, else nullptr
+        static TJPackedArray * Pack(IJValue * const * items, size_t size);
+    };
+
+    class TJLazyIndex;
+
+    // Array or map inside a lazily loaded document, see TJLazyDocument. Its elements
+    // become nodes on first access; nested containers stay lazy until reached.
+    struct TJLazyContainer {
+        TJLazyIndex * index;
+        size_t start;                   // position of the opening bracket in the structural index
+        mutable bool expanded;
+        mutable IJValue ** items;       // arrays
+        mutable size_t size;
+        mutable map_t * map;            // maps
+
+        void Expand() const;
+
+        inline void Materialize() const {
+            if (!expanded) {
+                Expand();
+            }
+        }
+    };
+
+    // Tag for constructors that refer to external storage instead of copying it
+    struct TJBorrow { };
+
+    // Tag for string constructors that throw TJParseError, at the offset of the
+    // first bad byte, when the string is not well-formed UTF-8
+    struct TJCheckUtf8 { };
 
     class IJSON_VALUE;
     class JSON_UNDEFINED;
@@ -30,195 +404,1185 @@ namespace NJValue {
     class JSON_DOUBLE;
     class JSON_STRING;
     class JSON_ARRAY;
+    class JSON_MAP;
 
-    class IJSON_VALUE {
-        EJValueType type;
-
+    // Object storage: entries stay in insertion order in one contiguous vector.
+    // Up to LINEAR_MAX entries a lookup is a linear scan, larger maps add an
+    // open-addressing index of entry positions. Given an arena, entries, index
+    // and key bytes are all carved from it.
+    class TJMap : public TJPooled {
         public:
-        inline IJSON_VALUE(EJValueType type): type(type) { }
-        inline virtual ~IJSON_VALUE() { std::cout << "~IJSON_VALUE()\n"; }
+        struct TEntry {
+            const char * key;
+            uint32_t size;
+            uint32_t hash;
+            IJValue * value;
+
+            inline string_t GetKey() const { return string_t(key, size); }
+        };
 
-        inline EJValueType GetType() const { return type; }
+        typedef std::vector<TEntry, TJAllocator<TEntry>> entries_t;
+        typedef entries_t::const_iterator const_iterator;
 
-        inline virtual string_t AsString() const = 0;
-        inline virtual bool_t AsBool() const = 0;
-        inline virtual integer_t AsInteger() const = 0;
-        inline virtual double_t AsDouble() const = 0;
-        inline virtual array_t AsArray() const = 0;
-    };
+        static const size_t LINEAR_MAX = 8;
 
-    class JSON_UNDEFINED: public IJSON_VALUE {
+        // Key hash, for lookups of a key known in advance, see Find()
+        inline static uint32_t Hash(const char * key, size_t size) {
+            uint64_t h = 0x9E3779B97F4A7C15ULL ^ size;
+            uint64_t w;
+            for (; size >= 8; key += 8, size -= 8) {
+                std::memcpy(&w, key, 8);
+                h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+                h ^= h >> 32;
+            }
+            if (size != 0) {
+                w = 0;
+                std::memcpy(&w, key, size);
+                h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+            }
+            h ^= h >> 29;
+            h *= 0xC4CEB9FE1A85EC53ULL;
+            h ^= h >> 32;
+            return static_cast<uint32_t>(h);
+        }
+
+        private:
+        static const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+        entries_t entries;
+        std::vector<uint32_t, TJAllocator<uint32_t>> index;  // entry position + 1, 0 marks a free slot
+
+        inline TJArena * GetArena() const { return entries.get_allocator().GetArena(); }
+
+        inline void FreeKeys() {
+            TJAllocator<char> alloc(GetArena());
+            for (const TEntry & entry : entries) {
+                alloc.deallocate(const_cast<char *>(entry.key), entry.size);
+            }
+        }
+
+        inline void IndexEntry(size_t pos) {
+            size_t mask = index.size() - 1;
+            size_t slot = entries[pos].hash & mask;
+            while (index[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            index[slot] = static_cast<uint32_t>(pos + 1);
+        }
+
+        // Keeps the index at most half full
+        inline void Rehash(size_t count) {
+            size_t capacity = 16;
+            while (capacity < count * 2) {
+                capacity *= 2;
+            }
+            index.assign(capacity, 0);
+            for (size_t i = 0; i < entries.size(); ++i) {
+                IndexEntry(i);
+            }
+        }
+
+        inline size_t Position(const char * key, size_t size) const {
+            if (index.empty()) {
+                for (size_t i = 0; i < entries.size(); ++i) {
+                    const TEntry & entry = entries[i];
+                    if (entry.size == size && std::memcmp(entry.key, key, size) == 0) {
+                        return i;
+                    }
+                }
+                return NOT_FOUND;
+            }
+
+            return Position(key, size, Hash(key, size));
+        }
+
+        inline size_t Position(const char * key, size_t size, uint32_t hash) const {
+            if (index.empty()) {
+                for (size_t i = 0; i < entries.size(); ++i) {
+                    const TEntry & entry = entries[i];
+                    if (entry.hash == hash && entry.size == size && std::memcmp(entry.key, key, size) == 0) {
+                        return i;
+                    }
+                }
+                return NOT_FOUND;
+            }
+
+            size_t mask = index.size() - 1;
+            for (size_t slot = hash & mask; index[slot] != 0; slot = (slot + 1) & mask) {
+                const TEntry & entry = entries[index[slot] - 1];
+                if (entry.hash == hash && entry.size == size && std::memcmp(entry.key, key, size) == 0) {
+                    return index[slot] - 1;
+                }
+            }
+            return NOT_FOUND;
+        }
+
+        inline void Append(const char * key, size_t size, uint32_t hash, IJValue * value) {
+            if (size > UINT32_MAX) {
+                throw std::length_error("Map key is too long");
+            }
+            char * copy = TJAllocator<char>(GetArena()).allocate(size);
+            std::memcpy(copy, key, size);
+            entries.push_back(TEntry{ copy, static_cast<uint32_t>(size), hash, value });
+
+            if (!index.empty() && entries.size() * 2 <= index.size()) {
+                IndexEntry(entries.size() - 1);
+            } else if (entries.size() > LINEAR_MAX) {
+                Rehash(entries.size());
+            }
+        }
 
         public:
-        inline JSON_UNDEFINED() : IJSON_VALUE(JUNDEFINED) { std::cout << "JSON_UNDEFINED()\n"; }
-        inline JSON_UNDEFINED(const IJSON_VALUE & val) : IJSON_VALUE(JUNDEFINED) { std::cout << "JSON_UNDEFINED(const IJSON_VALUE & val)\n"; }
-        inline virtual ~JSON_UNDEFINED() { std::cout << "~JSON_UNDEFINED()\n"; }
+        explicit TJMap(TJArena * arena = nullptr)
+            : entries(TJAllocator<TEntry>(arena)), index(TJAllocator<uint32_t>(arena))
+        { }
+
+        // Copies live on the heap whatever the source was allocated from
+        TJMap(const TJMap & map) {
+            *this = map;
+        }
+
+        TJMap(TJMap && map) = default;
+
+        ~TJMap() { FreeKeys(); }
+
+        TJMap & operator=(const TJMap & map) {
+            if (this != &map) {
+                Clear();
+                Reserve(map.Size());
+                for (const TEntry & entry : map) {
+                    Append(entry.key, entry.size, entry.hash, entry.value);
+                }
+            }
+            return *this;
+        }
+
+        inline size_t Size() const { return entries.size(); }
+        inline bool Empty() const { return entries.empty(); }
+        inline const_iterator begin() const { return entries.begin(); }
+        inline const_iterator end() const { return entries.end(); }
+
+        inline IJValue * Find(const char * key, size_t size) const {
+            size_t pos = Position(key, size);
+            return pos == NOT_FOUND ? nullptr : entries[pos].value;
+        }
+
+        inline IJValue * Find(const string_t & key) const { return Find(key.data(), key.size()); }
+
+        // Lookup with the key hash computed beforehand by Hash()
+        inline IJValue * Find(const char * key, size_t size, uint32_t hash) const {
+            size_t pos = Position(key, size, hash);
+            return pos == NOT_FOUND ? nullptr : entries[pos].value;
+        }
+
+        // The same, telling an absent key from one whose value is nullptr
+        inline const TEntry * FindEntry(const char * key, size_t size, uint32_t hash) const {
+            size_t pos = Position(key, size, hash);
+            return pos == NOT_FOUND ? nullptr : &entries[pos];
+        }
+
+        inline void Reserve(size_t count) {
+            entries.reserve(count);
+            if (count > LINEAR_MAX && index.size() < count * 2) {
+                Rehash(count);
+            }
+        }
+
+        // Inserts at the end or replaces the value of an existing key; true if inserted
+        inline bool Set(const char * key, size_t size, IJValue * value) {
+            size_t pos = Position(key, size);
+            if (pos != NOT_FOUND) {
+                entries[pos].value = value;
+                return false;
+            }
+            Append(key, size, Hash(key, size), value);
+            return true;
+        }
 
-        inline virtual string_t AsString() const { return ""; }
-        inline virtual bool_t AsBool() const { return false; }
-        inline virtual integer_t AsInteger() const { return 0; }
-        inline virtual double_t AsDouble() const { return 0.0; }
-        inline virtual array_t AsArray() const { return array_t(); }
+        inline bool Set(const string_t & key, IJValue * value) { return Set(key.data(), key.size(), value); }
+
+        inline bool Erase(const string_t & key) {
+            size_t pos = Position(key.data(), key.size());
+            if (pos == NOT_FOUND) {
+                return false;
+            }
+            TJAllocator<char>(GetArena()).deallocate(const_cast<char *>(entries[pos].key), entries[pos].size);
+            entries.erase(entries.begin() + pos);
+            if (entries.size() <= LINEAR_MAX) {
+                index.clear();
+            } else {
+                Rehash(entries.size());
+            }
+            return true;
+        }
 
+        inline void Clear() {
+            FreeKeys();
+            entries.clear();
+            index.clear();
+        }
     };
 
-    class JSON_NULL: public IJSON_VALUE {
+    // Pieces of the structural hash, see IJSON_VALUE::Hash(). Arrays fold their
+    // elements in order; maps add up a term per entry, so entry order does not
+    // matter. Public for code that hashes trees as it builds them, see TJInterner.
+    namespace NHash {
+        inline uint64_t Mix(uint64_t h, uint64_t v) {
+            h = (h ^ v) * 0xFF51AFD7ED558CCDULL;
+            return h ^ (h >> 32);
+        }
+
+        inline uint64_t Finish(uint64_t h) {
+            h ^= h >> 29;
+            h *= 0xC4CEB9FE1A85EC53ULL;
+            return h ^ (h >> 32);
+        }
+
+        inline uint64_t Seed(EJValueType type) { return 0x9E3779B97F4A7C15ULL * static_cast<uint64_t>(type); }
+
+        inline uint64_t Scalar(EJValueType type, uint64_t bits) { return Finish(Mix(Seed(type), bits)); }
+        inline uint64_t Bool(bool_t val) { return Scalar(JBOOL, val ? 1 : 0); }
+        inline uint64_t Integer(integer_t val) { return Scalar(JINTEGER, static_cast<uint64_t>(val)); }
+
+        inline uint64_t Double(double_t val) {
+            uint64_t bits;
+            std::memcpy(&bits, &val, sizeof(bits));
+            return Scalar(JDOUBLE, bits);
+        }
+
+        inline uint64_t String(const char * data, size_t size) {
+            uint64_t h = Mix(Seed(JSTRING), size);
+            uint64_t w;
+            for (; size >= 8; data += 8, size -= 8) {
+                std::memcpy(&w, data, 8);
+                h = Mix(h, w);
+            }
+            if (size != 0) {
+                w = 0;
+                std::memcpy(&w, data, size);
+                h = Mix(h, w);
+            }
+            return Finish(h);
+        }
+
+        // Arrays: ArrayStart(), Mix() with each element hash, then Finish()
+        inline uint64_t ArrayStart(size_t size) { return Mix(Seed(JARRAY), size); }
+
+        // Maps: Map() of the sum of MapEntry() over the entries
+        inline uint64_t MapEntry(uint32_t keyHash, uint64_t valueHash) { return Finish(Mix(keyHash, valueHash)); }
+        inline uint64_t Map(uint64_t entrySum, size_t size) { return Finish(Mix(Mix(Seed(JMAP), size), entrySum)); }
+    }
+
+    class IJSON_VALUE {
+        template<class T> friend class TJValue;
 
         public:
-        inline JSON_NULL() : IJSON_VALUE(JNULL) { std::cout << "JSON_NULL()\n"; }
-        inline JSON_NULL(const IJSON_VALUE & val) : IJSON_VALUE(JNULL) { std::cout << "JSON_NULL(const IJSON_VALUE & val)\n"; }
-        inline virtual ~JSON_NULL () { std::cout << "~JSON_NULL()\n"; }
+        static const size_t SHORT_STRING_MAX = 14;
+
+        private:
+        // Layouts of JSTRING, JARRAY and JMAP payloads, kept in the layout byte.
+        // 0..SHORT_STRING_MAX is the length of an inline string.
+        static const unsigned char OWNED = SHORT_STRING_MAX + 1;
+        static const unsigned char BORROWED = SHORT_STRING_MAX + 2;
+        static const unsigned char LAZY = SHORT_STRING_MAX + 3;
+        static const unsigned char PACKED = SHORT_STRING_MAX + 4;
+
+        // 16 bytes: scalar/pointer payload or inline short string, the layout and the type tag.
+        // Strings up to SHORT_STRING_MAX bytes live in storage, longer ones on the heap.
+        // Owned arrays point to a TJSharedArray, or to a TJPackedArray with the PACKED
+        // layout, and owned maps to a map_t: its values stay the caller's, or with
+        // the OWNED layout are copies owned by the map.
+        // Borrowed strings and arrays keep a pointer and a 32-bit size, borrowed maps
+        // a pointer to arena-allocated storage, lazy strings a TJLazyString and lazy
+        // arrays and maps a TJLazyContainer; none of them own anything.
+        alignas(integer_t) char storage[SHORT_STRING_MAX];
+        unsigned char layout;
+        unsigned char type;
+
+        template<class V>
+        inline V Load(size_t offset = 0) const { V v; std::memcpy(&v, storage + offset, sizeof(V)); return v; }
+
+        template<class V>
+        inline void Store(const V & v, size_t offset = 0) { std::memcpy(storage + offset, &v, sizeof(V)); }
+
+        inline void Release() {
+            if (type == JSTRING && layout == OWNED) {
+                TJOwnedString::Delete(Load<TJOwnedString *>());
+            } else if (type == JARRAY && layout == PACKED) {
+                ReleasePacked(Load<TJPackedArray *>());
+            } else if (type == JARRAY && layout != BORROWED && layout != LAZY) {
+                ReleaseArray(Load<TJSharedArray *>());
+            } else if (type == JMAP && layout == OWNED) {
+                ReleaseMap(Load<map_t *>());
+            } else if (type == JMAP && layout != BORROWED && layout != LAZY) {
+                delete Load<map_t *>();
+            }
+        }
 
-        inline virtual string_t AsString() const { return ""; }
-        inline virtual bool_t AsBool() const { return false; }
-        inline virtual integer_t AsInteger() const { return 0; }
-        inline virtual double_t AsDouble() const { return 0.0; }
-        inline virtual array_t AsArray() const { return array_t(); }
+        inline void Assign(const IJSON_VALUE & val) {
+            std::memcpy(storage, val.storage, sizeof(storage));
+            layout = val.layout;
+            type = val.type;
+        }
 
-    };
+        // Copies always own their payload, borrowed ones included, and do not
+        // depend on the document a borrowed or lazy container came from
+        inline void CopyFrom(const IJSON_VALUE & val) {
+            Assign(val);
+            JTrace(JTRACE_COPY, val.GetType());
+            if (val.type == JSTRING && val.layout > SHORT_STRING_MAX) {
+                layout = 0;
+                SetString(val.StringData(), val.StringSize());
+            } else if (val.type == JARRAY) {
+                layout = 0;
+                Store(static_cast<TJSharedArray *>(nullptr));
+                ShareArray(val);
+            } else if (val.type == JMAP) {
+                layout = 0;
+                Store(static_cast<map_t *>(nullptr));
+                CopyMap(val);
+            }
+        }
 
-    class JSON_BOOL: public IJSON_VALUE {
+        // Adopted values of an OWNED map are deleted with it
+        static void ReleaseMap(map_t * map);
+
+        inline static void ReleaseArray(TJSharedArray * array) {
+            if (array != nullptr && array->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete array;
+            }
+        }
+
+        inline static void ReleasePacked(TJPackedArray * array) {
+            if (array->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete array;
+            }
+        }
+
+        inline void MoveFrom(IJSON_VALUE & val) {
+            Assign(val);
+            JTrace(JTRACE_MOVE, val.GetType());
+            // Leave an empty value of the same type behind
+            std::memset(val.storage, 0, sizeof(val.storage));
+            val.layout = 0;
+        }
+
+        inline const char * StringData() const {
+            switch (layout) {
+                case OWNED:
+                    return Load<TJOwnedString *>()->Data();
+                case BORROWED:
+                    return Load<const char *>();
+                case LAZY: {
+                    const TJLazyString * lazy = Load<const TJLazyString *>();
+                    lazy->Materialize();
+                    return lazy->data;
+                }
+                default:
+                    return storage;
+            }
+        }
+
+        inline size_t StringSize() const {
+            switch (layout) {
+                case OWNED:
+                    return Load<TJOwnedString *>()->size;
+                case BORROWED:
+                    return Load<uint32_t>(sizeof(void *));
+                case LAZY: {
+                    const TJLazyString * lazy = Load<const TJLazyString *>();
+                    lazy->Materialize();
+                    return lazy->size;
+                }
+                default:
+                    return layout;
+            }
+        }
+
+        inline bool StringEquals(const char * str, size_t len) const {
+            return StringSize() == len && std::memcmp(StringData(), str, len) == 0;
+        }
+
+        // "", "false" and "true" coerce to 0 and 1, other strings to their leading number or 0
+        inline integer_t StringAsInteger() const {
+            const TJOwnedString * owned = layout == OWNED ? Load<const TJOwnedString *>() : nullptr;
+            if (owned != nullptr && (owned->cached.load(std::memory_order_acquire) & TJOwnedString::CACHED_INTEGER)) {
+                return owned->integerValue.load(std::memory_order_relaxed);
+            }
+
+            integer_t value = 0;
+            if (StringEquals("true", 4)) {
+                value = 1;
+            } else if (!StringEquals("false", 5)) {
+                ParseInteger(StringData(), StringSize(), value);
+            }
 
-        bool_t value;
+            if (owned != nullptr) {
+                owned->integerValue.store(value, std::memory_order_relaxed);
+                owned->cached.fetch_or(TJOwnedString::CACHED_INTEGER, std::memory_order_release);
+            }
+            return value;
+        }
+
+        inline double_t StringAsDouble() const {
+            const TJOwnedString * owned = layout == OWNED ? Load<const TJOwnedString *>() : nullptr;
+            if (owned != nullptr && (owned->cached.load(std::memory_order_acquire) & TJOwnedString::CACHED_DOUBLE)) {
+                return owned->doubleValue.load(std::memory_order_relaxed);
+            }
+
+            double_t value = 0.0;
+            if (StringEquals("true", 4)) {
+                value = 1.0;
+            } else if (!StringEquals("false", 5)) {
+                ParseDouble(StringData(), StringSize(), value);
+            }
+
+            if (owned != nullptr) {
+                owned->doubleValue.store(value, std::memory_order_relaxed);
+                owned->cached.fetch_or(TJOwnedString::CACHED_DOUBLE, std::memory_order_release);
+            }
+            return value;
+        }
+
+        inline const TJLazyContainer * Lazy() const {
+            const TJLazyContainer * lazy = Load<const TJLazyContainer *>();
+            lazy->Materialize();
+            return lazy;
+        }
+
+        inline size_t ArraySize() const {
+            if (layout == BORROWED) {
+                return Load<uint32_t>(sizeof(void *));
+            }
+            if (layout == LAZY) {
+                return Lazy()->size;
+            }
+            if (layout == PACKED) {
+                return Load<TJPackedArray *>()->Size();
+            }
+            const TJSharedArray * a = Load<TJSharedArray *>();
+            return a == nullptr ? 0 : a->items.size();
+        }
+
+        // Contiguous elements of borrowed and lazy arrays
+        inline IJValue * const * ArrayItems() const {
+            return layout == LAZY ? Lazy()->items : Load<IJValue * const *>();
+        }
+
+        inline const map_t * MapPtr() const {
+            return layout == LAZY ? Lazy()->map : Load<const map_t *>();
+        }
+
+        inline size_t MapSize() const {
+            const map_t * m = MapPtr();
+            return m == nullptr ? 0 : m->Size();
+        }
+
+        // Accessors for a type known in advance, known must be GetType(). TJValue<T>
+        // passes the constant type of T, so the switch folds to the one case.
+        inline string_t AsStringOf(EJValueType known, EJDoubleFormat format) const {
+            char buf[FORMAT_FIXED_MAX];
+            switch (known) {
+                case JBOOL:
+                    return Load<bool_t>() ? string_t("true") : string_t("false");
+                case JINTEGER:
+                    return string_t(buf, FormatInteger(buf, Load<integer_t>()));
+                case JDOUBLE:
+                    return string_t(buf, FormatDouble(buf, Load<double_t>(), format));
+                case JSTRING:
+                    return string_t(StringData(), StringSize());
+                case JARRAY:
+                    return string_t(buf, FormatInteger(buf, ArraySize()));
+                case JMAP:
+                    return string_t(buf, FormatInteger(buf, MapSize()));
+                default:
+                    return "";
+            }
+        }
+
+        inline TJStringView AsStringViewOf(EJValueType known) const {
+            switch (known) {
+                case JBOOL:
+                    return Load<bool_t>() ? TJStringView("true", 4) : TJStringView("false", 5);
+                case JSTRING:
+                    return TJStringView(StringData(), StringSize());
+                default:
+                    return TJStringView();
+            }
+        }
+
+        inline bool_t AsBoolOf(EJValueType known) const {
+            switch (known) {
+                case JBOOL:
+                    return Load<bool_t>();
+                case JINTEGER:
+                    return ToBool(Load<integer_t>());
+                case JDOUBLE:
+                    return ToBool(Load<double_t>());
+                case JSTRING:
+                    return (StringSize() == 0 || StringEquals("0", 1) || StringEquals("false", 5))
+                        ? false
+                        : true;
+                case JARRAY:
+                    return ArraySize() == 0 ? false : true;
+                case JMAP:
+                    return MapSize() == 0 ? false : true;
+                default:
+                    return false;
+            }
+        }
+
+        inline integer_t AsIntegerOf(EJValueType known) const {
+            switch (known) {
+                case JBOOL:
+                    return Load<bool_t>() ? 1 : 0;
+                case JINTEGER:
+                    return Load<integer_t>();
+                case JDOUBLE:
+                    return ToInteger(Load<double_t>());
+                case JSTRING:
+                    return StringAsInteger();
+                case JARRAY:
+                    return ArraySize();
+                case JMAP:
+                    return MapSize();
+                default:
+                    return 0;
+            }
+        }
+
+        inline double_t AsDoubleOf(EJValueType known) const {
+            switch (known) {
+                case JBOOL:
+                    return Load<bool_t>() ? 1.0 : 0.0;
+                case JINTEGER:
+                    return static_cast<double_t>(Load<integer_t>());
+                case JDOUBLE:
+                    return Load<double_t>();
+                case JSTRING:
+                    return StringAsDouble();
+                case JARRAY:
+                    return static_cast<double_t>(ArraySize());
+                case JMAP:
+                    return static_cast<double_t>(MapSize());
+                default:
+                    return 0.0;
+            }
+        }
+
+        bool ArrayEquals(const IJSON_VALUE & val) const;
+        bool MapEquals(const IJSON_VALUE & val) const;
+
+        inline size_t SizeOf(EJValueType known) const {
+            switch (known) {
+                case JARRAY:
+                    return ArraySize();
+                case JMAP:
+                    return MapSize();
+                default:
+                    return 0;
+            }
+        }
+
+        protected:
+        inline void SetBool(const bool_t & val) { Store(val); }
+        inline void SetInteger(const integer_t & val) { Store(val); }
+        inline void SetDouble(const double_t & val) { Store(val); }
+
+        inline void SetString(const char * data, size_t size) {
+            if (size <= SHORT_STRING_MAX) {
+                std::memcpy(storage, data, size);
+                layout = static_cast<unsigned char>(size);
+            } else {
+                Store(TJOwnedString::New(data, size));
+                layout = OWNED;
+                JTrace(JTRACE_ALLOCATE, JSTRING, sizeof(TJOwnedString) + size + 1);
+            }
+        }
+
+        inline void SetString(const string_t & val) { SetString(val.data(), val.size()); }
+
+        // Empty arrays are kept as nullptr and cost no allocation
+        inline void SetArray(const array_t & val) {
+            if (val.empty()) {
+                Store(static_cast<TJSharedArray *>(nullptr));
+                return;
+            }
+            Store(new TJSharedArray(val));
+            JTrace(JTRACE_ALLOCATE, JARRAY, sizeof(TJSharedArray) + val.size() * sizeof(IJValue *));
+        }
+
+        inline void SetArray(array_t && val) {
+            if (val.empty()) {
+                Store(static_cast<TJSharedArray *>(nullptr));
+                return;
+            }
+            size_t size = val.size();
+            Store(new TJSharedArray(std::move(val)));
+            JTrace(JTRACE_ALLOCATE, JARRAY, sizeof(TJSharedArray) + size * sizeof(IJValue *));
+        }
+
+        // Numbers are packed, see TJPackedArray; empty arrays cost nothing as with SetArray()
+        inline void SetPacked(std::vector<integer_t> val) {
+            if (!val.empty()) {
+                TJPackedArray * packed = new TJPackedArray(JINTEGER);
+                packed->integers = std::move(val);
+                StorePacked(packed);
+            }
+        }
+
+        inline void SetPacked(std::vector<double_t> val) {
+            if (!val.empty()) {
+                TJPackedArray * packed = new TJPackedArray(JDOUBLE);
+                packed->doubles = std::move(val);
+                StorePacked(packed);
+            }
+        }
+
+        inline void StorePacked(TJPackedArray * packed) {
+            Store(packed);
+            layout = PACKED;
+            JTrace(JTRACE_ALLOCATE, JARRAY, packed->GetMemoryUsed());
+        }
+
+        // Owned storage is shared in O(1), borrowed and lazy elements are copied:
+        // as numbers if they are all integers or all doubles, else as nodes of
+        // their own, so the copy outlives the document
+        inline void ShareArray(const IJSON_VALUE & val) {
+            if (val.layout == PACKED) {
+                TJPackedArray * packed = val.Load<TJPackedArray *>();
+                packed->refs.fetch_add(1, std::memory_order_relaxed);
+                Store(packed);
+                layout = PACKED;
+                return;
+            }
+            if (val.layout == BORROWED || val.layout == LAZY) {
+                TJPackedArray * packed = TJPackedArray::Pack(val.ArrayItems(), val.ArraySize());
+                if (packed != nullptr) {
+                    StorePacked(packed);
+                } else {
+                    TJSharedArray * array = TJSharedArray::Copy(val.ArrayItems(), val.ArraySize());
+                    Store(array);
+                    JTrace(JTRACE_ALLOCATE, JARRAY, sizeof(TJSharedArray) + array->items.size() * sizeof(IJValue *));
+                }
+                return;
+            }
+            TJSharedArray * array = val.Load<TJSharedArray *>();
+            if (array != nullptr) {
+                array->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+            Store(array);
+        }
+
+        // Storage only this value refers to, ready to be changed
+        inline TJSharedArray & MutableArray() {
+            TJSharedArray * array;
+            if (layout == BORROWED || layout == LAZY) {
+                array = new TJSharedArray(AsArray());
+                layout = 0;
+            } else if (layout == PACKED) {
+                TJPackedArray * packed = Load<TJPackedArray *>();
+                array = packed->Unpack();
+                ReleasePacked(packed);
+                layout = 0;
+            } else {
+                array = Load<TJSharedArray *>();
+                if (array == nullptr) {
+                    array = new TJSharedArray(array_t());
+                } else if (array->refs.load(std::memory_order_acquire) != 1) {
+                    TJSharedArray * copy = new TJSharedArray(*array);
+                    ReleaseArray(array);
+                    array = copy;
+                } else {
+                    return *array;
+                }
+            }
+            Store(array);
+            JTrace(JTRACE_ALLOCATE, JARRAY, sizeof(TJSharedArray) + array->items.size() * sizeof(IJValue *));
+            return *array;
+        }
+
+        // Whether an element of itemType can be added and keep the array packed
+        inline bool Packs(EJValueType itemType) const {
+            if (itemType != JINTEGER && itemType != JDOUBLE) {
+                return false;
+            }
+            return layout == PACKED ? Load<TJPackedArray *>()->itemType == itemType : ArraySize() == 0;
+        }
+
+        // Packed storage only this value refers to; the array is packed with
+        // itemType already or is empty
+        inline TJPackedArray & MutablePacked(EJValueType itemType) {
+            TJPackedArray * packed;
+            if (layout == PACKED) {
+                packed = Load<TJPackedArray *>();
+                if (packed->refs.load(std::memory_order_acquire) == 1) {
+                    packed->DropNodes();
+                    packed->hash.store(0, std::memory_order_relaxed);
+                    return *packed;
+                }
+                TJPackedArray * copy = new TJPackedArray(*packed);
+                ReleasePacked(packed);
+                packed = copy;
+            } else {
+                Release();
+                packed = new TJPackedArray(itemType);
+            }
+            StorePacked(packed);
+            return *packed;
+        }
+
+        inline void SetMap(const map_t & val) {
+            if (val.Empty()) {
+                Store(static_cast<map_t *>(nullptr));
+                return;
+            }
+            Store(new map_t(val));
+            JTrace(JTRACE_ALLOCATE, JMAP, sizeof(map_t) + val.Size() * sizeof(map_t::TEntry));
+        }
+
+        // Values of a map filled by the caller stay the caller's; those of
+        // borrowed, lazy and OWNED maps are copied into an OWNED map
+        inline void CopyMap(const IJSON_VALUE & val) {
+            if (val.MapSize() == 0) {
+                return;
+            }
+            if (val.layout == 0) {
+                SetMap(*val.MapPtr());
+                return;
+            }
+            AdoptMap(*val.MapPtr());
+        }
+
+        void AdoptMap(const map_t & val);
+
+        // The caller keeps data alive for as long as this value, see TJDocument
+        inline void SetStringRef(const char * data, size_t size) {
+            if (size <= SHORT_STRING_MAX) {
+                SetString(data, size);
+                return;
+            }
+            if (size > UINT32_MAX) {
+                throw std::length_error("Borrowed string is too long");
+            }
+            Store(data);
+            Store(static_cast<uint32_t>(size), sizeof(void *));
+            layout = BORROWED;
+        }
+
+        inline void SetStringLazy(const TJLazyString * lazy) {
+            Store(lazy);
+            layout = LAZY;
+        }
+
+        inline void SetArrayRef(IJValue * const * items, size_t size) {
+            if (size > UINT32_MAX) {
+                throw std::length_error("Borrowed array is too long");
+            }
+            Store(items);
+            Store(static_cast<uint32_t>(size), sizeof(void *));
+            layout = BORROWED;
+        }
+
+        inline void SetMapRef(map_t * map) {
+            Store(map);
+            layout = BORROWED;
+        }
+
+        inline void SetContainerLazy(const TJLazyContainer * lazy) {
+            Store(lazy);
+            layout = LAZY;
+        }
+
+        // Counts a value built from another one as a copy or as a type conversion
+        inline void TraceFrom(const IJSON_VALUE & val) const {
+            JTrace(val.type == type ? JTRACE_COPY : JTRACE_CONVERT, GetType());
+        }
 
         public:
-        inline JSON_BOOL(const bool_t & val = false) : IJSON_VALUE(JBOOL), value(val) { std::cout << "JSON_BOOL(const bool_t & val)\n"; }
-        inline JSON_BOOL(const IJSON_VALUE & val) : IJSON_VALUE(JBOOL), value(val.AsBool()) { std::cout << "JSON_BOOL(const IJSON_VALUE & val)\n"; }
-        inline virtual ~JSON_BOOL () { std::cout << "~JSON_BOOL()\n"; }
+        inline IJSON_VALUE(EJValueType type = JUNDEFINED): layout(0), type(static_cast<unsigned char>(type)) {
+            std::memset(storage, 0, sizeof(storage));
+            JTrace(JTRACE_CONSTRUCT, type);
+        }
+        inline IJSON_VALUE(const IJSON_VALUE & val) { JTrace(JTRACE_CONSTRUCT, val.GetType()); CopyFrom(val); }
+        inline IJSON_VALUE(IJSON_VALUE && val) { JTrace(JTRACE_CONSTRUCT, val.GetType()); MoveFrom(val); }
+        inline ~IJSON_VALUE() { JTrace(JTRACE_DESTROY, GetType()); Release(); }
+
+        inline IJSON_VALUE & operator=(const IJSON_VALUE & val) {
+            if (this != &val) {
+                Release();
+                CopyFrom(val);
+            }
+            return *this;
+        }
+
+        inline IJSON_VALUE & operator=(IJSON_VALUE && val) {
+            if (this != &val) {
+                Release();
+                MoveFrom(val);
+            }
+            return *this;
+        }
+
+        inline EJValueType GetType() const { return static_cast<EJValueType>(type); }
+
+        // Conversion rules of the accessors below between numbers, also used to
+        // build values straight from a C++ number of another type
+        static inline bool_t ToBool(integer_t val) { return val != 0; }
+        static inline bool_t ToBool(double_t val) { return !(val >= 0.0 && val < 1.0); }
+        static inline integer_t ToInteger(double_t val) { return static_cast<integer_t>(val); }
 
-        inline virtual string_t AsString() const { return value ? string_t("true") : string_t("false"); }
-        inline virtual bool_t AsBool() const { return value; }
-        inline virtual integer_t AsInteger() const { return value ? 1 : 0; }
-        inline virtual double_t AsDouble() const { return value ? 1.0 : 0.0; }
-        inline virtual array_t AsArray() const { return array_t(); }
+        inline string_t AsString(EJDoubleFormat format = JDOUBLE_SHORTEST) const { return AsStringOf(GetType(), format); }
 
+        // String bytes without copying: strings, "true"/"false" for bools and ""
+        // for undefined and null. Numbers and containers need AsString().
+        inline TJStringView AsStringView() const { return AsStringViewOf(GetType()); }
+
+        inline bool_t AsBool() const { return AsBoolOf(GetType()); }
+
+        inline integer_t AsInteger() const { return AsIntegerOf(GetType()); }
+
+        inline double_t AsDouble() const { return AsDoubleOf(GetType()); }
+
+        inline array_t AsArray() const {
+            if (type != JARRAY || ArraySize() == 0) {
+                return array_t();
+            }
+            if (layout == BORROWED || layout == LAZY) {
+                IJValue * const * items = ArrayItems();
+                return array_t(items, items + ArraySize());
+            }
+            if (layout == PACKED) {
+                const TJPackedArray * packed = Load<TJPackedArray *>();
+                array_t items;
+                for (size_t i = 0; i < packed->Size(); ++i) {
+                    items.push_back(packed->Node(i));
+                }
+                return items;
+            }
+            return Load<TJSharedArray *>()->items;
+        }
+
+        inline map_t AsMap() const {
+            if (type != JMAP || MapSize() == 0) {
+                return map_t();
+            }
+            return *MapPtr();
+        }
+
+        // Number of array elements or map entries, 0 for scalars
+        inline size_t Size() const { return SizeOf(GetType()); }
+
+        // Structural hash: values that are Equals() hash the same. Long owned
+        // strings and packed arrays keep theirs until changed. Other arrays and
+        // maps are walked every time, as their elements may have been changed
+        // in place through At() or Find() without them knowing.
+        uint64_t Hash() const;
+
+        // Deep equality: the same type and contents, map entries in any order,
+        // doubles by their bits (-0.0 differs from 0.0, a NaN equals itself) and
+        // missing elements as null. 1 and 1.0 differ. Values sharing storage are
+        // equal without a walk, cached hashes that differ end it early.
+        bool Equals(const IJSON_VALUE & val) const;
+
+        // Array element without copying the array, nullptr if out of range or not an array
+        inline IJValue * At(size_t index) const {
+            if (type != JARRAY || index >= ArraySize()) {
+                return nullptr;
+            }
+            if (layout == BORROWED || layout == LAZY) {
+                return ArrayItems()[index];
+            }
+            if (layout == PACKED) {
+                return Load<TJPackedArray *>()->Node(index);
+            }
+            return Load<TJSharedArray *>()->items[index];
+        }
+
+        inline bool IsPacked() const { return type == JARRAY && layout == PACKED; }
+
+        // Elements of a packed array of integers or doubles without copying or
+        // building nodes; empty for any other value
+        inline TJSpan<integer_t> AsIntegerSpan() const {
+            if (IsPacked() && Load<TJPackedArray *>()->itemType == JINTEGER) {
+                return TJSpan<integer_t>(Load<TJPackedArray *>()->integers);
+            }
+            return TJSpan<integer_t>();
+        }
+
+        inline TJSpan<double_t> AsDoubleSpan() const {
+            if (IsPacked() && Load<TJPackedArray *>()->itemType == JDOUBLE) {
+                return TJSpan<double_t>(Load<TJPackedArray *>()->doubles);
+            }
+            return TJSpan<double_t>();
+        }
+
+        // Array changes, ignored by other types. Copies sharing the storage keep
+        // seeing the old elements. Values are copied into the array and owned by
+        // it, pointers stay the caller's. Numbers added to an empty or packed
+        // array of their type keep it packed, anything else unpacks it.
+        inline void PushBack(const IJValue & item);
+        inline void PopBack();
+        inline void Set(size_t index, const IJValue & item);
+
+        inline void PushBack(IJValue * item) {
+            if (type == JARRAY) {
+                TJSharedArray & array = MutableArray();
+                array.items.push_back(item);
+                array.owned.push_back(false);
+            }
+        }
+
+        // Map storage without copying, nullptr if empty or not a map
+        inline const map_t * GetMap() const {
+            return type == JMAP ? MapPtr() : nullptr;
+        }
+
+        // Value of key in a map without copying anything, nullptr if absent or not a map
+        inline IJValue * Find(const string_t & key) const {
+            const map_t * map = type == JMAP ? MapPtr() : nullptr;
+            return map == nullptr ? nullptr : map->Find(key);
+        }
     };
 
-    class JSON_INTEGER: public IJSON_VALUE {
+    static_assert(sizeof(IJSON_VALUE) == 16, "IJSON_VALUE must stay 16 bytes");
 
-        integer_t value;
+    class JSON_UNDEFINED: public IJSON_VALUE {
 
         public:
-        inline JSON_INTEGER(const integer_t & val = 0) : IJSON_VALUE(JINTEGER), value(val) { std::cout << "JSON_INTEGER()\n"; }
-        inline JSON_INTEGER(const IJSON_VALUE & val) : IJSON_VALUE(JINTEGER), value(val.AsInteger()) { std::cout << "JSON_INTEGER(const IJSON_VALUE & val)\n"; }
-        inline virtual ~JSON_INTEGER () { std::cout << "~JSON_INTEGER()\n"; }
+        inline JSON_UNDEFINED() : IJSON_VALUE(JUNDEFINED) { }
+        inline JSON_UNDEFINED(const IJSON_VALUE & val) : IJSON_VALUE(JUNDEFINED) { TraceFrom(val); }
+    };
 
-        inline virtual string_t AsString() const { return std::to_string(value); }
-        inline virtual bool_t AsBool() const { return value == 0 ? false : true; }
-        inline virtual integer_t AsInteger() const { return value; }
-        inline virtual double_t AsDouble() const { return static_cast<double_t>(value); }
-        inline virtual array_t AsArray() const { return array_t(); }
+    class JSON_NULL: public IJSON_VALUE {
 
+        public:
+        inline JSON_NULL() : IJSON_VALUE(JNULL) { }
+        inline JSON_NULL(const IJSON_VALUE & val) : IJSON_VALUE(JNULL) { TraceFrom(val); }
     };
 
-    class JSON_DOUBLE: public IJSON_VALUE {
+    class JSON_BOOL: public IJSON_VALUE {
 
-        double_t value;
+        public:
+        inline JSON_BOOL(const bool_t & val = false) : IJSON_VALUE(JBOOL) { SetBool(val); }
+        inline JSON_BOOL(const IJSON_VALUE & val) : IJSON_VALUE(JBOOL) { TraceFrom(val); SetBool(val.AsBool()); }
+    };
+
+    class JSON_INTEGER: public IJSON_VALUE {
 
         public:
-        inline JSON_DOUBLE(const double_t & val = 0.0) : IJSON_VALUE(JDOUBLE), value(val) { std::cout << "JSON_DOUBLE()\n"; }
-        inline JSON_DOUBLE(const IJSON_VALUE & val) : IJSON_VALUE(JDOUBLE), value(val.AsDouble()) { std::cout << "JSON_DOUBLE(const IJSON_VALUE & val)\n"; }
-        inline virtual ~JSON_DOUBLE () { std::cout << "~JSON_DOUBLE()\n"; }
+        inline JSON_INTEGER(const integer_t & val = 0) : IJSON_VALUE(JINTEGER) { SetInteger(val); }
+        inline JSON_INTEGER(const IJSON_VALUE & val) : IJSON_VALUE(JINTEGER) { TraceFrom(val); SetInteger(val.AsInteger()); }
+    };
 
-        inline virtual string_t AsString() const { return std::to_string(value); }
-        inline virtual bool_t AsBool() const { return (value >= 0.0 && value < 1.0) ? false : true; }
-        inline virtual integer_t AsInteger() const { return (integer_t)value; }
-        inline virtual double_t AsDouble() const { return value; }
-        inline virtual array_t AsArray() const { return array_t(); }
+    class JSON_DOUBLE: public IJSON_VALUE {
 
+        public:
+        inline JSON_DOUBLE(const double_t & val = 0.0) : IJSON_VALUE(JDOUBLE) { SetDouble(val); }
+        inline JSON_DOUBLE(const IJSON_VALUE & val) : IJSON_VALUE(JDOUBLE) { TraceFrom(val); SetDouble(val.AsDouble()); }
     };
 
     class JSON_STRING: public IJSON_VALUE {
 
-        string_t value;
+        public:
+        inline JSON_STRING(const string_t & val = "") : IJSON_VALUE(JSTRING) { SetString(val); }
+        inline JSON_STRING(const char * data, size_t size) : IJSON_VALUE(JSTRING) { SetString(data, size); }
+        inline JSON_STRING(const IJSON_VALUE & val) : IJSON_VALUE(JSTRING) { TraceFrom(val); SetString(val.AsString()); }
+        inline JSON_STRING(TJBorrow, const char * data, size_t size) : IJSON_VALUE(JSTRING) { SetStringRef(data, size); }
+        inline JSON_STRING(TJCheckUtf8, const char * data, size_t size) : IJSON_VALUE(JSTRING) {
+            size_t bad = FindInvalidUtf8(data, size);
+            if (bad != size) {
+                throw TJParseError("Invalid UTF-8", bad);
+            }
+            SetString(data, size);
+        }
+        inline JSON_STRING(TJCheckUtf8 check, const string_t & val) : JSON_STRING(check, val.data(), val.size()) { }
+        inline JSON_STRING(TJBorrow, const TJLazyString * lazy) : IJSON_VALUE(JSTRING) { SetStringLazy(lazy); }
+    };
+
+
+    class JSON_ARRAY: public IJSON_VALUE {
 
         public:
-        inline JSON_STRING(const string_t & val = "") : IJSON_VALUE(JSTRING), value(val) { std::cout << "JSON_STRING()\n"; }
-        inline JSON_STRING(const IJSON_VALUE & val) : IJSON_VALUE(JSTRING), value(val.AsString()) { std::cout << "JSON_STRING(const IJSON_VALUE & val)\n"; }
-        inline virtual ~JSON_STRING () { std::cout << "~JSON_STRING()\n"; }
+        inline JSON_ARRAY() : IJSON_VALUE(JARRAY) { }
+        inline JSON_ARRAY(const array_t & val) : IJSON_VALUE(JARRAY) { SetArray(val); }
+        inline JSON_ARRAY(array_t && val) : IJSON_VALUE(JARRAY) { SetArray(std::move(val)); }
+        inline JSON_ARRAY(std::vector<integer_t> val) : IJSON_VALUE(JARRAY) { SetPacked(std::move(val)); }
+        inline JSON_ARRAY(std::vector<double_t> val) : IJSON_VALUE(JARRAY) { SetPacked(std::move(val)); }
+        inline JSON_ARRAY(const IJSON_VALUE & val) : IJSON_VALUE(JARRAY) {
+            TraceFrom(val);
+            if (val.GetType() == JARRAY) {
+                ShareArray(val);
+            }
+        }
+        inline JSON_ARRAY(TJBorrow, IJValue * const * items, size_t size) : IJSON_VALUE(JARRAY) { SetArrayRef(items, size); }
+        inline JSON_ARRAY(TJBorrow, const TJLazyContainer * lazy) : IJSON_VALUE(JARRAY) { SetContainerLazy(lazy); }
+    };
 
-        inline virtual string_t AsString() const {
-            return value;
+
+    class JSON_MAP: public IJSON_VALUE {
+
+        public:
+        inline JSON_MAP() : IJSON_VALUE(JMAP) { }
+        inline JSON_MAP(const map_t & val) : IJSON_VALUE(JMAP) { SetMap(val); }
+        inline JSON_MAP(const IJSON_VALUE & val) : IJSON_VALUE(JMAP) {
+            TraceFrom(val);
+            if (val.GetType() == JMAP) {
+                CopyMap(val);
+            }
         }
+        inline JSON_MAP(TJBorrow, map_t * map) : IJSON_VALUE(JMAP) { SetMapRef(map); }
+        inline JSON_MAP(TJBorrow, const TJLazyContainer * lazy) : IJSON_VALUE(JMAP) { SetContainerLazy(lazy); }
+    };
 
-        inline virtual bool_t AsBool() const {
-            return (value.empty() || value == "0" || value == "false")
-                ? false
-                : true;
+
+
+    // Type every value of a JSON_* class has, known at compile time. Values of
+    // IJSON_VALUE itself may have any type, for them IsFixed() is false.
+    template<class T>
+    struct TJStaticType {
+        static constexpr bool IsFixed() { return false; }
+        static constexpr EJValueType Type() { return JUNDEFINED; }
+        static constexpr bool Is(EJValueType) { return false; }
+    };
+
+    template<EJValueType TYPE>
+    struct TJFixedType {
+        static constexpr bool IsFixed() { return true; }
+        static constexpr EJValueType Type() { return TYPE; }
+        static constexpr bool Is(EJValueType type) { return type == TYPE; }
+    };
+
+    template<> struct TJStaticType<JSON_UNDEFINED>: TJFixedType<JUNDEFINED> { };
+    template<> struct TJStaticType<JSON_NULL>: TJFixedType<JNULL> { };
+    template<> struct TJStaticType<JSON_BOOL>: TJFixedType<JBOOL> { };
+    template<> struct TJStaticType<JSON_INTEGER>: TJFixedType<JINTEGER> { };
+    template<> struct TJStaticType<JSON_DOUBLE>: TJFixedType<JDOUBLE> { };
+    template<> struct TJStaticType<JSON_STRING>: TJFixedType<JSTRING> { };
+    template<> struct TJStaticType<JSON_ARRAY>: TJFixedType<JARRAY> { };
+    template<> struct TJStaticType<JSON_MAP>: TJFixedType<JMAP> { };
+
+    // Builds a T from a C++ value with the result T(JSON_X(val)) has, JSON_X
+    // being the class of the value's type. TJConvertVia takes that path, which
+    // costs nothing when T is JSON_X; TJConvert<T> builds T straight from the
+    // value for the pairs of scalar types that convert.
+    template<class T>
+    struct TJConvertVia {
+        static inline T From(const bool_t & val) { return T(JSON_BOOL(val)); }
+        static inline T From(const integer_t & val) { return T(JSON_INTEGER(val)); }
+        static inline T From(const double_t & val) { return T(JSON_DOUBLE(val)); }
+        static inline T From(const string_t & val) { return T(JSON_STRING(val)); }
+        static inline T From(const char * val) { return T(JSON_STRING(val, std::strlen(val))); }
+        static inline T From(const array_t & val) { return T(JSON_ARRAY(val)); }
+        static inline T From(array_t && val) { return T(JSON_ARRAY(std::move(val))); }
+        static inline T From(std::vector<integer_t> && val) { return T(JSON_ARRAY(std::move(val))); }
+        static inline T From(std::vector<double_t> && val) { return T(JSON_ARRAY(std::move(val))); }
+        static inline T From(const map_t & val) { return T(JSON_MAP(val)); }
+    };
+
+    template<class T>
+    struct TJConvert: TJConvertVia<T> { };
+
+    template<>
+    struct TJConvert<JSON_BOOL>: TJConvertVia<JSON_BOOL> {
+        using TJConvertVia<JSON_BOOL>::From;
+
+        static inline JSON_BOOL From(const integer_t & val) {
+            JTrace(JTRACE_CONVERT, JBOOL);
+            return JSON_BOOL(IJSON_VALUE::ToBool(val));
         }
 
-        inline virtual integer_t AsInteger() const {
-            try {
-                return (value.empty() || value =="false")
-                    ? 0
-                    : ( value == "true" )
-                        ? 1
-                        : std::stol(value);
-            } catch (std::invalid_argument) {
-                return 0;
-            }
+        static inline JSON_BOOL From(const double_t & val) {
+            JTrace(JTRACE_CONVERT, JBOOL);
+            return JSON_BOOL(IJSON_VALUE::ToBool(val));
         }
+    };
 
-        inline virtual double_t AsDouble() const {
-            try {
-                return (value.empty() || value =="false")
-                    ? 0.0
-                    : ( value =="true" )
-                        ? 1.0
-                        : std::stod(value);
-            } catch (std::invalid_argument) {
-                return 0.0;
-            }
+    template<>
+    struct TJConvert<JSON_INTEGER>: TJConvertVia<JSON_INTEGER> {
+        using TJConvertVia<JSON_INTEGER>::From;
+
+        static inline JSON_INTEGER From(const bool_t & val) {
+            JTrace(JTRACE_CONVERT, JINTEGER);
+            return JSON_INTEGER(val ? 1 : 0);
         }
 
-        inline virtual array_t AsArray() const { return array_t(); }
+        static inline JSON_INTEGER From(const double_t & val) {
+            JTrace(JTRACE_CONVERT, JINTEGER);
+            return JSON_INTEGER(IJSON_VALUE::ToInteger(val));
+        }
     };
 
+    template<>
+    struct TJConvert<JSON_DOUBLE>: TJConvertVia<JSON_DOUBLE> {
+        using TJConvertVia<JSON_DOUBLE>::From;
 
-    class JSON_ARRAY: public IJSON_VALUE {
+        static inline JSON_DOUBLE From(const bool_t & val) {
+            JTrace(JTRACE_CONVERT, JDOUBLE);
+            return JSON_DOUBLE(val ? 1.0 : 0.0);
+        }
 
-        array_t value;
-        public:
-        inline JSON_ARRAY() : IJSON_VALUE(JARRAY) { std::cout << "JSON_ARRAY()\n"; }
-        inline JSON_ARRAY(const array_t & val) : IJSON_VALUE(JARRAY), value(val) { std::cout << "JSON_ARRAY(const array_t & val)\n"; }
-        inline JSON_ARRAY(const IJSON_VALUE & val) : IJSON_VALUE(JARRAY), value(val.AsArray()) { std::cout << "JSON_ARRAY(const IJSON_VALUE & val)\n"; }
-        inline virtual ~JSON_ARRAY () { std::cout << "~JSON_ARRAY()\n"; }
-
-        inline virtual string_t AsString() const { return std::to_string(value.size()); }
-        inline virtual bool_t AsBool() const { return value.size() == 0 ? false : true; }
-        inline virtual integer_t AsInteger() const { return value.size(); }
-        inline virtual double_t AsDouble() const { return static_cast<double_t>(value.size()); }
-        inline virtual array_t AsArray() const { return value; }
+        static inline JSON_DOUBLE From(const integer_t & val) {
+            JTrace(JTRACE_CONVERT, JDOUBLE);
+            return JSON_DOUBLE(static_cast<double_t>(val));
+        }
     };
 
+    template<>
+    struct TJConvert<JSON_STRING>: TJConvertVia<JSON_STRING> {
+        using TJConvertVia<JSON_STRING>::From;
+
+        static inline JSON_STRING From(const bool_t & val) {
+            JTrace(JTRACE_CONVERT, JSTRING);
+            return val ? JSON_STRING("true", 4) : JSON_STRING("false", 5);
+        }
 
+        static inline JSON_STRING From(const integer_t & val) {
+            char buf[FORMAT_INTEGER_MAX];
+            JTrace(JTRACE_CONVERT, JSTRING);
+            return JSON_STRING(buf, FormatInteger(buf, val) - buf);
+        }
+
+        static inline JSON_STRING From(const double_t & val) {
+            char buf[FORMAT_FIXED_MAX];
+            JTrace(JTRACE_CONVERT, JSTRING);
+            return JSON_STRING(buf, FormatDouble(buf, val, JDOUBLE_SHORTEST) - buf);
+        }
+    };
 
     class IJValue {
 
     protected:
 
+        IJSON_VALUE value;
+
         IJValue() { }
+        IJValue(const IJSON_VALUE & val) : value(val) { }
+        IJValue(IJSON_VALUE && val) : value(std::move(val)) { }
 
     public:
-        inline bool IsUndefined() const { return GetValue().GetType() == JUNDEFINED; }
-        inline bool IsNull() const { return GetValue().GetType() == JNULL; }
-        inline bool IsBool() const { return GetValue().GetType() == JBOOL; }
-        inline bool IsInteger() const { return GetValue().GetType() == JINTEGER; }
-        inline bool IsDouble() const { return GetValue().GetType() == JDOUBLE; }
-        inline bool IsString() const { return GetValue().GetType() == JSTRING; }
-        inline bool IsArray() const { return GetValue().GetType() == JARRAY; }
-        inline bool IsMap() const { return GetValue().GetType() == JMAP; }
-
-        virtual const IJSON_VALUE & GetValue() const = 0;
-        virtual IJSON_VALUE * GetValuePtr() = 0;
-
-        inline string_t AsString() const { return GetValue().AsString(); };
-        inline bool_t AsBool() const { return GetValue().AsBool(); };
-        inline integer_t AsInteger() const { return GetValue().AsInteger(); };
-        inline double_t AsDouble() const { return GetValue().AsDouble(); };
+        inline bool IsUndefined() const { return value.GetType() == JUNDEFINED; }
+        inline bool IsNull() const { return value.GetType() == JNULL; }
+        inline bool IsBool() const { return value.GetType() == JBOOL; }
+        inline bool IsInteger() const { return value.GetType() == JINTEGER; }
+        inline bool IsDouble() const { return value.GetType() == JDOUBLE; }
+        inline bool IsString() const { return value.GetType() == JSTRING; }
+        inline bool IsArray() const { return value.GetType() == JARRAY; }
+        inline bool IsMap() const { return value.GetType() == JMAP; }
+
+        inline const IJSON_VALUE & GetValue() const { return value; }
+        // The value may be changed through the pointer but not its type, which
+        // TJValue<T> takes as fixed by T
+        inline IJSON_VALUE * GetValuePtr() { return &value; }
+
+        inline string_t AsString(EJDoubleFormat format = JDOUBLE_SHORTEST) const { return value.AsString(format); };
+        inline TJStringView AsStringView() const { return value.AsStringView(); };
+        inline bool_t AsBool() const { return value.AsBool(); };
+        inline integer_t AsInteger() const { return value.AsInteger(); };
+        inline double_t AsDouble() const { return value.AsDouble(); };
         inline array_t AsArray() const {
             if (IsArray()) {
-                return GetValue().AsArray();
+                return value.AsArray();
             } else {
                 array_t a;
 //                a.push_back(this);
@@ -226,57 +1590,95 @@ namespace NJValue {
             }
         };
 
-//        virtual IJValue * GetValue() const = 0;
+        inline map_t AsMap() const { return value.AsMap(); };
+        inline IJValue * Find(const string_t & key) const { return value.Find(key); };
+        inline size_t Size() const { return value.Size(); };
+        inline IJValue * At(size_t index) const { return value.At(index); };
 
-        virtual ~IJValue() {
-        }
+        inline void PushBack(const IJValue & item) { value.PushBack(item); }
+        inline void PushBack(IJValue * item) { value.PushBack(item); }
+        inline void PopBack() { value.PopBack(); }
+        inline void Set(size_t index, const IJValue & item) { value.Set(index, item); }
+
+        inline uint64_t Hash() const { return value.Hash(); }
+        inline bool Equals(const IJValue & val) const { return value.Equals(val.value); }
+
+        inline bool IsPacked() const { return value.IsPacked(); }
+        inline TJSpan<integer_t> AsIntegerSpan() const { return value.AsIntegerSpan(); }
+        inline TJSpan<double_t> AsDoubleSpan() const { return value.AsDoubleSpan(); }
+
+//        virtual IJValue * GetValue() const = 0;
     };
 
+    // Value of class T. For the JSON_* classes the type never changes, so the
+    // type checks and accessors below compile to constants and direct loads;
+    // through IJValue they check the type at run time.
     template<class T>
     class TJValue : public IJValue {
 
-        T value;
-
     public:
 
-        TJValue() {
+        TJValue() : IJValue(T()) {
         }
 
-        TJValue(const T & val) : value(val) {
+        TJValue(const T & val) : IJValue(val) {
         }
 
-        TJValue(const integer_t & val) : value(T(JSON_INTEGER(val))) {
+        TJValue(T && val) : IJValue(std::move(val)) {
         }
 
-        TJValue(const int & val) : value(T(JSON_INTEGER(static_cast<integer_t>(val)))) {
+        TJValue(const integer_t & val) : IJValue(TJConvert<T>::From(val)) {
         }
 
-        TJValue(const double_t & val) : value(T(JSON_DOUBLE(val))) {
+        TJValue(const int & val) : IJValue(TJConvert<T>::From(static_cast<integer_t>(val))) {
         }
 
-        TJValue(const string_t & val) : value(T(JSON_STRING(val))) {
+        TJValue(const double_t & val) : IJValue(TJConvert<T>::From(val)) {
         }
 
-        TJValue(const char * val) : value(T(JSON_STRING(string_t(val)))) {
+        TJValue(const string_t & val) : IJValue(TJConvert<T>::From(val)) {
         }
 
-        TJValue(const bool_t & val) : value(T(JSON_BOOL(val))) {
+        TJValue(const char * val) : IJValue(TJConvert<T>::From(val)) {
         }
 
-        TJValue(const array_t & val) : value(T(JSON_ARRAY(val))) {
+        TJValue(const bool_t & val) : IJValue(TJConvert<T>::From(val)) {
         }
 
-        virtual ~TJValue() {
+        TJValue(const array_t & val) : IJValue(TJConvert<T>::From(val)) {
         }
 
+        TJValue(array_t && val) : IJValue(TJConvert<T>::From(std::move(val))) {
+        }
 
-        virtual inline const IJSON_VALUE & GetValue() const {
-            return value;
-        };
+        TJValue(std::vector<integer_t> val) : IJValue(TJConvert<T>::From(std::move(val))) {
+        }
 
-        virtual inline IJSON_VALUE * GetValuePtr() {
-            return &value;
-        };
+        TJValue(std::vector<double_t> val) : IJValue(TJConvert<T>::From(std::move(val))) {
+        }
+
+        TJValue(const map_t & val) : IJValue(TJConvert<T>::From(val)) {
+        }
+
+        inline EJValueType GetType() const {
+            return TJStaticType<T>::IsFixed() ? TJStaticType<T>::Type() : value.GetType();
+        }
+
+        inline bool IsUndefined() const { return GetType() == JUNDEFINED; }
+        inline bool IsNull() const { return GetType() == JNULL; }
+        inline bool IsBool() const { return GetType() == JBOOL; }
+        inline bool IsInteger() const { return GetType() == JINTEGER; }
+        inline bool IsDouble() const { return GetType() == JDOUBLE; }
+        inline bool IsString() const { return GetType() == JSTRING; }
+        inline bool IsArray() const { return GetType() == JARRAY; }
+        inline bool IsMap() const { return GetType() == JMAP; }
+
+        inline string_t AsString(EJDoubleFormat format = JDOUBLE_SHORTEST) const { return value.AsStringOf(GetType(), format); }
+        inline TJStringView AsStringView() const { return value.AsStringViewOf(GetType()); }
+        inline bool_t AsBool() const { return value.AsBoolOf(GetType()); }
+        inline integer_t AsInteger() const { return value.AsIntegerOf(GetType()); }
+        inline double_t AsDouble() const { return value.AsDoubleOf(GetType()); }
+        inline size_t Size() const { return value.SizeOf(GetType()); }
 
 /*
         virtual void push_back(const JSON_NULL & val) {
@@ -313,6 +1715,92 @@ namespace NJValue {
     };
 
 
+    inline void IJSON_VALUE::PushBack(const IJValue & item) {
+        if (type != JARRAY) {
+            return;
+        }
+        const IJSON_VALUE & val = item.GetValue();
+        if (Packs(val.GetType())) {
+            // Read first: item may be a node of this array, which the change drops
+            integer_t integer = val.AsInteger();
+            double_t number = val.AsDouble();
+            TJPackedArray & packed = MutablePacked(val.GetType());
+            if (packed.itemType == JINTEGER) {
+                packed.integers.push_back(integer);
+            } else {
+                packed.doubles.push_back(number);
+            }
+            return;
+        }
+
+        // Copied first, so an array pushed into itself keeps the old elements
+        IJValue * copy = TJSharedArray::Adopt(item);
+        TJSharedArray * array;
+        try {
+            array = &MutableArray();
+            array->items.push_back(copy);
+        } catch (...) {
+            TJSharedArray::Drop(copy);
+            throw;
+        }
+        array->owned.push_back(true);
+    }
+
+    inline void IJSON_VALUE::PopBack() {
+        if (type != JARRAY || ArraySize() == 0) {
+            return;
+        }
+        if (layout == PACKED) {
+            TJPackedArray & packed = MutablePacked(Load<TJPackedArray *>()->itemType);
+            if (packed.itemType == JINTEGER) {
+                packed.integers.pop_back();
+            } else {
+                packed.doubles.pop_back();
+            }
+            return;
+        }
+
+        TJSharedArray & array = MutableArray();
+        if (array.owned.back()) {
+            TJSharedArray::Drop(array.items.back());
+        }
+        array.items.pop_back();
+        array.owned.pop_back();
+    }
+
+    inline void IJSON_VALUE::Set(size_t index, const IJValue & item) {
+        if (type != JARRAY || index >= ArraySize()) {
+            return;
+        }
+        const IJSON_VALUE & val = item.GetValue();
+        if (layout == PACKED && Packs(val.GetType())) {
+            integer_t integer = val.AsInteger();
+            double_t number = val.AsDouble();
+            TJPackedArray & packed = MutablePacked(val.GetType());
+            if (packed.itemType == JINTEGER) {
+                packed.integers[index] = integer;
+            } else {
+                packed.doubles[index] = number;
+            }
+            return;
+        }
+
+        IJValue * copy = TJSharedArray::Adopt(item);
+        TJSharedArray * array;
+        try {
+            array = &MutableArray();
+        } catch (...) {
+            TJSharedArray::Drop(copy);
+            throw;
+        }
+        if (array->owned[index]) {
+            TJSharedArray::Drop(array->items[index]);
+        }
+        array->items[index] = copy;
+        array->owned[index] = true;
+    }
+
+
 /* /////////////////////////////////////////////////////////////////////////// */
 
 
@@ -331,4 +1819,6 @@ namespace NJValue {
     // JSON_STRING
 
     // JSON_ARRAY
+
+    // JSON_MAP
 }
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <vector>
+#include "jvalue_pool.h"
+
+namespace NJValue {
+
+    // Monotonic bump allocator. Memory is handed out from a list of blocks and only
+    // returned all at once: Reset() rewinds to the first block and keeps every block
+    // for reuse, the destructor frees them. Destructors of objects placed here never run.
+    class TJArena {
+        struct TBlock {
+            char * data;
+            size_t size;
+        };
+
+        std::vector<TBlock> blocks;
+        size_t current;
+        char * ptr;
+        char * end;
+        size_t blockSize;
+        size_t used;
+
+        static const size_t MAX_BLOCK_SIZE = 16 << 20;
+
+        inline static char * AlignUp(char * p, size_t align) {
+            return reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(p) + align - 1) & ~(uintptr_t(align) - 1));
+        }
+
+        void * AllocateSlow(size_t size, size_t align) {
+            // Move on to the next kept block that fits, or add a new one
+            while (++current < blocks.size()) {
+                ptr = AlignUp(blocks[current].data, align);
+                end = blocks[current].data + blocks[current].size;
+                if (ptr + size <= end) {
+                    return Bump(size);
+                }
+            }
+
+            size_t next = blocks.empty() ? blockSize : std::min(blocks.back().size * 2, static_cast<size_t>(MAX_BLOCK_SIZE));
+            next = std::max(next, size + align);
+            char * data = static_cast<char *>(std::malloc(next));
+            if (data == nullptr) {
+                throw std::bad_alloc();
+            }
+            blocks.push_back(TBlock{ data, next });
+            current = blocks.size() - 1;
+            ptr = AlignUp(data, align);
+            end = data + next;
+            return Bump(size);
+        }
+
+        inline void * Bump(size_t size) {
+            void * p = ptr;
+            ptr += size;
+            used += size;
+            return p;
+        }
+
+        public:
+        explicit TJArena(size_t blockSize = 64 << 10)
+            : current(0), ptr(nullptr), end(nullptr), blockSize(blockSize), used(0)
+        { }
+
+        TJArena(TJArena && arena)
+            : blocks(std::move(arena.blocks)), current(arena.current), ptr(arena.ptr), end(arena.end)
+            , blockSize(arena.blockSize), used(arena.used)
+        {
+            arena.blocks.clear();
+            arena.current = 0;
+            arena.ptr = arena.end = nullptr;
+            arena.used = 0;
+        }
+
+        TJArena & operator=(TJArena && arena) {
+            std::swap(blocks, arena.blocks);
+            std::swap(current, arena.current);
+            std::swap(ptr, arena.ptr);
+            std::swap(end, arena.end);
+            std::swap(blockSize, arena.blockSize);
+            std::swap(used, arena.used);
+            return *this;
+        }
+
+        TJArena(const TJArena &) = delete;
+        TJArena & operator=(const TJArena &) = delete;
+
+        ~TJArena() {
+            for (const TBlock & block : blocks) {
+                std::free(block.data);
+            }
+        }
+
+        inline void * Allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+            char * p = AlignUp(ptr, align);
+            if (ptr == nullptr || p + size > end) {
+                return AllocateSlow(size, align);
+            }
+            ptr = p;
+            return Bump(size);
+        }
+
+        template<class T, class... Args>
+        inline T * New(Args && ... args) {
+            return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        template<class T>
+        inline T * NewArray(size_t count) {
+            return static_cast<T *>(Allocate(sizeof(T) * count, alignof(T)));
+        }
+
+        inline char * CopyString(const char * data, size_t size) {
+            char * p = static_cast<char *>(Allocate(size, 1));
+            std::memcpy(p, data, size);
+            return p;
+        }
+
+        // Forget every allocation but keep the blocks, so the next document allocates nothing
+        inline void Reset() {
+            current = 0;
+            used = 0;
+            if (blocks.empty()) {
+                ptr = end = nullptr;
+            } else {
+                ptr = blocks[0].data;
+                end = blocks[0].data + blocks[0].size;
+            }
+        }
+
+        // Bytes handed out since the last Reset()
+        inline size_t GetUsed() const { return used; }
+
+        inline size_t GetCapacity() const {
+            size_t capacity = 0;
+            for (const TBlock & block : blocks) {
+                capacity += block.size;
+            }
+            return capacity;
+        }
+    };
+
+    // Standard allocator over an arena. Without an arena it falls back to the thread's
+    // pool, see TJPool; with one, deallocate() is a no-op and memory goes back with the arena.
+    template<class T>
+    class TJAllocator {
+        template<class U> friend class TJAllocator;
+
+        TJArena * arena;
+
+        public:
+        typedef T value_type;
+
+        TJAllocator(TJArena * arena = nullptr) noexcept : arena(arena) { }
+
+        template<class U>
+        TJAllocator(const TJAllocator<U> & alloc) noexcept : arena(alloc.arena) { }
+
+        inline T * allocate(size_t n) {
+            if (arena != nullptr) {
+                return arena->NewArray<T>(n);
+            }
+            return static_cast<T *>(TJPool::Allocate(n * sizeof(T)));
+        }
+
+        inline void deallocate(T * p, size_t n) noexcept {
+            if (arena == nullptr) {
+                TJPool::Deallocate(p, n * sizeof(T));
+            }
+        }
+
+        inline TJArena * GetArena() const { return arena; }
+
+        template<class U>
+        inline bool operator==(const TJAllocator<U> & alloc) const { return arena == alloc.arena; }
+
+        template<class U>
+        inline bool operator!=(const TJAllocator<U> & alloc) const { return arena != alloc.arena; }
+    };
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "jvalue.h"
+#include "jvalue_document.h"
+#include "jvalue_mmap.h"
+#include "jvalue_parser.h"
+
+namespace NJValue {
+
+    // Binary encoding of value trees. Every EJValueType is represented, JUNDEFINED
+    // included. Numbers are little-endian and copied in host order, so only
+    // little-endian hosts are supported. Offsets count from the start of the
+    // buffer and are 32-bit, so an encoded tree is limited to 4 GiB. Children
+    // follow their parent in the order DecodeBinary() visits them, which
+    // rejects buffers where they do not.
+    //
+    //     buffer:     "JVB" version(1), then the root value
+    //     value:      type(1), then by type
+    //       JUNDEFINED, JNULL  nothing
+    //       JBOOL              0 or 1 (1)
+    //       JINTEGER           int64 (8)
+    //       JDOUBLE            IEEE binary64 (8)
+    //       JSTRING            size(4), bytes
+    //       JARRAY             count(4), count element offsets(4)
+    //       JMAP               count(4), sorted(4), count * { key offset(4), value offset(4) }
+    //     key:        size(4), bytes
+    //
+    // Map entries keep insertion order. Maps with more than BINARY_LINEAR_MAX entries
+    // also get, at offset sorted, their entry numbers ordered by key bytes; smaller
+    // maps have sorted == 0 and are scanned.
+    static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "The binary encoding is read and written in host order");
+
+    const uint8_t BINARY_VERSION = 1;
+    const size_t BINARY_HEADER_SIZE = 4;
+    const size_t BINARY_LINEAR_MAX = 8;
+
+    // Appends the encoding of value to out. Throws std::length_error past 4 GiB.
+    void EncodeBinary(const IJSON_VALUE & value, string_t & out);
+    inline void EncodeBinary(const IJValue & value, string_t & out) { EncodeBinary(value.GetValue(), out); }
+
+    inline string_t EncodeBinary(const IJValue & value) {
+        string_t out;
+        EncodeBinary(value, out);
+        return out;
+    }
+
+    // Builds a document from an encoded buffer after resetting doc. JPARSE_BORROW
+    // leaves strings pointing into data. Malformed input throws TJParseError.
+    void DecodeBinary(const char * data, size_t size, TJDocument & doc, EJParseMode mode = JPARSE_COPY);
+
+    inline TJDocument DecodeBinary(const char * data, size_t size) {
+        TJDocument doc;
+        DecodeBinary(data, size, doc);
+        return doc;
+    }
+
+    inline TJDocument DecodeBinary(const string_t & data) { return DecodeBinary(data.data(), data.size()); }
+
+    // Value read in place from an encoded buffer: nothing is decoded until asked
+    // for, elements and keys are reached through the offset tables. A view taken
+    // from a missing key or an out of range index is Empty(). Offsets are checked
+    // against the buffer on every access; corrupt input throws TJParseError.
+    // Scalar accessors convert between types the way IJSON_VALUE does.
+    class TJBinaryValue {
+        const char * data;
+        size_t size;
+        size_t offset;
+
+        // Checks that count bytes at pos lie in the buffer
+        inline void Need(size_t pos, size_t count) const {
+            if (pos > size || size - pos < count) {
+                throw TJParseError("Truncated binary value", pos);
+            }
+        }
+
+        inline uint32_t LoadSize(size_t pos) const {
+            Need(pos, sizeof(uint32_t));
+            uint32_t val;
+            std::memcpy(&val, data + pos, sizeof(val));
+            return val;
+        }
+
+        template<class T>
+        inline T LoadPayload() const {
+            Need(offset + 1, sizeof(T));
+            T val;
+            std::memcpy(&val, data + offset + 1, sizeof(val));
+            return val;
+        }
+
+        TJBinaryValue Child(size_t pos) const;
+        TJStringView Key(size_t entry) const;
+
+        public:
+        TJBinaryValue() : data(nullptr), size(0), offset(0) { }
+        TJBinaryValue(const char * data, size_t size, size_t offset);
+
+        inline bool Empty() const { return data == nullptr; }
+        inline size_t GetOffset() const { return offset; }
+
+        inline EJValueType GetType() const {
+            return Empty() ? JUNDEFINED : static_cast<EJValueType>(data[offset]);
+        }
+
+        bool_t AsBool() const;
+        integer_t AsInteger() const;
+        double_t AsDouble() const;
+
+        // Bytes of a string, an empty view for other types
+        TJStringView AsStringView() const;
+        inline string_t AsString() const {
+            TJStringView str = AsStringView();
+            return string_t(str.data(), str.size());
+        }
+
+        // Elements of an array or entries of a map, 0 for scalars
+        size_t Size() const;
+
+        TJBinaryValue At(size_t index) const;
+
+        // Map entries in insertion order
+        TJStringView KeyAt(size_t index) const;
+        TJBinaryValue ValueAt(size_t index) const;
+
+        TJBinaryValue Find(const char * key, size_t keySize) const;
+        inline TJBinaryValue Find(const string_t & key) const { return Find(key.data(), key.size()); }
+    };
+
+    // Encoded buffer read in place, either caller-owned or a mapped file.
+    class TJBinaryDocument {
+        TJMappedFile file;
+        TJBinaryValue root;
+
+        void Attach(const char * data, size_t size);
+
+        public:
+        // data must outlive the document
+        TJBinaryDocument(const char * data, size_t size) { Attach(data, size); }
+
+        explicit TJBinaryDocument(TJMappedFile && mapped) : file(std::move(mapped)) {
+            Attach(file.Data(), file.Size());
+        }
+
+        static inline TJBinaryDocument Open(const string_t & path) {
+            return TJBinaryDocument(TJMappedFile(path));
+        }
+
+        inline const TJBinaryValue & Root() const { return root; }
+    };
+}
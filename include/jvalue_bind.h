@@ -0,0 +1,348 @@
+#pragma once
+
+#include "jvalue.h"
+#include "jvalue_binary.h"
+#include "jvalue_parser.h"
+#include "jvalue_writer.h"
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace NJValue {
+
+    // Typed binding: plain structs read from parser events or from the binary
+    // encoding and written as JSON, without building any IJSON_VALUE. A struct
+    // is bound once, at global scope, by listing its fields:
+    //
+    //     struct TPoint { int x; double_t y; string_t label; std::vector<integer_t> tags; };
+    //     JVALUE_BIND(TPoint, JVALUE_FIELD(x) JVALUE_FIELD(y) JVALUE_FIELD_AS(label, "name") JVALUE_FIELD(tags))
+    //
+    // Fields may be bool, integral and floating point numbers, string_t,
+    // std::vector of any of these and other bound structs. Each C++ type maps
+    // to one EJValueType at compile time and values of another type throw
+    // TJParseError, except integers read into floating point fields. Integers
+    // that do not fit the field throw too. Keys without a field are skipped;
+    // missing keys and nulls leave the field as it was.
+    template<class T>
+    struct TJBindFields {
+        static const bool bound = false;
+    };
+
+#define JVALUE_FIELD_AS(member, key) visit(key, &TBound::member);
+#define JVALUE_FIELD(member) JVALUE_FIELD_AS(member, #member)
+#define JVALUE_BIND(Type, fields)                                   \
+    namespace NJValue {                                             \
+        template<>                                                  \
+        struct TJBindFields<Type> {                                 \
+            static const bool bound = true;                         \
+            typedef Type TBound;                                    \
+            template<class V> static void Fields(V & visit) { fields } \
+        };                                                          \
+    }
+
+    // Reader, writer and EJValueType of one C++ type. Read() gets the event
+    // that starts the value and leaves the reader after its last event.
+    template<class T, class Enable = void>
+    struct TJBind;
+
+    namespace NBind {
+
+        // Next event of a value that has been fed completely
+        inline EJEvent Pull(TJEventReader & reader) {
+            EJEvent event = reader.Next();
+            if (event == JEVENT_NEED_MORE || event == JEVENT_END) {
+                throw TJParseError("Unexpected end of input", reader.GetOffset());
+            }
+            return event;
+        }
+
+        inline EJValueType EventType(const TJEventReader & reader, EJEvent event) {
+            switch (event) {
+                case JEVENT_START_ARRAY:
+                    return JARRAY;
+                case JEVENT_START_MAP:
+                    return JMAP;
+                default:
+                    return reader.GetValueType();
+            }
+        }
+
+        inline void Skip(TJEventReader & reader, EJEvent event) {
+            if (event != JEVENT_START_ARRAY && event != JEVENT_START_MAP) {
+                return;
+            }
+            size_t depth = reader.GetDepth();
+            while (reader.GetDepth() >= depth) {
+                Pull(reader);
+            }
+        }
+
+        // Integers go into floating point fields, nothing else converts
+        inline bool Accepts(EJValueType field, EJValueType value) {
+            return field == value || (field == JDOUBLE && value == JINTEGER);
+        }
+
+        inline const char * Expected(EJValueType type) {
+            switch (type) {
+                case JBOOL: return "Expected a bool";
+                case JINTEGER: return "Expected an integer";
+                case JDOUBLE: return "Expected a number";
+                case JSTRING: return "Expected a string";
+                case JARRAY: return "Expected an array";
+                default: return "Expected a map";
+            }
+        }
+
+        template<class T>
+        inline void Read(TJEventReader & reader, EJEvent event, T & out) {
+            EJValueType type = EventType(reader, event);
+            if (type == JNULL) {
+                return;
+            }
+            if (!Accepts(TJBind<T>::type, type)) {
+                throw TJParseError(Expected(TJBind<T>::type), reader.GetOffset());
+            }
+            TJBind<T>::Read(reader, event, out);
+        }
+
+        template<class T>
+        inline void Read(const TJBinaryValue & value, T & out) {
+            EJValueType type = value.GetType();
+            if (type == JNULL || type == JUNDEFINED) {
+                return;
+            }
+            if (!Accepts(TJBind<T>::type, type)) {
+                throw TJParseError(Expected(TJBind<T>::type), value.GetOffset());
+            }
+            TJBind<T>::Read(value, out);
+        }
+
+        template<class T>
+        inline T CheckRange(integer_t value, size_t offset) {
+            bool fits = std::is_signed<T>::value
+                ? value >= static_cast<integer_t>(std::numeric_limits<T>::min())
+                  && value <= static_cast<integer_t>(std::numeric_limits<T>::max())
+                : value >= 0 && static_cast<uint64_t>(value) <= static_cast<uint64_t>(std::numeric_limits<T>::max());
+            if (!fits) {
+                throw TJParseError("Integer out of range", offset);
+            }
+            return static_cast<T>(value);
+        }
+
+        // Reads the value of key into the field of that name, if there is one
+        template<class TStruct, class TSource>
+        struct TFieldReader {
+            TStruct & out;
+            const char * key;
+            size_t size;
+            TSource & source;
+            bool found;
+
+            template<size_t N, class M>
+            inline void operator()(const char (&name)[N], M TStruct::*member) {
+                if (!found && size == N - 1 && std::memcmp(key, name, N - 1) == 0) {
+                    found = true;
+                    source.Read(out.*member);
+                }
+            }
+        };
+
+        struct TEventSource {
+            TJEventReader & reader;
+            EJEvent event;
+
+            template<class M>
+            inline void Read(M & field) { NBind::Read(reader, event, field); }
+        };
+
+        struct TBinarySource {
+            TJBinaryValue value;
+
+            template<class M>
+            inline void Read(M & field) { NBind::Read(value, field); }
+        };
+
+        template<class TStruct>
+        struct TFieldWriter {
+            const TStruct & value;
+            TJWriter & writer;
+            bool first;
+
+            template<size_t N, class M>
+            inline void operator()(const char (&name)[N], M TStruct::*member) {
+                writer.WriteRaw(first ? "\"" : ",\"", first ? 1 : 2);
+                first = false;
+                // Field names go out as given, so they must not need escaping
+                writer.WriteRaw(name, N - 1);
+                writer.WriteRaw("\":", 2);
+                TJBind<M>::Write(writer, value.*member);
+            }
+        };
+    }
+
+    template<>
+    struct TJBind<bool> {
+        static const EJValueType type = JBOOL;
+
+        static inline void Read(TJEventReader & reader, EJEvent, bool & out) { out = reader.GetBool(); }
+        static inline void Read(const TJBinaryValue & value, bool & out) { out = value.AsBool(); }
+        static inline void Write(TJWriter & writer, bool value) { writer.WriteBool(value); }
+    };
+
+    template<class T>
+    struct TJBind<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+        static const EJValueType type = JINTEGER;
+
+        static inline void Read(TJEventReader & reader, EJEvent, T & out) {
+            out = NBind::CheckRange<T>(reader.GetInteger(), reader.GetOffset());
+        }
+
+        static inline void Read(const TJBinaryValue & value, T & out) {
+            out = NBind::CheckRange<T>(value.AsInteger(), value.GetOffset());
+        }
+
+        // Unsigned values above the range of integer_t throw std::out_of_range
+        static inline void Write(TJWriter & writer, T value) {
+            if (!std::is_signed<T>::value && static_cast<uint64_t>(value) > static_cast<uint64_t>(std::numeric_limits<integer_t>::max())) {
+                throw std::out_of_range("Integer does not fit integer_t");
+            }
+            writer.WriteInteger(static_cast<integer_t>(value));
+        }
+    };
+
+    template<class T>
+    struct TJBind<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+        static const EJValueType type = JDOUBLE;
+
+        static inline void Read(TJEventReader & reader, EJEvent, T & out) {
+            out = static_cast<T>(reader.GetValueType() == JINTEGER ? static_cast<double_t>(reader.GetInteger()) : reader.GetDouble());
+        }
+
+        static inline void Read(const TJBinaryValue & value, T & out) { out = static_cast<T>(value.AsDouble()); }
+        static inline void Write(TJWriter & writer, T value) { writer.WriteDouble(value); }
+    };
+
+    template<>
+    struct TJBind<string_t> {
+        static const EJValueType type = JSTRING;
+
+        static inline void Read(TJEventReader & reader, EJEvent, string_t & out) { out = reader.GetString(); }
+
+        static inline void Read(const TJBinaryValue & value, string_t & out) {
+            TJStringView str = value.AsStringView();
+            out.assign(str.data(), str.size());
+        }
+
+        static inline void Write(TJWriter & writer, const string_t & value) { writer.WriteString(value.data(), value.size()); }
+    };
+
+    // Reading replaces the elements; null elements are value-initialized
+    template<class T>
+    struct TJBind<std::vector<T>> {
+        static const EJValueType type = JARRAY;
+
+        static void Read(TJEventReader & reader, EJEvent, std::vector<T> & out) {
+            out.clear();
+            for (EJEvent event = NBind::Pull(reader); event != JEVENT_END_ARRAY; event = NBind::Pull(reader)) {
+                T item = T();
+                NBind::Read(reader, event, item);
+                out.push_back(std::move(item));
+            }
+        }
+
+        static void Read(const TJBinaryValue & value, std::vector<T> & out) {
+            size_t size = value.Size();
+            out.clear();
+            out.reserve(size);
+            for (size_t i = 0; i < size; ++i) {
+                T item = T();
+                NBind::Read(value.At(i), item);
+                out.push_back(std::move(item));
+            }
+        }
+
+        static void Write(TJWriter & writer, const std::vector<T> & value) {
+            writer.WriteRaw("[", 1);
+            for (size_t i = 0; i < value.size(); ++i) {
+                if (i != 0) {
+                    writer.WriteRaw(",", 1);
+                }
+                TJBind<T>::Write(writer, value[i]);
+            }
+            writer.WriteRaw("]", 1);
+        }
+    };
+
+    template<class T>
+    struct TJBind<T, typename std::enable_if<TJBindFields<T>::bound>::type> {
+        static const EJValueType type = JMAP;
+
+        static void Read(TJEventReader & reader, EJEvent, T & out) {
+            for (EJEvent event = NBind::Pull(reader); event != JEVENT_END_MAP; event = NBind::Pull(reader)) {
+                // The key stays in the reader's token only until the value is pulled
+                string_t key = reader.GetString();
+                NBind::TEventSource source = { reader, NBind::Pull(reader) };
+                NBind::TFieldReader<T, NBind::TEventSource> visit = { out, key.data(), key.size(), source, false };
+                TJBindFields<T>::Fields(visit);
+                if (!visit.found) {
+                    NBind::Skip(reader, source.event);
+                }
+            }
+        }
+
+        static void Read(const TJBinaryValue & value, T & out) {
+            size_t size = value.Size();
+            for (size_t i = 0; i < size; ++i) {
+                TJStringView key = value.KeyAt(i);
+                NBind::TBinarySource source = { value.ValueAt(i) };
+                NBind::TFieldReader<T, NBind::TBinarySource> visit = { out, key.data(), key.size(), source, false };
+                TJBindFields<T>::Fields(visit);
+            }
+        }
+
+        static void Write(TJWriter & writer, const T & value) {
+            NBind::TFieldWriter<T> visit = { value, writer, true };
+            writer.WriteRaw("{", 1);
+            TJBindFields<T>::Fields(visit);
+            writer.WriteRaw("}", 1);
+        }
+    };
+
+    // Reads one complete JSON text into out, throws TJParseError on syntax
+    // errors, type mismatches and anything after the value
+    template<class T>
+    void FromJson(const char * data, size_t size, T & out) {
+        TJEventReader reader;
+        reader.Feed(data, size);
+        reader.Close();
+        NBind::Read(reader, NBind::Pull(reader), out);
+        // Throws on anything after the value
+        reader.Next();
+    }
+
+    template<class T>
+    inline void FromJson(const string_t & text, T & out) { FromJson(text.data(), text.size(), out); }
+
+    // Reads the value starting at event, the first one pulled for it. The
+    // whole value must have been fed, or the reader closed.
+    template<class T>
+    inline void Read(TJEventReader & reader, EJEvent event, T & out) { NBind::Read(reader, event, out); }
+
+    template<class T>
+    inline void FromBinary(const TJBinaryValue & value, T & out) { NBind::Read(value, out); }
+
+    // Compact JSON, kept in the writer until its next flush
+    template<class T>
+    inline void Write(TJWriter & writer, const T & value) { TJBind<T>::Write(writer, value); }
+
+    template<class T>
+    typename std::enable_if<TJBindFields<T>::bound, string_t>::type ToJson(const T & value) {
+        string_t out;
+        TJStringSink sink(out);
+        TJWriter writer(sink, JWRITE_COMPACT, 1024);
+        TJBind<T>::Write(writer, value);
+        writer.Flush();
+        return out;
+    }
+}
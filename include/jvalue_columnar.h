@@ -0,0 +1,67 @@
+#pragma once
+
+#include "jvalue.h"
+#include "jvalue_thread_pool.h"
+#include <vector>
+
+namespace NJValue {
+
+    // One field of an array of records, with the cells of all records in
+    // contiguous vectors indexed by row. Only the vectors of the column's type
+    // are filled. Cells of invalid rows are 0, false or dictionary word 0.
+    struct TJColumn {
+        string_t name;
+        EJValueType type;                   // JBOOL, JINTEGER, JDOUBLE, JSTRING or JNULL if never set
+        std::vector<uint64_t> valid;        // bit per row: the record has the field and it is not null
+        std::vector<integer_t> integers;
+        std::vector<double_t> doubles;
+        std::vector<uint64_t> bools;        // bit per row
+        std::vector<uint32_t> codes;        // position of each row's string in the dictionary
+        string_t dictionary;                // distinct strings back to back, in order of first appearance
+        std::vector<size_t> offsets;        // start of each dictionary string, then the end of the last
+
+        TJColumn() : type(JNULL) { }
+
+        inline bool IsValid(size_t row) const { return (valid[row >> 6] >> (row & 63)) & 1; }
+        inline bool GetBool(size_t row) const { return (bools[row >> 6] >> (row & 63)) & 1; }
+
+        inline size_t GetDictionarySize() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+        inline TJStringView GetWord(size_t code) const {
+            return TJStringView(dictionary.data() + offsets[code], offsets[code + 1] - offsets[code]);
+        }
+        inline TJStringView GetString(size_t row) const { return GetWord(codes[row]); }
+    };
+
+    // Struct-of-arrays form of an array of maps. The schema comes from the data:
+    // a column per key in order of first appearance, typed by the values it has.
+    // Integers next to doubles make a JDOUBLE column; any other mix, and arrays
+    // or maps, make a JSTRING one that keeps strings as they are and has the
+    // JSON text of everything else. Null and undefined values, missing keys and
+    // elements that are not maps leave the row invalid in the column.
+    class TJColumnar {
+        std::vector<TJColumn> columns;
+        size_t rows;
+
+        friend TJColumnar ToColumns(const IJValue & records);
+        friend TJColumnar ToColumns(const IJValue & records, TJThreadPool & pool, size_t sliceRows);
+
+        public:
+        TJColumnar() : rows(0) { }
+
+        inline size_t GetRows() const { return rows; }
+        inline size_t Size() const { return columns.size(); }
+        inline const TJColumn & operator[](size_t i) const { return columns[i]; }
+
+        // nullptr if no record has the key
+        const TJColumn * Find(const string_t & name) const;
+    };
+
+    TJColumnar ToColumns(const IJValue & records);
+
+    // The same on the pool, in slices of sliceRows records (rounded up to 64,
+    // so slices never share a bitmap word). Records are read from several
+    // threads at once, so they must not come from a TJLazyDocument or a
+    // JPARSE_BORROW parse, whose values change on first access. Must not be
+    // called from a task of the same pool.
+    TJColumnar ToColumns(const IJValue & records, TJThreadPool & pool, size_t sliceRows = 16384);
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "jvalue.h"
+#include "jvalue_arena.h"
+#include <memory>
+
+namespace NJValue {
+
+    // Owns a tree of values. Nodes, string bytes, array and map storage are all carved
+    // from one arena: dropping the document releases everything at once without
+    // visiting a single node, and Reset() lets the next document reuse the memory.
+    // Array elements and borrowed strings point into the document, so it must
+    // outlive any array_t taken from it; copying a value out of it makes it owned,
+    // nested arrays and maps included, and the copy outlives the document.
+    // A document parsed into again and again, see Parse(), stops allocating once
+    // its arena and the parser's scratch have grown to the largest input.
+    class TJDocument {
+        // Held by pointer so maps and lazy strings can keep referring to it across moves
+        std::unique_ptr<TJArena> arena;
+        const IJValue * root;
+        size_t nodeCount;
+        std::vector<uint64_t> scratch;
+
+        inline IJValue * AddNode(IJSON_VALUE && val) {
+            ++nodeCount;
+            return arena->New<TJValue<IJSON_VALUE>>(std::move(val));
+        }
+
+        public:
+        explicit TJDocument(size_t blockSize = 64 << 10)
+            : arena(new TJArena(blockSize)), root(nullptr), nodeCount(0)
+        { }
+
+        TJDocument(TJDocument && doc) = default;
+        TJDocument & operator=(TJDocument && doc) = default;
+        TJDocument(const TJDocument &) = delete;
+        TJDocument & operator=(const TJDocument &) = delete;
+
+        inline const IJValue & Root() const { return *root; }
+        inline void SetRoot(const IJValue * val) { root = val; }
+        inline bool Empty() const { return root == nullptr; }
+
+        inline size_t Size() const { return nodeCount; }
+        inline size_t GetMemoryUsed() const { return arena->GetUsed(); }
+        inline TJArena & GetArena() { return *arena; }
+
+        // Structural index buffer of the parser, kept with its capacity across Reset()
+        inline std::vector<uint64_t> & GetScratch() { return scratch; }
+
+        // Drop every value but keep the arena blocks for the next document
+        inline void Reset() {
+            arena->Reset();
+            root = nullptr;
+            nodeCount = 0;
+        }
+
+        inline IJValue * NewNull() { return AddNode(JSON_NULL()); }
+        inline IJValue * NewBool(bool_t val) { return AddNode(JSON_BOOL(val)); }
+        inline IJValue * NewInteger(integer_t val) { return AddNode(JSON_INTEGER(val)); }
+        inline IJValue * NewDouble(double_t val) { return AddNode(JSON_DOUBLE(val)); }
+
+        inline IJValue * NewString(const char * data, size_t size) {
+            if (size <= IJSON_VALUE::SHORT_STRING_MAX) {
+                return AddNode(JSON_STRING(TJBorrow(), data, size));
+            }
+            JTrace(JTRACE_ALLOCATE, JSTRING, size);
+            return AddNode(JSON_STRING(TJBorrow(), arena->CopyString(data, size), size));
+        }
+
+        inline IJValue * NewString(const string_t & val) { return NewString(val.data(), val.size()); }
+
+        // Raw bytes for a string that is written in place, then passed to NewStringRef()
+        inline char * AllocateString(size_t size) {
+            JTrace(JTRACE_ALLOCATE, JSTRING, size);
+            return static_cast<char *>(arena->Allocate(size, 1));
+        }
+
+        // data must live in this document's arena or outlive the document
+        inline IJValue * NewStringRef(const char * data, size_t size) {
+            return AddNode(JSON_STRING(TJBorrow(), data, size));
+        }
+
+        // Escaped string body decoded into the arena on first access; raw must outlive the document
+        inline IJValue * NewLazyString(const char * raw, size_t size) {
+            TJLazyString * lazy = arena->New<TJLazyString>();
+            lazy->raw = raw;
+            lazy->rawSize = size;
+            lazy->arena = arena.get();
+            lazy->data = nullptr;
+            lazy->size = 0;
+            return AddNode(JSON_STRING(TJBorrow(), lazy));
+        }
+
+        inline IJValue * NewArray(IJValue * const * items, size_t size) {
+            if (size == 0) {
+                return AddNode(JSON_ARRAY());
+            }
+            JTrace(JTRACE_ALLOCATE, JARRAY, size * sizeof(IJValue *));
+            IJValue ** storage = arena->NewArray<IJValue *>(size);
+            std::copy(items, items + size, storage);
+            return AddNode(JSON_ARRAY(TJBorrow(), storage, size));
+        }
+
+        // Empty map storage in the arena, filled by the caller and then wrapped by NewMap()
+        inline map_t * NewMapStorage(size_t capacity = 0) {
+            map_t * map = arena->New<map_t>(arena.get());
+            map->Reserve(capacity);
+            return map;
+        }
+
+        inline IJValue * NewMap(map_t * map) {
+            return AddNode(JSON_MAP(TJBorrow(), map));
+        }
+
+        // Array or map expanded on first access, see TJLazyDocument
+        inline IJValue * NewLazyContainer(const TJLazyContainer * lazy, bool isMap) {
+            if (isMap) {
+                return AddNode(JSON_MAP(TJBorrow(), lazy));
+            }
+            return AddNode(JSON_ARRAY(TJBorrow(), lazy));
+        }
+
+        // Nodes in the arena for the numbers of a packed array
+        inline IJValue * NewPackedArray(const IJSON_VALUE & val) {
+            TJSpan<integer_t> integers = val.AsIntegerSpan();
+            TJSpan<double_t> doubles = val.AsDoubleSpan();
+            std::vector<IJValue *> items(val.Size());
+            for (size_t i = 0; i < items.size(); ++i) {
+                items[i] = integers.empty() ? NewDouble(doubles[i]) : NewInteger(integers[i]);
+            }
+            return NewArray(items.data(), items.size());
+        }
+
+        // Any value; strings, arrays and maps are copied into the arena
+        inline IJValue * NewValue(const IJSON_VALUE & val) {
+            switch (val.GetType()) {
+                case JSTRING:
+                    return NewString(val.AsString());
+                case JARRAY: {
+                    if (val.IsPacked()) {
+                        return NewPackedArray(val);
+                    }
+                    array_t items = val.AsArray();
+                    std::vector<IJValue *> flat(items.begin(), items.end());
+                    return NewArray(flat.data(), flat.size());
+                }
+                case JMAP: {
+                    map_t items = val.AsMap();
+                    map_t * map = NewMapStorage(items.Size());
+                    for (const map_t::TEntry & entry : items) {
+                        map->Set(entry.key, entry.size, entry.value);
+                    }
+                    return NewMap(map);
+                }
+                default:
+                    return AddNode(IJSON_VALUE(val));
+            }
+        }
+
+        // Deep copy whose arrays and maps are all storage of this arena, with a
+        // node for every element, packed numbers and missing (null) elements included
+        IJValue * Import(const IJValue * val);
+    };
+}
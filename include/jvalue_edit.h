@@ -0,0 +1,88 @@
+#pragma once
+
+#include "jvalue.h"
+#include "jvalue_document.h"
+#include "jvalue_writer.h"
+#include <unordered_map>
+#include <vector>
+
+namespace NJValue {
+
+    enum EJPatchOp { JPATCH_ADD = 0, JPATCH_REMOVE, JPATCH_REPLACE };
+
+    // Document changed in place by JSON Patch (RFC 6902) operations at JSON
+    // Pointers (RFC 6901) and written out again after each round of changes.
+    //
+    // ToJson() remembers where every container went in its output. A change
+    // marks the containers on its path dirty; the next ToJson() formats those
+    // again and copies every other container from the previous output as it
+    // is, so the cost of a round is the changed paths plus a copy of bytes.
+    // The changes also accumulate as a patch, see GetPatch().
+    //
+    // Values are copied into the document's own arena. Replaced and removed
+    // values stay there until the garbage outgrows the live document, which is
+    // then copied into a fresh arena; the output after that is formatted in
+    // full once. The tree must only be changed through the methods below.
+    class TJEditableDocument {
+        struct TFragment {
+            size_t offset;                  // from the start of the parent container in the output
+            size_t size;
+            bool dirty;
+        };
+
+        struct TChange {
+            EJPatchOp op;
+            string_t path;
+            string_t value;                 // JSON of the value added or replaced
+        };
+
+        TJDocument doc;
+        IJValue * root;
+        size_t liveMemory;                  // arena bytes after the last copy into a fresh arena
+        std::unordered_map<const IJValue *, TFragment> fragments;
+        string_t output;
+        size_t copied;
+        bool changed;
+        std::vector<TChange> changes;
+        std::vector<IJValue *> ancestors;   // containers above the target of the current change
+
+        IJValue * Resolve(const string_t & path, string_t & last);
+        void Assign(IJValue * target, const IJValue & val);
+        void SetItems(IJValue * array, const std::vector<IJValue *> & items);
+        void Touch();
+        void Emit(TJWriter & writer, const IJValue * node, size_t oldParent, size_t newParent);
+
+        public:
+        explicit TJEditableDocument(const IJValue & root);
+
+        TJEditableDocument(const TJEditableDocument &) = delete;
+        TJEditableDocument & operator=(const TJEditableDocument &) = delete;
+
+        inline const IJValue & Root() const { return *root; }
+        inline size_t GetMemoryUsed() const { return doc.GetMemoryUsed(); }
+
+        // RFC 6902 semantics: Add() inserts into arrays ("-" appends) and adds
+        // or replaces map keys, Remove() and Replace() need the target to exist.
+        // The empty path is the root, which Add() and Replace() replace and
+        // Remove() refuses. Malformed paths throw TJParseError, paths that do
+        // not lead to a place for the value std::out_of_range.
+        void Add(const string_t & path, const IJValue & val);
+        void Remove(const string_t & path);
+        void Replace(const string_t & path, const IJValue & val);
+
+        // Applies an RFC 6902 patch document, an array of operations; "add",
+        // "remove" and "replace" are supported, others throw std::invalid_argument
+        void Apply(const IJValue & patch);
+
+        // Compact JSON of the document, valid until the next change
+        const string_t & ToJson();
+
+        // Bytes of the last ToJson() copied from the output before it
+        inline size_t GetCopiedBytes() const { return copied; }
+
+        // RFC 6902 patch of the changes made since construction or ClearPatch(),
+        // in the order they were made
+        string_t GetPatch() const;
+        inline void ClearPatch() { changes.clear(); }
+    };
+}
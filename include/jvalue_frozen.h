@@ -0,0 +1,129 @@
+#pragma once
+
+#include "jvalue.h"
+#include "jvalue_document.h"
+#include <atomic>
+#include <mutex>
+
+namespace NJValue {
+
+    // Document that no longer changes, safe to read from any number of threads
+    // at once without locking. The whole tree lives in the document's own arena:
+    // strings are copied and decoded, lazy containers expanded and packed numbers
+    // given nodes when it is built, so nothing read through Root() writes to it,
+    // caches included. Values copied out of it are the reader's own, arrays and
+    // maps with everything under them, and stay valid after the document is gone.
+    class TJFrozenDocument {
+        TJDocument doc;
+
+        public:
+        // A document whose root is null
+        TJFrozenDocument();
+
+        // Deep copy of root and everything under it
+        explicit TJFrozenDocument(const IJValue & root);
+
+        // Parsed as with Parse(); throws TJParseError
+        TJFrozenDocument(const char * data, size_t size);
+        explicit TJFrozenDocument(const string_t & text) : TJFrozenDocument(text.data(), text.size()) { }
+
+        TJFrozenDocument(TJFrozenDocument && doc) = default;
+        TJFrozenDocument & operator=(TJFrozenDocument && doc) = default;
+
+        inline const IJValue & Root() const { return doc.Root(); }
+        inline size_t Size() const { return doc.Size(); }
+        inline size_t GetMemoryUsed() const { return doc.GetMemoryUsed(); }
+    };
+
+    // Current version of a frozen document, read by many threads and replaced by
+    // a writer while they read it (read-copy-update). Acquire() hands out a
+    // snapshot that pins the version current at the time: Publish() swaps in a
+    // new version for the snapshots taken after it, and a version is freed by
+    // whoever lets go of it last, the holder or its last snapshot.
+    //
+    // Readers take no lock and never wait. Acquire() is a few atomic operations
+    // on counters every reader shares; a thread that keeps its snapshot and calls
+    // Refresh() per request instead only reads the version number until it changes.
+    // Publish() calls are serialized and wait for Acquire() calls under way.
+    class TJDocumentHolder {
+        struct TVersion {
+            TJFrozenDocument doc;
+            uint64_t number;
+            std::atomic<size_t> refs;
+
+            TVersion(TJFrozenDocument && doc, uint64_t number) : doc(std::move(doc)), number(number), refs(1) { }
+        };
+
+        std::atomic<TVersion *> current;
+        std::atomic<uint64_t> version;
+        // Acquire() calls between reading current and counting their reference,
+        // by the parity of the epoch they started in; Publish() waits for its epoch to drain
+        mutable std::atomic<size_t> readers[2];
+        std::atomic<size_t> epoch;
+        std::mutex writer;
+
+        inline static void Release(TVersion * version) {
+            if (version != nullptr && version->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete version;
+            }
+        }
+
+        public:
+        // Pins one version of the document; copies pin it too
+        class TSnapshot {
+            friend class TJDocumentHolder;
+
+            TVersion * version;
+
+            explicit TSnapshot(TVersion * version) : version(version) { }
+
+            public:
+            TSnapshot() : version(nullptr) { }
+
+            TSnapshot(const TSnapshot & snapshot) : version(snapshot.version) {
+                if (version != nullptr) {
+                    version->refs.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            TSnapshot(TSnapshot && snapshot) noexcept : version(snapshot.version) { snapshot.version = nullptr; }
+
+            TSnapshot & operator=(TSnapshot snapshot) {
+                std::swap(version, snapshot.version);
+                return *this;
+            }
+
+            ~TSnapshot() { Release(version); }
+
+            // Default-constructed snapshots hold no document
+            inline bool Empty() const { return version == nullptr; }
+            inline const TJFrozenDocument & Document() const { return version->doc; }
+            inline const IJValue & Root() const { return version->doc.Root(); }
+
+            // Number Publish() returned for this version, 0 if Empty()
+            inline uint64_t GetVersion() const { return version == nullptr ? 0 : version->number; }
+        };
+
+        // Version 1, a null document until the first Publish()
+        TJDocumentHolder();
+        explicit TJDocumentHolder(TJFrozenDocument && doc);
+        ~TJDocumentHolder();
+
+        TJDocumentHolder(const TJDocumentHolder &) = delete;
+        TJDocumentHolder & operator=(const TJDocumentHolder &) = delete;
+
+        TSnapshot Acquire() const;
+
+        // Makes snapshot current, unless it already is
+        inline void Refresh(TSnapshot & snapshot) const {
+            if (snapshot.GetVersion() != version.load(std::memory_order_acquire)) {
+                snapshot = Acquire();
+            }
+        }
+
+        // Replaces the document for later Acquire() calls; returns the new version number
+        uint64_t Publish(TJFrozenDocument && doc);
+
+        inline uint64_t GetVersion() const { return version.load(std::memory_order_acquire); }
+    };
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "jvalue.h"
+#include "jvalue_arena.h"
+#include <memory>
+#include <vector>
+
+namespace NJValue {
+
+    // Structural hash and equality of values, for unordered containers keyed by
+    // value: std::unordered_set<const IJValue *, TJValueHash, TJValueEqual>
+    struct TJValueHash {
+        inline size_t operator()(const IJValue & val) const { return static_cast<size_t>(val.Hash()); }
+        inline size_t operator()(const IJValue * val) const { return static_cast<size_t>(val->Hash()); }
+    };
+
+    struct TJValueEqual {
+        inline bool operator()(const IJValue & a, const IJValue & b) const { return a.Equals(b); }
+        inline bool operator()(const IJValue * a, const IJValue * b) const { return a->Equals(*b); }
+    };
+
+    // Hash-consing: Intern() gives the one node the interner keeps for each
+    // distinct value, so repeated nulls, bools, numbers, strings and whole
+    // subtrees are stored once and values interned by the same interner are
+    // Equals() exactly when they are the same node. Nodes are built bottom-up,
+    // children first, so a container is matched by the identity of its
+    // children and its hash comes from theirs without walking them again. A
+    // map equal to one interned before comes back as that one, in its order.
+    // Nodes live in the interner's arena: they must not be changed and must
+    // not outlive it, or Reset(). Not thread-safe.
+    class TJInterner {
+        // Node with its structural hash; the value comes first so a node
+        // pointer is a pointer to its TNode
+        struct TNode {
+            TJValue<IJSON_VALUE> value;
+            uint64_t hash;
+
+            TNode(IJSON_VALUE && val, uint64_t hash) : value(std::move(val)), hash(hash) { }
+        };
+
+        // Hashes sit next to the pointers, so probing reads no node that does not match
+        struct TSlot {
+            uint64_t hash;
+            TNode * node;
+        };
+
+        std::unique_ptr<TJArena> arena;
+        std::vector<TSlot> table;       // open addressing, at most half full
+        std::vector<TNode *> children;  // nodes of the elements of the containers being interned
+        size_t size;
+
+        inline void Insert(const TSlot & entry) {
+            size_t mask = table.size() - 1;
+            size_t slot = entry.hash & mask;
+            while (table[slot].node != nullptr) {
+                slot = (slot + 1) & mask;
+            }
+            table[slot] = entry;
+        }
+
+        template<class F>
+        TNode * Lookup(uint64_t hash, F matches) const;
+        TNode * Add(IJSON_VALUE && val, uint64_t hash);
+
+        TNode * InternScalar(const IJSON_VALUE & val);
+        TNode * InternArray(const IJSON_VALUE & val);
+        TNode * InternMap(const IJSON_VALUE & val);
+        TNode * InternNode(const IJValue * val);
+
+        public:
+        explicit TJInterner(size_t blockSize = 64 << 10)
+            : arena(new TJArena(blockSize)), size(0)
+        { }
+
+        TJInterner(TJInterner && interner) = default;
+        TJInterner & operator=(TJInterner && interner) = default;
+        TJInterner(const TJInterner &) = delete;
+        TJInterner & operator=(const TJInterner &) = delete;
+
+        // Node of the value, added with any of its parts not seen before.
+        // Missing elements come back as null nodes.
+        inline const IJValue * Intern(const IJValue & val) { return &InternNode(&val)->value; }
+
+        // Hash() of a node returned by Intern(), kept with the node
+        inline static uint64_t Hash(const IJValue * interned) {
+            return reinterpret_cast<const TNode *>(interned)->hash;
+        }
+
+        // Distinct values interned
+        inline size_t Size() const { return size; }
+        inline size_t GetMemoryUsed() const { return arena->GetUsed() + table.capacity() * sizeof(TSlot); }
+
+        // Drop every node but keep the arena blocks and the table
+        inline void Reset() {
+            arena->Reset();
+            table.assign(table.size(), TSlot());
+            children.clear();
+            size = 0;
+        }
+    };
+}
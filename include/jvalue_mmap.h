@@ -0,0 +1,43 @@
+#pragma once
+
+#include "jvalue.h"
+
+namespace NJValue {
+
+    // Read-only private mapping of a whole file. Throws std::system_error when
+    // the file cannot be opened or mapped; an empty file maps to nothing.
+    class TJMappedFile {
+        const char * data;
+        size_t size;
+
+        void Unmap();
+
+        public:
+        TJMappedFile() : data(nullptr), size(0) { }
+        explicit TJMappedFile(const string_t & path);
+
+        TJMappedFile(TJMappedFile && file) : data(file.data), size(file.size) {
+            file.data = nullptr;
+            file.size = 0;
+        }
+
+        TJMappedFile & operator=(TJMappedFile && file) {
+            if (this != &file) {
+                Unmap();
+                data = file.data;
+                size = file.size;
+                file.data = nullptr;
+                file.size = 0;
+            }
+            return *this;
+        }
+
+        TJMappedFile(const TJMappedFile &) = delete;
+        TJMappedFile & operator=(const TJMappedFile &) = delete;
+
+        ~TJMappedFile() { Unmap(); }
+
+        inline const char * Data() const { return data; }
+        inline size_t Size() const { return size; }
+    };
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "jvalue.h"
+#include "jvalue_document.h"
+#include "jvalue_parser.h"
+#include "jvalue_thread_pool.h"
+
+namespace NJValue {
+
+    struct TJNdjsonOptions {
+        size_t threads;         // workers when no pool is given, 0 means one per hardware thread
+        size_t chunkSize;       // bytes per chunk, each extended to the end of its last line
+        size_t maxPending;      // chunks parsed or parsing but not delivered yet, 0 means twice the workers
+        bool ordered;           // deliver chunks in input order rather than as they finish
+        EJParseMode mode;
+        EJUtf8Mode utf8;
+
+        TJNdjsonOptions()
+            : threads(0), chunkSize(1 << 20), maxPending(0), ordered(true), mode(JPARSE_BORROW), utf8(JUTF8_STRICT)
+        { }
+    };
+
+    // Values of the lines in one chunk of the input, parsed into the batch's own
+    // arena. Batches are recycled once the callback returns, so values must be
+    // copied out to be kept; with JPARSE_BORROW strings also point into the input.
+    class TJNdjsonBatch {
+        TJDocument doc;
+        std::vector<const IJValue *> values;
+        size_t index;
+        size_t offset;
+
+        friend class TJNdjsonReader;
+
+        public:
+        TJNdjsonBatch() : index(0), offset(0) { }
+
+        // Position of the chunk among all chunks and in bytes from the input start
+        inline size_t GetIndex() const { return index; }
+        inline size_t GetOffset() const { return offset; }
+
+        inline size_t Size() const { return values.size(); }
+        inline const IJValue & operator[](size_t i) const { return *values[i]; }
+        inline size_t GetMemoryUsed() const { return doc.GetMemoryUsed(); }
+    };
+
+    using TJNdjsonCallback = std::function<void(const TJNdjsonBatch & batch)>;
+
+    // Parses newline-delimited JSON on a thread pool. The input is cut into
+    // line-aligned chunks that workers parse into batches, each with its own
+    // arena; at most maxPending batches exist at a time, so a slow callback
+    // holds back parsing rather than letting memory grow. The callback always
+    // runs on the calling thread. A parse error stops the work, and the first
+    // error in input order is rethrown with its offset counted from the input
+    // start, once every batch before it has been delivered. One Read() at a time.
+    class TJNdjsonReader {
+        TJThreadPool & pool;
+        TJNdjsonOptions options;
+        // Kept across Read() calls, so their arenas are reused
+        std::vector<std::unique_ptr<TJNdjsonBatch>> batches;
+
+        public:
+        TJNdjsonReader(TJThreadPool & pool, const TJNdjsonOptions & options = TJNdjsonOptions())
+            : pool(pool), options(options)
+        { }
+
+        void Read(const char * data, size_t size, const TJNdjsonCallback & callback);
+    };
+
+    void ParseNdjson(const char * data, size_t size, const TJNdjsonCallback & callback,
+                     const TJNdjsonOptions & options = TJNdjsonOptions());
+
+    // Maps the file for the duration of the call
+    void ParseNdjsonFile(const string_t & path, const TJNdjsonCallback & callback,
+                         const TJNdjsonOptions & options = TJNdjsonOptions());
+}
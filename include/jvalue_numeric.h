@@ -0,0 +1,44 @@
+#pragma once
+
+#include "jvalue.h"
+#include <vector>
+
+namespace NJValue {
+
+    enum EJCompare { JCOMPARE_LESS = 0, JCOMPARE_LESS_EQUAL, JCOMPARE_GREATER, JCOMPARE_GREATER_EQUAL, JCOMPARE_EQUAL, JCOMPARE_NOT_EQUAL };
+
+    // Kernels over contiguous numbers, such as the spans of packed arrays.
+    // Double sums add in the same order whatever the kernel, so the result does
+    // not depend on the CPU; integer sums wrap around. Min() and Max() skip NaNs
+    // and give the largest and the smallest value of the type (infinities for
+    // doubles) when there is nothing to compare.
+    integer_t Sum(TJSpan<integer_t> values, EJSimdKernel kernel = JKERNEL_AUTO);
+    double_t Sum(TJSpan<double_t> values, EJSimdKernel kernel = JKERNEL_AUTO);
+    integer_t Min(TJSpan<integer_t> values, EJSimdKernel kernel = JKERNEL_AUTO);
+    double_t Min(TJSpan<double_t> values, EJSimdKernel kernel = JKERNEL_AUTO);
+    integer_t Max(TJSpan<integer_t> values, EJSimdKernel kernel = JKERNEL_AUTO);
+    double_t Max(TJSpan<double_t> values, EJSimdKernel kernel = JKERNEL_AUTO);
+
+    // Number of values v for which "v op operand" holds; NaNs are only not equal
+    size_t CountIf(TJSpan<integer_t> values, EJCompare op, integer_t operand, EJSimdKernel kernel = JKERNEL_AUTO);
+    size_t CountIf(TJSpan<double_t> values, EJCompare op, double_t operand, EJSimdKernel kernel = JKERNEL_AUTO);
+
+    // out needs room for values.size() numbers. Doubles are truncated as AsInteger() does.
+    void Convert(TJSpan<integer_t> values, double_t * out, EJSimdKernel kernel = JKERNEL_AUTO);
+    void Convert(TJSpan<double_t> values, integer_t * out, EJSimdKernel kernel = JKERNEL_AUTO);
+
+    // The same over the elements of an array as AsDouble() sees them: through
+    // the kernels for packed arrays, one element at a time for the others.
+    // Sum() adds doubles, integers included, in the order of the double kernels,
+    // so it does not depend on how the array is stored and does not wrap.
+    // Values that are not arrays have no elements; Mean() of nothing is NaN.
+    double_t Sum(const IJValue & array);
+    double_t Min(const IJValue & array);
+    double_t Max(const IJValue & array);
+    double_t Mean(const IJValue & array);
+    size_t CountIf(const IJValue & array, EJCompare op, double_t operand);
+
+    // Replace the contents of out with the elements as AsInteger()/AsDouble() see them
+    void ToIntegers(const IJValue & array, std::vector<integer_t> & out);
+    void ToDoubles(const IJValue & array, std::vector<double_t> & out);
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "jvalue.h"
+#include "jvalue_document.h"
+#include "jvalue_mmap.h"
+#include <memory>
+#include <cstdint>
+#include <vector>
+
+namespace NJValue {
+
+    // How parsed strings relate to the input. JPARSE_BORROW keeps strings as views of
+    // the input, which then has to outlive the document; strings with escapes are
+    // decoded on first access.
+    enum EJParseMode { JPARSE_COPY = 0, JPARSE_BORROW };
+
+    enum EJEvent {
+        JEVENT_NEED_MORE = 0,   // current chunk is consumed, Feed() the next one
+        JEVENT_END,             // document is complete and the input is closed
+        JEVENT_START_ARRAY,
+        JEVENT_END_ARRAY,
+        JEVENT_START_MAP,
+        JEVENT_END_MAP,
+        JEVENT_KEY,
+        JEVENT_VALUE            // scalar, see GetValueType()
+    };
+
+    // Resumable pull parser. Tokens may be split at any byte between chunks;
+    // memory is bounded by nesting depth plus the longest single token.
+    // A chunk passed to Feed() must stay valid until Next() returns JEVENT_NEED_MORE.
+    class TJEventReader {
+        enum EState {
+            S_VALUE, S_ARRAY_FIRST, S_MAP_FIRST, S_KEY, S_COLON, S_NEXT,
+            S_STRING, S_NUMBER, S_LITERAL, S_DONE
+        };
+
+        const char * data;
+        size_t size;
+        size_t pos;
+        size_t consumed;
+        bool closed;
+        size_t maxDepth;
+        EJUtf8Mode utf8;
+
+        EState state;
+        std::vector<unsigned char> stack;
+
+        string_t token;
+        bool isKey;
+        int escape;
+        unsigned hexCount;
+        uint32_t hexValue;
+        uint32_t highSurrogate;
+        const char * literal;
+        size_t literalSize;
+
+        EJValueType valueType;
+        bool_t boolValue;
+        integer_t integerValue;
+        double_t doubleValue;
+
+        void Fail(const char * message) const;
+        EJEvent AfterValue(EJValueType type);
+        EJEvent StartValue(char c);
+        EJEvent CloseContainer(unsigned char kind);
+        bool ScanString();
+        EJEvent FinishNumber();
+        void FinishEscape(uint32_t cp);
+
+        public:
+        TJEventReader(size_t maxDepth = 1024, EJUtf8Mode utf8 = JUTF8_STRICT);
+
+        void Feed(const char * data, size_t size);
+        void Close();
+        EJEvent Next();
+
+        inline bool IsDone() const { return state == S_DONE; }
+        inline size_t GetDepth() const { return stack.size(); }
+        inline size_t GetOffset() const { return consumed + pos; }
+
+        // Valid after JEVENT_VALUE (type and scalar) or JEVENT_KEY (string)
+        inline EJValueType GetValueType() const { return valueType; }
+        inline bool_t GetBool() const { return boolValue; }
+        inline integer_t GetInteger() const { return integerValue; }
+        inline double_t GetDouble() const { return doubleValue; }
+        inline const string_t & GetString() const { return token; }
+    };
+
+    class IJEventHandler {
+        public:
+        virtual ~IJEventHandler() { }
+
+        virtual void OnNull() { }
+        virtual void OnBool(bool_t) { }
+        virtual void OnInteger(integer_t) { }
+        virtual void OnDouble(double_t) { }
+        virtual void OnString(const string_t &) { }
+        virtual void OnKey(const string_t &) { }
+        virtual void OnStartArray() { }
+        virtual void OnEndArray() { }
+        virtual void OnStartMap() { }
+        virtual void OnEndMap() { }
+    };
+
+    // Push wrapper over TJEventReader: every Feed() delivers all events the chunk completes.
+    class TJEventParser {
+        TJEventReader reader;
+        IJEventHandler & handler;
+
+        void Drain();
+
+        public:
+        TJEventParser(IJEventHandler & handler, size_t maxDepth = 1024, EJUtf8Mode utf8 = JUTF8_STRICT)
+            : reader(maxDepth, utf8), handler(handler)
+        { }
+
+        inline void Feed(const char * data, size_t size) {
+            reader.Feed(data, size);
+            Drain();
+        }
+
+        inline void Finish() {
+            reader.Close();
+            Drain();
+        }
+
+        inline bool IsDone() const { return reader.IsDone(); }
+    };
+
+    // Structural index of a lazily loaded document and the nodes made from it so far
+    class TJLazyIndex {
+        TJMappedFile file;
+        const char * data;
+        size_t size;
+        std::vector<uint64_t> index;
+        std::vector<uint32_t> ends;     // distance from an opening bracket to its closing one
+        TJDocument doc;
+        const IJValue * root;
+        EJSimdKernel kernel;
+        EJUtf8Mode utf8;
+
+        inline size_t After(size_t i) const {
+            char c = data[index[i]];
+            return (c == '[' || c == '{') ? i + ends[i] + 1 : i + 1;
+        }
+
+        void MatchBrackets();
+        IJValue * MakeNode(size_t i);
+
+        public:
+        TJLazyIndex(TJMappedFile && file, const char * data, size_t size, EJSimdKernel kernel, EJUtf8Mode utf8);
+
+        void Expand(const TJLazyContainer & container);
+
+        inline const IJValue & Root() const { return *root; }
+        inline size_t GetIndexSize() const { return index.size(); }
+        inline size_t GetMemoryUsed() const {
+            return index.capacity() * sizeof(uint64_t) + ends.capacity() * sizeof(uint32_t) + doc.GetMemoryUsed();
+        }
+    };
+
+    // Read-only document over a mapped file or a caller-owned buffer. Only the
+    // structural index is built up front, one SIMD pass plus bracket matching:
+    // containers are expanded a level at a time when first accessed, scalars decoded
+    // then, and strings stay views of the input. Loading cost follows what is read.
+    // Bracket mismatches throw at load time; other syntax errors, and strings that
+    // are not well-formed UTF-8 unless utf8 is JUTF8_LENIENT, throw TJParseError
+    // only when the broken part is reached. Accessors expand state, so concurrent
+    // readers need external locking.
+    class TJLazyDocument {
+        std::unique_ptr<TJLazyIndex> index;
+
+        public:
+        // data must outlive the document
+        TJLazyDocument(const char * data, size_t size, EJSimdKernel kernel = JKERNEL_AUTO, EJUtf8Mode utf8 = JUTF8_STRICT)
+            : index(new TJLazyIndex(TJMappedFile(), data, size, kernel, utf8))
+        { }
+
+        explicit TJLazyDocument(TJMappedFile && file, EJSimdKernel kernel = JKERNEL_AUTO, EJUtf8Mode utf8 = JUTF8_STRICT)
+            : index(new TJLazyIndex(std::move(file), nullptr, 0, kernel, utf8))
+        { }
+
+        static inline TJLazyDocument Open(const string_t & path, EJSimdKernel kernel = JKERNEL_AUTO, EJUtf8Mode utf8 = JUTF8_STRICT) {
+            return TJLazyDocument(TJMappedFile(path), kernel, utf8);
+        }
+
+        inline const IJValue & Root() const { return index->Root(); }
+
+        // Structurals in the index and bytes held by the index and the nodes made so far
+        inline size_t GetIndexSize() const { return index->GetIndexSize(); }
+        inline size_t GetMemoryUsed() const { return index->GetMemoryUsed(); }
+    };
+
+    // Positions of every structural character, opening quote and scalar start in data.
+    void FindStructurals(const char * data, size_t size, std::vector<uint64_t> & index, EJSimdKernel kernel = JKERNEL_AUTO);
+
+    // Strings that are not well-formed UTF-8 throw TJParseError, as in
+    // TJEventReader and TJLazyDocument; JUTF8_LENIENT takes them as they are
+    TJDocument Parse(const char * data, size_t size, EJSimdKernel kernel = JKERNEL_AUTO);
+
+    // Parses into doc after resetting it, so a long-lived document reuses its arena
+    void Parse(const char * data, size_t size, TJDocument & doc, EJParseMode mode = JPARSE_COPY, EJSimdKernel kernel = JKERNEL_AUTO,
+               EJUtf8Mode utf8 = JUTF8_STRICT);
+
+    // Parses each line of data holding a value into doc, which is not reset first,
+    // and appends the values to roots; blank lines are skipped. Newlines inside a
+    // value are not allowed, as in NDJSON.
+    void ParseLines(const char * data, size_t size, TJDocument & doc, std::vector<const IJValue *> & roots,
+                    EJParseMode mode = JPARSE_COPY, EJSimdKernel kernel = JKERNEL_AUTO, EJUtf8Mode utf8 = JUTF8_STRICT);
+
+    inline TJDocument Parse(const string_t & text) {
+        return Parse(text.data(), text.size());
+    }
+}
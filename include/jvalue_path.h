@@ -0,0 +1,54 @@
+#pragma once
+
+#include "jvalue.h"
+#include <vector>
+
+namespace NJValue {
+
+    // JSON Pointer (RFC 6901) compiled once and evaluated against any number of
+    // trees. Besides plain pointers such as "/events/0/user" two kinds of segment
+    // are understood:
+    //     *            every element of an array or value of a map
+    //     start:end    elements of an array from start up to end, either may be
+    //                  left out or be negative to count from the end, e.g. "-3:"
+    // On maps index and slice segments are plain keys, as in RFC 6901.
+    //
+    // Evaluation follows only the matching branches and never copies containers:
+    // results point at nodes of the tree. Over a TJLazyDocument this means only
+    // the containers on the way to the matches are expanded.
+    class TJPath {
+        enum EStep { STEP_KEY, STEP_INDEX, STEP_SLICE, STEP_WILDCARD };
+
+        struct TStep {
+            EStep kind;
+            string_t key;           // decoded segment, used on maps
+            uint32_t hash;
+            long index;             // STEP_INDEX; slice start for STEP_SLICE
+            long end;
+            bool hasStart;
+            bool hasEnd;
+        };
+
+        string_t expression;
+        std::vector<TStep> steps;
+        bool singular;
+
+        void Walk(const IJValue & node, size_t step, std::vector<const IJValue *> & out, bool first) const;
+
+        public:
+        // Throws TJParseError on malformed expressions, offsets are within expression
+        explicit TJPath(const string_t & expression);
+
+        inline const string_t & GetExpression() const { return expression; }
+        inline size_t GetDepth() const { return steps.size(); }
+
+        // True if the path has no wildcard or slice and so matches at most one node
+        inline bool IsSingular() const { return singular; }
+
+        // Appends every match to out in document order
+        void Select(const IJValue & root, std::vector<const IJValue *> & out) const;
+
+        // First match in document order, nullptr if there is none
+        const IJValue * SelectFirst(const IJValue & root) const;
+    };
+}
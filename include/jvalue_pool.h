@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace NJValue {
+
+    // Counters of the calling thread's pool, see TJPool
+    struct TJPoolStats {
+        uint64_t hits;              // allocations served from a free list
+        uint64_t misses;            // allocations that went to the heap, oversized ones included
+        uint64_t released;          // frees that went to the heap: oversized, or the free list was full
+        size_t cachedBytes;         // held in the free lists now
+
+        inline double GetHitRate() const {
+            return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / (hits + misses);
+        }
+    };
+
+    // Thread-local size-class free lists for what owned values put on the heap:
+    // long strings, array and map storage, element nodes, and the blocks of
+    // containers on a TJAllocator without an arena. Sizes are rounded up to a
+    // class, multiples of 16 bytes up to 256 and powers of two up to MAX_SIZE.
+    // A freed block goes on the list of its class in the thread that frees it,
+    // and the next allocation of that class there takes it back without calling
+    // the heap, so a thread building and dropping documents of the same shape
+    // stops allocating after the first few. Blocks come from the heap one by one,
+    // so they may be freed on any thread. Larger blocks bypass the pool. A list
+    // keeps at most MAX_CACHED bytes; what it holds goes back to the heap on
+    // Trim() and when the thread exits.
+    class TJPool {
+        public:
+        static const size_t MAX_SIZE = 1 << 20;
+        static const size_t MAX_CACHED = 1 << 20;
+
+        static void * Allocate(size_t size);
+        static void Deallocate(void * p, size_t size) noexcept;
+
+        // Frees the calling thread's cached blocks
+        static void Trim() noexcept;
+
+        static TJPoolStats GetStats();
+        static void ResetStats();
+    };
+
+    // Base of heap payloads: new and delete of the derived type go through the pool
+    struct TJPooled {
+        inline static void * operator new(size_t size) { return TJPool::Allocate(size); }
+        inline static void * operator new(size_t, void * p) noexcept { return p; }
+        inline static void operator delete(void * p, size_t size) noexcept { TJPool::Deallocate(p, size); }
+        inline static void operator delete(void *, void *) noexcept { }
+    };
+}
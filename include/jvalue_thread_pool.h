@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NJValue {
+
+    // Fixed set of worker threads, each with its own task queue. Submit() spreads
+    // tasks over the queues round-robin; a worker takes tasks from the front of its
+    // queue and, once that is empty, steals from the back of the others, so a slow
+    // task does not hold up the ones queued behind it. Tasks must not throw.
+    // The destructor runs every queued task, then joins the workers.
+    class TJThreadPool {
+        struct TQueue {
+            std::mutex lock;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<TQueue>> queues;
+        std::vector<std::thread> workers;
+        std::atomic<size_t> queued;
+        std::atomic<size_t> nextQueue;
+        std::mutex lock;
+        std::condition_variable wake;
+        bool stopping;
+
+        bool Take(size_t self, std::function<void()> & task);
+        void Run(size_t self);
+
+        public:
+        // 0 threads means one per hardware thread
+        explicit TJThreadPool(size_t threads = 0);
+        ~TJThreadPool();
+
+        TJThreadPool(const TJThreadPool &) = delete;
+        TJThreadPool & operator=(const TJThreadPool &) = delete;
+
+        inline size_t Size() const { return workers.size(); }
+
+        void Submit(std::function<void()> task);
+    };
+}
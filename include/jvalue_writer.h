@@ -0,0 +1,139 @@
+#pragma once
+
+#include "jvalue.h"
+#include <cstdio>
+#include <vector>
+#include <sys/uio.h>
+
+namespace NJValue {
+
+    // Destination of serialized bytes. WriteV() gets several pieces at once, by
+    // default it writes them one by one.
+    class IJSink {
+        public:
+        virtual ~IJSink() { }
+
+        virtual void Write(const char * data, size_t size) = 0;
+
+        virtual void WriteV(const struct iovec * iov, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                Write(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+            }
+        }
+
+        virtual void Flush() { }
+    };
+
+    class TJStringSink: public IJSink {
+        string_t & out;
+
+        public:
+        explicit TJStringSink(string_t & out) : out(out) { }
+
+        void Write(const char * data, size_t size) override { out.append(data, size); }
+    };
+
+    // Does not own the FILE; throws std::system_error when fwrite() fails
+    class TJFileSink: public IJSink {
+        FILE * file;
+
+        public:
+        explicit TJFileSink(FILE * file) : file(file) { }
+
+        void Write(const char * data, size_t size) override;
+        void Flush() override;
+    };
+
+    // Does not own the descriptor. Pieces go out with one writev() call where
+    // possible; short writes and EINTR are retried, errors throw std::system_error.
+    class TJFdSink: public IJSink {
+        int fd;
+
+        public:
+        explicit TJFdSink(int fd) : fd(fd) { }
+
+        void Write(const char * data, size_t size) override;
+        void WriteV(const struct iovec * iov, size_t count) override;
+    };
+
+    enum EJWriteStyle { JWRITE_COMPACT = 0, JWRITE_PRETTY };
+
+    // Serializes value trees into a fixed-size buffer that is handed to the sink
+    // whenever it fills up, so output size does not affect memory use. String runs
+    // of at least LARGE_PIECE bytes bypass the buffer and go to the sink by
+    // reference together with the buffered bytes before them.
+    // Undefined values and non-finite doubles are written as null.
+    class TJWriter {
+        struct TFrame {
+            const IJSON_VALUE * container;
+            size_t index;
+            map_t::const_iterator entry;
+        };
+
+        IJSink & sink;
+        EJWriteStyle style;
+        size_t indent;
+        EJDoubleFormat doubleFormat;
+        EJUtf8Mode utf8;
+
+        std::vector<char> buffer;
+        size_t used;
+        size_t written;                 // bytes handed to the sink
+        std::vector<TFrame> stack;
+
+        inline void Put(char c) {
+            if (used == buffer.size()) {
+                FlushBuffer();
+            }
+            buffer[used++] = c;
+        }
+
+        inline void Put(const char * data, size_t size) {
+            if (size > buffer.size() - used) {
+                PutSlow(data, size);
+                return;
+            }
+            std::memcpy(buffer.data() + used, data, size);
+            used += size;
+        }
+
+        void PutSlow(const char * data, size_t size);
+        void FlushBuffer();
+        void NewLine(size_t depth);
+        void WriteScalar(const IJSON_VALUE & value);
+
+        public:
+        static const size_t LARGE_PIECE = 4096;
+
+        TJWriter(IJSink & sink, EJWriteStyle style = JWRITE_COMPACT, size_t bufferSize = 64 << 10);
+
+        // Spaces per nesting level in JWRITE_PRETTY
+        inline void SetIndent(size_t spaces) { indent = spaces; }
+        inline void SetDoubleFormat(EJDoubleFormat format) { doubleFormat = format; }
+        // JUTF8_STRICT throws TJParseError for strings that are not UTF-8, with the
+        // offset in the string; by default their bytes are written as they are
+        inline void SetUtf8Mode(EJUtf8Mode mode) { utf8 = mode; }
+
+        // Bytes written so far, flushed or not
+        inline size_t GetOffset() const { return written + used; }
+
+        // Writes one value and flushes everything to the sink
+        void Write(const IJSON_VALUE & value);
+        inline void Write(const IJValue & value) { Write(value.GetValue()); }
+
+        // Bytes written as is, e.g. separators between values; kept until the next flush
+        inline void WriteRaw(const char * data, size_t size) { Put(data, size); }
+
+        // Single scalars, for output built without a value tree. Like WriteRaw()
+        // they add no separators and are kept until the next flush.
+        inline void WriteNull() { Put("null", 4); }
+        inline void WriteBool(bool_t value) { value ? Put("true", 4) : Put("false", 5); }
+        void WriteInteger(integer_t value);
+        void WriteDouble(double_t value);
+        void WriteString(const char * data, size_t size);
+
+        void Flush();
+    };
+
+    string_t ToJson(const IJValue & value, EJWriteStyle style = JWRITE_COMPACT);
+}
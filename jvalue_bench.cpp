@@ -0,0 +1,572 @@
+#include "jvalue.h"
+#include "jvalue_binary.h"
+#include "jvalue_bind.h"
+#include "jvalue_columnar.h"
+#include "jvalue_document.h"
+#include "jvalue_edit.h"
+#include "jvalue_frozen.h"
+#include "jvalue_hash.h"
+#include "jvalue_ndjson.h"
+#include "jvalue_numeric.h"
+#include "jvalue_parser.h"
+#include "jvalue_path.h"
+#include "jvalue_writer.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <thread>
+#include <string>
+#include <vector>
+
+
+using namespace NJValue;
+
+// Every heap allocation made by the process is counted, so a benchmark can
+// report allocations and bytes per operation; threaded ones count their workers' too.
+namespace {
+    std::atomic<size_t> AllocCount(0);
+    std::atomic<size_t> AllocBytes(0);
+
+    // Out of line, so GCC does not see free() paired with an inlined operator new
+    __attribute__((noinline)) void FreeBlock(void * p) noexcept {
+        std::free(p);
+    }
+}
+
+void * operator new(size_t size) {
+    AllocCount.fetch_add(1, std::memory_order_relaxed);
+    AllocBytes.fetch_add(size, std::memory_order_relaxed);
+    void * p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void * p) noexcept {
+    FreeBlock(p);
+}
+
+void operator delete(void * p, size_t) noexcept {
+    FreeBlock(p);
+}
+
+// Element of the objects corpus, for the typed binding benchmarks
+namespace {
+    struct TRecord {
+        integer_t id;
+        string_t name;
+        double_t score;
+        bool active;
+    };
+}
+
+JVALUE_BIND(TRecord, JVALUE_FIELD(id) JVALUE_FIELD(name) JVALUE_FIELD(score) JVALUE_FIELD(active))
+
+namespace {
+
+    template<class V>
+    inline void DoNotOptimize(const V & value) {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    // Fixed seed, so every run and every release benchmarks the same bytes
+    class TRandom {
+        uint64_t state;
+
+        public:
+        explicit TRandom(uint64_t seed = 0x2545F4914F6CDD1DULL) : state(seed) { }
+
+        inline uint64_t Next() {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
+
+        inline size_t Below(size_t n) { return Next() % n; }
+    };
+
+    std::string RandomWord(TRandom & rnd, size_t size) {
+        std::string word;
+        for (size_t i = 0; i < size; ++i) {
+            word += static_cast<char>('a' + rnd.Below(26));
+        }
+        return word;
+    }
+
+    std::string DeepCorpus() {
+        std::string text;
+        for (int i = 0; i < 900; ++i) {
+            text += (i % 2 == 0) ? "[1, " : "{\"k\": ";
+        }
+        text += "null";
+        for (int i = 899; i >= 0; --i) {
+            text += (i % 2 == 0) ? "]" : "}";
+        }
+        return text;
+    }
+
+    std::string WideCorpus() {
+        TRandom rnd(1);
+        std::string text = "[";
+        for (int i = 0; i < 100000; ++i) {
+            text += std::to_string(rnd.Below(1000000)) + ",";
+        }
+        text.back() = ']';
+        return text;
+    }
+
+    std::string NumericCorpus() {
+        TRandom rnd(2);
+        std::string text = "[";
+        char buf[32];
+        for (int i = 0; i < 50000; ++i) {
+            std::snprintf(buf, sizeof(buf), "%.17g,", double(rnd.Next() >> 11) / double(1ULL << 53) * 1e6 - 5e5);
+            text += buf;
+        }
+        text.back() = ']';
+        return text;
+    }
+
+    std::string StringCorpus() {
+        TRandom rnd(3);
+        std::string text = "[";
+        for (int i = 0; i < 20000; ++i) {
+            text += "\"" + RandomWord(rnd, 8 + rnd.Below(40));
+            if (i % 4 == 0) {
+                text += "\\n\\u00e9\\\"";
+            }
+            text += "\",";
+        }
+        text.back() = ']';
+        return text;
+    }
+
+    // Log records with long messages, some of them not ASCII
+    std::string LogCorpus() {
+        TRandom rnd(6);
+        std::string text = "[";
+        for (int i = 0; i < 5000; ++i) {
+            std::string message;
+            size_t size = 100 + rnd.Below(300);
+            while (message.size() < size) {
+                message += RandomWord(rnd, 3 + rnd.Below(8)) + (rnd.Below(20) == 0 ? " caf\xc3\xa9 \xe2\x82\xac " : " ");
+            }
+            text += "{\"level\": \"info\", \"message\": \"" + message + (i % 10 == 0 ? "\\n\\tat frame" : "") + "\"},";
+        }
+        text.back() = ']';
+        return text;
+    }
+
+    std::string ObjectsCorpus() {
+        TRandom rnd(4);
+        std::string text = "[";
+        for (int i = 0; i < 20000; ++i) {
+            text += "{\"id\": " + std::to_string(i)
+                + ", \"name\": \"" + RandomWord(rnd, 6)
+                + "\", \"score\": " + std::to_string(rnd.Below(1000)) + ".5"
+                + ", \"active\": " + (rnd.Below(2) ? "true" : "false") + "},";
+        }
+        text.back() = ']';
+        return text;
+    }
+
+    std::string NdjsonCorpus() {
+        TRandom rnd(5);
+        std::string text;
+        for (int i = 0; i < 200000; ++i) {
+            text += "{\"id\": " + std::to_string(i)
+                + ", \"name\": \"" + RandomWord(rnd, 8)
+                + "\", \"score\": " + std::to_string(rnd.Below(100000)) + ".25"
+                + ", \"tags\": [\"" + RandomWord(rnd, 4) + "\", \"" + RandomWord(rnd, 5) + "\"]}\n";
+        }
+        return text;
+    }
+
+    struct TBenchmark {
+        std::string name;
+        size_t bytesPerOp;              // input bytes an operation processes, 0 if not meaningful
+        std::function<void()> op;
+    };
+
+    struct TResult {
+        size_t iterations;
+        double nsPerOp;
+        double bytesPerOp;
+        double allocsPerOp;
+        double mbPerSec;
+        double opsPerSec;
+    };
+
+    TResult Run(const TBenchmark & bench, double minSeconds) {
+        bench.op();     // warm up caches and the documents reused between iterations
+
+        size_t iterations = 1;
+        while (true) {
+            size_t allocs = AllocCount.load(std::memory_order_relaxed);
+            size_t bytes = AllocBytes.load(std::memory_order_relaxed);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; ++i) {
+                bench.op();
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (seconds >= minSeconds || iterations >= (size_t(1) << 30)) {
+                TResult result;
+                result.iterations = iterations;
+                result.nsPerOp = seconds * 1e9 / iterations;
+                result.bytesPerOp = double(AllocBytes.load(std::memory_order_relaxed) - bytes) / iterations;
+                result.allocsPerOp = double(AllocCount.load(std::memory_order_relaxed) - allocs) / iterations;
+                result.opsPerSec = iterations / seconds;
+                result.mbPerSec = bench.bytesPerOp * result.opsPerSec / (1 << 20);
+                return result;
+            }
+            iterations = seconds <= 0.0 ? iterations * 10 : std::max(iterations * 2, size_t(iterations * minSeconds * 1.2 / seconds));
+        }
+    }
+
+    void AddParse(std::vector<TBenchmark> & benchmarks, const std::string & name, const std::string & text) {
+        std::shared_ptr<TJDocument> doc(new TJDocument());
+        benchmarks.push_back(TBenchmark{ "parse/" + name, text.size(), [&text, doc]() {
+            Parse(text.data(), text.size(), *doc);
+            DoNotOptimize(doc->Root());
+        }});
+        benchmarks.push_back(TBenchmark{ "parse_borrow/" + name, text.size(), [&text, doc]() {
+            Parse(text.data(), text.size(), *doc, JPARSE_BORROW);
+            DoNotOptimize(doc->Root());
+        }});
+        // Index only, plus the first element: what a lookup in a large file costs
+        benchmarks.push_back(TBenchmark{ "lazy_first/" + name, text.size(), [&text]() {
+            TJLazyDocument lazy(text.data(), text.size());
+            const IJSON_VALUE & root = lazy.Root().GetValue();
+            DoNotOptimize(root.Size() == 0 ? nullptr : root.At(0));
+        }});
+    }
+
+    // Discards the output, so only serialization itself is measured
+    class TNullSink: public IJSink {
+        public:
+        void Write(const char *, size_t) override { }
+    };
+
+    void AddSerialize(std::vector<TBenchmark> & benchmarks, const std::string & name, const std::string & text) {
+        std::shared_ptr<TJDocument> doc(new TJDocument(Parse(text)));
+        std::shared_ptr<TNullSink> sink(new TNullSink());
+        std::shared_ptr<TJWriter> writer(new TJWriter(*sink));
+        benchmarks.push_back(TBenchmark{ "serialize/" + name, text.size(), [doc, sink, writer]() {
+            writer->Write(doc->Root());
+        }});
+        std::shared_ptr<std::string> encoded(new std::string(EncodeBinary(doc->Root())));
+        benchmarks.push_back(TBenchmark{ "encode_binary/" + name, text.size(), [doc, encoded]() {
+            encoded->clear();
+            EncodeBinary(doc->Root(), *encoded);
+        }});
+        std::shared_ptr<TJDocument> decoded(new TJDocument());
+        benchmarks.push_back(TBenchmark{ "decode_binary/" + name, encoded->size(), [encoded, decoded]() {
+            DecodeBinary(encoded->data(), encoded->size(), *decoded, JPARSE_BORROW);
+            DoNotOptimize(decoded->Root());
+        }});
+    }
+
+    // Scaling of parallel ingestion: 1, 2, 4... workers up to the hardware threads
+    void AddNdjson(std::vector<TBenchmark> & benchmarks, const std::string & text) {
+        size_t hardware = std::max(std::thread::hardware_concurrency(), 1u);
+        for (size_t threads = 1; ; threads *= 2) {
+            threads = std::min(threads, hardware);
+            std::shared_ptr<TJThreadPool> pool(new TJThreadPool(threads));
+            std::shared_ptr<TJNdjsonReader> reader(new TJNdjsonReader(*pool));
+            benchmarks.push_back(TBenchmark{ "ndjson/threads_" + std::to_string(threads), text.size(), [&text, pool, reader]() {
+                size_t values = 0;
+                reader->Read(text.data(), text.size(), [&values](const TJNdjsonBatch & batch) {
+                    values += batch.Size();
+                });
+                DoNotOptimize(values);
+            }});
+            if (threads == hardware) {
+                break;
+            }
+        }
+    }
+
+    void Usage(const char * self) {
+        std::fprintf(stderr,
+            "Usage: %s [--json] [--min-time SECONDS] [FILTER...]\n"
+            "  --json       one JSON object per benchmark, for diffing runs\n"
+            "  --min-time   minimal measured time per benchmark, 0.5 by default\n"
+            "  FILTER       run only benchmarks whose name contains one of the filters\n",
+            self);
+    }
+}
+
+int main(int argc, char ** argv) {
+    bool json = false;
+    double minSeconds = 0.5;
+    std::vector<std::string> filters;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            minSeconds = std::atof(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            Usage(argv[0]);
+            return 1;
+        } else {
+            filters.push_back(argv[i]);
+        }
+    }
+
+    static const std::string deep = DeepCorpus();
+    static const std::string wide = WideCorpus();
+    static const std::string numeric = NumericCorpus();
+    static const std::string strings = StringCorpus();
+    static const std::string objects = ObjectsCorpus();
+    static const std::string ndjson = NdjsonCorpus();
+    static const std::string logs = LogCorpus();
+
+    std::vector<TBenchmark> benchmarks;
+
+    benchmarks.push_back(TBenchmark{ "construct/integer", 0, []() {
+        TJValue<JSON_INTEGER> v = 12345;
+        DoNotOptimize(v);
+    }});
+    benchmarks.push_back(TBenchmark{ "construct/short_string", 0, []() {
+        TJValue<JSON_STRING> v = "short";
+        DoNotOptimize(v);
+    }});
+    benchmarks.push_back(TBenchmark{ "construct/long_string", 0, []() {
+        TJValue<JSON_STRING> v = "a string that does not fit in the value itself";
+        DoNotOptimize(v);
+    }});
+
+    static const TJValue<JSON_STRING> integerString = "1234567";
+    static const TJValue<JSON_STRING> doubleString = "-12345.678e-3";
+    static const TJValue<JSON_STRING> wordString = "not a number";
+    benchmarks.push_back(TBenchmark{ "coerce/string_as_integer", 0, []() {
+        integer_t v = integerString.AsInteger();
+        DoNotOptimize(v);
+    }});
+    benchmarks.push_back(TBenchmark{ "coerce/string_as_double", 0, []() {
+        double_t v = doubleString.AsDouble();
+        DoNotOptimize(v);
+    }});
+    benchmarks.push_back(TBenchmark{ "coerce/word_as_integer", 0, []() {
+        integer_t v = wordString.AsInteger();
+        DoNotOptimize(v);
+    }});
+
+    benchmarks.push_back(TBenchmark{ "format/integer", 0, []() {
+        char buf[FORMAT_INTEGER_MAX];
+        DoNotOptimize(FormatInteger(buf, -1234567890123L));
+    }});
+    benchmarks.push_back(TBenchmark{ "format/double", 0, []() {
+        char buf[FORMAT_DOUBLE_MAX];
+        DoNotOptimize(FormatDouble(buf, 12345.678901234567));
+    }});
+    benchmarks.push_back(TBenchmark{ "format/double_fixed", 0, []() {
+        char buf[FORMAT_FIXED_MAX];
+        DoNotOptimize(FormatDouble(buf, 12345.678901234567, JDOUBLE_FIXED));
+    }});
+
+    static std::deque<TJValue<JSON_INTEGER>> items;
+    static array_t itemPtrs;
+    for (int i = 0; i < 1000; ++i) {
+        items.push_back(TJValue<JSON_INTEGER>(i));
+        itemPtrs.push_back(&items.back());
+    }
+    static const TJValue<JSON_ARRAY> array1k = itemPtrs;
+    benchmarks.push_back(TBenchmark{ "copy/array_1k", 0, []() {
+        TJValue<JSON_ARRAY> copy = array1k;
+        DoNotOptimize(copy);
+    }});
+
+    // An owned tree built and dropped, all of its blocks taken from and returned to the pool
+    benchmarks.push_back(TBenchmark{ "pool/build_owned", 0, []() {
+        TJValue<JSON_ARRAY> rows;
+        for (int i = 0; i < 100; ++i) {
+            TJValue<JSON_ARRAY> row;
+            row.PushBack(TJValue<JSON_STRING>("a string that does not fit in the value itself"));
+            row.PushBack(TJValue<JSON_INTEGER>(i));
+            row.PushBack(TJValue<JSON_BOOL>(true));
+            rows.PushBack(row);
+        }
+        DoNotOptimize(rows);
+    }});
+
+    // Pulling one field out of every element: a compiled path against copying through AsArray()
+    static const TJDocument objectsDoc = Parse(objects);
+    static const TJPath names("/*/name");
+    benchmarks.push_back(TBenchmark{ "path/select_wildcard", 0, []() {
+        std::vector<const IJValue *> out;
+        names.Select(objectsDoc.Root(), out);
+        DoNotOptimize(out.size());
+    }});
+    benchmarks.push_back(TBenchmark{ "path/by_hand_as_array", 0, []() {
+        std::vector<const IJValue *> out;
+        for (IJValue * item : objectsDoc.Root().AsArray()) {
+            out.push_back(item->Find("name"));
+        }
+        DoNotOptimize(out.size());
+    }});
+
+    // Aggregates over 50k doubles: packed numbers against the parsed nodes
+    static const TJDocument numericDoc = Parse(numeric);
+    static const TJValue<JSON_ARRAY> packed(numericDoc.Root().GetValue());
+    benchmarks.push_back(TBenchmark{ "numeric/sum_packed", 0, []() {
+        DoNotOptimize(Sum(packed));
+    }});
+    benchmarks.push_back(TBenchmark{ "numeric/sum_nodes", 0, []() {
+        DoNotOptimize(Sum(numericDoc.Root()));
+    }});
+    benchmarks.push_back(TBenchmark{ "numeric/count_if_packed", 0, []() {
+        DoNotOptimize(CountIf(packed, JCOMPARE_GREATER, 0.0));
+    }});
+    benchmarks.push_back(TBenchmark{ "numeric/count_if_nodes", 0, []() {
+        DoNotOptimize(CountIf(numericDoc.Root(), JCOMPARE_GREATER, 0.0));
+    }});
+    benchmarks.push_back(TBenchmark{ "numeric/pack", 0, []() {
+        TJValue<JSON_ARRAY> copy(numericDoc.Root().GetValue());
+        DoNotOptimize(copy);
+    }});
+
+    // Records into structs: bound straight from the events against a tree copied out by hand
+    benchmarks.push_back(TBenchmark{ "bind/read", objects.size(), []() {
+        std::vector<TRecord> records;
+        FromJson(objects, records);
+        DoNotOptimize(records.size());
+    }});
+    benchmarks.push_back(TBenchmark{ "bind/parse_and_copy", objects.size(), []() {
+        TJDocument doc = Parse(objects);
+        std::vector<TRecord> records;
+        for (IJValue * item : doc.Root().AsArray()) {
+            TRecord record;
+            record.id = item->Find("id")->AsInteger();
+            record.name = item->Find("name")->AsString();
+            record.score = item->Find("score")->AsDouble();
+            record.active = item->Find("active")->AsBool();
+            records.push_back(record);
+        }
+        DoNotOptimize(records.size());
+    }});
+    static std::vector<TRecord> boundRecords;
+    FromJson(objects, boundRecords);
+    benchmarks.push_back(TBenchmark{ "bind/write", 0, []() {
+        string_t out;
+        TJStringSink sink(out);
+        TJWriter writer(sink);
+        Write(writer, boundRecords);
+        writer.Flush();
+        DoNotOptimize(out.size());
+    }});
+
+    // Records to columns, on the calling thread and on every hardware thread
+    benchmarks.push_back(TBenchmark{ "columnar/sequential", 0, []() {
+        DoNotOptimize(ToColumns(objectsDoc.Root()).GetRows());
+    }});
+    static TJThreadPool columnarPool;
+    benchmarks.push_back(TBenchmark{ "columnar/pool", 0, []() {
+        DoNotOptimize(ToColumns(objectsDoc.Root(), columnarPool, 1024).GetRows());
+    }});
+
+    // Deep equality of two parses of the same records, hashing and hash-consing them
+    static const TJDocument objectsTwin = Parse(objects);
+    benchmarks.push_back(TBenchmark{ "equal/documents", objects.size(), []() {
+        DoNotOptimize(objectsDoc.Root().Equals(objectsTwin.Root()));
+    }});
+    static const TJValue<JSON_ARRAY> packedTwin(numericDoc.Root().GetValue());
+    benchmarks.push_back(TBenchmark{ "equal/packed", 0, []() {
+        DoNotOptimize(packed.Equals(packedTwin));
+    }});
+    benchmarks.push_back(TBenchmark{ "hash/documents", objects.size(), []() {
+        DoNotOptimize(objectsDoc.Root().Hash());
+    }});
+    static TJInterner interner;
+    benchmarks.push_back(TBenchmark{ "intern/objects", objects.size(), []() {
+        interner.Reset();
+        DoNotOptimize(interner.Intern(objectsDoc.Root()));
+    }});
+
+    // One leaf changed, then written out again: copying the untouched records against formatting them all
+    static TJEditableDocument editable(objectsDoc.Root());
+    benchmarks.push_back(TBenchmark{ "edit/rewrite_leaf", objects.size(), []() {
+        static integer_t n = 0;
+        editable.Replace("/500/id", TJValue<JSON_INTEGER>(++n));
+        DoNotOptimize(editable.ToJson().size());
+    }});
+    benchmarks.push_back(TBenchmark{ "edit/rewrite_full", objects.size(), []() {
+        DoNotOptimize(ToJson(editable.Root()).size());
+    }});
+
+    // A reader's cost per request: a snapshot taken afresh against one kept and refreshed
+    static TJDocumentHolder holder(TJFrozenDocument(objectsDoc.Root()));
+    benchmarks.push_back(TBenchmark{ "frozen/acquire", 0, []() {
+        TJDocumentHolder::TSnapshot snapshot = holder.Acquire();
+        DoNotOptimize(snapshot.Root().At(500));
+    }});
+    benchmarks.push_back(TBenchmark{ "frozen/refresh", 0, []() {
+        static TJDocumentHolder::TSnapshot snapshot;
+        holder.Refresh(snapshot);
+        DoNotOptimize(snapshot.Root().At(500));
+    }});
+
+    // String kernels over whole log text, where the parser and the writer use them per string
+    for (EJSimdKernel kernel : { JKERNEL_SCALAR, JKERNEL_AVX2 }) {
+        std::string suffix = kernel == JKERNEL_SCALAR ? "scalar" : "avx2";
+        benchmarks.push_back(TBenchmark{ "utf8/validate_" + suffix, logs.size(), [kernel]() {
+            DoNotOptimize(FindInvalidUtf8(logs.data(), logs.size(), kernel));
+        }});
+        benchmarks.push_back(TBenchmark{ "utf8/find_escape_" + suffix, logs.size(), [kernel]() {
+            size_t found = 0;
+            for (size_t i = 0; i < logs.size(); i += found + 1) {
+                found = FindEscape(logs.data() + i, logs.size() - i, kernel);
+            }
+            DoNotOptimize(found);
+        }});
+    }
+
+    AddParse(benchmarks, "deep", deep);
+    AddParse(benchmarks, "wide", wide);
+    AddParse(benchmarks, "numeric", numeric);
+    AddParse(benchmarks, "strings", strings);
+    AddParse(benchmarks, "objects", objects);
+    AddParse(benchmarks, "logs", logs);
+
+    AddSerialize(benchmarks, "deep", deep);
+    AddSerialize(benchmarks, "wide", wide);
+    AddSerialize(benchmarks, "numeric", numeric);
+    AddSerialize(benchmarks, "strings", strings);
+    AddSerialize(benchmarks, "objects", objects);
+    AddSerialize(benchmarks, "logs", logs);
+
+    AddNdjson(benchmarks, ndjson);
+
+    if (!json) {
+        std::printf("%-28s %12s %12s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "bytes/op", "allocs/op", "MB/s");
+    }
+    for (const TBenchmark & bench : benchmarks) {
+        bool selected = filters.empty();
+        for (const std::string & filter : filters) {
+            selected = selected || bench.name.find(filter) != std::string::npos;
+        }
+        if (!selected) {
+            continue;
+        }
+
+        TResult r = Run(bench, minSeconds);
+        if (json) {
+            std::printf("{\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.2f, \"bytes_per_op\": %.2f, "
+                "\"allocs_per_op\": %.2f, \"ops_per_sec\": %.2f, \"mb_per_sec\": %.2f}\n",
+                bench.name.c_str(), r.iterations, r.nsPerOp, r.bytesPerOp, r.allocsPerOp, r.opsPerSec, r.mbPerSec);
+        } else {
+            std::printf("%-28s %12zu %12.1f %12.1f %12.2f %12.1f\n",
+                bench.name.c_str(), r.iterations, r.nsPerOp, r.bytesPerOp, r.allocsPerOp, r.mbPerSec);
+        }
+        std::fflush(stdout);
+    }
+    return 0;
+}
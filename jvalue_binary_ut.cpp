@@ -0,0 +1,134 @@
+#include <boost/test/unit_test.hpp>
+#include "jvalue_binary.h"
+#include "jvalue_writer.h"
+#include <string>
+#include <system_error>
+#include <unistd.h>
+
+
+using namespace NJValue;
+
+BOOST_AUTO_TEST_SUITE(testSuiteJValueBinary)
+
+    BOOST_AUTO_TEST_CASE( testBinaryRoundTrip ) {
+        std::string text = "{\"a\":[1,-2.5,true,false,null,\"x\\ny\"],\"b\":{},\"c\":[],\"d\":{\"e\":[[]]},\"f\":-9223372036854775808}";
+        TJDocument doc = Parse(text);
+        std::string encoded = EncodeBinary(doc.Root());
+        BOOST_CHECK_EQUAL(encoded.substr(0, 3), "JVB");
+
+        TJDocument decoded = DecodeBinary(encoded);
+        BOOST_CHECK_EQUAL(ToJson(decoded.Root()), text);
+        BOOST_CHECK(decoded.Root().GetValue().Find("f")->GetValue().GetType() == JINTEGER);
+
+        TJDocument borrowed;
+        DecodeBinary(encoded.data(), encoded.size(), borrowed, JPARSE_BORROW);
+        BOOST_CHECK_EQUAL(ToJson(borrowed.Root()), text);
+
+        // Undefined survives, unlike in JSON text
+        TJDocument tree;
+        IJValue * items[] = { tree.NewValue(JSON_UNDEFINED()), tree.NewInteger(7) };
+        tree.SetRoot(tree.NewArray(items, 2));
+        TJDocument back = DecodeBinary(EncodeBinary(tree.Root()));
+        BOOST_CHECK(back.Root().GetValue().At(0)->GetValue().GetType() == JUNDEFINED);
+        BOOST_CHECK_EQUAL(back.Root().GetValue().At(1)->GetValue().AsInteger(), 7);
+
+        // Owned containers without elements have no storage
+        TJValue<JSON_MAP> emptyMap;
+        TJDocument emptyBack = DecodeBinary(EncodeBinary(emptyMap));
+        BOOST_CHECK(emptyBack.Root().IsMap());
+        BOOST_CHECK_EQUAL(emptyBack.Root().Size(), 0);
+        BOOST_CHECK_EQUAL(ToJson(DecodeBinary(EncodeBinary(TJValue<JSON_ARRAY>())).Root()), "[]");
+
+        // Deep nesting does not recurse
+        std::string deep(100000, '[');
+        deep += std::string(100000, ']');
+        BOOST_CHECK_EQUAL(ToJson(DecodeBinary(EncodeBinary(Parse(deep).Root())).Root()), deep);
+    }
+
+    BOOST_AUTO_TEST_CASE( testBinaryReader ) {
+        std::string text = "{\"list\":[10,\"20\",2.5,true],\"name\":\"binary\"";
+        for (int i = 0; i < 100; ++i) {
+            text += ",\"k" + std::to_string(i) + "\":" + std::to_string(i);
+        }
+        text += "}";
+        std::string encoded = EncodeBinary(Parse(text).Root());
+
+        TJBinaryDocument doc(encoded.data(), encoded.size());
+        const TJBinaryValue & root = doc.Root();
+        BOOST_CHECK(root.GetType() == JMAP);
+        BOOST_CHECK_EQUAL(root.Size(), 102);
+        BOOST_CHECK_EQUAL(root.KeyAt(0).size(), 4);
+        BOOST_CHECK_EQUAL(root.ValueAt(1).AsString(), "binary");
+        BOOST_CHECK_EQUAL(root.Find("name").AsString(), "binary");
+        for (int i = 0; i < 100; ++i) {
+            BOOST_CHECK_EQUAL(root.Find("k" + std::to_string(i)).AsInteger(), i);
+        }
+        BOOST_CHECK(root.Find("missing").Empty());
+        BOOST_CHECK(root.Find("k100").Empty());
+
+        TJBinaryValue list = root.Find("list");
+        BOOST_CHECK_EQUAL(list.Size(), 4);
+        BOOST_CHECK_EQUAL(list.At(0).AsInteger(), 10);
+        BOOST_CHECK_EQUAL(list.At(1).AsInteger(), 20);
+        BOOST_CHECK_EQUAL(list.At(2).AsDouble(), 2.5);
+        BOOST_CHECK(list.At(3).AsBool());
+        BOOST_CHECK(list.At(4).Empty());
+        BOOST_CHECK(list.Find("x").Empty());
+
+        // Small maps are scanned
+        std::string small = EncodeBinary(Parse("{\"b\":1,\"a\":2}").Root());
+        TJBinaryDocument smallDoc(small.data(), small.size());
+        BOOST_CHECK_EQUAL(smallDoc.Root().Find("a").AsInteger(), 2);
+        BOOST_CHECK_EQUAL(smallDoc.Root().KeyAt(0).size(), 1);
+        BOOST_CHECK_EQUAL(*smallDoc.Root().KeyAt(0).data(), 'b');
+    }
+
+    BOOST_AUTO_TEST_CASE( testBinaryErrors ) {
+        BOOST_CHECK_THROW(TJBinaryDocument("JSON", 4), TJParseError);
+        BOOST_CHECK_THROW(TJBinaryDocument("JV", 2), TJParseError);
+
+        std::string encoded = EncodeBinary(Parse("[\"abc\", [1, 2], {\"k\": null}]").Root());
+        for (size_t size = 0; size < encoded.size(); ++size) {
+            BOOST_CHECK_THROW(DecodeBinary(encoded.data(), size), TJParseError);
+        }
+
+        // Offsets pointing backwards would make cycles
+        std::string cyclic = encoded;
+        uint32_t self = BINARY_HEADER_SIZE;
+        std::memcpy(&cyclic[BINARY_HEADER_SIZE + 5], &self, sizeof(self));
+        BOOST_CHECK_THROW(DecodeBinary(cyclic), TJParseError);
+
+        std::string badType = encoded;
+        badType[BINARY_HEADER_SIZE] = 42;
+        BOOST_CHECK_THROW(DecodeBinary(badType), TJParseError);
+
+        // Nested pairs sharing their child would decode to 2^64 nodes
+        std::string shared = encoded.substr(0, BINARY_HEADER_SIZE);
+        for (uint32_t i = 0; i < 64; ++i) {
+            uint32_t pair[3] = { 2, static_cast<uint32_t>(shared.size() + 13), static_cast<uint32_t>(shared.size() + 13) };
+            shared.push_back(static_cast<char>(JARRAY));
+            shared.append(reinterpret_cast<const char *>(pair), sizeof(pair));
+        }
+        shared.push_back(static_cast<char>(JNULL));
+        BOOST_CHECK_THROW(DecodeBinary(shared), TJParseError);
+        TJBinaryDocument reader(shared.data(), shared.size());
+        BOOST_CHECK_EQUAL(reader.Root().At(1).At(0).GetType(), JARRAY);
+    }
+
+    BOOST_AUTO_TEST_CASE( testBinaryMappedFile ) {
+        char path[] = "/tmp/jvalue_binary_XXXXXX";
+        int fd = mkstemp(path);
+        BOOST_REQUIRE(fd >= 0);
+        std::string encoded = EncodeBinary(Parse("{\"values\": [1, 2, 3]}").Root());
+        BOOST_REQUIRE(write(fd, encoded.data(), encoded.size()) == static_cast<ssize_t>(encoded.size()));
+        close(fd);
+
+        {
+            TJBinaryDocument doc = TJBinaryDocument::Open(path);
+            BOOST_CHECK_EQUAL(doc.Root().Find("values").At(2).AsInteger(), 3);
+        }
+        unlink(path);
+        BOOST_CHECK_THROW(TJBinaryDocument::Open(path), std::system_error);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
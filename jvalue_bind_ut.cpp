@@ -0,0 +1,171 @@
+#include <boost/test/unit_test.hpp>
+#include "jvalue_bind.h"
+#include "jvalue_binary.h"
+#include "jvalue_parser.h"
+#include "jvalue_writer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+using namespace NJValue;
+
+namespace {
+    struct TPoint {
+        int x;
+        double_t y;
+    };
+
+    struct TShape {
+        string_t label;
+        bool closed;
+        uint8_t layer;
+        std::vector<TPoint> points;
+        std::vector<std::vector<integer_t>> groups;
+        TPoint origin;
+        float scale;
+
+        TShape() : closed(false), layer(0), origin(), scale(1.0f) { }
+    };
+}
+
+JVALUE_BIND(TPoint, JVALUE_FIELD(x) JVALUE_FIELD(y))
+JVALUE_BIND(TShape,
+    JVALUE_FIELD_AS(label, "name")
+    JVALUE_FIELD(closed)
+    JVALUE_FIELD(layer)
+    JVALUE_FIELD(points)
+    JVALUE_FIELD(groups)
+    JVALUE_FIELD(origin)
+    JVALUE_FIELD(scale))
+
+namespace {
+    const char SHAPE[] = "{\"name\": \"tri\\nangle\", \"closed\": true, \"layer\": 200,"
+                         " \"comment\": {\"skip\": [1, {\"me\": null}], \"x\": 5},"
+                         " \"points\": [{\"x\": 1, \"y\": 2}, {\"y\": 0.5, \"z\": [], \"x\": -3}, null],"
+                         " \"groups\": [[1, 2], [], [3]],"
+                         " \"origin\": null, \"scale\": 2}";
+
+    void CheckShape(const TShape & shape) {
+        BOOST_CHECK_EQUAL(shape.label, "tri\nangle");
+        BOOST_CHECK(shape.closed);
+        BOOST_CHECK_EQUAL(shape.layer, 200);
+        BOOST_REQUIRE_EQUAL(shape.points.size(), 3);
+        BOOST_CHECK_EQUAL(shape.points[0].x, 1);
+        BOOST_CHECK_EQUAL(shape.points[0].y, 2.0);
+        BOOST_CHECK_EQUAL(shape.points[1].x, -3);
+        BOOST_CHECK_EQUAL(shape.points[1].y, 0.5);
+        BOOST_CHECK_EQUAL(shape.points[2].x, 0);
+        BOOST_REQUIRE_EQUAL(shape.groups.size(), 3);
+        BOOST_CHECK(shape.groups[0] == std::vector<integer_t>({ 1, 2 }));
+        BOOST_CHECK(shape.groups[1].empty());
+        BOOST_CHECK_EQUAL(shape.groups[2][0], 3);
+        BOOST_CHECK_EQUAL(shape.origin.x, 0);
+        BOOST_CHECK_EQUAL(shape.scale, 2.0f);
+    }
+
+    template<class T>
+    string_t ReadError(const string_t & text) {
+        T out = T();
+        try {
+            FromJson(text, out);
+        } catch (const TJParseError & e) {
+            return e.GetMessage();
+        }
+        return "";
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(testSuiteJValueBind)
+
+    BOOST_AUTO_TEST_CASE( testBindRead ) {
+#ifdef JVALUE_STATS
+        ResetStats();
+#endif
+        TShape shape;
+        FromJson(SHAPE, shape);
+        CheckShape(shape);
+#ifdef JVALUE_STATS
+        // Straight from the events, no nodes in between
+        for (int type = JUNDEFINED; type <= JMAP; ++type) {
+            BOOST_CHECK_EQUAL(GetStats(static_cast<EJValueType>(type)).constructed, 0);
+        }
+#endif
+
+        // Missing keys keep what the struct had, vectors are replaced
+        shape.layer = 7;
+        FromJson("{\"groups\": [[4]]}", shape);
+        BOOST_CHECK_EQUAL(shape.layer, 7);
+        BOOST_CHECK_EQUAL(shape.points.size(), 3);
+        BOOST_CHECK_EQUAL(shape.groups.size(), 1);
+
+        std::vector<TPoint> points;
+        FromJson("[{\"x\": 4}, {\"x\": 5}]", points);
+        BOOST_REQUIRE_EQUAL(points.size(), 2);
+        BOOST_CHECK_EQUAL(points[1].x, 5);
+
+        // A value within a stream of events
+        TJEventReader reader;
+        const char text[] = "[{\"x\": 9, \"y\": 1.5}]";
+        reader.Feed(text, sizeof(text) - 1);
+        reader.Close();
+        BOOST_CHECK_EQUAL(reader.Next(), JEVENT_START_ARRAY);
+        TPoint point;
+        Read(reader, reader.Next(), point);
+        BOOST_CHECK_EQUAL(point.x, 9);
+        BOOST_CHECK_EQUAL(point.y, 1.5);
+        BOOST_CHECK_EQUAL(reader.Next(), JEVENT_END_ARRAY);
+    }
+
+    BOOST_AUTO_TEST_CASE( testBindErrors ) {
+        BOOST_CHECK_EQUAL(ReadError<TPoint>("{\"x\": 1.5}"), "Expected an integer");
+        BOOST_CHECK_EQUAL(ReadError<TPoint>("{\"x\": \"1\"}"), "Expected an integer");
+        BOOST_CHECK_EQUAL(ReadError<TPoint>("{\"x\": 3000000000}"), "Integer out of range");
+        BOOST_CHECK_EQUAL(ReadError<TPoint>("[]"), "Expected a map");
+        BOOST_CHECK_EQUAL(ReadError<TPoint>("{\"x\": 1} {}"), "Trailing characters");
+        BOOST_CHECK_EQUAL(ReadError<TPoint>("{\"x\": 1"), "Unexpected end of input");
+        BOOST_CHECK_EQUAL(ReadError<TShape>("{\"layer\": -1}"), "Integer out of range");
+        BOOST_CHECK_EQUAL(ReadError<TShape>("{\"points\": [1]}"), "Expected a map");
+        BOOST_CHECK_EQUAL(ReadError<TShape>("{\"name\": false}"), "Expected a string");
+        BOOST_CHECK_EQUAL(ReadError<std::vector<bool>>("[true, 1]"), "Expected a bool");
+        BOOST_CHECK_EQUAL(ReadError<TShape>("{\"unknown\": [1, }"), "Unexpected character");
+    }
+
+    BOOST_AUTO_TEST_CASE( testBindWrite ) {
+        TShape shape;
+        FromJson(SHAPE, shape);
+        string_t json = ToJson(shape);
+        BOOST_CHECK_EQUAL(json, "{\"name\":\"tri\\nangle\",\"closed\":true,\"layer\":200,"
+                                "\"points\":[{\"x\":1,\"y\":2.0},{\"x\":-3,\"y\":0.5},{\"x\":0,\"y\":0.0}],"
+                                "\"groups\":[[1,2],[],[3]],\"origin\":{\"x\":0,\"y\":0.0},\"scale\":2.0}");
+        // The same text as the tree writer makes of it
+        BOOST_CHECK_EQUAL(ToJson(Parse(json).Root()), json);
+
+        TShape copy;
+        FromJson(json, copy);
+        BOOST_CHECK_EQUAL(ToJson(copy), json);
+
+        string_t out;
+        TJStringSink sink(out);
+        TJWriter writer(sink);
+        Write(writer, std::vector<uint64_t>{ 1, 2 });
+        writer.Flush();
+        BOOST_CHECK_EQUAL(out, "[1,2]");
+        BOOST_CHECK_THROW(Write(writer, std::vector<uint64_t>{ UINT64_MAX }), std::out_of_range);
+    }
+
+    BOOST_AUTO_TEST_CASE( testBindBinary ) {
+        string_t binary = EncodeBinary(Parse(SHAPE).Root());
+        TJBinaryDocument doc(binary.data(), binary.size());
+        TShape shape;
+        FromBinary(doc.Root(), shape);
+        CheckShape(shape);
+
+        TPoint point;
+        BOOST_CHECK_THROW(FromBinary(doc.Root().Find("name"), point), TJParseError);
+        binary = EncodeBinary(Parse("{\"x\": -129}").Root());
+        int8_t narrow = 0;
+        BOOST_CHECK_THROW(FromBinary(TJBinaryDocument(binary.data(), binary.size()).Root().Find("x"), narrow), TJParseError);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
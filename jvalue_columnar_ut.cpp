@@ -0,0 +1,121 @@
+#include <boost/test/unit_test.hpp>
+#include "jvalue_columnar.h"
+#include "jvalue_parser.h"
+#include <string>
+
+
+using namespace NJValue;
+
+namespace {
+    void CheckSameColumns(const TJColumnar & a, const TJColumnar & b) {
+        BOOST_REQUIRE_EQUAL(a.Size(), b.Size());
+        BOOST_CHECK_EQUAL(a.GetRows(), b.GetRows());
+        for (size_t i = 0; i < a.Size(); ++i) {
+            BOOST_CHECK_EQUAL(a[i].name, b[i].name);
+            BOOST_CHECK_EQUAL(a[i].type, b[i].type);
+            BOOST_CHECK(a[i].valid == b[i].valid);
+            BOOST_CHECK(a[i].integers == b[i].integers);
+            BOOST_CHECK(a[i].doubles == b[i].doubles);
+            BOOST_CHECK(a[i].bools == b[i].bools);
+            BOOST_CHECK(a[i].codes == b[i].codes);
+            BOOST_CHECK_EQUAL(a[i].dictionary, b[i].dictionary);
+            BOOST_CHECK(a[i].offsets == b[i].offsets);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(testSuiteJValueColumnar)
+
+    BOOST_AUTO_TEST_CASE( testColumnsSchema ) {
+        TJDocument doc = Parse("[{\"id\": 1, \"price\": 2, \"ok\": true, \"tag\": \"a\"},"
+                               " {\"id\": 2, \"price\": 2.5, \"ok\": false, \"tag\": 3, \"extra\": null},"
+                               " 7,"
+                               " {\"tag\": \"a\", \"id\": null, \"nested\": {\"x\": [1]}},"
+                               " {\"ok\": null}]");
+        TJColumnar columns = ToColumns(doc.Root());
+        BOOST_CHECK_EQUAL(columns.GetRows(), 5);
+        BOOST_REQUIRE_EQUAL(columns.Size(), 6);
+        BOOST_CHECK(columns.Find("missing") == nullptr);
+
+        const TJColumn & id = *columns.Find("id");
+        BOOST_CHECK_EQUAL(&id, &columns[0]);
+        BOOST_CHECK_EQUAL(id.type, JINTEGER);
+        BOOST_CHECK_EQUAL(id.integers[1], 2);
+        BOOST_CHECK(id.IsValid(0) && id.IsValid(1));
+        BOOST_CHECK(!id.IsValid(2) && !id.IsValid(3) && !id.IsValid(4));
+        BOOST_CHECK(id.doubles.empty());
+
+        // Integers next to doubles promote
+        const TJColumn & price = columns[1];
+        BOOST_CHECK_EQUAL(price.type, JDOUBLE);
+        BOOST_CHECK_EQUAL(price.doubles[0], 2.0);
+        BOOST_CHECK_EQUAL(price.doubles[1], 2.5);
+
+        const TJColumn & ok = columns[2];
+        BOOST_CHECK_EQUAL(ok.type, JBOOL);
+        BOOST_CHECK(ok.GetBool(0));
+        BOOST_CHECK(!ok.GetBool(1) && ok.IsValid(1));
+        BOOST_CHECK(!ok.IsValid(4));
+
+        // Mixed types fall back to strings, each distinct string stored once
+        const TJColumn & tag = columns[3];
+        BOOST_CHECK_EQUAL(tag.type, JSTRING);
+        BOOST_CHECK_EQUAL(tag.GetDictionarySize(), 2);
+        BOOST_CHECK_EQUAL(tag.GetString(0), "a");
+        BOOST_CHECK_EQUAL(tag.GetString(1), "3");
+        BOOST_CHECK_EQUAL(tag.codes[3], tag.codes[0]);
+
+        // Only nulls: no type, no valid row
+        const TJColumn & extra = columns[4];
+        BOOST_CHECK_EQUAL(extra.name, "extra");
+        BOOST_CHECK_EQUAL(extra.type, JNULL);
+        BOOST_CHECK_EQUAL(extra.valid[0], 0);
+
+        const TJColumn & nested = columns[5];
+        BOOST_CHECK_EQUAL(nested.type, JSTRING);
+        BOOST_CHECK_EQUAL(nested.GetString(3), "{\"x\":[1]}");
+    }
+
+    BOOST_AUTO_TEST_CASE( testColumnsEmpty ) {
+        TJColumnar columns = ToColumns(TJValue<JSON_MAP>());
+        BOOST_CHECK_EQUAL(columns.GetRows(), 0);
+        BOOST_CHECK_EQUAL(columns.Size(), 0);
+
+        columns = ToColumns(TJValue<JSON_ARRAY>(std::vector<integer_t>{ 1, 2 }));
+        BOOST_CHECK_EQUAL(columns.GetRows(), 2);
+        BOOST_CHECK_EQUAL(columns.Size(), 0);
+    }
+
+    BOOST_AUTO_TEST_CASE( testColumnsParallel ) {
+        std::string text = "[";
+        for (size_t i = 0; i < 5000; ++i) {
+            text += i == 0 ? "" : ",";
+            // Keys change order and fields come and go, so the cache misses too
+            if (i % 7 == 3) {
+                text += "{\"name\": \"n" + std::to_string(i % 97) + "\", \"id\": " + std::to_string(i) + "}";
+            } else {
+                text += "{\"id\": " + std::to_string(i) + ", \"score\": " + std::to_string(i % 10) + ".5"
+                      + ", \"even\": " + (i % 2 == 0 ? "true" : "false")
+                      + ", \"name\": \"n" + std::to_string(i % 89) + "\""
+                      + (i > 4000 ? ", \"late\": 1" : "") + "}";
+            }
+        }
+        text += "]";
+        TJDocument doc = Parse(text);
+
+        TJColumnar sequential = ToColumns(doc.Root());
+        BOOST_REQUIRE_EQUAL(sequential.Size(), 5);
+        BOOST_CHECK_EQUAL(sequential[4].name, "late");
+        const TJColumn & name = *sequential.Find("name");
+        BOOST_CHECK_EQUAL(name.GetString(0), "n0");
+        BOOST_CHECK_EQUAL(name.GetString(3), "n3");
+        BOOST_CHECK_EQUAL(name.GetString(4999), "n" + std::to_string(4999 % 89));
+        BOOST_CHECK_EQUAL(sequential.Find("id")->integers[4999], 4999);
+
+        TJThreadPool pool(4);
+        for (size_t sliceRows : { 1, 64, 100, 1000, 100000 }) {
+            CheckSameColumns(ToColumns(doc.Root(), pool, sliceRows), sequential);
+        }
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
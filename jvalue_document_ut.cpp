@@ -0,0 +1,181 @@
+#include <boost/test/unit_test.hpp>
+#include "jvalue_document.h"
+#include "jvalue_parser.h"
+#include <memory>
+#include <string>
+
+
+using namespace NJValue;
+
+BOOST_AUTO_TEST_SUITE(testSuiteJValueDocument)
+
+    BOOST_AUTO_TEST_CASE( testArena ) {
+        TJArena arena(256);
+        BOOST_CHECK_EQUAL(arena.GetCapacity(), 0);
+
+        char * c = static_cast<char *>(arena.Allocate(1, 1));
+        double * d = arena.New<double>(2.5);
+        BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(d) % alignof(double), 0);
+        BOOST_CHECK_EQUAL(*d, 2.5);
+        BOOST_CHECK(reinterpret_cast<char *>(d) > c);
+
+        // Larger than a block
+        char * big = static_cast<char *>(arena.Allocate(1000, 1));
+        std::memset(big, 'x', 1000);
+        size_t capacity = arena.GetCapacity();
+        BOOST_CHECK(capacity >= 1256);
+
+        arena.Reset();
+        BOOST_CHECK_EQUAL(arena.GetUsed(), 0);
+        BOOST_CHECK_EQUAL(arena.Allocate(1, 1), c);
+        arena.Allocate(1000, 1);
+        BOOST_CHECK_EQUAL(arena.GetCapacity(), capacity);
+
+        TJArena moved(std::move(arena));
+        BOOST_CHECK_EQUAL(moved.GetCapacity(), capacity);
+        BOOST_CHECK_EQUAL(arena.GetCapacity(), 0);
+    }
+
+    BOOST_AUTO_TEST_CASE( testDocumentValues ) {
+        TJDocument doc;
+        IJValue * items[] = {
+            doc.NewNull(),
+            doc.NewBool(true),
+            doc.NewInteger(-15),
+            doc.NewDouble(0.1),
+            doc.NewString("short"),
+            doc.NewString("a string longer than fourteen bytes")
+        };
+        IJValue * root = doc.NewArray(items, 6);
+        doc.SetRoot(root);
+
+        BOOST_CHECK_EQUAL(doc.Size(), 7);
+        BOOST_CHECK_EQUAL(doc.Root().IsArray(), true);
+        BOOST_CHECK_EQUAL(doc.Root().AsString(), "6");
+
+        array_t a = doc.Root().AsArray();
+        BOOST_CHECK_EQUAL(a[0]->IsNull(), true);
+        BOOST_CHECK_EQUAL(a[1]->AsString(), "true");
+        BOOST_CHECK_EQUAL(a[2]->AsInteger(), -15);
+        BOOST_CHECK_EQUAL(a[3]->AsString(), "0.1");
+        BOOST_CHECK_EQUAL(a[4]->AsString(), "short");
+        BOOST_CHECK_EQUAL(a[5]->AsString(), "a string longer than fourteen bytes");
+
+        // Copies taken out of the document own their payload
+        TJValue<JSON_STRING> s(a[5]->GetValue());
+        TJValue<JSON_ARRAY> copy(doc.Root().GetValue());
+        doc.Reset();
+        doc.NewString("overwrites the arena memory of the old string");
+        BOOST_CHECK_EQUAL(s.AsString(), "a string longer than fourteen bytes");
+        BOOST_CHECK_EQUAL(copy.AsInteger(), 6);
+    }
+
+    BOOST_AUTO_TEST_CASE( testDocumentCopyOutlivesDocument ) {
+        const std::string text = "[\"a long string value here!!\",[1,2,\"a nested string, long too\",[true]],"
+            "{\"k\":\"vvvvvvvvvvvvvvvvvvvvvvvv\",\"m\":{\"n\":[null,\"another long nested string\"]}}]";
+
+        std::unique_ptr<TJValue<IJSON_VALUE>> copy;
+        std::unique_ptr<TJValue<JSON_MAP>> map;
+        {
+            TJDocument doc;
+            Parse(text.data(), text.size(), doc);
+            copy.reset(new TJValue<IJSON_VALUE>(doc.Root().GetValue()));
+            map.reset(new TJValue<JSON_MAP>(doc.Root().At(2)->GetValue()));
+        }
+        // Copies of the copies share or copy owned storage
+        TJValue<IJSON_VALUE> again(copy->GetValue());
+        copy.reset();
+
+        BOOST_CHECK_EQUAL(again.At(0)->AsString(), "a long string value here!!");
+        const IJValue * nested = again.At(1);
+        BOOST_CHECK_EQUAL(nested->Size(), 4);
+        BOOST_CHECK_EQUAL(nested->At(1)->AsInteger(), 2);
+        BOOST_CHECK_EQUAL(nested->At(2)->AsString(), "a nested string, long too");
+        BOOST_CHECK_EQUAL(nested->At(3)->At(0)->AsBool(), true);
+        BOOST_CHECK_EQUAL(again.At(2)->Find("k")->AsString(), "vvvvvvvvvvvvvvvvvvvvvvvv");
+        BOOST_CHECK_EQUAL(again.At(2)->Find("m")->Find("n")->At(1)->AsString(), "another long nested string");
+
+        TJValue<JSON_MAP> mapCopy(map->GetValue());
+        map.reset();
+        BOOST_CHECK_EQUAL(mapCopy.Find("k")->AsString(), "vvvvvvvvvvvvvvvvvvvvvvvv");
+        BOOST_CHECK_EQUAL(mapCopy.Find("m")->Find("n")->At(0)->IsNull(), true);
+        BOOST_CHECK_EQUAL(mapCopy.Find("m")->Find("n")->At(1)->AsString(), "another long nested string");
+    }
+
+    BOOST_AUTO_TEST_CASE( testDocumentReuse ) {
+        std::string text = "[";
+        for (int i = 0; i < 1000; ++i) {
+            text += "[" + std::to_string(i) + ", \"value number " + std::to_string(i) + "\", \"esc\\\\aped\\n string\"],";
+        }
+        text += "null]";
+
+        TJDocument doc(4096);
+        Parse(text.data(), text.size(), doc);
+        BOOST_CHECK_EQUAL(doc.Root().AsInteger(), 1001);
+        BOOST_CHECK_EQUAL(doc.Root().AsArray()[999]->AsArray()[1]->AsString(), "value number 999");
+        BOOST_CHECK_EQUAL(doc.Root().AsArray()[999]->AsArray()[2]->AsString(), "esc\\aped\n string");
+
+        size_t capacity = doc.GetArena().GetCapacity();
+        size_t used = doc.GetMemoryUsed();
+        for (int i = 0; i < 10; ++i) {
+            Parse(text.data(), text.size(), doc);
+        }
+        BOOST_CHECK_EQUAL(doc.GetArena().GetCapacity(), capacity);
+        BOOST_CHECK_EQUAL(doc.GetMemoryUsed(), used);
+        BOOST_CHECK_EQUAL(doc.Root().AsArray()[5]->AsArray()[0]->AsInteger(), 5);
+    }
+
+    BOOST_AUTO_TEST_CASE( testDocumentBorrowedStrings ) {
+        const std::string text = "{\"plain\": \"a string that is long enough\", \"esc\": \"tab\\there \\u00e9 and more\", "
+            "\"short\": \"s\\n\", \"list\": [\"x\", \"y\\\"z\"]}";
+
+        TJDocument moved;
+        {
+            TJDocument doc;
+            Parse(text.data(), text.size(), doc, JPARSE_BORROW);
+            moved = std::move(doc);
+        }
+        const IJValue & root = moved.Root();
+
+        TJStringView plain = root.Find("plain")->AsStringView();
+        BOOST_CHECK(plain.data() >= text.data() && plain.data() < text.data() + text.size());
+        BOOST_CHECK(plain == "a string that is long enough");
+
+        size_t used = moved.GetMemoryUsed();
+        BOOST_CHECK_EQUAL(root.Find("esc")->AsString(), "tab\there \xc3\xa9 and more");
+        BOOST_CHECK(moved.GetMemoryUsed() > used);
+        used = moved.GetMemoryUsed();
+        BOOST_CHECK(root.Find("esc")->AsStringView() == "tab\there \xc3\xa9 and more");
+        BOOST_CHECK_EQUAL(moved.GetMemoryUsed(), used);
+
+        BOOST_CHECK_EQUAL(root.Find("short")->AsString(), "s\n");
+        BOOST_CHECK_EQUAL(root.Find("short")->AsBool(), true);
+        BOOST_CHECK_EQUAL(root.Find("list")->AsArray()[1]->AsString(), "y\"z");
+
+        // Escapes are still validated while parsing
+        std::string invalid = "[\"bad \\q escape\"]";
+        TJDocument doc;
+        BOOST_CHECK_THROW(Parse(invalid.data(), invalid.size(), doc, JPARSE_BORROW), TJParseError);
+    }
+
+    BOOST_AUTO_TEST_CASE( testDocumentArrayCopies ) {
+        const std::string text = "{\"list\": [1, \"two\", [3]]}";
+        TJDocument doc;
+        Parse(text.data(), text.size(), doc);
+        const IJValue & list = *doc.Root().Find("list");
+
+        // A copy of an arena array has nodes of its own, changing it leaves the arena alone
+        TJValue<JSON_ARRAY> copy(list.GetValue());
+        copy.PopBack();
+        copy.Set(0, *list.At(2));
+        copy.PushBack(*list.At(1));
+        BOOST_CHECK_EQUAL(list.Size(), 3);
+        BOOST_CHECK_EQUAL(list.At(0)->AsInteger(), 1);
+        BOOST_CHECK_EQUAL(copy.Size(), 3);
+        BOOST_CHECK_EQUAL(copy.At(0)->Size(), 1);
+        BOOST_CHECK(copy.At(1) != list.At(1));
+        BOOST_CHECK(copy.At(1)->Equals(*list.At(1)));
+        BOOST_CHECK_EQUAL(copy.At(2)->AsString(), "two");
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,132 @@
+#include <boost/test/unit_test.hpp>
+#include "jvalue_edit.h"
+#include "jvalue_parser.h"
+#include "jvalue_writer.h"
+#include <stdexcept>
+#include <string>
+
+
+using namespace NJValue;
+
+namespace {
+    const char SOURCE[] = "{\"name\": \"service\", \"ports\": [80, 443], \"limits\": {\"cpu\": 2.5, \"mem\": \"4Gi\"},"
+                          " \"tags\": [{\"k\": \"a\"}, {\"k\": \"b\"}], \"a/b\": {\"~\": 1}, \"empty\": []}";
+
+    // Output the full writer makes of the tree
+    void CheckOutput(TJEditableDocument & doc) {
+        BOOST_CHECK_EQUAL(doc.ToJson(), ToJson(doc.Root()));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(testSuiteJValueEdit)
+
+    BOOST_AUTO_TEST_CASE( testEditIncremental ) {
+        TJEditableDocument doc(Parse(SOURCE).Root());
+        CheckOutput(doc);
+        BOOST_CHECK_EQUAL(doc.GetCopiedBytes(), 0);
+        size_t size = doc.ToJson().size();
+        BOOST_CHECK_EQUAL(doc.GetCopiedBytes(), size);
+
+        // Only the root and "limits" are formatted again
+        doc.Replace("/limits/cpu", TJValue<JSON_INTEGER>(4));
+        CheckOutput(doc);
+        BOOST_CHECK_EQUAL(doc.GetCopiedBytes(), std::string("[80,443]"
+                                                            "[{\"k\":\"a\"},{\"k\":\"b\"}]"
+                                                            "{\"~\":1}").size());
+
+        doc.Add("/ports/1", TJValue<JSON_INTEGER>(8080));
+        doc.Add("/ports/-", TJValue<JSON_INTEGER>(9090));
+        doc.Add("/tags/1/v", TJValue<JSON_STRING>("a string longer than fourteen bytes"));
+        doc.Add("/empty/0", Parse("{\"nested\": [true, null]}").Root());
+        doc.Replace("/a~1b/~0", TJValue<JSON_ARRAY>(std::vector<double_t>{ 0.5, 1.5 }));
+        doc.Remove("/tags/0");
+        doc.Add("/limits/cpu", TJValue<JSON_DOUBLE>(1.5));
+        doc.Remove("/name");
+        CheckOutput(doc);
+        BOOST_CHECK_EQUAL(doc.ToJson(), "{\"ports\":[80,8080,443,9090],\"limits\":{\"cpu\":1.5,\"mem\":\"4Gi\"},"
+                                        "\"tags\":[{\"k\":\"b\",\"v\":\"a string longer than fourteen bytes\"}],"
+                                        "\"a/b\":{\"~\":[0.5,1.5]},\"empty\":[{\"nested\":[true,null]}]}");
+
+        // Changes inside parts copied by the previous round
+        doc.Replace("/empty/0/nested/1", TJValue<JSON_STRING>("x"));
+        CheckOutput(doc);
+        doc.Replace("/tags/0/k", TJValue<JSON_BOOL>(false));
+        CheckOutput(doc);
+        BOOST_CHECK(doc.GetCopiedBytes() > 0);
+
+        doc.Replace("", Parse("[1, [2]]").Root());
+        CheckOutput(doc);
+        doc.Add("/1/-", TJValue<JSON_MAP>());
+        CheckOutput(doc);
+        BOOST_CHECK_EQUAL(doc.ToJson(), "[1,[2,{}]]");
+    }
+
+    BOOST_AUTO_TEST_CASE( testEditPatch ) {
+        TJDocument source = Parse(SOURCE);
+        TJEditableDocument doc(source.Root());
+        doc.Replace("/limits/mem", TJValue<JSON_STRING>("8Gi"));
+        doc.Add("/ports/0", TJValue<JSON_INTEGER>(22));
+        doc.Remove("/a~1b");
+        doc.Add("/tags/-", Parse("{\"k\": \"c\"}").Root());
+        string_t patch = doc.GetPatch();
+        BOOST_CHECK_EQUAL(patch, "[{\"op\":\"replace\",\"path\":\"/limits/mem\",\"value\":\"8Gi\"},"
+                                 "{\"op\":\"add\",\"path\":\"/ports/0\",\"value\":22},"
+                                 "{\"op\":\"remove\",\"path\":\"/a~1b\"},"
+                                 "{\"op\":\"add\",\"path\":\"/tags/-\",\"value\":{\"k\":\"c\"}}]");
+
+        // The patch takes the original to the same document
+        TJEditableDocument replica(source.Root());
+        replica.Apply(Parse(patch).Root());
+        BOOST_CHECK(replica.Root().Equals(doc.Root()));
+        BOOST_CHECK_EQUAL(replica.ToJson(), doc.ToJson());
+
+        doc.ClearPatch();
+        BOOST_CHECK_EQUAL(doc.GetPatch(), "[]");
+        // A value taken from the tree itself is recorded as it was before the change
+        doc.Replace("/limits/cpu", doc.Root());
+        BOOST_CHECK_EQUAL(doc.GetPatch().find("\"cpu\":2.5"), doc.GetPatch().find("\"cpu\""));
+        CheckOutput(doc);
+    }
+
+    BOOST_AUTO_TEST_CASE( testEditErrors ) {
+        TJEditableDocument doc(Parse(SOURCE).Root());
+        TJValue<JSON_NULL> null;
+        BOOST_CHECK_THROW(doc.Replace("limits", null), TJParseError);
+        BOOST_CHECK_THROW(doc.Replace("/a~2b", null), TJParseError);
+        BOOST_CHECK_THROW(doc.Replace("/missing", null), std::out_of_range);
+        BOOST_CHECK_THROW(doc.Replace("/missing/x", null), std::out_of_range);
+        BOOST_CHECK_THROW(doc.Replace("/ports/2", null), std::out_of_range);
+        BOOST_CHECK_THROW(doc.Add("/ports/3", null), std::out_of_range);
+        BOOST_CHECK_THROW(doc.Add("/ports/01", null), std::out_of_range);
+        BOOST_CHECK_THROW(doc.Add("/name/x", null), std::out_of_range);
+        BOOST_CHECK_THROW(doc.Remove("/ports/-"), std::out_of_range);
+        BOOST_CHECK_THROW(doc.Remove("/limits/gpu"), std::out_of_range);
+        BOOST_CHECK_THROW(doc.Remove(""), std::out_of_range);
+        BOOST_CHECK_THROW(doc.Apply(Parse("{}").Root()), std::invalid_argument);
+        BOOST_CHECK_THROW(doc.Apply(Parse("[{\"op\": \"move\", \"from\": \"/a\", \"path\": \"/b\"}]").Root()), std::invalid_argument);
+        BOOST_CHECK_THROW(doc.Apply(Parse("[{\"op\": \"add\", \"path\": \"/b\"}]").Root()), std::invalid_argument);
+        // Failed changes change nothing
+        BOOST_CHECK_EQUAL(doc.GetPatch(), "[]");
+        BOOST_CHECK(doc.Root().Equals(Parse(SOURCE).Root()));
+    }
+
+    BOOST_AUTO_TEST_CASE( testEditGarbage ) {
+        TJEditableDocument doc(Parse(SOURCE).Root());
+        doc.ToJson();
+        size_t start = doc.GetMemoryUsed();
+        // Long strings and containers leave garbage behind, the arena is renewed from time to time
+        for (int i = 0; i < 20000; ++i) {
+            doc.Replace("/limits/mem", TJValue<JSON_STRING>("a long string number " + std::to_string(i)));
+            doc.Add("/ports/-", TJValue<JSON_INTEGER>(i));
+            doc.Remove("/ports/0");
+            if (i % 1000 == 0) {
+                CheckOutput(doc);
+            }
+        }
+        CheckOutput(doc);
+        BOOST_CHECK_LT(doc.GetMemoryUsed(), start + (1 << 20));
+        BOOST_CHECK_EQUAL(doc.Root().Find("ports")->At(1)->AsInteger(), 19999);
+        BOOST_CHECK_EQUAL(doc.Root().Find("limits")->Find("mem")->AsString(), "a long string number 19999");
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,182 @@
+#include <boost/test/unit_test.hpp>
+#include "jvalue_frozen.h"
+#include "jvalue_parser.h"
+#include "jvalue_writer.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+using namespace NJValue;
+
+namespace {
+    const char SOURCE[] = "{\"name\": \"an escaped \\\"name\\\" long enough\", \"ports\": [80, 443],"
+                          " \"limits\": {\"cpu\": 2.5, \"tags\": [\"a\", \"b\\u00e9\"]}, \"empty\": {}}";
+
+    // Document of a version: every reader checks that its parts agree
+    std::string Version(int number) {
+        std::string items;
+        for (int i = 0; i < number % 50; ++i) {
+            items += (i == 0 ? "" : ",") + std::to_string(number);
+        }
+        return "{\"version\": " + std::to_string(number) + ", \"items\": [" + items + "],"
+               " \"label\": \"version number " + std::to_string(number) + "\"}";
+    }
+
+    bool Consistent(const IJValue & root, integer_t & seen) {
+        integer_t number = root.Find("version")->AsInteger();
+        const IJValue * items = root.Find("items");
+        bool ok = number >= seen && items->Size() == static_cast<size_t>(number % 50)
+            && root.Find("label")->AsString() == "version number " + std::to_string(number);
+        for (size_t i = 0; i < items->Size(); ++i) {
+            ok = ok && items->At(i)->AsInteger() == number;
+        }
+        seen = number;
+        return ok;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(testSuiteJValueFrozen)
+
+    BOOST_AUTO_TEST_CASE( testFrozenDocument ) {
+        std::string text = SOURCE;
+        std::string expected = ToJson(Parse(text).Root());
+
+        // Borrowed and lazy strings, lazy containers and packed numbers all end up in its arena
+        TJDocument borrowed;
+        Parse(text.data(), text.size(), borrowed, JPARSE_BORROW);
+        TJFrozenDocument fromBorrowed(borrowed.Root());
+        TJLazyDocument lazy(text.data(), text.size());
+        TJFrozenDocument fromLazy(lazy.Root());
+        TJValue<JSON_ARRAY> packed(std::vector<integer_t>{ 1, 2, 3 });
+        TJFrozenDocument fromPacked(packed);
+        TJFrozenDocument parsed(text);
+        text.assign(text.size(), ' ');
+
+        BOOST_CHECK_EQUAL(ToJson(fromBorrowed.Root()), expected);
+        BOOST_CHECK_EQUAL(ToJson(fromLazy.Root()), expected);
+        BOOST_CHECK_EQUAL(ToJson(parsed.Root()), expected);
+        BOOST_CHECK_EQUAL(ToJson(fromPacked.Root()), "[1,2,3]");
+        BOOST_CHECK(!fromPacked.Root().IsPacked());
+        BOOST_CHECK(TJFrozenDocument().Root().IsNull());
+        BOOST_CHECK_THROW(TJFrozenDocument("[1,"), TJParseError);
+
+        // Many readers at once
+        std::vector<std::thread> threads;
+        std::atomic<size_t> failures(0);
+        for (int t = 0; t < 8; ++t) {
+            threads.emplace_back([&]() {
+                for (int i = 0; i < 200; ++i) {
+                    if (ToJson(parsed.Root()) != expected || parsed.Root().Hash() != fromLazy.Root().Hash()
+                        || parsed.Root().Find("limits")->Find("tags")->At(1)->AsString() != "b\xc3\xa9") {
+                        ++failures;
+                    }
+                }
+            });
+        }
+        for (std::thread & thread : threads) {
+            thread.join();
+        }
+        BOOST_CHECK_EQUAL(failures.load(), 0);
+    }
+
+    BOOST_AUTO_TEST_CASE( testHolderPublish ) {
+        TJDocumentHolder holder;
+        BOOST_CHECK_EQUAL(holder.GetVersion(), 1);
+        BOOST_CHECK(holder.Acquire().Root().IsNull());
+
+        BOOST_CHECK_EQUAL(holder.Publish(TJFrozenDocument(Version(2))), 2);
+        TJDocumentHolder::TSnapshot old = holder.Acquire();
+        BOOST_CHECK_EQUAL(old.GetVersion(), 2);
+        BOOST_CHECK_EQUAL(holder.Publish(TJFrozenDocument(Version(3))), 3);
+
+        // The old version stays readable for as long as a snapshot has it
+        BOOST_CHECK_EQUAL(old.Root().Find("version")->AsInteger(), 2);
+        TJDocumentHolder::TSnapshot copy = old;
+        old = TJDocumentHolder::TSnapshot();
+        BOOST_CHECK(old.Empty());
+        BOOST_CHECK_EQUAL(old.GetVersion(), 0);
+        BOOST_CHECK_EQUAL(copy.Root().Find("label")->AsString(), "version number 2");
+
+        holder.Refresh(copy);
+        BOOST_CHECK_EQUAL(copy.GetVersion(), 3);
+        BOOST_CHECK_EQUAL(copy.Document().Root().Find("version")->AsInteger(), 3);
+        holder.Refresh(old);
+        BOOST_CHECK_EQUAL(old.GetVersion(), 3);
+
+        // Snapshots may outlive the holder
+        TJDocumentHolder::TSnapshot last;
+        {
+            TJDocumentHolder scoped(TJFrozenDocument(Version(7)));
+            last = scoped.Acquire();
+        }
+        BOOST_CHECK_EQUAL(last.Root().Find("items")->Size(), 7);
+    }
+
+    BOOST_AUTO_TEST_CASE( testHolderSnapshotCopies ) {
+        TJDocumentHolder holder{ TJFrozenDocument(SOURCE) };
+        TJValue<IJSON_VALUE> root;
+        TJValue<JSON_ARRAY> tags;
+        {
+            TJDocumentHolder::TSnapshot snapshot = holder.Acquire();
+            root = TJValue<IJSON_VALUE>(snapshot.Root().GetValue());
+            tags = TJValue<JSON_ARRAY>(snapshot.Root().Find("limits")->Find("tags")->GetValue());
+        }
+        // Frees the version the copies came from
+        holder.Publish(TJFrozenDocument(Version(2)));
+        holder.Publish(TJFrozenDocument(Version(3)));
+
+        BOOST_CHECK_EQUAL(root.Find("name")->AsString(), "an escaped \"name\" long enough");
+        BOOST_CHECK_EQUAL(root.Find("ports")->At(1)->AsInteger(), 443);
+        BOOST_CHECK_EQUAL(root.Find("limits")->Find("cpu")->AsDouble(), 2.5);
+        BOOST_CHECK_EQUAL(root.Find("limits")->Find("tags")->At(1)->AsString(), "b\xc3\xa9");
+        BOOST_CHECK_EQUAL(tags.Size(), 2);
+        BOOST_CHECK_EQUAL(tags.At(0)->AsString(), "a");
+        BOOST_CHECK_EQUAL(ToJson(root), ToJson(Parse(std::string(SOURCE)).Root()));
+    }
+
+    BOOST_AUTO_TEST_CASE( testHolderConcurrent ) {
+        TJDocumentHolder holder(TJFrozenDocument(Version(1)));
+        std::atomic<bool> done(false);
+        std::atomic<size_t> failures(0);
+        std::atomic<size_t> reads(0);
+
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 4; ++t) {
+            readers.emplace_back([&, t]() {
+                integer_t seen = 0;
+                TJDocumentHolder::TSnapshot kept;
+                while (!done.load()) {
+                    // Half take a snapshot per read, half keep theirs and refresh it
+                    if (t % 2 == 0) {
+                        TJDocumentHolder::TSnapshot snapshot = holder.Acquire();
+                        failures += !Consistent(snapshot.Root(), seen);
+                    } else {
+                        holder.Refresh(kept);
+                        failures += !Consistent(kept.Root(), seen);
+                    }
+                    ++reads;
+                }
+            });
+        }
+
+        for (int number = 2; number <= 300; ++number) {
+            holder.Publish(TJFrozenDocument(Version(number)));
+            if (number % 50 == 0) {
+                std::this_thread::yield();
+            }
+        }
+        while (reads.load() < 1000) {
+            std::this_thread::yield();
+        }
+        done = true;
+        for (std::thread & thread : readers) {
+            thread.join();
+        }
+        BOOST_CHECK_EQUAL(failures.load(), 0);
+        BOOST_CHECK_EQUAL(holder.GetVersion(), 300);
+        BOOST_CHECK_EQUAL(holder.Acquire().Root().Find("version")->AsInteger(), 300);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
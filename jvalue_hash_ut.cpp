@@ -0,0 +1,130 @@
+#include <boost/test/unit_test.hpp>
+#include "jvalue_hash.h"
+#include "jvalue_parser.h"
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+
+using namespace NJValue;
+
+namespace {
+    void CheckEqual(const IJValue & a, const IJValue & b) {
+        BOOST_CHECK(a.Equals(b));
+        BOOST_CHECK(b.Equals(a));
+        BOOST_CHECK_EQUAL(a.Hash(), b.Hash());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(testSuiteJValueHash)
+
+    BOOST_AUTO_TEST_CASE( testHashEquals ) {
+        TJDocument a = Parse("{\"id\": 7, \"tags\": [\"x\", null, 1.5], \"text\": \"longer than fourteen bytes\", \"m\": {}}");
+        TJDocument b = Parse("{\"m\": {}, \"text\": \"longer than fourteen bytes\", \"tags\": [\"x\", null, 1.5], \"id\": 7}");
+        CheckEqual(a.Root(), b.Root());
+        // Owned copies against the document
+        TJValue<IJSON_VALUE> copy(a.Root().GetValue());
+        CheckEqual(copy, b.Root());
+
+        BOOST_CHECK(!Parse("[1]").Root().Equals(Parse("[1.0]").Root()));
+        BOOST_CHECK(!Parse("[0.0]").Root().Equals(Parse("[-0.0]").Root()));
+        BOOST_CHECK(!Parse("{\"a\": 1}").Root().Equals(Parse("{\"b\": 1}").Root()));
+        BOOST_CHECK(!Parse("[[1], 2]").Root().Equals(Parse("[[2], 1]").Root()));
+        BOOST_CHECK(!TJValue<JSON_NULL>().Equals(TJValue<JSON_UNDEFINED>()));
+        BOOST_CHECK(!TJValue<JSON_STRING>("").Equals(TJValue<JSON_NULL>()));
+
+        // Missing elements are null, missing keys are not
+        TJValue<JSON_ARRAY> holes;
+        holes.PushBack(static_cast<IJValue *>(nullptr));
+        CheckEqual(holes, Parse("[null]").Root());
+        map_t entries;
+        entries.Set("a", nullptr);
+        BOOST_CHECK(!TJValue<JSON_MAP>(entries).Equals(Parse("{\"b\": null}").Root()));
+        CheckEqual(TJValue<JSON_MAP>(entries), Parse("{\"a\": null}").Root());
+    }
+
+    BOOST_AUTO_TEST_CASE( testHashPackedAndChanges ) {
+        TJValue<JSON_ARRAY> packed(std::vector<integer_t>{ 1, 2, 3 });
+        BOOST_REQUIRE(packed.IsPacked());
+        CheckEqual(packed, Parse("[1, 2, 3]").Root());
+        TJValue<JSON_ARRAY> doubles(std::vector<double_t>{ 1.0, 2.0, 3.0 });
+        BOOST_CHECK(!packed.Equals(doubles));
+
+        // Copies share the storage and its cached hash, a change drops it
+        TJValue<JSON_ARRAY> shared(packed);
+        uint64_t before = packed.Hash();
+        CheckEqual(packed, shared);
+        shared.PushBack(TJValue<JSON_INTEGER>(4));
+        BOOST_CHECK_EQUAL(packed.Hash(), before);
+        BOOST_CHECK(!shared.Equals(packed));
+        shared.PopBack();
+        CheckEqual(shared, packed);
+        shared.Set(0, TJValue<JSON_INTEGER>(9));
+        BOOST_CHECK_NE(shared.Hash(), before);
+
+        // Elements changed in place are seen by the arrays above them
+        TJValue<JSON_ARRAY> outer;
+        outer.PushBack(TJValue<JSON_ARRAY>());
+        before = outer.Hash();
+        outer.At(0)->PushBack(TJValue<JSON_STRING>("inner"));
+        BOOST_CHECK_NE(outer.Hash(), before);
+        CheckEqual(outer, Parse("[[\"inner\"]]").Root());
+
+        TJValue<JSON_STRING> text(string_t(40, 'x'));
+        TJValue<JSON_STRING> other(string_t(40, 'y'));
+        BOOST_CHECK_EQUAL(text.Hash(), TJValue<JSON_STRING>(string_t(40, 'x')).Hash());
+        BOOST_CHECK_NE(text.Hash(), other.Hash());
+        BOOST_CHECK(!text.Equals(other));
+
+        std::unordered_set<const IJValue *, TJValueHash, TJValueEqual> seen;
+        TJDocument doc = Parse("[{\"a\": [1]}, {\"a\": [2]}, {\"a\": [1]}, [1], [1]]");
+        for (size_t i = 0; i < doc.Root().Size(); ++i) {
+            seen.insert(doc.Root().At(i));
+        }
+        BOOST_CHECK_EQUAL(seen.size(), 3);
+    }
+
+    BOOST_AUTO_TEST_CASE( testInterner ) {
+        const char text[] = "[{\"a\": 1, \"b\": [true, null]}, {\"b\": [true, null], \"a\": 1},"
+                            " {\"a\": 2, \"b\": [true, null]}, null, true]";
+        TJDocument doc = Parse(text);
+        TJInterner interner;
+        const IJValue * root = interner.Intern(doc.Root());
+        CheckEqual(*root, doc.Root());
+        BOOST_CHECK_EQUAL(TJInterner::Hash(root), doc.Root().Hash());
+
+        BOOST_CHECK_EQUAL(root->At(0), root->At(1));
+        BOOST_CHECK_NE(root->At(0), root->At(2));
+        BOOST_CHECK_EQUAL(root->At(0)->Find("b"), root->At(2)->Find("b"));
+        BOOST_CHECK_EQUAL(root->At(3), root->At(0)->Find("b")->At(1));
+        BOOST_CHECK_EQUAL(root->At(4), root->At(0)->Find("b")->At(0));
+        // 1, true, null, [true, null], the two maps, 2 and the root
+        BOOST_CHECK_EQUAL(interner.Size(), 8);
+
+        // The same values again, from elsewhere, give the same nodes
+        BOOST_CHECK_EQUAL(interner.Intern(Parse(text).Root()), root);
+        BOOST_CHECK_EQUAL(interner.Intern(TJValue<JSON_ARRAY>(std::vector<integer_t>{ 1, 2 })),
+                          interner.Intern(Parse("[1, 2]").Root()));
+        BOOST_CHECK_EQUAL(interner.Size(), 9);
+
+        TJValue<JSON_ARRAY> holes;
+        holes.PushBack(static_cast<IJValue *>(nullptr));
+        BOOST_CHECK_EQUAL(interner.Intern(holes), interner.Intern(Parse("[null]").Root()));
+
+        // Repetitive documents shrink to their distinct parts
+        std::string repeated = "[";
+        for (size_t i = 0; i < 1000; ++i) {
+            repeated += (i == 0 ? "" : ",");
+            repeated += "{\"kind\": \"a string that is not short\", \"flags\": [true, false], \"n\": " + std::to_string(i % 10) + "}";
+        }
+        repeated += "]";
+        TJDocument big = Parse(repeated);
+        interner.Reset();
+        const IJValue * shrunk = interner.Intern(big.Root());
+        CheckEqual(*shrunk, big.Root());
+        // 10 numbers, the string, true, false, the flags, 10 maps and the root
+        BOOST_CHECK_EQUAL(interner.Size(), 25);
+        BOOST_CHECK_LT(interner.GetMemoryUsed(), big.GetMemoryUsed() / 4);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,102 @@
+#include <boost/test/unit_test.hpp>
+#include "jvalue_parser.h"
+#include "jvalue_writer.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+
+
+using namespace NJValue;
+
+BOOST_AUTO_TEST_SUITE(testSuiteJValueLazy)
+
+    BOOST_AUTO_TEST_CASE( testLazyAccess ) {
+        std::string text = " {\"a\": [1, 2.5, \"x\\ny\", true, null], \"b\": {\"c\": {\"d\": \"e\"}}, \"f\": []} ";
+        TJLazyDocument doc(text.data(), text.size());
+        const IJSON_VALUE & root = doc.Root().GetValue();
+
+        BOOST_CHECK(root.GetType() == JMAP);
+        BOOST_CHECK_EQUAL(root.Size(), 3);
+        const IJSON_VALUE & a = root.Find("a")->GetValue();
+        BOOST_CHECK_EQUAL(a.Size(), 5);
+        BOOST_CHECK_EQUAL(a.At(0)->GetValue().AsInteger(), 1);
+        BOOST_CHECK_EQUAL(a.At(1)->GetValue().AsDouble(), 2.5);
+        BOOST_CHECK_EQUAL(a.At(2)->GetValue().AsString(), "x\ny");
+        BOOST_CHECK(a.At(4)->GetValue().GetType() == JNULL);
+        BOOST_CHECK_EQUAL(root.Find("b")->GetValue().Find("c")->GetValue().Find("d")->GetValue().AsString(), "e");
+        BOOST_CHECK_EQUAL(root.Find("f")->GetValue().Size(), 0);
+
+        // The whole tree serializes, and copies are independent of the document
+        BOOST_CHECK_EQUAL(ToJson(doc.Root()), "{\"a\":[1,2.5,\"x\\ny\",true,null],\"b\":{\"c\":{\"d\":\"e\"}},\"f\":[]}");
+        TJValue<JSON_ARRAY> copy = TJValue<JSON_ARRAY>(a.AsArray());
+        BOOST_CHECK_EQUAL(ToJson(copy), "[1,2.5,\"x\\ny\",true,null]");
+
+        TJLazyDocument scalar("-7", 2);
+        BOOST_CHECK_EQUAL(scalar.Root().GetValue().AsInteger(), -7);
+    }
+
+    BOOST_AUTO_TEST_CASE( testLazyExpandsOnDemand ) {
+        std::string text = "[";
+        for (int i = 0; i < 1000; ++i) {
+            text += "{\"id\":" + std::to_string(i) + ",\"tags\":[\"a\",\"b\",\"c\"]},";
+        }
+        text += "{\"id\":-1}]";
+        TJLazyDocument doc(text.data(), text.size());
+        size_t loaded = doc.GetMemoryUsed();
+
+        const IJSON_VALUE & root = doc.Root().GetValue();
+        BOOST_CHECK_EQUAL(root.Size(), 1001);
+        size_t topLevel = doc.GetMemoryUsed();
+        BOOST_CHECK(topLevel > loaded);
+
+        BOOST_CHECK_EQUAL(root.At(1000)->GetValue().Find("id")->GetValue().AsInteger(), -1);
+        BOOST_CHECK_EQUAL(root.At(500)->GetValue().Find("tags")->GetValue().At(2)->GetValue().AsString(), "c");
+        BOOST_CHECK(doc.GetMemoryUsed() - topLevel < 4096);
+    }
+
+    BOOST_AUTO_TEST_CASE( testLazyErrors ) {
+        // Broken scalars throw only once reached
+        std::string text = "[1, tru, {\"a\": 01x}, [1,]]";
+        TJLazyDocument doc(text.data(), text.size());
+        const IJSON_VALUE & root = doc.Root().GetValue();
+        BOOST_CHECK_THROW(root.Size(), TJParseError);
+
+        std::string nested = "[1, {\"a\": tru}, [1,], {\"b\" 1}]";
+        TJLazyDocument partial(nested.data(), nested.size());
+        const IJSON_VALUE & items = partial.Root().GetValue();
+        BOOST_CHECK_EQUAL(items.Size(), 4);
+        BOOST_CHECK_EQUAL(items.At(0)->GetValue().AsInteger(), 1);
+        BOOST_CHECK_THROW(items.At(1)->GetValue().Size(), TJParseError);
+        BOOST_CHECK_THROW(items.At(2)->GetValue().Size(), TJParseError);
+        BOOST_CHECK_THROW(items.At(3)->GetValue().Size(), TJParseError);
+
+        // Bracket structure is checked at load time
+        const char * broken[] = { "", "   ", "[1, 2", "[1}", "{\"a\": [}]", "[] []", "]" };
+        for (const char * s : broken) {
+            BOOST_CHECK_THROW(TJLazyDocument(s, std::strlen(s)), TJParseError);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testLazyMappedFile ) {
+        char path[] = "/tmp/jvalue_lazy_XXXXXX";
+        int fd = mkstemp(path);
+        BOOST_REQUIRE(fd >= 0);
+        std::string text = "{\"name\": \"mapped\", \"values\": [1, 2, 3]}";
+        BOOST_REQUIRE(write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size()));
+        close(fd);
+
+        {
+            TJLazyDocument doc = TJLazyDocument::Open(path);
+            const IJSON_VALUE & root = doc.Root().GetValue();
+            BOOST_CHECK_EQUAL(root.Find("name")->GetValue().AsString(), "mapped");
+            BOOST_CHECK_EQUAL(root.Find("values")->GetValue().At(2)->GetValue().AsInteger(), 3);
+            BOOST_CHECK(doc.GetIndexSize() > 0);
+        }
+        unlink(path);
+
+        BOOST_CHECK_THROW(TJLazyDocument::Open(path), std::system_error);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
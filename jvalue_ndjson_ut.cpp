@@ -0,0 +1,129 @@
+#include <boost/test/unit_test.hpp>
+#include "jvalue_ndjson.h"
+#include "jvalue_writer.h"
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+
+
+using namespace NJValue;
+
+namespace {
+    std::string MakeLines(size_t count) {
+        std::string text;
+        for (size_t i = 0; i < count; ++i) {
+            text += "{\"id\":" + std::to_string(i) + ",\"name\":\"line " + std::to_string(i) + "\"}\n";
+            if (i % 7 == 0) {
+                text += "   \r\n";
+            }
+        }
+        return text;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(testSuiteJValueNdjson)
+
+    BOOST_AUTO_TEST_CASE( testThreadPool ) {
+        std::atomic<size_t> sum(0);
+        {
+            TJThreadPool pool(4);
+            BOOST_CHECK_EQUAL(pool.Size(), 4);
+            for (size_t i = 1; i <= 1000; ++i) {
+                pool.Submit([&sum, i]() { sum += i; });
+            }
+        }
+        BOOST_CHECK_EQUAL(sum.load(), 500500);
+    }
+
+    BOOST_AUTO_TEST_CASE( testParseLines ) {
+        std::string text = "1\n\n  [true, \"a\"]\r\n{\"b\": null}";
+        TJDocument doc;
+        std::vector<const IJValue *> roots;
+        ParseLines(text.data(), text.size(), doc, roots);
+        BOOST_REQUIRE_EQUAL(roots.size(), 3);
+        BOOST_CHECK_EQUAL(ToJson(*roots[0]), "1");
+        BOOST_CHECK_EQUAL(ToJson(*roots[1]), "[true,\"a\"]");
+        BOOST_CHECK_EQUAL(ToJson(*roots[2]), "{\"b\":null}");
+
+        roots.clear();
+        BOOST_CHECK_THROW(ParseLines("1 2\n", 4, doc, roots), TJParseError);
+        BOOST_CHECK_THROW(ParseLines("[1,\n2]\n", 7, doc, roots), TJParseError);
+    }
+
+    BOOST_AUTO_TEST_CASE( testNdjsonOrdered ) {
+        std::string text = MakeLines(5000);
+        TJNdjsonOptions options;
+        options.threads = 4;
+        options.chunkSize = 1000;
+        options.maxPending = 3;
+
+        size_t expected = 0;
+        size_t batches = 0;
+        std::thread::id caller = std::this_thread::get_id();
+        ParseNdjson(text.data(), text.size(), [&](const TJNdjsonBatch & batch) {
+            BOOST_CHECK(std::this_thread::get_id() == caller);
+            BOOST_CHECK_EQUAL(batch.GetIndex(), batches++);
+            for (size_t i = 0; i < batch.Size(); ++i) {
+                BOOST_CHECK_EQUAL(batch[i].GetValue().Find("id")->GetValue().AsInteger(), static_cast<integer_t>(expected++));
+            }
+        }, options);
+        BOOST_CHECK_EQUAL(expected, 5000);
+        BOOST_CHECK(batches > 100);
+    }
+
+    BOOST_AUTO_TEST_CASE( testNdjsonUnordered ) {
+        std::string text = MakeLines(3000);
+        TJNdjsonOptions options;
+        options.threads = 3;
+        options.chunkSize = 512;
+        options.ordered = false;
+        options.mode = JPARSE_COPY;
+
+        std::vector<bool> seen(3000, false);
+        TJThreadPool pool(3);
+        TJNdjsonReader reader(pool, options);
+        for (int round = 0; round < 2; ++round) {
+            seen.assign(3000, false);
+            reader.Read(text.data(), text.size(), [&](const TJNdjsonBatch & batch) {
+                for (size_t i = 0; i < batch.Size(); ++i) {
+                    seen[batch[i].GetValue().Find("id")->GetValue().AsInteger()] = true;
+                }
+            });
+            BOOST_CHECK(std::find(seen.begin(), seen.end(), false) == seen.end());
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testNdjsonErrors ) {
+        std::string text = MakeLines(2000);
+        size_t broken = text.find("\"id\":1500");
+        text[broken] = '?';
+
+        TJNdjsonOptions options;
+        options.threads = 4;
+        options.chunkSize = 256;
+        size_t delivered = 0;
+        try {
+            ParseNdjson(text.data(), text.size(), [&](const TJNdjsonBatch & batch) {
+                delivered += batch.Size();
+            }, options);
+            BOOST_ERROR("no error");
+        } catch (const TJParseError & e) {
+            // Somewhere on the broken line
+            BOOST_CHECK(e.GetOffset() >= broken - 1);
+            BOOST_CHECK(e.GetOffset() <= text.find('\n', broken));
+        }
+        BOOST_CHECK(delivered <= 1500);
+        BOOST_CHECK(delivered > 1400);
+
+        // Callback exceptions stop the work and come out of the call
+        BOOST_CHECK_THROW(ParseNdjson(text.data(), broken, [](const TJNdjsonBatch &) {
+            throw std::runtime_error("stop");
+        }, options), std::runtime_error);
+
+        size_t calls = 0;
+        ParseNdjson("", 0, [&](const TJNdjsonBatch &) { ++calls; });
+        BOOST_CHECK_EQUAL(calls, 0);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
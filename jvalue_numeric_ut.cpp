@@ -0,0 +1,320 @@
+#include <boost/test/unit_test.hpp>
+#include "jvalue_binary.h"
+#include "jvalue_numeric.h"
+#include "jvalue_parser.h"
+#include "jvalue_writer.h"
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+
+
+using namespace NJValue;
+
+namespace {
+    const EJSimdKernel KERNELS[] = { JKERNEL_SCALAR, JKERNEL_SSE42, JKERNEL_AVX2 };
+
+    std::vector<integer_t> RandomIntegers(size_t count, integer_t range) {
+        std::mt19937_64 random(count);
+        std::vector<integer_t> values(count);
+        for (integer_t & value : values) {
+            value = static_cast<integer_t>(random() % (2 * range + 1)) - range;
+        }
+        return values;
+    }
+
+    std::vector<double_t> RandomDoubles(size_t count) {
+        std::mt19937_64 random(count);
+        std::uniform_real_distribution<double_t> distribution(-1000.0, 1000.0);
+        std::vector<double_t> values(count);
+        for (double_t & value : values) {
+            value = distribution(random);
+        }
+        return values;
+    }
+
+    bool SameBits(double_t a, double_t b) {
+        return std::memcmp(&a, &b, sizeof(a)) == 0;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(testSuiteJValueNumeric)
+
+    BOOST_AUTO_TEST_CASE( testPackedArray ) {
+        TJValue<JSON_ARRAY> j = std::vector<integer_t>{ 1, 2, 3 };
+        BOOST_CHECK(j.IsPacked());
+        BOOST_CHECK_EQUAL(j.Size(), 3);
+        BOOST_CHECK_EQUAL(j.AsIntegerSpan().size(), 3);
+        BOOST_CHECK(j.AsDoubleSpan().empty());
+        BOOST_CHECK_EQUAL(j.At(2)->AsInteger(), 3);
+        BOOST_CHECK(j.At(3) == nullptr);
+        BOOST_CHECK_EQUAL(j.AsArray()[1]->AsString(), "2");
+        BOOST_CHECK_EQUAL(ToJson(j), "[1,2,3]");
+
+        // Numbers of the same type keep it packed, copies share and detach
+        TJValue<JSON_ARRAY> copy = j;
+        BOOST_CHECK(copy.AsIntegerSpan().data() == j.AsIntegerSpan().data());
+        copy.PushBack(TJValue<JSON_INTEGER>(4));
+        copy.Set(0, *copy.At(3));
+        BOOST_CHECK(copy.IsPacked());
+        BOOST_CHECK_EQUAL(ToJson(copy), "[4,2,3,4]");
+        BOOST_CHECK_EQUAL(ToJson(j), "[1,2,3]");
+
+        // Anything else unpacks it
+        copy.PushBack(TJValue<JSON_DOUBLE>(0.5));
+        BOOST_CHECK(!copy.IsPacked());
+        BOOST_CHECK_EQUAL(ToJson(copy), "[4,2,3,4,0.5]");
+        copy.PopBack();
+        BOOST_CHECK(!copy.IsPacked());
+
+        TJValue<JSON_ARRAY> doubles = std::vector<double_t>{ 0.5 };
+        doubles.PopBack();
+        BOOST_CHECK_EQUAL(ToJson(doubles), "[]");
+        doubles.PushBack(TJValue<JSON_STRING>("s"));
+        BOOST_CHECK(!doubles.IsPacked());
+
+        TJValue<JSON_ARRAY> empty;
+        empty.PushBack(TJValue<JSON_DOUBLE>(1.5));
+        empty.PushBack(TJValue<JSON_DOUBLE>(NAN));
+        BOOST_CHECK(empty.IsPacked());
+        BOOST_CHECK_EQUAL(ToJson(empty), "[1.5,null]");
+
+        TJValue<JSON_ARRAY> nested;
+        nested.PushBack(j);
+        BOOST_CHECK(!nested.IsPacked());
+        BOOST_CHECK(nested.At(0)->IsPacked());
+        BOOST_CHECK_EQUAL(ToJson(nested), "[[1,2,3]]");
+
+        // Pointer elements stay the caller's
+        TJValue<JSON_INTEGER> external = 7;
+        j.PushBack(&external);
+        BOOST_CHECK(!j.IsPacked());
+        BOOST_CHECK(j.At(3) == &external);
+        BOOST_CHECK_EQUAL(j.At(0)->AsInteger(), 1);
+    }
+
+    BOOST_AUTO_TEST_CASE( testPackedCopies ) {
+        TJDocument doc = Parse("{\"ints\": [1, -2, 3], \"doubles\": [0.5, 1e3], \"mixed\": [1, 2.5], \"empty\": []}");
+        TJValue<JSON_ARRAY> ints(doc.Root().Find("ints")->GetValue());
+        TJValue<JSON_ARRAY> doubles(doc.Root().Find("doubles")->GetValue());
+        TJValue<JSON_ARRAY> mixed(doc.Root().Find("mixed")->GetValue());
+        TJValue<JSON_ARRAY> empty(doc.Root().Find("empty")->GetValue());
+        BOOST_CHECK(ints.IsPacked());
+        BOOST_CHECK(doubles.IsPacked());
+        BOOST_CHECK(!mixed.IsPacked());
+        BOOST_CHECK(!empty.IsPacked());
+        BOOST_CHECK_EQUAL(ints.AsIntegerSpan()[1], -2);
+        BOOST_CHECK_EQUAL(doubles.AsDoubleSpan()[1], 1000.0);
+
+        // Packed copies no longer depend on the document
+        doc.Reset();
+        BOOST_CHECK_EQUAL(ToJson(ints), "[1,-2,3]");
+
+        TJDocument copy;
+        copy.SetRoot(copy.NewValue(ints.GetValue()));
+        BOOST_CHECK(!copy.Root().IsPacked());
+        BOOST_CHECK_EQUAL(ToJson(copy.Root()), "[1,-2,3]");
+
+        string_t binary = EncodeBinary(doubles);
+        TJDocument decoded;
+        DecodeBinary(binary.data(), binary.size(), decoded);
+        BOOST_CHECK_EQUAL(ToJson(decoded.Root()), "[0.5,1000.0]");
+        TJBinaryDocument view(binary.data(), binary.size());
+        BOOST_CHECK_EQUAL(view.Root().At(1).AsDouble(), 1000.0);
+
+#ifdef JVALUE_STATS
+        // A number each instead of a node and a pointer each
+        std::vector<integer_t> numbers = RandomIntegers(1000, 1000);
+        ResetStats();
+        TJValue<JSON_ARRAY> packed(numbers);
+        size_t packedBytes = GetStats(JARRAY).bytesAllocated;
+        BOOST_CHECK(packedBytes < 1000 * sizeof(integer_t) + 256);
+        BOOST_CHECK_EQUAL(Sum(packed), static_cast<double_t>(Sum(TJSpan<integer_t>(numbers))));
+        BOOST_CHECK_EQUAL(GetStats(JARRAY).bytesAllocated, packedBytes);
+        BOOST_CHECK_EQUAL(GetStats(JINTEGER).constructed, 0);
+#endif
+    }
+
+    BOOST_AUTO_TEST_CASE( testKernels ) {
+        for (size_t size : { 0, 1, 7, 8, 9, 1001 }) {
+            std::vector<integer_t> integers = RandomIntegers(size, 1000000);
+            std::vector<double_t> doubles = RandomDoubles(size);
+            if (size > 1) {
+                integers[size / 2] = LONG_MIN;
+                integers[size - 1] = LONG_MAX;
+                doubles[size / 2] = NAN;
+            }
+
+            integer_t sum = 0;
+            integer_t min = LONG_MAX;
+            integer_t max = LONG_MIN;
+            for (integer_t value : integers) {
+                sum = static_cast<integer_t>(static_cast<uint64_t>(sum) + static_cast<uint64_t>(value));
+                min = std::min(min, value);
+                max = std::max(max, value);
+            }
+            double_t doubleSum = Sum(TJSpan<double_t>(doubles), JKERNEL_SCALAR);
+
+            for (EJSimdKernel kernel : KERNELS) {
+                if (kernel > DetectKernel()) {
+                    continue;
+                }
+                BOOST_CHECK_EQUAL(Sum(TJSpan<integer_t>(integers), kernel), sum);
+                BOOST_CHECK_EQUAL(Min(TJSpan<integer_t>(integers), kernel), min);
+                BOOST_CHECK_EQUAL(Max(TJSpan<integer_t>(integers), kernel), max);
+                BOOST_CHECK(SameBits(Sum(TJSpan<double_t>(doubles), kernel), doubleSum));
+
+                double_t doubleMin = Min(TJSpan<double_t>(doubles), kernel);
+                double_t doubleMax = Max(TJSpan<double_t>(doubles), kernel);
+                size_t less = 0;
+                size_t notEqual = 0;
+                for (double_t value : doubles) {
+                    BOOST_CHECK(std::isnan(value) || (doubleMin <= value && value <= doubleMax));
+                    less += value < 10.0 ? 1 : 0;
+                    notEqual += value != doubles[0] ? 1 : 0;
+                }
+                BOOST_CHECK_EQUAL(CountIf(TJSpan<double_t>(doubles), JCOMPARE_LESS, 10.0, kernel), less);
+                BOOST_CHECK_EQUAL(CountIf(TJSpan<double_t>(doubles), JCOMPARE_GREATER_EQUAL, 10.0, kernel),
+                                  size - less - (size > 1 ? 1 : 0));
+                if (size != 0) {
+                    BOOST_CHECK_EQUAL(CountIf(TJSpan<double_t>(doubles), JCOMPARE_NOT_EQUAL, doubles[0], kernel), notEqual);
+                    BOOST_CHECK_EQUAL(CountIf(TJSpan<double_t>(doubles), JCOMPARE_EQUAL, doubles[0], kernel), size - notEqual);
+                }
+
+                const EJCompare ops[] = { JCOMPARE_LESS, JCOMPARE_LESS_EQUAL, JCOMPARE_GREATER,
+                                          JCOMPARE_GREATER_EQUAL, JCOMPARE_EQUAL, JCOMPARE_NOT_EQUAL };
+                integer_t operand = size != 0 ? integers[0] : 0;
+                for (EJCompare op : ops) {
+                    BOOST_CHECK_EQUAL(CountIf(TJSpan<integer_t>(integers), op, operand, kernel),
+                                      CountIf(TJSpan<integer_t>(integers), op, operand, JKERNEL_SCALAR));
+                }
+
+                std::vector<double_t> converted(size);
+                Convert(TJSpan<integer_t>(integers), converted.data(), kernel);
+                std::vector<integer_t> truncated(size);
+                Convert(TJSpan<double_t>(converted), truncated.data(), kernel);
+                for (size_t i = 0; i < size; ++i) {
+                    BOOST_CHECK(SameBits(converted[i], static_cast<double_t>(integers[i])));
+                    if (std::fabs(converted[i]) < 1e18) {
+                        BOOST_CHECK_EQUAL(truncated[i], integers[i]);
+                    }
+                }
+            }
+        }
+
+        BOOST_CHECK_EQUAL(Min(TJSpan<double_t>()), std::numeric_limits<double_t>::infinity());
+        BOOST_CHECK_EQUAL(Max(TJSpan<integer_t>()), LONG_MIN);
+    }
+
+    BOOST_AUTO_TEST_CASE( testConversions ) {
+        std::vector<integer_t> integers = { 0, -1, 1, (1L << 53) + 1, -(1L << 53) - 1, LONG_MIN, LONG_MAX,
+                                            (1L << 62) + 511, -(1L << 62) - 513 };
+        std::vector<double_t> doubles = { -0.9, 0.9, -2.5, 2.5, 1e15 + 0.5, -1e15 - 0.5, 4e15, -4e15, 1e18, -1e18 };
+        for (EJSimdKernel kernel : KERNELS) {
+            if (kernel > DetectKernel()) {
+                continue;
+            }
+            std::vector<double_t> converted(integers.size());
+            Convert(TJSpan<integer_t>(integers), converted.data(), kernel);
+            for (size_t i = 0; i < integers.size(); ++i) {
+                BOOST_CHECK(SameBits(converted[i], static_cast<double_t>(integers[i])));
+            }
+
+            std::vector<integer_t> truncated(doubles.size());
+            Convert(TJSpan<double_t>(doubles), truncated.data(), kernel);
+            for (size_t i = 0; i < doubles.size(); ++i) {
+                BOOST_CHECK_EQUAL(truncated[i], static_cast<integer_t>(doubles[i]));
+            }
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testArrayAggregates ) {
+        std::vector<integer_t> numbers = RandomIntegers(500, 100);
+        TJValue<JSON_ARRAY> packed(numbers);
+        std::vector<TJValue<JSON_INTEGER>> nodes(numbers.begin(), numbers.end());
+        array_t items;
+        for (TJValue<JSON_INTEGER> & node : nodes) {
+            items.push_back(&node);
+        }
+        TJValue<JSON_ARRAY> generic(items);
+        BOOST_REQUIRE(packed.IsPacked());
+        BOOST_REQUIRE(!generic.IsPacked());
+
+        BOOST_CHECK_EQUAL(Sum(packed), Sum(generic));
+        BOOST_CHECK_EQUAL(Min(packed), Min(generic));
+        BOOST_CHECK_EQUAL(Max(packed), Max(generic));
+        BOOST_CHECK_EQUAL(Mean(packed), Mean(generic));
+        for (double_t operand : { -100.0, -3.5, 0.0, 2.5, 50.0, 1e30, -1e30, static_cast<double_t>(NAN) }) {
+            BOOST_CHECK_EQUAL(CountIf(packed, JCOMPARE_LESS, operand), CountIf(generic, JCOMPARE_LESS, operand));
+            BOOST_CHECK_EQUAL(CountIf(packed, JCOMPARE_LESS_EQUAL, operand), CountIf(generic, JCOMPARE_LESS_EQUAL, operand));
+            BOOST_CHECK_EQUAL(CountIf(packed, JCOMPARE_GREATER, operand), CountIf(generic, JCOMPARE_GREATER, operand));
+            BOOST_CHECK_EQUAL(CountIf(packed, JCOMPARE_EQUAL, operand), CountIf(generic, JCOMPARE_EQUAL, operand));
+            BOOST_CHECK_EQUAL(CountIf(packed, JCOMPARE_NOT_EQUAL, operand), CountIf(generic, JCOMPARE_NOT_EQUAL, operand));
+        }
+
+        // Sums agree however the numbers are stored: integers do not wrap, and
+        // doubles round the same
+        TJValue<JSON_ARRAY> large(std::vector<integer_t>{ LONG_MAX, LONG_MAX });
+        TJValue<JSON_ARRAY> largeNodes;
+        largeNodes.PushBack(TJValue<JSON_NULL>());
+        largeNodes.Set(0, TJValue<JSON_INTEGER>(LONG_MAX));
+        largeNodes.PushBack(TJValue<JSON_STRING>("9223372036854775807"));
+        BOOST_REQUIRE(large.IsPacked());
+        BOOST_CHECK_EQUAL(Sum(large), 2.0 * LONG_MAX);
+        BOOST_CHECK_EQUAL(Sum(largeNodes), Sum(large));
+        // Integers past 2^53 count as the doubles they convert to
+        TJValue<JSON_ARRAY> precise(std::vector<integer_t>{ 9007199254740993L, 9007199254740993L, 1 });
+        TJDocument preciseNodes = Parse("[9007199254740993, 9007199254740993, 1]");
+        BOOST_REQUIRE(precise.IsPacked());
+        BOOST_REQUIRE(!preciseNodes.Root().IsPacked());
+        for (EJCompare op : { JCOMPARE_LESS, JCOMPARE_LESS_EQUAL, JCOMPARE_GREATER, JCOMPARE_GREATER_EQUAL, JCOMPARE_EQUAL, JCOMPARE_NOT_EQUAL }) {
+            for (double_t operand : { 9007199254740992.0, 9007199254740994.0, 1.0, 1.5 }) {
+                BOOST_CHECK_EQUAL(CountIf(precise, op, operand), CountIf(preciseNodes.Root(), op, operand));
+            }
+        }
+        BOOST_CHECK_EQUAL(CountIf(precise, JCOMPARE_EQUAL, 9007199254740992.0), 2);
+        BOOST_CHECK_EQUAL(Sum(precise), Sum(preciseNodes.Root()));
+        std::vector<double_t> fractional;
+        for (integer_t number : numbers) {
+            fractional.push_back(number / 7.0 + 1e10);
+        }
+        TJValue<JSON_ARRAY> packedFractions(fractional);
+        std::vector<TJValue<JSON_DOUBLE>> fractionNodes(fractional.begin(), fractional.end());
+        array_t fractionItems;
+        for (TJValue<JSON_DOUBLE> & node : fractionNodes) {
+            fractionItems.push_back(&node);
+        }
+        TJValue<JSON_ARRAY> genericFractions(fractionItems);
+        BOOST_REQUIRE(!genericFractions.IsPacked());
+        BOOST_CHECK(SameBits(Sum(packedFractions), Sum(genericFractions)));
+
+        std::vector<double_t> doubles;
+        std::vector<integer_t> integers;
+        ToDoubles(packed, doubles);
+        ToIntegers(packed, integers);
+        BOOST_CHECK(integers == numbers);
+        BOOST_CHECK_EQUAL(doubles.size(), numbers.size());
+        BOOST_CHECK_EQUAL(doubles[7], static_cast<double_t>(numbers[7]));
+
+        TJValue<JSON_ARRAY> fractions = std::vector<double_t>{ 1.5, -2.5, NAN };
+        ToIntegers(fractions, integers);
+        BOOST_CHECK_EQUAL(integers.size(), 3);
+        BOOST_CHECK_EQUAL(integers[1], -2);
+        BOOST_CHECK_EQUAL(Max(fractions), 1.5);
+        BOOST_CHECK_EQUAL(Min(fractions), -2.5);
+
+        // Coercion like AsDouble() for other elements, nothing for non-arrays
+        TJDocument doc = Parse("[\"12\", true, null, 0.5]");
+        BOOST_CHECK_EQUAL(Sum(doc.Root()), 13.5);
+        BOOST_CHECK_EQUAL(CountIf(doc.Root(), JCOMPARE_GREATER, 0.0), 3);
+        TJValue<JSON_INTEGER> scalar = 5;
+        BOOST_CHECK_EQUAL(Sum(scalar), 0.0);
+        BOOST_CHECK(std::isnan(Mean(scalar)));
+        BOOST_CHECK_EQUAL(Min(scalar), std::numeric_limits<double_t>::infinity());
+        ToDoubles(scalar, doubles);
+        BOOST_CHECK(doubles.empty());
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,336 @@
+#include <boost/test/unit_test.hpp>
+#include "jvalue_parser.h"
+#include <string>
+#include <vector>
+
+
+using namespace NJValue;
+
+BOOST_AUTO_TEST_SUITE(testSuiteJValueParser)
+
+    BOOST_AUTO_TEST_CASE( testParseScalars ) {
+        {
+            TJDocument d = Parse("null");
+            BOOST_CHECK_EQUAL(d.Root().IsNull(), true);
+            BOOST_CHECK_EQUAL(d.Root().AsString(), "");
+            BOOST_CHECK_EQUAL(d.Root().AsInteger(), 0);
+            BOOST_CHECK_EQUAL(d.Root().AsBool(), false);
+        }
+
+        {
+            TJDocument d = Parse(" true ");
+            BOOST_CHECK_EQUAL(d.Root().IsBool(), true);
+            BOOST_CHECK_EQUAL(d.Root().AsString(), "true");
+            BOOST_CHECK_EQUAL(d.Root().AsInteger(), 1);
+            BOOST_CHECK_EQUAL(d.Root().AsDouble(), 1.0);
+        }
+
+        {
+            TJDocument d = Parse("false");
+            BOOST_CHECK_EQUAL(d.Root().IsBool(), true);
+            BOOST_CHECK_EQUAL(d.Root().AsString(), "false");
+            BOOST_CHECK_EQUAL(d.Root().AsBool(), false);
+        }
+
+        {
+            TJDocument d = Parse("-15");
+            BOOST_CHECK_EQUAL(d.Root().IsInteger(), true);
+            BOOST_CHECK_EQUAL(d.Root().AsString(), "-15");
+            BOOST_CHECK_EQUAL(d.Root().AsInteger(), -15);
+            BOOST_CHECK_EQUAL(d.Root().AsDouble(), -15.0);
+            BOOST_CHECK_EQUAL(d.Root().AsBool(), true);
+        }
+
+        {
+            TJDocument d = Parse("0");
+            BOOST_CHECK_EQUAL(d.Root().IsInteger(), true);
+            BOOST_CHECK_EQUAL(d.Root().AsBool(), false);
+        }
+
+        {
+            TJDocument d = Parse("-15.6");
+            BOOST_CHECK_EQUAL(d.Root().IsDouble(), true);
+            BOOST_CHECK_EQUAL(d.Root().AsString(), "-15.6");
+            BOOST_CHECK_EQUAL(d.Root().AsInteger(), -15);
+            BOOST_CHECK_EQUAL(d.Root().AsDouble(), -15.6);
+        }
+
+        {
+            TJDocument d = Parse("0.1");
+            BOOST_CHECK_EQUAL(d.Root().IsDouble(), true);
+            BOOST_CHECK_EQUAL(d.Root().AsString(), "0.1");
+            BOOST_CHECK_EQUAL(d.Root().AsBool(), false);
+        }
+
+        {
+            TJDocument d = Parse("9223372036854775807");
+            BOOST_CHECK_EQUAL(d.Root().IsInteger(), true);
+            BOOST_CHECK_EQUAL(d.Root().AsInteger(), 9223372036854775807L);
+        }
+
+        {
+            TJDocument d = Parse("-9223372036854775808");
+            BOOST_CHECK_EQUAL(d.Root().IsInteger(), true);
+            BOOST_CHECK_EQUAL(d.Root().AsString(), "-9223372036854775808");
+        }
+
+        {
+            TJDocument d = Parse("9223372036854775808");
+            BOOST_CHECK_EQUAL(d.Root().IsDouble(), true);
+        }
+
+        {
+            TJDocument d = Parse("1e3");
+            BOOST_CHECK_EQUAL(d.Root().IsDouble(), true);
+            BOOST_CHECK_EQUAL(d.Root().AsInteger(), 1000);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testParseStrings ) {
+        {
+            TJDocument d = Parse("\"Hello!\"");
+            BOOST_CHECK_EQUAL(d.Root().IsString(), true);
+            BOOST_CHECK_EQUAL(d.Root().AsString(), "Hello!");
+            BOOST_CHECK_EQUAL(d.Root().AsInteger(), 0);
+            BOOST_CHECK_EQUAL(d.Root().AsBool(), true);
+        }
+
+        {
+            TJDocument d = Parse("\"-25\"");
+            BOOST_CHECK_EQUAL(d.Root().AsInteger(), -25);
+            BOOST_CHECK_EQUAL(d.Root().AsDouble(), -25.0);
+        }
+
+        {
+            TJDocument d = Parse("\"a\\\"b\\\\c\\/\\n\\u0041\\u00e9\\ud83d\\ude00\"");
+            BOOST_CHECK_EQUAL(d.Root().AsString(), "a\"b\\c/\nA\xc3\xa9\xf0\x9f\x98\x80");
+        }
+
+        {
+            // Validating without an output buffer gives the decoded size
+            const char body[] = "a\\\"b\\u00e9\\ud83d\\ude00 tail";
+            char out[sizeof(body)];
+            size_t size = UnescapeString(body, sizeof(body) - 1, out);
+            BOOST_CHECK_EQUAL(std::string(out, size), "a\"b\xc3\xa9\xf0\x9f\x98\x80 tail");
+            BOOST_CHECK_EQUAL(UnescapeString(body, sizeof(body) - 1, nullptr), size);
+            BOOST_CHECK_THROW(UnescapeString("bad \\q", 6, nullptr), TJParseError);
+        }
+
+        {
+            TJDocument d = Parse("[\"\\\\\", \"x\"]");
+            BOOST_CHECK_EQUAL(d.Root().AsArray().size(), 2);
+            BOOST_CHECK_EQUAL(d.Root().AsArray()[0]->AsString(), "\\");
+            BOOST_CHECK_EQUAL(d.Root().AsArray()[1]->AsString(), "x");
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testParseArrays ) {
+        {
+            TJDocument d = Parse("[]");
+            BOOST_CHECK_EQUAL(d.Root().IsArray(), true);
+            BOOST_CHECK_EQUAL(d.Root().AsString(), "0");
+            BOOST_CHECK_EQUAL(d.Root().AsBool(), false);
+        }
+
+        {
+            TJDocument d = Parse("[1, [2.5, \"s\", [[]]], true, null]");
+            array_t a = d.Root().AsArray();
+            BOOST_CHECK_EQUAL(a.size(), 4);
+            BOOST_CHECK_EQUAL(a[0]->AsInteger(), 1);
+            BOOST_CHECK_EQUAL(a[1]->IsArray(), true);
+            BOOST_CHECK_EQUAL(a[1]->AsArray()[0]->AsDouble(), 2.5);
+            BOOST_CHECK_EQUAL(a[1]->AsArray()[1]->AsString(), "s");
+            BOOST_CHECK_EQUAL(a[1]->AsArray()[2]->AsArray()[0]->IsArray(), true);
+            BOOST_CHECK_EQUAL(a[2]->AsBool(), true);
+            BOOST_CHECK_EQUAL(a[3]->IsNull(), true);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testParseMaps ) {
+        {
+            TJDocument d = Parse("{}");
+            BOOST_CHECK_EQUAL(d.Root().IsMap(), true);
+            BOOST_CHECK_EQUAL(d.Root().AsString(), "0");
+            BOOST_CHECK_EQUAL(d.Root().AsBool(), false);
+            BOOST_CHECK(d.Root().Find("a") == nullptr);
+        }
+
+        {
+            TJDocument d = Parse("{\"id\": 7, \"name\": \"x\", \"tags\": [1, {\"k\\n\": null}], \"id\": 8}");
+            BOOST_CHECK_EQUAL(d.Root().IsMap(), true);
+            BOOST_CHECK_EQUAL(d.Root().AsInteger(), 3);
+            BOOST_CHECK_EQUAL(d.Root().Find("id")->AsInteger(), 8);
+            BOOST_CHECK_EQUAL(d.Root().Find("name")->AsString(), "x");
+            BOOST_CHECK_EQUAL(d.Root().Find("tags")->AsArray()[1]->Find("k\n")->IsNull(), true);
+            BOOST_CHECK(d.Root().Find("missing") == nullptr);
+
+            map_t m = d.Root().AsMap();
+            std::string order;
+            for (const map_t::TEntry & entry : m) {
+                order += entry.GetKey() + ";";
+            }
+            BOOST_CHECK_EQUAL(order, "id;name;tags;");
+        }
+
+        {
+            std::string text = "{";
+            for (int i = 0; i < 100; ++i) {
+                text += (i ? ", \"key" : "\"key") + std::to_string(i) + "\": " + std::to_string(i);
+            }
+            text += "}";
+            TJDocument d = Parse(text);
+            BOOST_CHECK_EQUAL(d.Root().AsInteger(), 100);
+            for (int i = 0; i < 100; ++i) {
+                BOOST_CHECK_EQUAL(d.Root().Find("key" + std::to_string(i))->AsInteger(), i);
+            }
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testParseErrors ) {
+        const char * invalid[] = {
+            "", " ", "[", "]", "[1,]", "[1 2]", "[,1]", "tru", "truex", "nul", "01", "-", "1.", "1e",
+            "\"abc", "\"\\x\"", "\"\\ud83d\"", "[1] 2", "\"a\"x",
+            "{", "{\"a\" 1}", "{1: 2}", "{\"a\": 1]", "{\"a\": 1,}", "[1}", "{\"a\"}"
+        };
+        for (const char * text : invalid) {
+            BOOST_CHECK_THROW(Parse(text), TJParseError);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testParseKernels ) {
+        std::string text = "[";
+        for (int i = 0; i < 200; ++i) {
+            text += "\"s\\\\" + std::to_string(i) + "\\\"q\", " + std::to_string(i * 7) + ", [true, null, -1.5e2],\n";
+        }
+        text += "\"" + std::string(100, '\\') + "\"]";
+
+        std::vector<uint64_t> scalar;
+        FindStructurals(text.data(), text.size(), scalar, JKERNEL_SCALAR);
+
+        EJSimdKernel kernels[] = { JKERNEL_SSE42, JKERNEL_AVX2 };
+        for (EJSimdKernel kernel : kernels) {
+            if (kernel > DetectKernel()) {
+                continue;
+            }
+            std::vector<uint64_t> index;
+            FindStructurals(text.data(), text.size(), index, kernel);
+            BOOST_CHECK(index == scalar);
+
+            TJDocument d = Parse(text.data(), text.size(), kernel);
+            array_t a = d.Root().AsArray();
+            BOOST_CHECK_EQUAL(a.size(), 601);
+            BOOST_CHECK_EQUAL(a[3]->AsString(), "s\\1\"q");
+            BOOST_CHECK_EQUAL(a[4]->AsInteger(), 7);
+            BOOST_CHECK_EQUAL(a[600]->AsString(), std::string(50, '\\'));
+        }
+    }
+
+    class TEventLog: public IJEventHandler {
+        public:
+        std::string log;
+
+        virtual void OnNull() { log += "null;"; }
+        virtual void OnBool(bool_t val) { log += val ? "true;" : "false;"; }
+        virtual void OnInteger(integer_t val) { log += "i" + std::to_string(val) + ";"; }
+        virtual void OnDouble(double_t val) { log += "d" + std::to_string(val) + ";"; }
+        virtual void OnString(const string_t & val) { log += "s" + val + ";"; }
+        virtual void OnKey(const string_t & val) { log += "k" + val + ";"; }
+        virtual void OnStartArray() { log += "[;"; }
+        virtual void OnEndArray() { log += "];"; }
+        virtual void OnStartMap() { log += "{;"; }
+        virtual void OnEndMap() { log += "};"; }
+    };
+
+    BOOST_AUTO_TEST_CASE( testEventParserChunks ) {
+        const std::string text = " {\"a\": [1, -2.5e1, \"x\\ty\\u00e9\\ud83d\\ude00\"], \"bb\": {\"c\": true, \"d\": null},"
+            " \"e\": [], \"f\": {}, \"g\": false, \"h\": 12345678901234567890} ";
+        const std::string expected = "{;ka;[;i1;d-25.000000;sx\ty\xc3\xa9\xf0\x9f\x98\x80;];kbb;{;kc;true;kd;null;};"
+            "ke;[;];kf;{;};kg;false;kh;d12345678901234567168.000000;};";
+
+        for (size_t split = 0; split <= text.size(); ++split) {
+            TEventLog log;
+            TJEventParser parser(log);
+            parser.Feed(text.data(), split);
+            parser.Feed(text.data() + split, text.size() - split);
+            parser.Finish();
+            BOOST_CHECK_EQUAL(log.log, expected);
+            BOOST_CHECK_EQUAL(parser.IsDone(), true);
+        }
+
+        {
+            TEventLog log;
+            TJEventParser parser(log);
+            for (char c : text) {
+                parser.Feed(&c, 1);
+            }
+            parser.Finish();
+            BOOST_CHECK_EQUAL(log.log, expected);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testEventReaderPull ) {
+        TJEventReader reader;
+        std::string chunk = "[12";
+        reader.Feed(chunk.data(), chunk.size());
+        BOOST_CHECK_EQUAL(reader.Next(), JEVENT_START_ARRAY);
+        BOOST_CHECK_EQUAL(reader.Next(), JEVENT_NEED_MORE);
+
+        chunk = "3, \"ab";
+        reader.Feed(chunk.data(), chunk.size());
+        BOOST_CHECK_EQUAL(reader.Next(), JEVENT_VALUE);
+        BOOST_CHECK_EQUAL(reader.GetValueType(), JINTEGER);
+        BOOST_CHECK_EQUAL(reader.GetInteger(), 123);
+        BOOST_CHECK_EQUAL(reader.Next(), JEVENT_NEED_MORE);
+
+        chunk = "c\"]";
+        reader.Feed(chunk.data(), chunk.size());
+        BOOST_CHECK_EQUAL(reader.Next(), JEVENT_VALUE);
+        BOOST_CHECK_EQUAL(reader.GetValueType(), JSTRING);
+        BOOST_CHECK_EQUAL(reader.GetString(), "abc");
+        BOOST_CHECK_EQUAL(reader.Next(), JEVENT_END_ARRAY);
+        BOOST_CHECK_EQUAL(reader.Next(), JEVENT_NEED_MORE);
+        reader.Close();
+        BOOST_CHECK_EQUAL(reader.Next(), JEVENT_END);
+        BOOST_CHECK_EQUAL(reader.IsDone(), true);
+    }
+
+    BOOST_AUTO_TEST_CASE( testEventReaderLargeArray ) {
+        // Depth, not document size, bounds the reader state
+        TJEventReader reader;
+        std::string chunk = "{\"k\": 1, \"v\": [true, \"s\"]},";
+        size_t events = 0;
+        size_t maxDepth = 0;
+
+        reader.Feed("[", 1);
+        BOOST_CHECK_EQUAL(reader.Next(), JEVENT_START_ARRAY);
+        BOOST_CHECK_EQUAL(reader.Next(), JEVENT_NEED_MORE);
+        for (int i = 0; i < 100000; ++i) {
+            reader.Feed(chunk.data(), chunk.size());
+            while (reader.Next() != JEVENT_NEED_MORE) {
+                ++events;
+                maxDepth = std::max(maxDepth, reader.GetDepth());
+            }
+        }
+        reader.Feed("null]", 5);
+        reader.Close();
+        while (reader.Next() != JEVENT_END) {
+            ++events;
+        }
+        BOOST_CHECK_EQUAL(events, 100000 * 9 + 2);
+        BOOST_CHECK_THROW(reader.Feed("[", 1), TJParseError);
+        BOOST_CHECK_EQUAL(maxDepth, 3);
+    }
+
+    BOOST_AUTO_TEST_CASE( testEventParserErrors ) {
+        const char * invalid[] = {
+            "", "[", "[1,]", "[1 2]", "{\"a\" 1}", "{1: 2}", "{\"a\": 1]", "tru", "nulll", "01", "-", "1.",
+            "\"abc", "\"\\x\"", "\"\\ud83d\"", "[1] 2", "\"a\"x", "[[[[1]]]]"
+        };
+        for (const char * text : invalid) {
+            TEventLog log;
+            TJEventParser parser(log, 3);
+            BOOST_CHECK_THROW({ parser.Feed(text, strlen(text)); parser.Finish(); }, TJParseError);
+        }
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
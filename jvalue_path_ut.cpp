@@ -0,0 +1,91 @@
+#include <boost/test/unit_test.hpp>
+#include "jvalue_parser.h"
+#include "jvalue_path.h"
+#include "jvalue_writer.h"
+#include <string>
+
+
+using namespace NJValue;
+
+namespace {
+    std::string Matches(const TJPath & path, const IJValue & root) {
+        std::vector<const IJValue *> out;
+        path.Select(root, out);
+        std::string text;
+        for (const IJValue * node : out) {
+            text += (text.empty() ? "" : " ") + ToJson(*node);
+        }
+        return text;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(testSuiteJValuePath)
+
+    BOOST_AUTO_TEST_CASE( testPathPointer ) {
+        // Examples of RFC 6901
+        TJDocument doc = Parse("{\"foo\": [\"bar\", \"baz\"], \"\": 0, \"a/b\": 1, \"c%d\": 2, \"e^f\": 3, \"g|h\": 4,"
+                               " \"i\\\\j\": 5, \"k\\\"l\": 6, \" \": 7, \"m~n\": 8}");
+        BOOST_CHECK_EQUAL(Matches(TJPath(""), doc.Root()), ToJson(doc.Root()));
+        BOOST_CHECK_EQUAL(Matches(TJPath("/foo"), doc.Root()), "[\"bar\",\"baz\"]");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/foo/0"), doc.Root()), "\"bar\"");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/"), doc.Root()), "0");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/a~1b"), doc.Root()), "1");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/c%d"), doc.Root()), "2");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/i\\j"), doc.Root()), "5");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/k\"l"), doc.Root()), "6");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/ "), doc.Root()), "7");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/m~0n"), doc.Root()), "8");
+
+        BOOST_CHECK_EQUAL(Matches(TJPath("/foo/2"), doc.Root()), "");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/foo/01"), doc.Root()), "");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/foo/-"), doc.Root()), "");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/missing/x"), doc.Root()), "");
+        BOOST_CHECK(TJPath("/foo/1").IsSingular());
+        BOOST_CHECK_EQUAL(TJPath("/foo/1").SelectFirst(doc.Root())->GetValue().AsString(), "baz");
+        BOOST_CHECK(TJPath("/foo/bar").SelectFirst(doc.Root()) == nullptr);
+
+        BOOST_CHECK_THROW(TJPath("foo"), TJParseError);
+        BOOST_CHECK_THROW(TJPath("/a~2"), TJParseError);
+        BOOST_CHECK_THROW(TJPath("/a~"), TJParseError);
+    }
+
+    BOOST_AUTO_TEST_CASE( testPathWildcardsAndSlices ) {
+        TJDocument doc = Parse("{\"events\": [{\"user\": {\"id\": 1}}, {\"user\": {\"id\": 2}}, {\"other\": 0},"
+                               " {\"user\": {\"id\": 3}}, {\"user\": {\"id\": 4}}], \"0\": \"zero\", \"1:2\": \"key\"}");
+        TJPath ids("/events/*/user/id");
+        BOOST_CHECK(!ids.IsSingular());
+        BOOST_CHECK_EQUAL(Matches(ids, doc.Root()), "1 2 3 4");
+        BOOST_CHECK_EQUAL(ids.SelectFirst(doc.Root())->GetValue().AsInteger(), 1);
+        BOOST_CHECK_EQUAL(Matches(TJPath("/events/1:3/user/id"), doc.Root()), "2");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/events/-2:/user/id"), doc.Root()), "3 4");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/events/:-3/user/id"), doc.Root()), "1 2");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/events/-100:100/user/id"), doc.Root()), "1 2 3 4");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/events/3:1"), doc.Root()), "");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/*/0/user/id"), doc.Root()), "1");
+
+        // On maps indexes and slices are keys
+        BOOST_CHECK_EQUAL(Matches(TJPath("/0"), doc.Root()), "\"zero\"");
+        BOOST_CHECK_EQUAL(Matches(TJPath("/1:2"), doc.Root()), "\"key\"");
+
+        // The same plan over many documents
+        for (int i = 0; i < 10; ++i) {
+            TJDocument other = Parse("{\"events\": [{\"user\": {\"id\": " + std::to_string(i) + "}}]}");
+            BOOST_CHECK_EQUAL(ids.SelectFirst(other.Root())->GetValue().AsInteger(), i);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testPathLazy ) {
+        std::string text = "{\"skip\": [";
+        for (int i = 0; i < 1000; ++i) {
+            text += "{\"a\": [1, 2, 3], \"b\": \"text\"},";
+        }
+        text += "{}], \"want\": {\"x\": [10, 20]}}";
+        TJLazyDocument doc(text.data(), text.size());
+        size_t loaded = doc.GetMemoryUsed();
+        BOOST_CHECK_EQUAL(TJPath("/want/x/1").SelectFirst(doc.Root())->GetValue().AsInteger(), 20);
+
+        // Only the containers on the way were expanded
+        BOOST_CHECK(doc.GetMemoryUsed() - loaded < 2048);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,203 @@
+#include <boost/test/unit_test.hpp>
+#include "jvalue.h"
+#include "jvalue_document.h"
+#include "jvalue_parser.h"
+#include "jvalue_pool.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+using namespace NJValue;
+
+namespace {
+    std::atomic<size_t> HeapAllocations(0);
+    std::atomic<size_t> HeapFrees(0);
+}
+
+// Every heap allocation of the test binary is counted
+void * operator new(size_t size) {
+    HeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void * p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void * p) noexcept {
+    if (p != nullptr) {
+        HeapFrees.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::free(p);
+}
+
+void operator delete(void * p, size_t) noexcept {
+    if (p != nullptr) {
+        HeapFrees.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::free(p);
+}
+
+namespace {
+    const char TEXT[] = "{\"id\": 1234, \"user\": {\"name\": \"a name longer than fourteen bytes\", \"roles\": [\"admin\", \"ops\"]},"
+                        " \"scores\": [1.5, 2.5, 3.5], \"events\": [{\"type\": \"login\", \"at\": 1}, {\"type\": \"logout\", \"at\": 2}],"
+                        " \"note\": \"an escaped \\\"string\\\" in the body\"}";
+
+    // Builds and drops an owned tree the shape of a typical response
+    size_t BuildOwned() {
+        TJValue<JSON_MAP> response;
+        TJValue<JSON_ARRAY> events;
+        for (int i = 0; i < 40; ++i) {
+            TJValue<JSON_ARRAY> event;
+            event.PushBack(TJValue<JSON_STRING>("an event name well past the short string size"));
+            event.PushBack(TJValue<JSON_INTEGER>(i));
+            event.PushBack(TJValue<JSON_ARRAY>());
+            events.PushBack(event);
+        }
+        // Not all numbers, or the array would be packed into a std::vector
+        TJValue<JSON_ARRAY> numbers;
+        numbers.PushBack(TJValue<JSON_NULL>());
+        for (int i = 0; i < 100; ++i) {
+            numbers.PushBack(TJValue<JSON_INTEGER>(i));
+        }
+        TJValue<JSON_STRING> name("a name longer than fourteen bytes");
+        map_t fields;
+        for (int i = 0; i < 12; ++i) {
+            fields.Set("field number " + std::to_string(i), i % 2 == 0 ? static_cast<IJValue *>(&events) : &numbers);
+        }
+        fields.Set("name", &name);
+        response = TJValue<JSON_MAP>(fields);
+        TJValue<JSON_MAP> copy = response;
+        copy.Find("field number 1")->Size();
+        events.Set(3, name);
+        numbers.At(5);
+        events.PopBack();
+        return copy.Size() + events.Size() + numbers.Size();
+    }
+
+    size_t ParseInto(TJDocument & doc) {
+        Parse(TEXT, sizeof(TEXT) - 1, doc, JPARSE_COPY);
+        return doc.Root().Find("events")->At(1)->Find("type")->AsStringView().size() + doc.Size();
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(testSuiteJValuePool)
+
+    BOOST_AUTO_TEST_CASE( testPoolSteadyState ) {
+        // The first cycles fill the pool
+        size_t expected = BuildOwned();
+        BuildOwned();
+
+        TJPool::ResetStats();
+        size_t before = HeapAllocations.load();
+        for (int i = 0; i < 100; ++i) {
+            BOOST_CHECK_EQUAL(BuildOwned(), expected);
+        }
+        size_t allocations = HeapAllocations.load() - before;
+        TJPoolStats stats = TJPool::GetStats();
+        // std::to_string keys are short enough for the small string buffer
+        BOOST_CHECK_EQUAL(allocations, 0);
+        BOOST_CHECK_EQUAL(stats.misses, 0);
+        BOOST_CHECK_GT(stats.hits, 100 * 100);
+        BOOST_CHECK_EQUAL(stats.GetHitRate(), 1.0);
+        BOOST_CHECK_GT(stats.cachedBytes, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE( testPoolDocumentReset ) {
+        TJDocument doc;
+        size_t expected = ParseInto(doc);
+        size_t capacity = doc.GetArena().GetCapacity();
+
+        size_t before = HeapAllocations.load();
+        for (int i = 0; i < 100; ++i) {
+            BOOST_CHECK_EQUAL(ParseInto(doc), expected);
+        }
+        BOOST_CHECK_EQUAL(HeapAllocations.load() - before, 0);
+        BOOST_CHECK_EQUAL(doc.GetArena().GetCapacity(), capacity);
+
+        // Copying out of the document goes through the pool as well, but for the
+        // number buffer of the packed "scores", which is a plain std::vector
+        {
+            TJValue<IJSON_VALUE> warm(doc.Root().GetValue());
+        }
+        before = HeapAllocations.load();
+        for (int i = 0; i < 100; ++i) {
+            TJValue<IJSON_VALUE> copy(doc.Root().GetValue());
+            BOOST_CHECK(copy.Equals(doc.Root()));
+        }
+        BOOST_CHECK_EQUAL(HeapAllocations.load() - before, 100);
+    }
+
+    BOOST_AUTO_TEST_CASE( testPoolThreads ) {
+        TJPool::Trim();
+        BOOST_CHECK_EQUAL(TJPool::GetStats().cachedBytes, 0);
+
+        // Blocks dropped on another thread are cached there; the thread frees them on exit
+        TJValue<JSON_STRING> * value = new TJValue<JSON_STRING>("a string owned by the main thread");
+        TJValue<JSON_ARRAY> * array = new TJValue<JSON_ARRAY>();
+        array->PushBack(*value);
+        TJPoolStats other;
+        std::thread([&]() {
+            delete value;
+            delete array;
+            BuildOwned();
+            other = TJPool::GetStats();
+        }).join();
+        BOOST_CHECK_GT(other.hits, 0);
+        BOOST_CHECK_GT(other.cachedBytes, 0);
+
+        // A consumer that only frees blocks allocated by a producer hands them back
+        // to the heap on exit, or on Trim()
+        TJPool::Trim();
+        std::vector<void *> produced;
+        for (int i = 0; i < 1000; ++i) {
+            produced.push_back(TJPool::Allocate(100));
+        }
+        size_t freed = HeapFrees.load();
+        TJPoolStats consumer;
+        TJPoolStats trimmed;
+        std::thread([&]() {
+            for (size_t i = 0; i < 500; ++i) {
+                TJPool::Deallocate(produced[i], 100);
+            }
+            consumer = TJPool::GetStats();
+        }).join();
+        BOOST_CHECK_EQUAL(consumer.cachedBytes, 500 * 112);
+        BOOST_CHECK_GE(HeapFrees.load() - freed, 500);
+        std::thread([&]() {
+            for (size_t i = 500; i < produced.size(); ++i) {
+                TJPool::Deallocate(produced[i], 100);
+            }
+            consumer = TJPool::GetStats();
+            TJPool::Trim();
+            trimmed = TJPool::GetStats();
+        }).join();
+        BOOST_CHECK_EQUAL(consumer.cachedBytes, 500 * 112);
+        BOOST_CHECK_EQUAL(trimmed.cachedBytes, 0);
+        BOOST_CHECK_GE(HeapFrees.load() - freed, 1000);
+
+        // Oversized blocks bypass the pool, lists stop growing at MAX_CACHED
+        TJPool::ResetStats();
+        void * large = TJPool::Allocate(TJPool::MAX_SIZE + 1);
+        TJPool::Deallocate(large, TJPool::MAX_SIZE + 1);
+        BOOST_CHECK_EQUAL(TJPool::GetStats().misses, 1);
+        BOOST_CHECK_EQUAL(TJPool::GetStats().released, 1);
+        TJPool::Trim();
+        std::vector<void *> blocks;
+        for (size_t i = 0; i < 2 * TJPool::MAX_CACHED / 64; ++i) {
+            blocks.push_back(TJPool::Allocate(64));
+        }
+        for (void * block : blocks) {
+            TJPool::Deallocate(block, 64);
+        }
+        BOOST_CHECK_EQUAL(TJPool::GetStats().cachedBytes, TJPool::MAX_CACHED);
+        BOOST_CHECK_EQUAL(TJPool::GetStats().released, 1 + TJPool::MAX_CACHED / 64);
+        TJPool::Trim();
+        BOOST_CHECK_EQUAL(TJPool::GetStats().cachedBytes, 0);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,7 +1,13 @@
 #define BOOST_TEST_MODULE testJValue
 #include <boost/test/unit_test.hpp>
 #include "jvalue.h"
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
 
 
 using namespace NJValue;
@@ -99,7 +105,8 @@ BOOST_AUTO_TEST_SUITE(testSuiteJValue)
         {
             TJValue<JSON_DOUBLE> j = 5.0;
             BOOST_CHECK_EQUAL(j.IsDouble(), true);
-            BOOST_CHECK_EQUAL(j.AsString(), "5.000000");
+            BOOST_CHECK_EQUAL(j.AsString(), "5.0");
+            BOOST_CHECK_EQUAL(j.AsString(JDOUBLE_FIXED), "5.000000");
             BOOST_CHECK_EQUAL(j.AsInteger(), 5);
             BOOST_CHECK_EQUAL(j.AsDouble(), 5.0);
             BOOST_CHECK_EQUAL(j.AsBool(), true);
@@ -110,7 +117,8 @@ BOOST_AUTO_TEST_SUITE(testSuiteJValue)
         {
             TJValue<JSON_DOUBLE> j = -15.6;
             BOOST_CHECK_EQUAL(j.IsDouble(), true);
-            BOOST_CHECK_EQUAL(j.AsString(), "-15.600000");
+            BOOST_CHECK_EQUAL(j.AsString(), "-15.6");
+            BOOST_CHECK_EQUAL(j.AsString(JDOUBLE_FIXED), "-15.600000");
             BOOST_CHECK_EQUAL(j.AsInteger(), -15);
             BOOST_CHECK_EQUAL(j.AsDouble(), -15.6);
             BOOST_CHECK_EQUAL(j.AsBool(), true);
@@ -121,7 +129,8 @@ BOOST_AUTO_TEST_SUITE(testSuiteJValue)
         {
             TJValue<JSON_DOUBLE> j = 0.1;
             BOOST_CHECK_EQUAL(j.IsDouble(), true);
-            BOOST_CHECK_EQUAL(j.AsString(), "0.100000");
+            BOOST_CHECK_EQUAL(j.AsString(), "0.1");
+            BOOST_CHECK_EQUAL(j.AsString(JDOUBLE_FIXED), "0.100000");
             BOOST_CHECK_EQUAL(j.AsInteger(), 0);
             BOOST_CHECK_EQUAL(j.AsDouble(), 0.1);
             BOOST_CHECK_EQUAL(j.AsBool(), false);
@@ -254,4 +263,455 @@ BOOST_AUTO_TEST_SUITE(testSuiteJValue)
         // TODO Добавить тесты на диапазоны допустимых значений
     }
 
+    BOOST_AUTO_TEST_CASE( testJValueLayout ) {
+        BOOST_CHECK_EQUAL(sizeof(IJSON_VALUE), 16);
+        BOOST_CHECK_EQUAL(sizeof(TJValue<JSON_INTEGER>), 16);
+        BOOST_CHECK_EQUAL(sizeof(TJValue<JSON_ARRAY>), 16);
+
+        {
+            TJValue<JSON_STRING> j = "01234567890123";
+            BOOST_CHECK_EQUAL(j.AsString(), "01234567890123");
+            BOOST_CHECK_EQUAL(j.AsInteger(), 1234567890123L);
+            TJValue<JSON_STRING> i = j;
+            BOOST_CHECK_EQUAL(i.AsString(), j.AsString());
+        }
+
+        {
+            TJValue<JSON_STRING> j = "A string that does not fit inline";
+            BOOST_CHECK_EQUAL(j.AsString(), "A string that does not fit inline");
+            BOOST_CHECK_EQUAL(j.AsBool(), true);
+            TJValue<JSON_STRING> i = j;
+            j = "short";
+            BOOST_CHECK_EQUAL(i.AsString(), "A string that does not fit inline");
+            BOOST_CHECK_EQUAL(j.AsString(), "short");
+        }
+
+        {
+            TJValue<JSON_INTEGER> e1 = 1;
+            TJValue<JSON_STRING> e2 = "2";
+            TJValue<JSON_ARRAY> j = array_t{ &e1, &e2 };
+            BOOST_CHECK_EQUAL(j.AsString(), "2");
+            BOOST_CHECK_EQUAL(j.AsBool(), true);
+            TJValue<JSON_ARRAY> i = j;
+            BOOST_CHECK_EQUAL(i.AsArray().size(), 2);
+            BOOST_CHECK_EQUAL(i.AsArray()[1]->AsInteger(), 2);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testJValueArraySharing ) {
+        TJValue<JSON_INTEGER> e1 = 1;
+        TJValue<JSON_INTEGER> e2 = 2;
+        TJValue<JSON_ARRAY> j = array_t{ &e1, &e2 };
+
+        {
+            // Copies share the storage until one of them changes
+#ifdef JVALUE_STATS
+            size_t allocated = GetStats(JARRAY).bytesAllocated;
+#endif
+            TJValue<JSON_ARRAY> i = j;
+            TJValue<JSON_ARRAY> k = i;
+#ifdef JVALUE_STATS
+            BOOST_CHECK_EQUAL(GetStats(JARRAY).bytesAllocated, allocated);
+#endif
+            BOOST_CHECK(i.At(0) == &e1);
+
+            TJValue<JSON_STRING> s = "pushed";
+            i.PushBack(s);
+            s = "changed";
+            k.Set(0, e2);
+            BOOST_CHECK_EQUAL(j.Size(), 2);
+            BOOST_CHECK_EQUAL(i.Size(), 3);
+            BOOST_CHECK_EQUAL(i.At(2)->AsString(), "pushed");
+            BOOST_CHECK_EQUAL(k.At(0)->AsInteger(), 2);
+            BOOST_CHECK(j.At(0) == &e1);
+
+            // Owned elements are copied along with the array
+            TJValue<JSON_ARRAY> l = i;
+            l.Set(2, e1);
+            l.PopBack();
+            BOOST_CHECK_EQUAL(l.Size(), 2);
+            BOOST_CHECK_EQUAL(i.At(2)->AsString(), "pushed");
+            i.PushBack(&e2);
+            BOOST_CHECK(i.At(3) == &e2);
+        }
+
+        {
+            TJValue<JSON_ARRAY> e;
+            TJValue<JSON_ARRAY> copy = e;
+            e.PushBack(e1);
+            BOOST_CHECK_EQUAL(e.Size(), 1);
+            BOOST_CHECK_EQUAL(copy.Size(), 0);
+            copy.PopBack();
+            BOOST_CHECK_EQUAL(copy.Size(), 0);
+        }
+
+        {
+            // The reference count is shared between threads
+            std::vector<std::thread> threads;
+            for (int t = 0; t < 4; ++t) {
+                threads.emplace_back([&j]() {
+                    for (int n = 0; n < 10000; ++n) {
+                        TJValue<JSON_ARRAY> copy = j;
+                        if (n % 100 == 0) {
+                            copy.PushBack(copy);
+                        }
+                    }
+                });
+            }
+            for (std::thread & thread : threads) {
+                thread.join();
+            }
+            BOOST_CHECK_EQUAL(j.Size(), 2);
+            BOOST_CHECK(j.At(1) == &e2);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testJValueMap ) {
+        {
+            TJValue<JSON_MAP> j;
+            BOOST_CHECK_EQUAL(j.IsMap(), true);
+            BOOST_CHECK_EQUAL(j.AsString(), "0");
+            BOOST_CHECK_EQUAL(j.AsInteger(), 0);
+            BOOST_CHECK_EQUAL(j.AsDouble(), 0.0);
+            BOOST_CHECK_EQUAL(j.AsBool(), false);
+            BOOST_CHECK(j.Find("a") == nullptr);
+        }
+
+        {
+            TJValue<JSON_INTEGER> a = 1;
+            TJValue<JSON_STRING> b = "2";
+            map_t m;
+            BOOST_CHECK_EQUAL(m.Set("a", &a), true);
+            BOOST_CHECK_EQUAL(m.Set("b", &b), true);
+            BOOST_CHECK_EQUAL(m.Set("a", &b), false);
+
+            TJValue<JSON_MAP> j = m;
+            BOOST_CHECK_EQUAL(j.IsMap(), true);
+            BOOST_CHECK_EQUAL(j.AsString(), "2");
+            BOOST_CHECK_EQUAL(j.AsBool(), true);
+            BOOST_CHECK_EQUAL(j.Find("a")->AsString(), "2");
+            BOOST_CHECK_EQUAL(j.Find("b")->AsInteger(), 2);
+
+            TJValue<JSON_MAP> i = j;
+            BOOST_CHECK_EQUAL(i.AsMap().Size(), 2);
+            BOOST_CHECK_EQUAL(i.Find("b")->AsString(), "2");
+        }
+
+        {
+            // Crosses LINEAR_MAX, so lookups go through the hash index
+            TJValue<JSON_NULL> n;
+            map_t m;
+            for (int i = 0; i < 50; ++i) {
+                m.Set("field" + std::to_string(i), &n);
+            }
+            BOOST_CHECK_EQUAL(m.Size(), 50);
+            BOOST_CHECK(m.Find("field49") == &n);
+            BOOST_CHECK(m.Find("field50") == nullptr);
+            BOOST_CHECK_EQUAL(m.Erase("field0"), true);
+            BOOST_CHECK_EQUAL(m.Erase("field0"), false);
+            BOOST_CHECK(m.Find("field0") == nullptr);
+            BOOST_CHECK(m.Find("field1") == &n);
+            BOOST_CHECK_EQUAL(m.begin()->GetKey(), "field1");
+
+            map_t copy = m;
+            m.Clear();
+            BOOST_CHECK_EQUAL(copy.Size(), 49);
+            BOOST_CHECK(copy.Find("field25") == &n);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testJValueStringView ) {
+        {
+            TJValue<JSON_STRING> j = "Hello!";
+            BOOST_CHECK(j.AsStringView() == "Hello!");
+            BOOST_CHECK_EQUAL(j.AsStringView().size(), 6);
+            BOOST_CHECK_EQUAL(j.AsStringView().ToString(), j.AsString());
+        }
+
+        {
+            TJValue<JSON_STRING> j = "A string that does not fit inline";
+            BOOST_CHECK(j.AsStringView() == "A string that does not fit inline");
+        }
+
+        {
+            TJValue<JSON_BOOL> j = true;
+            BOOST_CHECK(j.AsStringView() == "true");
+        }
+
+        {
+            TJValue<JSON_NULL> j;
+            BOOST_CHECK(j.AsStringView().empty());
+        }
+
+        {
+            const char text[] = "borrowed bytes, not copied";
+            TJValue<JSON_STRING> j = JSON_STRING(TJBorrow(), text, sizeof(text) - 1);
+            BOOST_CHECK(j.AsStringView().data() == text);
+            TJValue<JSON_STRING> i = j;
+            BOOST_CHECK(i.AsStringView().data() != text);
+            BOOST_CHECK(i.AsStringView() == j.AsStringView());
+        }
+    }
+
+    namespace {
+        // The value T(JSON_X(val)) has, the path conversions took before TJConvert
+        template<class T, class X, class S>
+        void CheckConversion(const S & val) {
+            TJValue<T> direct(val);
+            TJValue<IJSON_VALUE> via = IJSON_VALUE(T(X(val)));
+            BOOST_CHECK_EQUAL(direct.GetType(), via.GetValue().GetType());
+            BOOST_CHECK_EQUAL(direct.AsString(), via.AsString());
+            BOOST_CHECK_EQUAL(direct.AsBool(), via.AsBool());
+            BOOST_CHECK_EQUAL(direct.AsInteger(), via.AsInteger());
+        }
+
+        template<class S, class X>
+        void CheckConversions(const S & val) {
+            CheckConversion<JSON_UNDEFINED, X>(val);
+            CheckConversion<JSON_NULL, X>(val);
+            CheckConversion<JSON_BOOL, X>(val);
+            CheckConversion<JSON_INTEGER, X>(val);
+            CheckConversion<JSON_DOUBLE, X>(val);
+            CheckConversion<JSON_STRING, X>(val);
+            CheckConversion<JSON_ARRAY, X>(val);
+            CheckConversion<JSON_MAP, X>(val);
+            CheckConversion<IJSON_VALUE, X>(val);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testJValueStaticType ) {
+        static_assert(TJStaticType<JSON_INTEGER>::IsFixed() && TJStaticType<JSON_INTEGER>::Is(JINTEGER), "fixed type");
+        static_assert(!TJStaticType<JSON_MAP>::Is(JARRAY), "other type");
+        static_assert(!TJStaticType<IJSON_VALUE>::IsFixed(), "any type");
+
+        TJValue<JSON_DOUBLE> d = 2.5;
+        BOOST_CHECK(d.IsDouble() && !d.IsInteger());
+        BOOST_CHECK_EQUAL(d.AsInteger(), 2);
+        TJValue<IJSON_VALUE> any = JSON_STRING("7");
+        BOOST_CHECK(any.IsString() && !any.IsDouble());
+        BOOST_CHECK_EQUAL(any.AsInteger(), 7);
+        const IJValue & erased = d;
+        BOOST_CHECK(erased.IsDouble());
+
+        for (bool_t val : { false, true }) {
+            CheckConversions<bool_t, JSON_BOOL>(val);
+        }
+        for (integer_t val : { integer_t(0), integer_t(1), integer_t(-42), integer_t(LLONG_MIN) }) {
+            CheckConversions<integer_t, JSON_INTEGER>(val);
+        }
+        for (double_t val : { 0.0, 0.5, -1.5, 1e300, std::nan("") }) {
+            CheckConversions<double_t, JSON_DOUBLE>(val);
+        }
+        for (const char * val : { "", "0", "false", "12.5", "text longer than fourteen" }) {
+            CheckConversions<string_t, JSON_STRING>(string_t(val));
+        }
+
+        // Moved numbers keep their storage
+        std::vector<integer_t> numbers = { 1, 2, 3 };
+        const integer_t * data = numbers.data();
+        TJValue<JSON_ARRAY> packed(std::move(numbers));
+        BOOST_CHECK(packed.AsIntegerSpan().data() == data);
+        TJValue<JSON_INTEGER> one = 1;
+        array_t items = { &one, &one };
+        TJValue<JSON_ARRAY> array(std::move(items));
+        BOOST_CHECK_EQUAL(array.Size(), 2);
+        BOOST_CHECK(array.At(1) == &one);
+
+#ifdef JVALUE_STATS
+        // No temporary of the source type
+        ResetStats();
+        {
+            TJValue<JSON_STRING> s = integer_t(5);
+            TJValue<JSON_DOUBLE> n = true;
+            BOOST_CHECK_EQUAL(s.AsString(), "5");
+            BOOST_CHECK_EQUAL(n.AsDouble(), 1.0);
+        }
+        BOOST_CHECK_EQUAL(GetStats(JINTEGER).constructed, 0);
+        BOOST_CHECK_EQUAL(GetStats(JBOOL).constructed, 0);
+        BOOST_CHECK_EQUAL(GetStats(JSTRING).converted, 1);
+        BOOST_CHECK_EQUAL(GetStats(JDOUBLE).converted, 1);
+#endif
+    }
+
+#ifdef JVALUE_STATS
+    BOOST_AUTO_TEST_CASE( testJValueStats ) {
+        ResetStats();
+        {
+            TJValue<JSON_INTEGER> i = 5;
+            TJValue<JSON_STRING> s = "a string longer than fourteen bytes";
+            TJValue<JSON_STRING> copy = s;
+            TJValue<JSON_STRING> converted(i.GetValue());
+            BOOST_CHECK_EQUAL(converted.AsString(), "5");
+        }
+
+        // Temporaries are counted too, but every value created is destroyed
+        TJTypeStats integers = GetStats(JINTEGER);
+        BOOST_CHECK(integers.constructed >= 1);
+        BOOST_CHECK_EQUAL(integers.destroyed, integers.constructed);
+        BOOST_CHECK_EQUAL(integers.converted, 0);
+        BOOST_CHECK_EQUAL(integers.bytesAllocated, 0);
+
+        TJTypeStats strings = GetStats(JSTRING);
+        BOOST_CHECK(strings.constructed >= 3);
+        BOOST_CHECK_EQUAL(strings.destroyed, strings.constructed);
+        BOOST_CHECK(strings.copied >= 1);
+        BOOST_CHECK_EQUAL(strings.converted, 1);
+        BOOST_CHECK(strings.bytesAllocated >= 2 * 35);
+        BOOST_CHECK_EQUAL(GetStats(JDOUBLE).constructed, 0);
+
+        ResetStats();
+        BOOST_CHECK_EQUAL(GetStats(JSTRING).constructed, 0);
+    }
+#endif
+
+#ifdef JVALUE_TRACE
+    namespace {
+        size_t traced[JTRACE_ALLOCATE + 1];
+
+        void CountEvent(EJTraceEvent event, EJValueType, size_t) {
+            ++traced[event];
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testJValueTraceHook ) {
+        SetTraceHook(CountEvent);
+        {
+            TJValue<JSON_DOUBLE> d = 0.5;
+            TJValue<JSON_DOUBLE> copy = d;
+        }
+        SetTraceHook(nullptr);
+        BOOST_CHECK(traced[JTRACE_COPY] >= 1);
+        BOOST_CHECK(traced[JTRACE_CONSTRUCT] >= 2);
+        BOOST_CHECK_EQUAL(traced[JTRACE_DESTROY], traced[JTRACE_CONSTRUCT]);
+    }
+#endif
+
+    BOOST_AUTO_TEST_CASE( testJValueNumberParsing ) {
+        integer_t i;
+        size_t consumed;
+        BOOST_CHECK_EQUAL(ParseInteger("12345", 5, i), JNUMBER_OK);
+        BOOST_CHECK_EQUAL(i, 12345);
+        BOOST_CHECK_EQUAL(ParseInteger("  -42abc", 8, i, &consumed), JNUMBER_PARTIAL);
+        BOOST_CHECK_EQUAL(i, -42);
+        BOOST_CHECK_EQUAL(consumed, 5);
+        BOOST_CHECK_EQUAL(ParseInteger("-9223372036854775808", 20, i), JNUMBER_OK);
+        BOOST_CHECK_EQUAL(i, LONG_MIN);
+        BOOST_CHECK_EQUAL(ParseInteger("9223372036854775808", 19, i), JNUMBER_RANGE);
+        BOOST_CHECK_EQUAL(i, LONG_MAX);
+        BOOST_CHECK_EQUAL(ParseInteger("x1", 2, i), JNUMBER_INVALID);
+        BOOST_CHECK_EQUAL(i, 0);
+
+        double_t d;
+        BOOST_CHECK_EQUAL(ParseDouble("0.1", 3, d), JNUMBER_OK);
+        BOOST_CHECK_EQUAL(d, 0.1);
+        BOOST_CHECK_EQUAL(ParseDouble("-1.5e3xyz", 9, d, &consumed), JNUMBER_PARTIAL);
+        BOOST_CHECK_EQUAL(d, -1500.0);
+        BOOST_CHECK_EQUAL(consumed, 6);
+        BOOST_CHECK_EQUAL(ParseDouble("1e", 2, d, &consumed), JNUMBER_PARTIAL);
+        BOOST_CHECK_EQUAL(consumed, 1);
+        BOOST_CHECK_EQUAL(ParseDouble("1e400", 5, d), JNUMBER_RANGE);
+        BOOST_CHECK(std::isinf(d));
+        BOOST_CHECK_EQUAL(ParseDouble(".", 1, d), JNUMBER_INVALID);
+        BOOST_CHECK_EQUAL(ParseDouble("-inf", 4, d), JNUMBER_OK);
+        BOOST_CHECK(std::isinf(d) && d < 0);
+
+        // Correct rounding, compared with strtod in the C locale
+        const char * samples[] = {
+            "9007199254740993", "2.2250738585072014e-308", "1.7976931348623157e308", "4.9e-324",
+            "0.1000000000000000055511151231257827021181583404541015625", "123456789012345678901234567890",
+            "0.30000000000000004", "1e23", "8.98846567431158e307", "-0.000001234567890123456789"
+        };
+        for (const char * sample : samples) {
+            ParseDouble(sample, std::strlen(sample), d);
+            BOOST_CHECK_EQUAL(d, std::strtod(sample, nullptr));
+        }
+        uint64_t state = 88172645463325252ULL;
+        char buf[40];
+        for (int n = 0; n < 10000; ++n) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            double_t value;
+            std::memcpy(&value, &state, sizeof(value));
+            if (!std::isfinite(value)) {
+                continue;
+            }
+            int len = std::snprintf(buf, sizeof(buf), "%.*g", 1 + int(state % 17), value);
+            ParseDouble(buf, len, d);
+            BOOST_CHECK_EQUAL(d, std::strtod(buf, nullptr));
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testJValueStringCoercion ) {
+        {
+            TJValue<JSON_STRING> j = "99999999999999999999";
+            BOOST_CHECK_EQUAL(j.AsInteger(), LONG_MAX);
+            BOOST_CHECK_EQUAL(j.AsDouble(), 1e20);
+        }
+
+        {
+            TJValue<JSON_STRING> j = "  12.75 apples";
+            BOOST_CHECK_EQUAL(j.AsInteger(), 12);
+            BOOST_CHECK_EQUAL(j.AsDouble(), 12.75);
+        }
+
+        {
+            // Heap strings remember the result
+            TJValue<JSON_STRING> j = "-123456.000000000001";
+            BOOST_CHECK_EQUAL(j.AsInteger(), -123456);
+            BOOST_CHECK_EQUAL(j.AsInteger(), -123456);
+            BOOST_CHECK_EQUAL(j.AsDouble(), -123456.0);
+            BOOST_CHECK_EQUAL(j.AsDouble(), -123456.0);
+            j = "a different long string";
+            BOOST_CHECK_EQUAL(j.AsInteger(), 0);
+            TJValue<JSON_STRING> copy = j;
+            BOOST_CHECK_EQUAL(copy.AsDouble(), 0.0);
+        }
+
+        {
+            TJValue<JSON_STRING> j = "1e400";
+            BOOST_CHECK(std::isinf(j.AsDouble()));
+            BOOST_CHECK_EQUAL(j.AsInteger(), 1);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testJValueNumberFormatting ) {
+        char buf[FORMAT_FIXED_MAX];
+        BOOST_CHECK_EQUAL(string_t(buf, FormatInteger(buf, 0)), "0");
+        BOOST_CHECK_EQUAL(string_t(buf, FormatInteger(buf, -1234567)), "-1234567");
+        BOOST_CHECK_EQUAL(string_t(buf, FormatInteger(buf, LONG_MIN)), "-9223372036854775808");
+        BOOST_CHECK_EQUAL(string_t(buf, FormatInteger(buf, LONG_MAX)), "9223372036854775807");
+
+        BOOST_CHECK_EQUAL(string_t(buf, FormatDouble(buf, 0.0)), "0.0");
+        BOOST_CHECK_EQUAL(string_t(buf, FormatDouble(buf, -0.0)), "-0.0");
+        BOOST_CHECK_EQUAL(string_t(buf, FormatDouble(buf, 1e20)), "100000000000000000000.0");
+        BOOST_CHECK_EQUAL(string_t(buf, FormatDouble(buf, 1e21)), "1e+21");
+        BOOST_CHECK_EQUAL(string_t(buf, FormatDouble(buf, 1.5e-7)), "1.5e-7");
+        BOOST_CHECK_EQUAL(string_t(buf, FormatDouble(buf, 0.000001)), "0.000001");
+        BOOST_CHECK_EQUAL(string_t(buf, FormatDouble(buf, 123.456)), "123.456");
+        BOOST_CHECK_EQUAL(string_t(buf, FormatDouble(buf, 0.30000000000000004)), "0.30000000000000004");
+        BOOST_CHECK_EQUAL(string_t(buf, FormatDouble(buf, 5e-324)), "5e-324");
+        BOOST_CHECK_EQUAL(string_t(buf, FormatDouble(buf, 1.7976931348623157e308)), "1.7976931348623157e+308");
+        BOOST_CHECK_EQUAL(string_t(buf, FormatDouble(buf, -1.0 / 0.0)), "-inf");
+        BOOST_CHECK_EQUAL(string_t(buf, FormatDouble(buf, 1e300, JDOUBLE_FIXED)).size(), 308);
+
+        // Every output reads back to the same double
+        uint64_t state = 2463534242ULL;
+        for (int n = 0; n < 20000; ++n) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            double_t value;
+            std::memcpy(&value, &state, sizeof(value));
+            if (!std::isfinite(value)) {
+                continue;
+            }
+            char * end = FormatDouble(buf, value);
+            BOOST_REQUIRE(end - buf <= static_cast<ptrdiff_t>(FORMAT_DOUBLE_MAX));
+            double_t back;
+            BOOST_CHECK_EQUAL(ParseDouble(buf, end - buf, back), JNUMBER_OK);
+            BOOST_CHECK_EQUAL(back, value);
+        }
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,173 @@
+#include <boost/test/unit_test.hpp>
+#include "jvalue.h"
+#include "jvalue_parser.h"
+#include "jvalue_writer.h"
+#include <random>
+#include <string>
+#include <vector>
+
+
+using namespace NJValue;
+
+namespace {
+    // Kernels the CPU can run
+    std::vector<EJSimdKernel> Kernels() {
+        std::vector<EJSimdKernel> kernels{ JKERNEL_SCALAR };
+        if (DetectKernel() != JKERNEL_SCALAR) {
+            kernels.push_back(JKERNEL_SSE42);
+        }
+        if (DetectKernel() == JKERNEL_AVX2) {
+            kernels.push_back(JKERNEL_AVX2);
+        }
+        return kernels;
+    }
+
+    struct TCase {
+        std::string text;
+        size_t bad;         // npos if well-formed
+    };
+
+    const size_t OK = std::string::npos;
+
+    const TCase CASES[] = {
+        { "plain ascii", OK },
+        { "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\xf4\x8f\xbf\xbf", OK },  // é € 😀 U+10FFFF
+        { "\xed\x9f\xbf\xee\x80\x80", OK },                             // around the surrogates
+        { "a\x80", 1 },                 // lone continuation
+        { "a\xc3", 1 },                 // truncated at the end
+        { "\xc3(", 0 },
+        { "\xc0\xaf", 0 },              // overlong '/'
+        { "\xc1\xbf", 0 },
+        { "\xe0\x9f\xbf", 0 },          // overlong 3-byte
+        { "\xed\xa0\x80", 0 },          // U+D800
+        { "\xf0\x8f\xbf\xbf", 0 },      // overlong 4-byte
+        { "\xf4\x90\x80\x80", 0 },      // U+110000
+        { "\xf5\x80\x80\x80", 0 },
+        { "\xff", 0 },
+        { "\xe2\x82", 0 },
+        { "\xe2\x82(", 0 },
+        { "\xf0\x9f\x98", 0 },
+        { "\xc3\xa9\xc3\xa9\x80", 4 },  // extra continuation
+    };
+
+    std::string Utf8(std::mt19937 & random) {
+        static const char * const PIECES[] = { "a", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "\"", "\\", "\n" };
+        std::string text;
+        size_t size = random() % 200;
+        while (text.size() < size) {
+            text += PIECES[random() % 7];
+        }
+        return text;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(testSuiteJValueUtf8)
+
+    BOOST_AUTO_TEST_CASE( testUtf8Validate ) {
+        for (EJSimdKernel kernel : Kernels()) {
+            for (const TCase & test : CASES) {
+                // At every position in and across 16- and 32-byte blocks, with text after it
+                for (size_t pad = 0; pad < 70; ++pad) {
+                    for (const char * tail : { "", "0123456789abcdef0123456789abcdef" }) {
+                        std::string text = std::string(pad, ' ') + test.text + tail;
+                        size_t bad = test.bad == OK ? text.size() : pad + test.bad;
+                        BOOST_CHECK_EQUAL(FindInvalidUtf8(text.data(), text.size(), kernel), bad);
+                    }
+                }
+            }
+        }
+
+        // Random well-formed text with one byte changed, against the scalar check
+        std::mt19937 random(17);
+        for (size_t i = 0; i < 3000; ++i) {
+            std::string text = Utf8(random);
+            BOOST_REQUIRE(IsValidUtf8(text.data(), text.size(), JKERNEL_SCALAR));
+            if (!text.empty()) {
+                text[random() % text.size()] = static_cast<char>(random());
+            }
+            size_t expected = FindInvalidUtf8(text.data(), text.size(), JKERNEL_SCALAR);
+            for (EJSimdKernel kernel : Kernels()) {
+                BOOST_CHECK_EQUAL(FindInvalidUtf8(text.data(), text.size(), kernel), expected);
+            }
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( testUtf8Escape ) {
+        for (EJSimdKernel kernel : Kernels()) {
+            for (size_t pad = 0; pad < 70; ++pad) {
+                std::string text(pad, 'x');
+                BOOST_CHECK_EQUAL(FindEscape(text.data(), text.size(), kernel), pad);
+                for (char c : { '"', '\\', '\x01', '\x1f', '\0' }) {
+                    std::string special = text + c + "\xc3\xa9 tail";
+                    BOOST_CHECK_EQUAL(FindEscape(special.data(), special.size(), kernel), pad);
+                }
+                std::string above = text + " \x7f\xff";
+                BOOST_CHECK_EQUAL(FindEscape(above.data(), above.size(), kernel), above.size());
+            }
+        }
+
+        // Long runs between escapes, through the buffer and around it
+        std::string text = std::string(5000, 'a') + "\"" + std::string(40, 'b') + "\n\xc3\xa9";
+        BOOST_CHECK_EQUAL(ToJson(TJValue<JSON_STRING>(text)), "\"" + std::string(5000, 'a') + "\\\"" + std::string(40, 'b') + "\\n\xc3\xa9\"");
+        BOOST_CHECK_EQUAL(Parse(ToJson(TJValue<JSON_STRING>(text))).Root().AsString(), text);
+        BOOST_CHECK_EQUAL(Parse("\"a\\u00e9\\ud83d\\ude00\\\\b\"").Root().AsString(), "a\xc3\xa9\xf0\x9f\x98\x80\\b");
+    }
+
+    BOOST_AUTO_TEST_CASE( testUtf8Modes ) {
+        const std::string bad = "[\"ok\", \"caf\xc3\xa9\", \"b\xe9t\"]";
+        try {
+            Parse(bad);
+            BOOST_ERROR("Invalid UTF-8 was accepted");
+        } catch (const TJParseError & e) {
+            BOOST_CHECK_EQUAL(e.GetMessage(), "Invalid UTF-8");
+            BOOST_CHECK_EQUAL(e.GetOffset(), bad.find('\xe9'));
+        }
+        BOOST_CHECK_THROW(Parse("{\"k\xff\": 1}"), TJParseError);
+        TJDocument doc;
+        Parse(bad.data(), bad.size(), doc, JPARSE_COPY, JKERNEL_AUTO, JUTF8_LENIENT);
+        BOOST_CHECK_EQUAL(doc.Root().At(2)->AsString(), "b\xe9t");
+        Parse(bad.data(), bad.size(), doc, JPARSE_BORROW, JKERNEL_SCALAR, JUTF8_LENIENT);
+        BOOST_CHECK_EQUAL(doc.Root().At(1)->AsString(), "caf\xc3\xa9");
+
+        // Streamed: a sequence split between chunks is fine, a broken one is not
+        TJEventReader reader;
+        const char text[] = "[\"\xf0\x9f\x98\x80\"]";
+        reader.Feed(text, 4);
+        BOOST_CHECK_EQUAL(reader.Next(), JEVENT_START_ARRAY);
+        BOOST_CHECK_EQUAL(reader.Next(), JEVENT_NEED_MORE);
+        reader.Feed(text + 4, sizeof(text) - 5);
+        BOOST_CHECK_EQUAL(reader.Next(), JEVENT_VALUE);
+        BOOST_CHECK_EQUAL(reader.GetString(), "\xf0\x9f\x98\x80");
+        TJEventReader strict;
+        strict.Feed(bad.data(), bad.size());
+        strict.Close();
+        BOOST_CHECK_THROW(for (;;) { strict.Next(); }, TJParseError);
+        TJEventReader lenient(1024, JUTF8_LENIENT);
+        lenient.Feed(bad.data(), bad.size());
+        lenient.Close();
+        while (lenient.Next() != JEVENT_END) { }
+
+        // Lazily loaded: checked when the string is reached
+        const std::string nested = "{\"a\": [1, {\"k\": \"b\xe9t, and long enough for the vector kernels\", \"e\": \"\\t\xff\"}]}";
+        TJLazyDocument strictLazy(nested.data(), nested.size());
+        BOOST_CHECK_THROW(strictLazy.Root().Find("a")->At(1)->Find("k"), TJParseError);
+        TJLazyDocument lenientLazy(nested.data(), nested.size(), JKERNEL_AUTO, JUTF8_LENIENT);
+        const IJValue * item = lenientLazy.Root().Find("a")->At(1);
+        BOOST_CHECK_EQUAL(item->Find("k")->AsString(), "b\xe9t, and long enough for the vector kernels");
+        BOOST_CHECK_EQUAL(item->Find("e")->AsString(), "\t\xff");
+
+        // Writing and building strings
+        TJValue<JSON_STRING> latin1("b\xe9t");
+        BOOST_CHECK_EQUAL(ToJson(latin1), "\"b\xe9t\"");
+        string_t out;
+        TJStringSink sink(out);
+        TJWriter writer(sink);
+        writer.SetUtf8Mode(JUTF8_STRICT);
+        writer.Write(TJValue<JSON_STRING>("caf\xc3\xa9"));
+        BOOST_CHECK_EQUAL(out, "\"caf\xc3\xa9\"");
+        BOOST_CHECK_THROW(writer.Write(latin1), TJParseError);
+        BOOST_CHECK_THROW(JSON_STRING(TJCheckUtf8(), "b\xe9t"), TJParseError);
+        BOOST_CHECK_EQUAL(TJValue<JSON_STRING>(JSON_STRING(TJCheckUtf8(), string_t("caf\xc3\xa9"))).AsString(), "caf\xc3\xa9");
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
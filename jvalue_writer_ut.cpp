@@ -0,0 +1,136 @@
+#include <boost/test/unit_test.hpp>
+#include "jvalue_parser.h"
+#include "jvalue_writer.h"
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+
+using namespace NJValue;
+
+namespace {
+    class TRecordingSink: public IJSink {
+        public:
+        string_t out;
+        size_t writes = 0;
+        size_t vectored = 0;
+
+        void Write(const char * data, size_t size) override {
+            ++writes;
+            out.append(data, size);
+        }
+
+        void WriteV(const struct iovec * iov, size_t count) override {
+            ++vectored;
+            for (size_t i = 0; i < count; ++i) {
+                out.append(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+            }
+        }
+    };
+}
+
+BOOST_AUTO_TEST_SUITE(testSuiteJValueWriter)
+
+    BOOST_AUTO_TEST_CASE( testWriteCompact ) {
+        std::string text = "{\"a\":[1,-2.5,true,false,null,\"x\"],\"b\":{},\"c\":[],\"d\":{\"e\":[[]]},\"f\":1e+300}";
+        TJDocument doc = Parse(text);
+        BOOST_CHECK_EQUAL(ToJson(doc.Root()), text);
+
+        BOOST_CHECK_EQUAL(ToJson(TJValue<JSON_INTEGER>(-7)), "-7");
+        BOOST_CHECK_EQUAL(ToJson(TJValue<JSON_DOUBLE>(2.0)), "2.0");
+        BOOST_CHECK_EQUAL(ToJson(TJValue<JSON_DOUBLE>(0.0 / 0.0)), "null");
+        BOOST_CHECK_EQUAL(ToJson(TJValue<JSON_UNDEFINED>()), "null");
+        BOOST_CHECK_EQUAL(ToJson(TJValue<JSON_STRING>("tab\t \"q\" \\ \x01 \xc3\xa9")), "\"tab\\t \\\"q\\\" \\\\ \\u0001 \xc3\xa9\"");
+
+        // Hand-built arrays may hold null pointers
+        array_t items;
+        items.push_back(nullptr);
+        BOOST_CHECK_EQUAL(ToJson(TJValue<JSON_ARRAY>(items)), "[null]");
+    }
+
+    BOOST_AUTO_TEST_CASE( testWritePretty ) {
+        TJDocument doc = Parse("{\"a\": [1, {\"b\": null}], \"c\": {}}");
+        BOOST_CHECK_EQUAL(ToJson(doc.Root(), JWRITE_PRETTY),
+            "{\n"
+            "    \"a\": [\n"
+            "        1,\n"
+            "        {\n"
+            "            \"b\": null\n"
+            "        }\n"
+            "    ],\n"
+            "    \"c\": {}\n"
+            "}");
+
+        string_t out;
+        TJStringSink sink(out);
+        TJWriter writer(sink, JWRITE_PRETTY);
+        writer.SetIndent(1);
+        writer.Write(Parse("[1]").Root());
+        BOOST_CHECK_EQUAL(out, "[\n 1\n]");
+    }
+
+    BOOST_AUTO_TEST_CASE( testWriteLarge ) {
+        std::string text = "[";
+        std::string big(100000, 'x');
+        big[50000] = '\n';
+        for (int i = 0; i < 2000; ++i) {
+            text += "{\"id\":" + std::to_string(i) + ",\"name\":\"item " + std::to_string(i) + "\"},";
+        }
+        text += "\"" + big.substr(0, 50000) + "\\n" + big.substr(50001) + "\"]";
+        TJDocument doc = Parse(text);
+
+        // Output goes out in buffer-sized pieces, the long string runs by reference
+        TRecordingSink sink;
+        TJWriter writer(sink, JWRITE_COMPACT, 4096);
+        writer.Write(doc.Root());
+        BOOST_CHECK_EQUAL(sink.out, text);
+        BOOST_CHECK(sink.writes > 10);
+        BOOST_CHECK_EQUAL(sink.vectored, 2);
+
+        // Deep nesting does not recurse
+        std::string deep(100000, '[');
+        deep += std::string(100000, ']');
+        TJDocument deepDoc = Parse(deep);
+        BOOST_CHECK_EQUAL(ToJson(deepDoc.Root()), deep);
+    }
+
+    BOOST_AUTO_TEST_CASE( testWriteSinks ) {
+        std::string big(20000, 'y');
+        TJValue<JSON_STRING> value = big;
+        std::string expected = "\"" + big + "\"";
+
+        int fds[2];
+        BOOST_REQUIRE(pipe(fds) == 0);
+        {
+            TJFdSink sink(fds[1]);
+            TJWriter writer(sink);
+            writer.WriteRaw("[", 1);
+            writer.Write(value);
+        }
+        close(fds[1]);
+        std::string read;
+        char buf[4096];
+        ssize_t n;
+        while ((n = ::read(fds[0], buf, sizeof(buf))) > 0) {
+            read.append(buf, n);
+        }
+        close(fds[0]);
+        BOOST_CHECK_EQUAL(read, "[" + expected);
+
+        FILE * file = std::tmpfile();
+        BOOST_REQUIRE(file != nullptr);
+        {
+            TJFileSink sink(file);
+            TJWriter writer(sink);
+            writer.Write(value);
+        }
+        std::rewind(file);
+        read.clear();
+        while ((n = std::fread(buf, 1, sizeof(buf), file)) > 0) {
+            read.append(buf, n);
+        }
+        std::fclose(file);
+        BOOST_CHECK_EQUAL(read, expected);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
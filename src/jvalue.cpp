@@ -1,7 +1,493 @@
 #include "jvalue.h"
-#include <iostream>
+#include <cstring>
+#include <memory>
 
 namespace NJValue {
 
+    namespace NPrivate {
+        std::atomic<uint64_t> Stats[STATS_TYPES][STATS_EVENTS];
+        std::atomic<TJTraceHook> TraceHook(nullptr);
+    }
 
+    TJTypeStats GetStats(EJValueType type) {
+        const std::atomic<uint64_t> * counters = NPrivate::Stats[type];
+        TJTypeStats stats;
+        stats.constructed = counters[JTRACE_CONSTRUCT].load(std::memory_order_relaxed);
+        stats.copied = counters[JTRACE_COPY].load(std::memory_order_relaxed);
+        stats.moved = counters[JTRACE_MOVE].load(std::memory_order_relaxed);
+        stats.converted = counters[JTRACE_CONVERT].load(std::memory_order_relaxed);
+        stats.destroyed = counters[JTRACE_DESTROY].load(std::memory_order_relaxed);
+        stats.bytesAllocated = counters[JTRACE_ALLOCATE].load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void ResetStats() {
+        for (size_t type = 0; type < NPrivate::STATS_TYPES; ++type) {
+            for (size_t event = 0; event < NPrivate::STATS_EVENTS; ++event) {
+                NPrivate::Stats[type][event].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void SetTraceHook(TJTraceHook hook) {
+        NPrivate::TraceHook.store(hook, std::memory_order_relaxed);
+    }
+
+    EJSimdKernel DetectKernel() {
+        static const EJSimdKernel kernel = __builtin_cpu_supports("avx2")
+            ? JKERNEL_AVX2
+            : __builtin_cpu_supports("sse4.2")
+                ? JKERNEL_SSE42
+                : JKERNEL_SCALAR;
+        return kernel;
+    }
+
+    TJSharedArray::TJSharedArray(const TJSharedArray & array)
+        : refs(1), items(array.items), owned(array.owned)
+    {
+        size_t i = 0;
+        try {
+            for (; i < items.size(); ++i) {
+                if (owned[i]) {
+                    items[i] = Adopt(*items[i]);
+                }
+            }
+        } catch (...) {
+            while (i-- > 0) {
+                if (owned[i]) {
+                    Drop(items[i]);
+                }
+            }
+            throw;
+        }
+    }
+
+    TJSharedArray::~TJSharedArray() {
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (owned[i]) {
+                Drop(items[i]);
+            }
+        }
+    }
+
+    IJValue * TJSharedArray::Adopt(const IJValue & item) {
+        void * node = TJPool::Allocate(sizeof(TJValue<IJSON_VALUE>));
+        try {
+            return new (node) TJValue<IJSON_VALUE>(item.GetValue());
+        } catch (...) {
+            TJPool::Deallocate(node, sizeof(TJValue<IJSON_VALUE>));
+            throw;
+        }
+    }
+
+    void TJSharedArray::Drop(IJValue * item) {
+        static_cast<TJValue<IJSON_VALUE> *>(item)->~TJValue<IJSON_VALUE>();
+        TJPool::Deallocate(item, sizeof(TJValue<IJSON_VALUE>));
+    }
+
+    TJSharedArray * TJSharedArray::Copy(IJValue * const * items, size_t size) {
+        std::unique_ptr<TJSharedArray> array(new TJSharedArray(array_t()));
+        for (size_t i = 0; i < size; ++i) {
+            IJValue * item = items[i] == nullptr ? nullptr : Adopt(*items[i]);
+            try {
+                array->owned.push_back(false);
+                array->items.push_back(item);
+            } catch (...) {
+                if (item != nullptr) {
+                    Drop(item);
+                }
+                throw;
+            }
+            array->owned.back() = item != nullptr;
+        }
+        return array.release();
+    }
+
+    IJValue * TJPackedArray::Node(size_t index) const {
+        IJValue * built = nodes.load(std::memory_order_acquire);
+        if (built == nullptr) {
+            size_t size = Size();
+            TJValue<IJSON_VALUE> * items = new TJValue<IJSON_VALUE>[size];
+            for (size_t i = 0; i < size; ++i) {
+                items[i] = itemType == JINTEGER
+                    ? TJValue<IJSON_VALUE>(JSON_INTEGER(integers[i]))
+                    : TJValue<IJSON_VALUE>(JSON_DOUBLE(doubles[i]));
+            }
+            JTrace(JTRACE_ALLOCATE, JARRAY, size * sizeof(TJValue<IJSON_VALUE>));
+            // Copies on other threads may race to build them, the first one wins
+            if (nodes.compare_exchange_strong(built, items, std::memory_order_acq_rel)) {
+                built = items;
+            } else {
+                delete[] items;
+            }
+        }
+        return static_cast<TJValue<IJSON_VALUE> *>(built) + index;
+    }
+
+    void TJPackedArray::DropNodes() {
+        IJValue * built = nodes.exchange(nullptr, std::memory_order_acq_rel);
+        delete[] static_cast<TJValue<IJSON_VALUE> *>(built);
+    }
+
+    TJSharedArray * TJPackedArray::Unpack() const {
+        std::unique_ptr<TJSharedArray> array(new TJSharedArray(array_t()));
+        for (size_t i = 0; i < Size(); ++i) {
+            IJValue * item = itemType == JINTEGER
+                ? TJSharedArray::Adopt(TJValue<JSON_INTEGER>(integers[i]))
+                : TJSharedArray::Adopt(TJValue<JSON_DOUBLE>(doubles[i]));
+            try {
+                array->owned.push_back(false);
+                array->items.push_back(item);
+            } catch (...) {
+                TJSharedArray::Drop(item);
+                throw;
+            }
+            array->owned.back() = true;
+        }
+        return array.release();
+    }
+
+    TJPackedArray * TJPackedArray::Pack(IJValue * const * items, size_t size) {
+        if (size == 0) {
+            return nullptr;
+        }
+        EJValueType itemType = items[0]->GetValue().GetType();
+        if (itemType != JINTEGER && itemType != JDOUBLE) {
+            return nullptr;
+        }
+        for (size_t i = 1; i < size; ++i) {
+            if (items[i]->GetValue().GetType() != itemType) {
+                return nullptr;
+            }
+        }
+
+        TJPackedArray * packed = new TJPackedArray(itemType);
+        if (itemType == JINTEGER) {
+            packed->integers.resize(size);
+            for (size_t i = 0; i < size; ++i) {
+                packed->integers[i] = items[i]->GetValue().AsInteger();
+            }
+        } else {
+            packed->doubles.resize(size);
+            for (size_t i = 0; i < size; ++i) {
+                packed->doubles[i] = items[i]->GetValue().AsDouble();
+            }
+        }
+        return packed;
+    }
+
+    void IJSON_VALUE::ReleaseMap(map_t * map) {
+        for (const map_t::TEntry & entry : *map) {
+            if (entry.value != nullptr) {
+                TJSharedArray::Drop(entry.value);
+            }
+        }
+        delete map;
+    }
+
+    void IJSON_VALUE::AdoptMap(const map_t & val) {
+        map_t * map = new map_t();
+        try {
+            map->Reserve(val.Size());
+            for (const map_t::TEntry & entry : val) {
+                IJValue * item = entry.value == nullptr ? nullptr : TJSharedArray::Adopt(*entry.value);
+                try {
+                    map->Set(entry.key, entry.size, item);
+                } catch (...) {
+                    if (item != nullptr) {
+                        TJSharedArray::Drop(item);
+                    }
+                    throw;
+                }
+            }
+        } catch (...) {
+            ReleaseMap(map);
+            throw;
+        }
+        Store(map);
+        layout = OWNED;
+        JTrace(JTRACE_ALLOCATE, JMAP, sizeof(map_t) + val.Size() * sizeof(map_t::TEntry));
+    }
+
+    namespace {
+
+        inline uint64_t ItemHash(const IJValue * item) {
+            return item == nullptr ? NHash::Scalar(JNULL, 0) : item->GetValue().Hash();
+        }
+
+        // Missing elements are null
+        inline bool ItemEquals(const IJValue * a, const IJValue * b) {
+            if (a == b) {
+                return true;
+            }
+            if (a == nullptr || b == nullptr) {
+                return (a != nullptr ? a : b)->GetValue().GetType() == JNULL;
+            }
+            return a->GetValue().Equals(b->GetValue());
+        }
+
+        inline uint64_t PackedHash(const TJPackedArray & packed) {
+            uint64_t h = packed.hash.load(std::memory_order_relaxed);
+            if (h != 0) {
+                return h;
+            }
+            h = NHash::ArrayStart(packed.Size());
+            if (packed.itemType == JINTEGER) {
+                for (integer_t item : packed.integers) {
+                    h = NHash::Mix(h, NHash::Integer(item));
+                }
+            } else {
+                for (double_t item : packed.doubles) {
+                    h = NHash::Mix(h, NHash::Double(item));
+                }
+            }
+            h = NHash::Finish(h);
+            packed.hash.store(h, std::memory_order_relaxed);
+            return h;
+        }
+
+        inline uint64_t DoubleBits(double_t val) {
+            uint64_t bits;
+            std::memcpy(&bits, &val, sizeof(bits));
+            return bits;
+        }
+
+        inline bool PackedEquals(const TJPackedArray & a, const TJPackedArray & b) {
+            if (a.itemType != b.itemType) {
+                return false;
+            }
+            uint64_t ha = a.hash.load(std::memory_order_relaxed);
+            uint64_t hb = b.hash.load(std::memory_order_relaxed);
+            if (ha != 0 && hb != 0 && ha != hb) {
+                return false;
+            }
+            return a.itemType == JINTEGER
+                ? std::memcmp(a.integers.data(), b.integers.data(), a.integers.size() * sizeof(integer_t)) == 0
+                : std::memcmp(a.doubles.data(), b.doubles.data(), a.doubles.size() * sizeof(double_t)) == 0;
+        }
+
+        inline bool PackedItemEquals(const TJPackedArray & packed, size_t index, const IJValue * item) {
+            if (item == nullptr || item->GetValue().GetType() != packed.itemType) {
+                return false;
+            }
+            return packed.itemType == JINTEGER
+                ? packed.integers[index] == item->GetValue().AsInteger()
+                : DoubleBits(packed.doubles[index]) == DoubleBits(item->GetValue().AsDouble());
+        }
+    }
+
+    uint64_t IJSON_VALUE::Hash() const {
+        switch (GetType()) {
+            case JBOOL:
+                return NHash::Bool(Load<bool_t>());
+            case JINTEGER:
+                return NHash::Integer(Load<integer_t>());
+            case JDOUBLE:
+                return NHash::Double(Load<double_t>());
+            case JSTRING: {
+                if (layout != OWNED) {
+                    return NHash::String(StringData(), StringSize());
+                }
+                const TJOwnedString * owned = Load<const TJOwnedString *>();
+                if (owned->cached.load(std::memory_order_acquire) & TJOwnedString::CACHED_HASH) {
+                    return owned->hashValue.load(std::memory_order_relaxed);
+                }
+                uint64_t h = NHash::String(owned->Data(), owned->size);
+                owned->hashValue.store(h, std::memory_order_relaxed);
+                owned->cached.fetch_or(TJOwnedString::CACHED_HASH, std::memory_order_release);
+                return h;
+            }
+            case JARRAY: {
+                if (layout == PACKED) {
+                    return PackedHash(*Load<const TJPackedArray *>());
+                }
+                size_t size = ArraySize();
+                uint64_t h = NHash::ArrayStart(size);
+                for (size_t i = 0; i < size; ++i) {
+                    h = NHash::Mix(h, ItemHash(At(i)));
+                }
+                return NHash::Finish(h);
+            }
+            case JMAP: {
+                const map_t * map = MapPtr();
+                uint64_t sum = 0;
+                if (map != nullptr) {
+                    for (const map_t::TEntry & entry : *map) {
+                        sum += NHash::MapEntry(entry.hash, ItemHash(entry.value));
+                    }
+                }
+                return NHash::Map(sum, MapSize());
+            }
+            default:
+                return NHash::Scalar(GetType(), 0);
+        }
+    }
+
+    bool IJSON_VALUE::Equals(const IJSON_VALUE & val) const {
+        if (this == &val) {
+            return true;
+        }
+        if (type != val.type) {
+            return false;
+        }
+        switch (GetType()) {
+            case JBOOL:
+                return Load<bool_t>() == val.Load<bool_t>();
+            case JINTEGER:
+            case JDOUBLE:
+                return Load<uint64_t>() == val.Load<uint64_t>();
+            case JSTRING: {
+                if (layout == OWNED && val.layout == OWNED) {
+                    const TJOwnedString * a = Load<const TJOwnedString *>();
+                    const TJOwnedString * b = val.Load<const TJOwnedString *>();
+                    if (a == b) {
+                        return true;
+                    }
+                    if ((a->cached.load(std::memory_order_acquire) & TJOwnedString::CACHED_HASH)
+                        && (b->cached.load(std::memory_order_acquire) & TJOwnedString::CACHED_HASH)
+                        && a->hashValue.load(std::memory_order_relaxed) != b->hashValue.load(std::memory_order_relaxed)) {
+                        return false;
+                    }
+                }
+                return val.StringEquals(StringData(), StringSize());
+            }
+            case JARRAY:
+                return ArrayEquals(val);
+            case JMAP:
+                return MapEquals(val);
+            default:
+                return true;
+        }
+    }
+
+    bool IJSON_VALUE::ArrayEquals(const IJSON_VALUE & val) const {
+        size_t size = ArraySize();
+        if (size != val.ArraySize()) {
+            return false;
+        }
+        if (size == 0 || (layout == val.layout && Load<const void *>() == val.Load<const void *>())) {
+            return true;
+        }
+        if (layout == PACKED && val.layout == PACKED) {
+            return PackedEquals(*Load<const TJPackedArray *>(), *val.Load<const TJPackedArray *>());
+        }
+        if (layout == PACKED || val.layout == PACKED) {
+            // Numbers against nodes, without building nodes for the packed side
+            const IJSON_VALUE & nodes = layout == PACKED ? val : *this;
+            const TJPackedArray & packed = *(layout == PACKED ? this : &val)->Load<const TJPackedArray *>();
+            for (size_t i = 0; i < size; ++i) {
+                if (!PackedItemEquals(packed, i, nodes.At(i))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        for (size_t i = 0; i < size; ++i) {
+            if (!ItemEquals(At(i), val.At(i))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool IJSON_VALUE::MapEquals(const IJSON_VALUE & val) const {
+        const map_t * a = MapPtr();
+        const map_t * b = val.MapPtr();
+        size_t size = a == nullptr ? 0 : a->Size();
+        if (size != (b == nullptr ? 0 : b->Size())) {
+            return false;
+        }
+        if (size == 0 || a == b) {
+            return true;
+        }
+        // Keys are unique, so finding every key of a in b finds all of b
+        for (const map_t::TEntry & entry : *a) {
+            const map_t::TEntry * other = b->FindEntry(entry.key, entry.size, entry.hash);
+            if (other == nullptr || !ItemEquals(entry.value, other->value)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    namespace {
+
+        inline uint32_t ReadHex4(const char * data, size_t pos, size_t limit, size_t offset) {
+            if (pos + 4 > limit) {
+                throw TJParseError("Truncated \\u escape", offset + pos);
+            }
+            uint32_t cp = 0;
+            for (size_t i = 0; i < 4; ++i) {
+                int d = HexDigit(data[pos + i]);
+                if (d < 0) {
+                    throw TJParseError("Invalid \\u escape", offset + pos);
+                }
+                cp = (cp << 4) | static_cast<uint32_t>(d);
+            }
+            return cp;
+        }
+    }
+
+    size_t UnescapeString(const char * data, size_t size, char * out, size_t offset) {
+        // Counted apart from out, which may be nullptr
+        size_t decodedSize = 0;
+        for (size_t j = 0; j < size; ++j) {
+            // Runs between escapes are found and copied whole
+            const char * escape = static_cast<const char *>(std::memchr(data + j, '\\', size - j));
+            size_t run = (escape == nullptr ? size : escape - data) - j;
+            if (out != nullptr) {
+                std::memcpy(out + decodedSize, data + j, run);
+            }
+            decodedSize += run;
+            j += run;
+            if (j == size) {
+                break;
+            }
+            if (++j >= size) {
+                throw TJParseError("Truncated escape", offset + j);
+            }
+
+            char decoded;
+            switch (data[j]) {
+                case '"': decoded = '"'; break;
+                case '\\': decoded = '\\'; break;
+                case '/': decoded = '/'; break;
+                case 'b': decoded = '\b'; break;
+                case 'f': decoded = '\f'; break;
+                case 'n': decoded = '\n'; break;
+                case 'r': decoded = '\r'; break;
+                case 't': decoded = '\t'; break;
+                case 'u': {
+                    uint32_t cp = ReadHex4(data, j + 1, size, offset);
+                    j += 4;
+                    if (cp >= 0xD800 && cp < 0xDC00) {
+                        if (j + 2 >= size || data[j + 1] != '\\' || data[j + 2] != 'u') {
+                            throw TJParseError("Unpaired surrogate", offset + j);
+                        }
+                        uint32_t low = ReadHex4(data, j + 3, size, offset);
+                        if (low < 0xDC00 || low >= 0xE000) {
+                            throw TJParseError("Invalid low surrogate", offset + j + 3);
+                        }
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        j += 6;
+                    } else if (cp >= 0xDC00 && cp < 0xE000) {
+                        throw TJParseError("Unpaired surrogate", offset + j);
+                    }
+                    if (out != nullptr) {
+                        decodedSize = WriteUtf8(out + decodedSize, cp) - out;
+                    } else {
+                        decodedSize += cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+                    }
+                    continue;
+                }
+                default:
+                    throw TJParseError("Invalid escape", offset + j);
+            }
+            if (out != nullptr) {
+                out[decodedSize] = decoded;
+            }
+            ++decodedSize;
+        }
+        return decodedSize;
+    }
 }
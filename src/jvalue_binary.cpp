@@ -0,0 +1,482 @@
+#include "jvalue_binary.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace NJValue {
+
+    namespace {
+
+        const char MAGIC[BINARY_HEADER_SIZE] = { 'J', 'V', 'B', static_cast<char>(BINARY_VERSION) };
+
+        const IJSON_VALUE NULL_VALUE(JNULL);
+
+        inline int CompareKeys(const char * a, size_t aSize, const char * b, size_t bSize) {
+            int cmp = std::memcmp(a, b, std::min(aSize, bSize));
+            if (cmp != 0) {
+                return cmp;
+            }
+            return aSize < bSize ? -1 : (aSize > bSize ? 1 : 0);
+        }
+
+        class TEncoder {
+            struct TFrame {
+                const IJSON_VALUE * container;
+                size_t node;
+                size_t index;
+                map_t::const_iterator entry;
+            };
+
+            string_t & out;
+            size_t base;
+            std::vector<TFrame> stack;
+
+            inline size_t Offset() const { return out.size() - base; }
+
+            template<class T>
+            inline void Append(T val) {
+                out.append(reinterpret_cast<const char *>(&val), sizeof(val));
+            }
+
+            inline void Patch(size_t pos, size_t val) {
+                uint32_t narrow = static_cast<uint32_t>(val);
+                std::memcpy(&out[base + pos], &narrow, sizeof(narrow));
+            }
+
+            inline size_t Table(const TFrame & frame) const { return frame.node + (frame.container->GetType() == JMAP ? 9 : 5); }
+
+            // Entry numbers ordered by key bytes, for binary search by readers
+            void WriteSorted(const TFrame & frame) {
+                const map_t * map = frame.container->GetMap();
+                std::vector<uint32_t> order(map->Size());
+                for (size_t i = 0; i < order.size(); ++i) {
+                    order[i] = static_cast<uint32_t>(i);
+                }
+                map_t::const_iterator entries = map->begin();
+                std::sort(order.begin(), order.end(), [entries](uint32_t a, uint32_t b) {
+                    return CompareKeys(entries[a].key, entries[a].size, entries[b].key, entries[b].size) < 0;
+                });
+                Patch(frame.node + 5, Offset());
+                out.append(reinterpret_cast<const char *>(order.data()), order.size() * sizeof(uint32_t));
+            }
+
+            void WriteNode(const IJSON_VALUE & value) {
+                EJValueType type = value.GetType();
+                out.push_back(static_cast<char>(type));
+                switch (type) {
+                    case JBOOL:
+                        out.push_back(value.AsBool() ? 1 : 0);
+                        return;
+                    case JINTEGER:
+                        Append(static_cast<int64_t>(value.AsInteger()));
+                        return;
+                    case JDOUBLE:
+                        Append(value.AsDouble());
+                        return;
+                    case JSTRING: {
+                        TJStringView str = value.AsStringView();
+                        Append(static_cast<uint32_t>(str.size()));
+                        out.append(str.data(), str.size());
+                        return;
+                    }
+                    case JARRAY:
+                    case JMAP: {
+                        TFrame frame;
+                        frame.container = &value;
+                        frame.node = Offset() - 1;
+                        frame.index = 0;
+                        size_t count = value.Size();
+                        Append(static_cast<uint32_t>(count));
+                        if (type == JMAP) {
+                            Append(static_cast<uint32_t>(0));
+                            // Owned maps without entries have no storage
+                            if (count != 0) {
+                                frame.entry = value.GetMap()->begin();
+                            }
+                        }
+                        out.append(count * (type == JMAP ? 8 : 4), '\0');
+                        if (count != 0) {
+                            stack.push_back(frame);
+                        }
+                        return;
+                    }
+                    default:
+                        return;
+                }
+            }
+
+            // Element of a packed array, written as WriteNode() would without building its node
+            void WritePacked(const IJSON_VALUE & array, size_t index) {
+                TJSpan<integer_t> integers = array.AsIntegerSpan();
+                if (integers.empty()) {
+                    out.push_back(static_cast<char>(JDOUBLE));
+                    Append(array.AsDoubleSpan()[index]);
+                } else {
+                    out.push_back(static_cast<char>(JINTEGER));
+                    Append(static_cast<int64_t>(integers[index]));
+                }
+            }
+
+            public:
+            TEncoder(string_t & out) : out(out), base(out.size()) { }
+
+            void Encode(const IJSON_VALUE & root) {
+                out.append(MAGIC, BINARY_HEADER_SIZE);
+                WriteNode(root);
+
+                while (!stack.empty()) {
+                    TFrame & frame = stack.back();
+                    bool isMap = frame.container->GetType() == JMAP;
+                    if (frame.index == frame.container->Size()) {
+                        if (isMap && frame.index > BINARY_LINEAR_MAX) {
+                            WriteSorted(frame);
+                        }
+                        stack.pop_back();
+                        continue;
+                    }
+
+                    // Children follow their parent, so offsets in a valid buffer always point forward
+                    size_t slot = Table(frame);
+                    const IJValue * item;
+                    if (isMap) {
+                        slot += frame.index * 8;
+                        Patch(slot, Offset());
+                        Append(frame.entry->size);
+                        out.append(frame.entry->key, frame.entry->size);
+                        slot += 4;
+                        item = frame.entry->value;
+                        ++frame.entry;
+                    } else {
+                        slot += frame.index * 4;
+                        if (frame.container->IsPacked()) {
+                            Patch(slot, Offset());
+                            WritePacked(*frame.container, frame.index++);
+                            continue;
+                        }
+                        item = frame.container->At(frame.index);
+                    }
+                    ++frame.index;
+
+                    Patch(slot, Offset());
+                    WriteNode(item == nullptr ? NULL_VALUE : item->GetValue());
+                }
+
+                if (Offset() > UINT32_MAX) {
+                    out.resize(base);
+                    throw std::length_error("Binary encoding exceeds 4 GiB");
+                }
+            }
+        };
+
+        class TDecoder {
+            struct TFrame {
+                TJBinaryValue container;
+                size_t index;
+                size_t start;
+            };
+
+            TJDocument & doc;
+            EJParseMode mode;
+            const char * data;
+            size_t furthest;        // offset of the last value or key decoded
+
+            std::vector<IJValue *> elements;
+            std::vector<TJStringView> keys;
+            std::vector<TFrame> frames;
+
+            IJValue * MakeString(const TJBinaryValue & value) {
+                TJStringView str = value.AsStringView();
+                if (mode == JPARSE_BORROW) {
+                    return doc.NewStringRef(str.data(), str.size());
+                }
+                return doc.NewString(str.data(), str.size());
+            }
+
+            IJValue * Close(const TFrame & frame) {
+                size_t count = elements.size() - frame.start;
+                if (frame.container.GetType() == JARRAY) {
+                    return doc.NewArray(elements.data() + frame.start, count);
+                }
+                size_t keyStart = keys.size() - count;
+                map_t * map = doc.NewMapStorage(count);
+                for (size_t i = 0; i < count; ++i) {
+                    map->Set(keys[keyStart + i].data(), keys[keyStart + i].size(), elements[frame.start + i]);
+                }
+                keys.resize(keyStart);
+                return doc.NewMap(map);
+            }
+
+            // Values and keys are laid out in the order they are decoded, so each one
+            // lies past the last. An offset that does not would let children be
+            // shared, and a few hundred bytes decode to an exponential tree.
+            inline void Advance(size_t pos) {
+                if (pos <= furthest) {
+                    throw TJParseError("Binary value out of order", pos);
+                }
+                furthest = pos;
+            }
+
+            inline TJBinaryValue NextValue(const TJBinaryValue & value) {
+                Advance(value.GetOffset());
+                return value;
+            }
+
+            inline TJStringView NextKey(const TJStringView & key) {
+                // The key's size comes before its bytes
+                Advance(key.data() - data - sizeof(uint32_t));
+                return key;
+            }
+
+            public:
+            TDecoder(TJDocument & doc, EJParseMode mode, const char * data) : doc(doc), mode(mode), data(data), furthest(0) { }
+
+            void Decode(const TJBinaryValue & root) {
+                TJBinaryValue value = NextValue(root);
+                for (;;) {
+                    IJValue * node;
+                    switch (value.GetType()) {
+                        case JNULL: node = doc.NewNull(); break;
+                        case JBOOL: node = doc.NewBool(value.AsBool()); break;
+                        case JINTEGER: node = doc.NewInteger(value.AsInteger()); break;
+                        case JDOUBLE: node = doc.NewDouble(value.AsDouble()); break;
+                        case JSTRING: node = MakeString(value); break;
+                        case JARRAY:
+                        case JMAP:
+                            if (value.Size() == 0) {
+                                node = value.GetType() == JARRAY ? doc.NewArray(nullptr, 0) : doc.NewMap(doc.NewMapStorage());
+                                break;
+                            }
+                            frames.push_back(TFrame{ value, 0, elements.size() });
+                            if (value.GetType() == JMAP) {
+                                keys.push_back(NextKey(value.KeyAt(0)));
+                                value = NextValue(value.ValueAt(0));
+                            } else {
+                                value = NextValue(value.At(0));
+                            }
+                            continue;
+                        default:
+                            node = doc.NewValue(JSON_UNDEFINED());
+                            break;
+                    }
+
+                    // Attach the finished value, closing every container that is done
+                    for (;;) {
+                        if (frames.empty()) {
+                            doc.SetRoot(node);
+                            return;
+                        }
+                        elements.push_back(node);
+
+                        TFrame & frame = frames.back();
+                        if (++frame.index < frame.container.Size()) {
+                            if (frame.container.GetType() == JMAP) {
+                                keys.push_back(NextKey(frame.container.KeyAt(frame.index)));
+                                value = NextValue(frame.container.ValueAt(frame.index));
+                            } else {
+                                value = NextValue(frame.container.At(frame.index));
+                            }
+                            break;
+                        }
+
+                        node = Close(frame);
+                        elements.resize(frame.start);
+                        frames.pop_back();
+                    }
+                }
+            }
+        };
+    }
+
+    void EncodeBinary(const IJSON_VALUE & value, string_t & out) {
+        TEncoder(out).Encode(value);
+    }
+
+    void DecodeBinary(const char * data, size_t size, TJDocument & doc, EJParseMode mode) {
+        doc.Reset();
+        TJBinaryDocument reader(data, size);
+        TDecoder(doc, mode, data).Decode(reader.Root());
+    }
+
+    TJBinaryValue::TJBinaryValue(const char * data, size_t size, size_t offset)
+        : data(data), size(size), offset(offset)
+    {
+        Need(offset, 1);
+        uint8_t type = static_cast<uint8_t>(data[offset]);
+        if (type < JUNDEFINED || type > JMAP) {
+            throw TJParseError("Unknown binary value type", offset);
+        }
+    }
+
+    TJBinaryValue TJBinaryValue::Child(size_t pos) const {
+        uint32_t child = LoadSize(pos);
+        if (child <= offset) {
+            throw TJParseError("Binary offset does not point forward", pos);
+        }
+        return TJBinaryValue(data, size, child);
+    }
+
+    TJStringView TJBinaryValue::Key(size_t entry) const {
+        size_t pos = offset + 9 + entry * 8;
+        uint32_t key = LoadSize(pos);
+        if (key <= offset) {
+            throw TJParseError("Binary offset does not point forward", pos);
+        }
+        uint32_t keySize = LoadSize(key);
+        Need(key + 4, keySize);
+        return TJStringView(data + key + 4, keySize);
+    }
+
+    bool_t TJBinaryValue::AsBool() const {
+        switch (GetType()) {
+            case JBOOL:
+                return LoadPayload<uint8_t>() != 0;
+            case JINTEGER:
+                return LoadPayload<int64_t>() != 0;
+            case JDOUBLE: {
+                double_t value = LoadPayload<double_t>();
+                return (value >= 0.0 && value < 1.0) ? false : true;
+            }
+            case JSTRING: {
+                TJStringView str = AsStringView();
+                return JSON_STRING(TJBorrow(), str.data(), str.size()).AsBool();
+            }
+            case JARRAY:
+            case JMAP:
+                return Size() != 0;
+            default:
+                return false;
+        }
+    }
+
+    integer_t TJBinaryValue::AsInteger() const {
+        switch (GetType()) {
+            case JBOOL:
+                return LoadPayload<uint8_t>() != 0 ? 1 : 0;
+            case JINTEGER:
+                return static_cast<integer_t>(LoadPayload<int64_t>());
+            case JDOUBLE:
+                return static_cast<integer_t>(LoadPayload<double_t>());
+            case JSTRING: {
+                TJStringView str = AsStringView();
+                return JSON_STRING(TJBorrow(), str.data(), str.size()).AsInteger();
+            }
+            case JARRAY:
+            case JMAP:
+                return Size();
+            default:
+                return 0;
+        }
+    }
+
+    double_t TJBinaryValue::AsDouble() const {
+        switch (GetType()) {
+            case JBOOL:
+                return LoadPayload<uint8_t>() != 0 ? 1.0 : 0.0;
+            case JINTEGER:
+                return static_cast<double_t>(LoadPayload<int64_t>());
+            case JDOUBLE:
+                return LoadPayload<double_t>();
+            case JSTRING: {
+                TJStringView str = AsStringView();
+                return JSON_STRING(TJBorrow(), str.data(), str.size()).AsDouble();
+            }
+            case JARRAY:
+            case JMAP:
+                return static_cast<double_t>(Size());
+            default:
+                return 0.0;
+        }
+    }
+
+    TJStringView TJBinaryValue::AsStringView() const {
+        if (GetType() != JSTRING) {
+            return TJStringView();
+        }
+        uint32_t length = LoadSize(offset + 1);
+        Need(offset + 5, length);
+        return TJStringView(data + offset + 5, length);
+    }
+
+    size_t TJBinaryValue::Size() const {
+        EJValueType type = GetType();
+        if (type != JARRAY && type != JMAP) {
+            return 0;
+        }
+        size_t count = LoadSize(offset + 1);
+        if (type == JMAP) {
+            Need(offset + 9, count * 8);
+        } else {
+            Need(offset + 5, count * 4);
+        }
+        return count;
+    }
+
+    TJBinaryValue TJBinaryValue::At(size_t index) const {
+        if (GetType() != JARRAY || index >= Size()) {
+            return TJBinaryValue();
+        }
+        return Child(offset + 5 + index * 4);
+    }
+
+    TJStringView TJBinaryValue::KeyAt(size_t index) const {
+        if (GetType() != JMAP || index >= Size()) {
+            return TJStringView();
+        }
+        return Key(index);
+    }
+
+    TJBinaryValue TJBinaryValue::ValueAt(size_t index) const {
+        if (GetType() != JMAP || index >= Size()) {
+            return TJBinaryValue();
+        }
+        return Child(offset + 9 + index * 8 + 4);
+    }
+
+    TJBinaryValue TJBinaryValue::Find(const char * key, size_t keySize) const {
+        if (GetType() != JMAP) {
+            return TJBinaryValue();
+        }
+        size_t count = Size();
+        uint32_t sorted = LoadSize(offset + 5);
+        if (sorted == 0) {
+            for (size_t i = 0; i < count; ++i) {
+                TJStringView candidate = Key(i);
+                if (candidate.size() == keySize && std::memcmp(candidate.data(), key, keySize) == 0) {
+                    return Child(offset + 9 + i * 8 + 4);
+                }
+            }
+            return TJBinaryValue();
+        }
+
+        if (sorted <= offset) {
+            throw TJParseError("Binary offset does not point forward", offset + 5);
+        }
+        Need(sorted, count * 4);
+        size_t low = 0;
+        size_t high = count;
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            uint32_t entry = LoadSize(sorted + mid * 4);
+            if (entry >= count) {
+                throw TJParseError("Binary entry number out of range", sorted + mid * 4);
+            }
+            TJStringView candidate = Key(entry);
+            int cmp = CompareKeys(candidate.data(), candidate.size(), key, keySize);
+            if (cmp == 0) {
+                return Child(offset + 9 + entry * 8 + 4);
+            }
+            if (cmp < 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return TJBinaryValue();
+    }
+
+    void TJBinaryDocument::Attach(const char * data, size_t size) {
+        if (size < BINARY_HEADER_SIZE || std::memcmp(data, MAGIC, BINARY_HEADER_SIZE) != 0) {
+            throw TJParseError("Not a binary document", 0);
+        }
+        root = TJBinaryValue(data, size, BINARY_HEADER_SIZE);
+    }
+}
@@ -0,0 +1,390 @@
+#include "jvalue_columnar.h"
+#include "jvalue_writer.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace NJValue {
+
+    namespace {
+
+        // Column type a cell asks for; JNULL cells do not take part
+        inline EJValueType CellType(EJValueType type) {
+            switch (type) {
+                case JUNDEFINED:
+                case JNULL:
+                    return JNULL;
+                case JARRAY:
+                case JMAP:
+                    return JSTRING;
+                default:
+                    return type;
+            }
+        }
+
+        inline EJValueType MergeTypes(EJValueType a, EJValueType b) {
+            if (a == JNULL || a == b) {
+                return b;
+            }
+            if (b == JNULL) {
+                return a;
+            }
+            if ((a == JINTEGER && b == JDOUBLE) || (a == JDOUBLE && b == JINTEGER)) {
+                return JDOUBLE;
+            }
+            return JSTRING;
+        }
+
+        inline void SetBit(std::vector<uint64_t> & bits, size_t row) {
+            bits[row >> 6] |= uint64_t(1) << (row & 63);
+        }
+
+        // Maps the keys of records to field numbers. Records of one array tend
+        // to have their keys in the same order, so the field last seen at each
+        // entry position (kept by the caller in atPosition) is tried first.
+        class TFieldIndex {
+            std::unordered_map<string_t, size_t> fields;
+
+            public:
+            std::vector<string_t> names;
+            std::vector<uint32_t> hashes;
+
+            // names.size() if the key is not a field
+            inline size_t Find(const map_t::TEntry & entry, size_t pos, std::vector<size_t> & atPosition) const {
+                if (pos < atPosition.size()) {
+                    size_t field = atPosition[pos];
+                    if (field < names.size() && hashes[field] == entry.hash && names[field].size() == entry.size
+                        && std::memcmp(names[field].data(), entry.key, entry.size) == 0) {
+                        return field;
+                    }
+                }
+                auto it = fields.find(entry.GetKey());
+                if (it == fields.end()) {
+                    return names.size();
+                }
+                if (pos >= atPosition.size()) {
+                    atPosition.resize(pos + 1, names.size());
+                }
+                atPosition[pos] = it->second;
+                return it->second;
+            }
+
+            // Field number of the key, added if new
+            inline size_t Add(const char * key, size_t size) {
+                auto found = fields.emplace(string_t(key, size), names.size());
+                if (found.second) {
+                    names.push_back(found.first->first);
+                    hashes.push_back(TJMap::Hash(key, size));
+                }
+                return found.first->second;
+            }
+        };
+
+        inline const map_t * RecordMap(const IJValue & records, size_t row) {
+            const IJValue * record = records.At(row);
+            return record != nullptr && record->IsMap() ? record->GetValue().GetMap() : nullptr;
+        }
+
+        // Fields of a run of records in order of first appearance, with their types
+        struct TSchema {
+            TFieldIndex index;
+            std::vector<EJValueType> types;
+            std::vector<size_t> atPosition;
+
+            void Scan(const IJValue & records, size_t begin, size_t end) {
+                for (size_t row = begin; row < end; ++row) {
+                    const map_t * map = RecordMap(records, row);
+                    if (map == nullptr) {
+                        continue;
+                    }
+                    size_t pos = 0;
+                    for (const map_t::TEntry & entry : *map) {
+                        size_t field = index.Find(entry, pos++, atPosition);
+                        if (field == types.size()) {
+                            field = index.Add(entry.key, entry.size);
+                            types.push_back(JNULL);
+                        }
+                        EJValueType type = entry.value != nullptr ? CellType(entry.value->GetValue().GetType()) : JNULL;
+                        types[field] = MergeTypes(types[field], type);
+                    }
+                }
+            }
+
+            void Merge(const TSchema & slice) {
+                for (size_t i = 0; i < slice.types.size(); ++i) {
+                    const string_t & name = slice.index.names[i];
+                    size_t field = index.Add(name.data(), name.size());
+                    if (field == types.size()) {
+                        types.push_back(JNULL);
+                    }
+                    types[field] = MergeTypes(types[field], slice.types[i]);
+                }
+            }
+        };
+
+        // Distinct strings of a string column in order of first appearance,
+        // stored back to back as TJColumn has them, with an open-addressing
+        // index of codes + 1 (0 marks a free slot) kept at most half full.
+        struct TDictionary {
+            string_t words;
+            std::vector<size_t> offsets;
+            std::vector<uint32_t> hashes;
+            std::vector<uint32_t> index;
+
+            inline size_t Size() const { return hashes.size(); }
+
+            inline TJStringView Word(size_t code) const {
+                return TJStringView(words.data() + offsets[code], offsets[code + 1] - offsets[code]);
+            }
+
+            inline void Insert(uint32_t code) {
+                size_t mask = index.size() - 1;
+                size_t slot = hashes[code] & mask;
+                while (index[slot] != 0) {
+                    slot = (slot + 1) & mask;
+                }
+                index[slot] = code + 1;
+            }
+
+            inline uint32_t Code(const char * data, size_t size) {
+                uint32_t hash = TJMap::Hash(data, size);
+                if (!index.empty()) {
+                    size_t mask = index.size() - 1;
+                    for (size_t slot = hash & mask; index[slot] != 0; slot = (slot + 1) & mask) {
+                        uint32_t code = index[slot] - 1;
+                        if (hashes[code] == hash && Word(code) == TJStringView(data, size)) {
+                            return code;
+                        }
+                    }
+                }
+
+                if (Size() == UINT32_MAX) {
+                    throw std::length_error("Too many distinct strings in a column");
+                }
+                if (offsets.empty()) {
+                    offsets.push_back(0);
+                }
+                uint32_t code = static_cast<uint32_t>(Size());
+                words.append(data, size);
+                offsets.push_back(words.size());
+                hashes.push_back(hash);
+                if (index.size() < 2 * hashes.size()) {
+                    index.assign(std::max<size_t>(16, 2 * index.size()), 0);
+                    for (uint32_t i = 0; i < hashes.size(); ++i) {
+                        Insert(i);
+                    }
+                } else {
+                    Insert(code);
+                }
+                return code;
+            }
+
+            inline uint32_t Code(TJStringView word) { return Code(word.data(), word.size()); }
+        };
+
+        // Cells of the rows begin..end; string columns get codes into the
+        // slice's own dictionaries, which Build() renumbers afterwards.
+        struct TSlice {
+            size_t begin;
+            size_t end;
+            TSchema schema;
+            std::vector<TDictionary> dictionaries;
+            std::exception_ptr error;
+
+            void Fill(const IJValue & records, const TFieldIndex & fields, std::vector<TJColumn> & columns) {
+                dictionaries.resize(columns.size());
+                std::vector<size_t> atPosition;
+                for (size_t row = begin; row < end; ++row) {
+                    const map_t * map = RecordMap(records, row);
+                    if (map == nullptr) {
+                        continue;
+                    }
+                    size_t pos = 0;
+                    for (const map_t::TEntry & entry : *map) {
+                        size_t field = fields.Find(entry, pos++, atPosition);
+                        if (field == columns.size() || entry.value == nullptr) {
+                            continue;
+                        }
+                        const IJSON_VALUE & value = entry.value->GetValue();
+                        if (CellType(value.GetType()) == JNULL) {
+                            continue;
+                        }
+                        TJColumn & column = columns[field];
+                        SetBit(column.valid, row);
+                        switch (column.type) {
+                            case JBOOL:
+                                if (value.AsBool()) {
+                                    SetBit(column.bools, row);
+                                }
+                                break;
+                            case JINTEGER:
+                                column.integers[row] = value.AsInteger();
+                                break;
+                            case JDOUBLE:
+                                column.doubles[row] = value.AsDouble();
+                                break;
+                            default:
+                                column.codes[row] = value.GetType() == JSTRING
+                                    ? dictionaries[field].Code(value.AsStringView())
+                                    : dictionaries[field].Code(ToJson(*entry.value));
+                                break;
+                        }
+                    }
+                }
+            }
+        };
+
+        // Runs fn on every slice, inline without a pool
+        template<class F>
+        void RunSlices(TJThreadPool * pool, std::vector<TSlice> & slices, F fn) {
+            if (pool == nullptr || slices.size() == 1) {
+                for (TSlice & slice : slices) {
+                    fn(slice);
+                }
+                return;
+            }
+
+            std::mutex lock;
+            std::condition_variable done;
+            size_t pending = slices.size();
+            for (TSlice & slice : slices) {
+                TSlice * task = &slice;
+                pool->Submit([task, &fn, &lock, &done, &pending]() {
+                    try {
+                        fn(*task);
+                    } catch (...) {
+                        task->error = std::current_exception();
+                    }
+                    std::lock_guard<std::mutex> guard(lock);
+                    if (--pending == 0) {
+                        done.notify_one();
+                    }
+                });
+            }
+            std::unique_lock<std::mutex> guard(lock);
+            done.wait(guard, [&pending]() { return pending == 0; });
+        }
+
+        inline void Rethrow(const std::vector<TSlice> & slices) {
+            for (const TSlice & slice : slices) {
+                if (slice.error) {
+                    std::rethrow_exception(slice.error);
+                }
+            }
+        }
+
+        size_t Build(const IJValue & records, TJThreadPool * pool, size_t sliceRows, std::vector<TJColumn> & columns) {
+            size_t rows = records.IsArray() ? records.Size() : 0;
+            // Packed arrays hold numbers only, no records to read
+            if (records.IsPacked()) {
+                return rows;
+            }
+
+            sliceRows = std::min(sliceRows, rows);
+            sliceRows = std::max<size_t>((sliceRows + 63) & ~size_t(63), 64);
+            std::vector<TSlice> slices((rows + sliceRows - 1) / sliceRows);
+            for (size_t i = 0; i < slices.size(); ++i) {
+                slices[i].begin = i * sliceRows;
+                slices[i].end = std::min(rows, slices[i].begin + sliceRows);
+            }
+
+            RunSlices(pool, slices, [&records](TSlice & slice) {
+                slice.schema.Scan(records, slice.begin, slice.end);
+            });
+            Rethrow(slices);
+
+            TSchema schema;
+            for (TSlice & slice : slices) {
+                schema.Merge(slice.schema);
+                slice.schema = TSchema();
+            }
+
+            size_t words = (rows + 63) / 64;
+            columns.resize(schema.types.size());
+            for (size_t i = 0; i < columns.size(); ++i) {
+                TJColumn & column = columns[i];
+                column.name = schema.index.names[i];
+                column.type = schema.types[i];
+                column.valid.assign(words, 0);
+                switch (column.type) {
+                    case JBOOL:
+                        column.bools.assign(words, 0);
+                        break;
+                    case JINTEGER:
+                        column.integers.assign(rows, 0);
+                        break;
+                    case JDOUBLE:
+                        column.doubles.assign(rows, 0);
+                        break;
+                    case JSTRING:
+                        column.codes.assign(rows, 0);
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            const TFieldIndex & fields = schema.index;
+            RunSlices(pool, slices, [&records, &fields, &columns](TSlice & slice) {
+                slice.Fill(records, fields, columns);
+            });
+            Rethrow(slices);
+
+            // One dictionary per column: slice words in slice order, codes renumbered
+            for (size_t i = 0; i < columns.size(); ++i) {
+                TJColumn & column = columns[i];
+                if (column.type != JSTRING) {
+                    continue;
+                }
+                // The first slice keeps its codes
+                TDictionary merged = std::move(slices[0].dictionaries[i]);
+                std::vector<uint32_t> renumber;
+                for (size_t s = 1; s < slices.size(); ++s) {
+                    TSlice & slice = slices[s];
+                    TDictionary & local = slice.dictionaries[i];
+                    renumber.resize(local.Size());
+                    for (size_t code = 0; code < local.Size(); ++code) {
+                        renumber[code] = merged.Code(local.Word(code));
+                    }
+                    for (size_t row = slice.begin; row < slice.end; ++row) {
+                        if (column.IsValid(row)) {
+                            column.codes[row] = renumber[column.codes[row]];
+                        }
+                    }
+                    local = TDictionary();
+                }
+                if (merged.offsets.empty()) {
+                    merged.offsets.push_back(0);
+                }
+                column.dictionary.swap(merged.words);
+                column.offsets.swap(merged.offsets);
+            }
+            return rows;
+        }
+    }
+
+    const TJColumn * TJColumnar::Find(const string_t & name) const {
+        for (const TJColumn & column : columns) {
+            if (column.name == name) {
+                return &column;
+            }
+        }
+        return nullptr;
+    }
+
+    TJColumnar ToColumns(const IJValue & records) {
+        TJColumnar result;
+        result.rows = Build(records, nullptr, SIZE_MAX, result.columns);
+        return result;
+    }
+
+    TJColumnar ToColumns(const IJValue & records, TJThreadPool & pool, size_t sliceRows) {
+        TJColumnar result;
+        result.rows = Build(records, &pool, sliceRows, result.columns);
+        return result;
+    }
+}
@@ -0,0 +1,45 @@
+#include "jvalue_document.h"
+#include <vector>
+
+namespace NJValue {
+
+    IJValue * TJDocument::Import(const IJValue * val) {
+        if (val == nullptr) {
+            return NewNull();
+        }
+        const IJSON_VALUE & value = val->GetValue();
+        switch (value.GetType()) {
+            case JSTRING: {
+                TJStringView str = value.AsStringView();
+                return NewString(str.data(), str.size());
+            }
+            case JARRAY: {
+                std::vector<IJValue *> items(value.Size());
+                TJSpan<integer_t> integers = value.AsIntegerSpan();
+                TJSpan<double_t> doubles = value.AsDoubleSpan();
+                for (size_t i = 0; i < items.size(); ++i) {
+                    if (!integers.empty()) {
+                        items[i] = NewInteger(integers[i]);
+                    } else if (!doubles.empty()) {
+                        items[i] = NewDouble(doubles[i]);
+                    } else {
+                        items[i] = Import(value.At(i));
+                    }
+                }
+                return NewArray(items.data(), items.size());
+            }
+            case JMAP: {
+                const map_t * map = value.GetMap();
+                map_t * storage = NewMapStorage(value.Size());
+                if (map != nullptr) {
+                    for (const map_t::TEntry & entry : *map) {
+                        storage->Set(entry.key, entry.size, Import(entry.value));
+                    }
+                }
+                return NewMap(storage);
+            }
+            default:
+                return NewValue(value);
+        }
+    }
+}
@@ -0,0 +1,360 @@
+#include "jvalue_edit.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace NJValue {
+
+    namespace {
+
+        const size_t NOT_WRITTEN = static_cast<size_t>(-1);
+
+        // Garbage the arena may hold on top of twice the live document
+        const size_t GARBAGE_SLACK = 256 << 10;
+
+        // Decoded segments of a JSON Pointer
+        std::vector<string_t> Segments(const string_t & path) {
+            std::vector<string_t> segments;
+            if (path.empty()) {
+                return segments;
+            }
+            if (path[0] != '/') {
+                throw TJParseError("Expected '/'", 0);
+            }
+            segments.emplace_back();
+            for (size_t i = 1; i < path.size(); ++i) {
+                if (path[i] == '/') {
+                    segments.emplace_back();
+                } else if (path[i] != '~') {
+                    segments.back() += path[i];
+                } else if (i + 1 < path.size() && (path[i + 1] == '0' || path[i + 1] == '1')) {
+                    segments.back() += path[++i] == '0' ? '~' : '/';
+                } else {
+                    throw TJParseError("Invalid escape", i);
+                }
+            }
+            return segments;
+        }
+
+        // Array index as RFC 6901 has it: no sign, no leading zeros
+        inline bool ParseIndex(const string_t & segment, size_t & index) {
+            if (segment.empty() || (segment.size() > 1 && segment[0] == '0')) {
+                return false;
+            }
+            for (char c : segment) {
+                if (c < '0' || c > '9') {
+                    return false;
+                }
+            }
+            integer_t value = 0;
+            if (ParseInteger(segment.data(), segment.size(), value) != JNUMBER_OK) {
+                return false;
+            }
+            index = static_cast<size_t>(value);
+            return true;
+        }
+
+        inline IJValue * Child(const IJValue * node, const string_t & segment) {
+            size_t index;
+            if (node->IsMap()) {
+                return node->Find(segment);
+            }
+            if (node->IsArray() && ParseIndex(segment, index)) {
+                return node->At(index);
+            }
+            return nullptr;
+        }
+
+        // Maps of the tree are always arena storage of the document, see TJDocument::Import()
+        inline map_t & MutableMap(IJValue * node) {
+            return *const_cast<map_t *>(node->GetValue().GetMap());
+        }
+
+        inline std::vector<IJValue *> Items(const IJValue * array) {
+            std::vector<IJValue *> items(array->Size());
+            for (size_t i = 0; i < items.size(); ++i) {
+                items[i] = array->At(i);
+            }
+            return items;
+        }
+
+        void WriteScalar(TJWriter & writer, const IJSON_VALUE & value) {
+            switch (value.GetType()) {
+                case JBOOL:
+                    writer.WriteBool(value.AsBool());
+                    break;
+                case JINTEGER:
+                    writer.WriteInteger(value.AsInteger());
+                    break;
+                case JDOUBLE:
+                    writer.WriteDouble(value.AsDouble());
+                    break;
+                case JSTRING: {
+                    TJStringView str = value.AsStringView();
+                    writer.WriteString(str.data(), str.size());
+                    break;
+                }
+                case JARRAY:
+                    writer.WriteRaw("[]", 2);
+                    break;
+                case JMAP:
+                    writer.WriteRaw("{}", 2);
+                    break;
+                default:
+                    writer.WriteNull();
+                    break;
+            }
+        }
+    }
+
+    TJEditableDocument::TJEditableDocument(const IJValue & val)
+        : copied(0), changed(true)
+    {
+        root = doc.Import(&val);
+        liveMemory = doc.GetMemoryUsed();
+    }
+
+    IJValue * TJEditableDocument::Resolve(const string_t & path, string_t & last) {
+        std::vector<string_t> segments = Segments(path);
+        ancestors.clear();
+        if (segments.empty()) {
+            return nullptr;
+        }
+        IJValue * node = root;
+        for (size_t i = 0; i + 1 < segments.size(); ++i) {
+            ancestors.push_back(node);
+            node = Child(node, segments[i]);
+            if (node == nullptr) {
+                throw std::out_of_range("No value at " + path);
+            }
+        }
+        ancestors.push_back(node);
+        last.swap(segments.back());
+        return node;
+    }
+
+    // Puts val into the target node itself, so the node stays where it is
+    void TJEditableDocument::Assign(IJValue * target, const IJValue & val) {
+        const IJSON_VALUE & value = val.GetValue();
+        EJValueType type = value.GetType();
+        if (type == JARRAY || type == JMAP || (type == JSTRING && value.AsStringView().size() > IJSON_VALUE::SHORT_STRING_MAX)) {
+            IJValue * copy = doc.Import(&val);
+            *target->GetValuePtr() = std::move(*copy->GetValuePtr());
+        } else {
+            // Copies of scalars and short strings are inline, no storage to own
+            *target->GetValuePtr() = value;
+        }
+        fragments.erase(target);
+    }
+
+    void TJEditableDocument::SetItems(IJValue * array, const std::vector<IJValue *> & items) {
+        IJValue * fresh = doc.NewArray(items.data(), items.size());
+        *array->GetValuePtr() = std::move(*fresh->GetValuePtr());
+    }
+
+    // Marks the containers above the change dirty; copies the tree into a
+    // fresh arena once the garbage of past changes outgrows it
+    void TJEditableDocument::Touch() {
+        changed = true;
+        for (const IJValue * node : ancestors) {
+            auto it = fragments.find(node);
+            if (it != fragments.end()) {
+                it->second.dirty = true;
+            }
+        }
+        ancestors.clear();
+
+        if (doc.GetMemoryUsed() > 2 * liveMemory + GARBAGE_SLACK) {
+            TJDocument fresh;
+            root = fresh.Import(root);
+            doc = std::move(fresh);
+            liveMemory = doc.GetMemoryUsed();
+            fragments.clear();
+        }
+    }
+
+    void TJEditableDocument::Add(const string_t & path, const IJValue & val) {
+        // Taken first: val may be part of the tree the change is about to alter
+        string_t json = NJValue::ToJson(val);
+        string_t key;
+        IJValue * parent = Resolve(path, key);
+        if (parent == nullptr) {
+            Assign(root, val);
+        } else if (parent->IsMap()) {
+            IJValue * existing = parent->Find(key);
+            if (existing != nullptr) {
+                Assign(existing, val);
+            } else {
+                IJValue * copy = doc.Import(&val);
+                MutableMap(parent).Set(key, copy);
+            }
+        } else if (parent->IsArray()) {
+            size_t index = parent->Size();
+            if (key != "-" && (!ParseIndex(key, index) || index > parent->Size())) {
+                throw std::out_of_range("No array position at " + path);
+            }
+            IJValue * copy = doc.Import(&val);
+            std::vector<IJValue *> items = Items(parent);
+            items.insert(items.begin() + index, copy);
+            SetItems(parent, items);
+        } else {
+            throw std::out_of_range("No container at " + path);
+        }
+        changes.push_back(TChange{ JPATCH_ADD, path, std::move(json) });
+        Touch();
+    }
+
+    void TJEditableDocument::Remove(const string_t & path) {
+        string_t key;
+        IJValue * parent = Resolve(path, key);
+        size_t index;
+        if (parent == nullptr) {
+            throw std::out_of_range("The root cannot be removed");
+        } else if (parent->IsMap()) {
+            if (!MutableMap(parent).Erase(key)) {
+                throw std::out_of_range("No value at " + path);
+            }
+        } else if (parent->IsArray() && ParseIndex(key, index) && index < parent->Size()) {
+            std::vector<IJValue *> items = Items(parent);
+            items.erase(items.begin() + index);
+            SetItems(parent, items);
+        } else {
+            throw std::out_of_range("No value at " + path);
+        }
+        changes.push_back(TChange{ JPATCH_REMOVE, path, string_t() });
+        Touch();
+    }
+
+    void TJEditableDocument::Replace(const string_t & path, const IJValue & val) {
+        string_t json = NJValue::ToJson(val);
+        string_t key;
+        IJValue * parent = Resolve(path, key);
+        IJValue * target = parent == nullptr ? root : Child(parent, key);
+        if (target == nullptr) {
+            throw std::out_of_range("No value at " + path);
+        }
+        Assign(target, val);
+        changes.push_back(TChange{ JPATCH_REPLACE, path, std::move(json) });
+        Touch();
+    }
+
+    void TJEditableDocument::Apply(const IJValue & patch) {
+        if (!patch.IsArray()) {
+            throw std::invalid_argument("A patch is an array of operations");
+        }
+        for (size_t i = 0; i < patch.Size(); ++i) {
+            const IJValue * operation = patch.At(i);
+            const IJValue * op = operation != nullptr ? operation->Find("op") : nullptr;
+            const IJValue * path = operation != nullptr ? operation->Find("path") : nullptr;
+            if (op == nullptr || !op->IsString() || path == nullptr || !path->IsString()) {
+                throw std::invalid_argument("Patch operation without an op or a path");
+            }
+            TJStringView name = op->AsStringView();
+            if (name == "remove") {
+                Remove(path->AsString());
+                continue;
+            }
+            if (name != TJStringView("add", 3) && name != TJStringView("replace", 7)) {
+                throw std::invalid_argument("Unsupported patch operation " + name.ToString());
+            }
+            const IJValue * value = operation->Find("value");
+            if (value == nullptr) {
+                throw std::invalid_argument("Patch operation without a value");
+            }
+            if (name == "add") {
+                Add(path->AsString(), *value);
+            } else {
+                Replace(path->AsString(), *value);
+            }
+        }
+    }
+
+    // Writes node; oldParent and newParent are where its parent starts in the
+    // previous output and in this one, oldParent NOT_WRITTEN if it is new
+    void TJEditableDocument::Emit(TJWriter & writer, const IJValue * node, size_t oldParent, size_t newParent) {
+        const IJSON_VALUE & value = node->GetValue();
+        EJValueType type = value.GetType();
+        if ((type != JARRAY && type != JMAP) || value.Size() == 0) {
+            WriteScalar(writer, value);
+            return;
+        }
+
+        size_t start = writer.GetOffset();
+        size_t old = NOT_WRITTEN;
+        auto it = fragments.find(node);
+        if (it != fragments.end() && oldParent != NOT_WRITTEN) {
+            old = oldParent + it->second.offset;
+            if (!it->second.dirty) {
+                writer.WriteRaw(output.data() + old, it->second.size);
+                copied += it->second.size;
+                it->second.offset = start - newParent;
+                return;
+            }
+        }
+
+        if (type == JARRAY) {
+            writer.WriteRaw("[", 1);
+            for (size_t i = 0; i < value.Size(); ++i) {
+                if (i != 0) {
+                    writer.WriteRaw(",", 1);
+                }
+                Emit(writer, value.At(i), old, start);
+            }
+            writer.WriteRaw("]", 1);
+        } else {
+            writer.WriteRaw("{", 1);
+            bool first = true;
+            for (const map_t::TEntry & entry : *value.GetMap()) {
+                if (!first) {
+                    writer.WriteRaw(",", 1);
+                }
+                first = false;
+                writer.WriteString(entry.key, entry.size);
+                writer.WriteRaw(":", 1);
+                Emit(writer, entry.value, old, start);
+            }
+            writer.WriteRaw("}", 1);
+        }
+        // Looked up again: the children may have rehashed the table
+        fragments[node] = TFragment{ start - newParent, writer.GetOffset() - start, false };
+    }
+
+    const string_t & TJEditableDocument::ToJson() {
+        if (!changed) {
+            copied = output.size();
+            return output;
+        }
+        string_t next;
+        next.reserve(output.size());
+        TJStringSink sink(next);
+        TJWriter writer(sink);
+        copied = 0;
+        Emit(writer, root, output.empty() ? NOT_WRITTEN : 0, 0);
+        writer.Flush();
+        output.swap(next);
+        changed = false;
+        return output;
+    }
+
+    string_t TJEditableDocument::GetPatch() const {
+        static const char * const OPS[] = { "add", "remove", "replace" };
+        string_t out;
+        TJStringSink sink(out);
+        TJWriter writer(sink);
+        writer.WriteRaw("[", 1);
+        for (size_t i = 0; i < changes.size(); ++i) {
+            const TChange & change = changes[i];
+            writer.WriteRaw(i == 0 ? "{\"op\":\"" : ",{\"op\":\"", i == 0 ? 7 : 8);
+            writer.WriteRaw(OPS[change.op], std::strlen(OPS[change.op]));
+            writer.WriteRaw("\",\"path\":", 9);
+            writer.WriteString(change.path.data(), change.path.size());
+            if (change.op != JPATCH_REMOVE) {
+                writer.WriteRaw(",\"value\":", 9);
+                writer.WriteRaw(change.value.data(), change.value.size());
+            }
+            writer.WriteRaw("}", 1);
+        }
+        writer.WriteRaw("]", 1);
+        writer.Flush();
+        return out;
+    }
+}
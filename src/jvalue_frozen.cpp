@@ -0,0 +1,69 @@
+#include "jvalue_frozen.h"
+#include "jvalue_parser.h"
+#include <thread>
+
+namespace NJValue {
+
+    TJFrozenDocument::TJFrozenDocument()
+        : doc(sizeof(TJValue<IJSON_VALUE>))
+    {
+        doc.SetRoot(doc.NewNull());
+    }
+
+    TJFrozenDocument::TJFrozenDocument(const IJValue & root) {
+        doc.SetRoot(doc.Import(&root));
+    }
+
+    TJFrozenDocument::TJFrozenDocument(const char * data, size_t size) {
+        // Copied strings are decoded into the arena, never lazily
+        Parse(data, size, doc, JPARSE_COPY);
+    }
+
+    TJDocumentHolder::TJDocumentHolder()
+        : TJDocumentHolder(TJFrozenDocument())
+    { }
+
+    TJDocumentHolder::TJDocumentHolder(TJFrozenDocument && doc)
+        : current(new TVersion(std::move(doc), 1)), version(1), epoch(0)
+    {
+        readers[0] = 0;
+        readers[1] = 0;
+    }
+
+    TJDocumentHolder::~TJDocumentHolder() {
+        Release(current.load(std::memory_order_acquire));
+    }
+
+    TJDocumentHolder::TSnapshot TJDocumentHolder::Acquire() const {
+        // The version read here is safe to count as long as Publish() waits for
+        // this epoch; if a Publish() moved on in between, start again
+        for (;;) {
+            size_t started = epoch.load();
+            std::atomic<size_t> & active = readers[started & 1];
+            active.fetch_add(1);
+            if (epoch.load() == started) {
+                TVersion * pinned = current.load();
+                pinned->refs.fetch_add(1, std::memory_order_relaxed);
+                active.fetch_sub(1, std::memory_order_release);
+                return TSnapshot(pinned);
+            }
+            active.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    uint64_t TJDocumentHolder::Publish(TJFrozenDocument && doc) {
+        std::lock_guard<std::mutex> guard(writer);
+        uint64_t number = version.load(std::memory_order_relaxed) + 1;
+        TVersion * old = current.exchange(new TVersion(std::move(doc), number));
+        version.store(number, std::memory_order_release);
+
+        // Acquire() calls from before the swap count in the old epoch's slot and may
+        // still be about to take a reference to old; later ones see the new version
+        size_t finished = epoch.fetch_add(1);
+        while (readers[finished & 1].load() != 0) {
+            std::this_thread::yield();
+        }
+        Release(old);
+        return number;
+    }
+}
@@ -0,0 +1,171 @@
+#include "jvalue_hash.h"
+#include <algorithm>
+#include <type_traits>
+
+namespace NJValue {
+
+    template<class F>
+    TJInterner::TNode * TJInterner::Lookup(uint64_t hash, F matches) const {
+        if (table.empty()) {
+            return nullptr;
+        }
+        size_t mask = table.size() - 1;
+        for (size_t slot = hash & mask; table[slot].node != nullptr; slot = (slot + 1) & mask) {
+            if (table[slot].hash == hash && matches(table[slot].node->value.GetValue())) {
+                return table[slot].node;
+            }
+        }
+        return nullptr;
+    }
+
+    TJInterner::TNode * TJInterner::Add(IJSON_VALUE && val, uint64_t hash) {
+        static_assert(std::is_standard_layout<TNode>::value, "Hash() reads TNode through a node pointer");
+
+        if (table.size() < 2 * (size + 1)) {
+            std::vector<TSlot> old(std::max<size_t>(16, 2 * table.size()), TSlot());
+            old.swap(table);
+            for (const TSlot & entry : old) {
+                if (entry.node != nullptr) {
+                    Insert(entry);
+                }
+            }
+        }
+
+        TNode * node = arena->New<TNode>(std::move(val), hash);
+        Insert(TSlot{ hash, node });
+        ++size;
+        return node;
+    }
+
+    TJInterner::TNode * TJInterner::InternScalar(const IJSON_VALUE & val) {
+        uint64_t hash = val.Hash();
+        TNode * node = Lookup(hash, [&val](const IJSON_VALUE & other) { return other.Equals(val); });
+        if (node != nullptr) {
+            return node;
+        }
+        if (val.GetType() == JSTRING) {
+            TJStringView str = val.AsStringView();
+            const char * data = str.data();
+            if (str.size() > IJSON_VALUE::SHORT_STRING_MAX) {
+                JTrace(JTRACE_ALLOCATE, JSTRING, str.size());
+                data = arena->CopyString(str.data(), str.size());
+            }
+            return Add(JSON_STRING(TJBorrow(), data, str.size()), hash);
+        }
+        return Add(IJSON_VALUE(val), hash);
+    }
+
+    TJInterner::TNode * TJInterner::InternArray(const IJSON_VALUE & val) {
+        size_t size = val.Size();
+        size_t base = children.size();
+        TJSpan<integer_t> integers = val.AsIntegerSpan();
+        TJSpan<double_t> doubles = val.AsDoubleSpan();
+        for (size_t i = 0; i < size; ++i) {
+            if (!integers.empty()) {
+                children.push_back(InternScalar(JSON_INTEGER(integers[i])));
+            } else if (!doubles.empty()) {
+                children.push_back(InternScalar(JSON_DOUBLE(doubles[i])));
+            } else {
+                children.push_back(InternNode(val.At(i)));
+            }
+        }
+        TNode * const * items = children.data() + base;
+
+        uint64_t hash = NHash::ArrayStart(size);
+        for (size_t i = 0; i < size; ++i) {
+            hash = NHash::Mix(hash, items[i]->hash);
+        }
+        hash = NHash::Finish(hash);
+
+        TNode * node = Lookup(hash, [items, size](const IJSON_VALUE & other) {
+            if (other.GetType() != JARRAY || other.Size() != size) {
+                return false;
+            }
+            for (size_t i = 0; i < size; ++i) {
+                if (other.At(i) != &items[i]->value) {
+                    return false;
+                }
+            }
+            return true;
+        });
+        if (node == nullptr) {
+            if (size == 0) {
+                node = Add(JSON_ARRAY(), hash);
+            } else {
+                JTrace(JTRACE_ALLOCATE, JARRAY, size * sizeof(IJValue *));
+                IJValue ** storage = arena->NewArray<IJValue *>(size);
+                for (size_t i = 0; i < size; ++i) {
+                    storage[i] = &items[i]->value;
+                }
+                node = Add(JSON_ARRAY(TJBorrow(), storage, size), hash);
+            }
+        }
+        children.resize(base);
+        return node;
+    }
+
+    TJInterner::TNode * TJInterner::InternMap(const IJSON_VALUE & val) {
+        const map_t * map = val.GetMap();
+        size_t size = val.Size();
+        size_t base = children.size();
+        uint64_t sum = 0;
+        if (map != nullptr) {
+            for (const map_t::TEntry & entry : *map) {
+                TNode * child = InternNode(entry.value);
+                children.push_back(child);
+                sum += NHash::MapEntry(entry.hash, child->hash);
+            }
+        }
+        TNode * const * values = children.data() + base;
+        uint64_t hash = NHash::Map(sum, size);
+
+        TNode * node = Lookup(hash, [map, values, size](const IJSON_VALUE & other) {
+            if (other.GetType() != JMAP || other.Size() != size) {
+                return false;
+            }
+            if (size == 0) {
+                return true;
+            }
+            const map_t * otherMap = other.GetMap();
+            size_t i = 0;
+            for (const map_t::TEntry & entry : *map) {
+                const map_t::TEntry * found = otherMap->FindEntry(entry.key, entry.size, entry.hash);
+                if (found == nullptr || found->value != &values[i++]->value) {
+                    return false;
+                }
+            }
+            return true;
+        });
+        if (node == nullptr) {
+            if (size == 0) {
+                node = Add(JSON_MAP(), hash);
+            } else {
+                JTrace(JTRACE_ALLOCATE, JMAP, size * sizeof(map_t::TEntry));
+                map_t * storage = arena->New<map_t>(arena.get());
+                storage->Reserve(size);
+                size_t i = 0;
+                for (const map_t::TEntry & entry : *map) {
+                    storage->Set(entry.key, entry.size, &values[i++]->value);
+                }
+                node = Add(JSON_MAP(TJBorrow(), storage), hash);
+            }
+        }
+        children.resize(base);
+        return node;
+    }
+
+    TJInterner::TNode * TJInterner::InternNode(const IJValue * val) {
+        if (val == nullptr) {
+            return InternScalar(JSON_NULL());
+        }
+        const IJSON_VALUE & value = val->GetValue();
+        switch (value.GetType()) {
+            case JARRAY:
+                return InternArray(value);
+            case JMAP:
+                return InternMap(value);
+            default:
+                return InternScalar(value);
+        }
+    }
+}
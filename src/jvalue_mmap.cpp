@@ -0,0 +1,47 @@
+#include "jvalue_mmap.h"
+#include <cerrno>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace NJValue {
+
+    TJMappedFile::TJMappedFile(const string_t & path)
+        : data(nullptr), size(0)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::system_category(), "open " + path);
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::system_category(), "fstat " + path);
+        }
+
+        if (st.st_size > 0) {
+            void * p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::system_category(), "mmap " + path);
+            }
+            data = static_cast<const char *>(p);
+            size = st.st_size;
+        }
+        // The mapping keeps the file alive
+        ::close(fd);
+    }
+
+    void TJMappedFile::Unmap() {
+        if (data != nullptr) {
+            ::munmap(const_cast<char *>(data), size);
+            data = nullptr;
+            size = 0;
+        }
+    }
+}
@@ -0,0 +1,157 @@
+#include "jvalue_ndjson.h"
+#include <map>
+
+namespace NJValue {
+
+    namespace {
+
+        struct TChunk {
+            TJNdjsonBatch * batch;
+            const char * data;
+            size_t size;
+            bool skipped;
+            std::exception_ptr error;
+        };
+
+        inline void LowerTo(std::atomic<size_t> & value, size_t limit) {
+            size_t current = value.load();
+            while (limit < current && !value.compare_exchange_weak(current, limit)) {
+            }
+        }
+    }
+
+    void TJNdjsonReader::Read(const char * data, size_t size, const TJNdjsonCallback & callback) {
+        size_t maxPending = options.maxPending != 0 ? options.maxPending : 2 * pool.Size();
+        size_t chunkSize = std::max<size_t>(options.chunkSize, 1);
+        EJParseMode mode = options.mode;
+        EJUtf8Mode utf8 = options.utf8;
+
+        std::vector<TJNdjsonBatch *> idle;
+        std::vector<TChunk> chunks;
+        while (batches.size() < maxPending) {
+            batches.emplace_back(new TJNdjsonBatch());
+        }
+        for (size_t i = 0; i < maxPending; ++i) {
+            idle.push_back(batches[i].get());
+        }
+
+        std::mutex lock;
+        std::condition_variable done;
+        std::vector<TChunk> finished;
+        // Lowest chunk index that failed; workers skip the chunks after it
+        std::atomic<size_t> firstFailure(SIZE_MAX);
+
+        std::map<size_t, TChunk> ready;
+        size_t nextChunk = 0;
+        size_t nextDelivery = 0;
+        size_t inFlight = 0;
+        size_t pos = 0;
+        std::exception_ptr error;
+        size_t errorIndex = SIZE_MAX;
+
+        auto process = [&](TChunk & chunk) {
+            TJNdjsonBatch * batch = chunk.batch;
+            if (chunk.error) {
+                if (batch->index < errorIndex) {
+                    errorIndex = batch->index;
+                    error = chunk.error;
+                }
+            } else if (!chunk.skipped && batch->index <= firstFailure.load()) {
+                try {
+                    callback(*batch);
+                } catch (...) {
+                    if (batch->index < errorIndex) {
+                        errorIndex = batch->index;
+                        error = std::current_exception();
+                    }
+                    LowerTo(firstFailure, batch->index);
+                }
+            }
+            idle.push_back(batch);
+            --inFlight;
+        };
+
+        for (;;) {
+            while (!idle.empty() && pos < size && firstFailure.load() == SIZE_MAX) {
+                size_t end = size - pos > chunkSize ? pos + chunkSize : size;
+                if (end < size) {
+                    const char * newline = static_cast<const char *>(std::memchr(data + end, '\n', size - end));
+                    end = newline == nullptr ? size : newline - data + 1;
+                }
+
+                TChunk chunk;
+                chunk.batch = idle.back();
+                chunk.data = data + pos;
+                chunk.size = end - pos;
+                chunk.skipped = false;
+                chunk.batch->index = nextChunk++;
+                chunk.batch->offset = pos;
+                idle.pop_back();
+                ++inFlight;
+                pos = end;
+
+                pool.Submit([chunk, mode, utf8, &lock, &done, &finished, &firstFailure]() mutable {
+                    TJNdjsonBatch & batch = *chunk.batch;
+                    batch.doc.Reset();
+                    batch.values.clear();
+                    if (batch.index > firstFailure.load()) {
+                        chunk.skipped = true;
+                    } else {
+                        try {
+                            ParseLines(chunk.data, chunk.size, batch.doc, batch.values, mode, JKERNEL_AUTO, utf8);
+                        } catch (const TJParseError & e) {
+                            chunk.error = std::make_exception_ptr(TJParseError(e.GetMessage(), e.GetOffset() + batch.offset));
+                        } catch (...) {
+                            chunk.error = std::current_exception();
+                        }
+                        if (chunk.error) {
+                            LowerTo(firstFailure, batch.index);
+                        }
+                    }
+
+                    std::lock_guard<std::mutex> guard(lock);
+                    finished.push_back(std::move(chunk));
+                    done.notify_one();
+                });
+            }
+
+            if (inFlight == 0) {
+                break;
+            }
+
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                done.wait(guard, [&finished]() { return !finished.empty(); });
+                chunks.swap(finished);
+            }
+            for (TChunk & chunk : chunks) {
+                if (options.ordered) {
+                    size_t index = chunk.batch->index;
+                    ready.insert(std::make_pair(index, std::move(chunk)));
+                } else {
+                    process(chunk);
+                }
+            }
+            chunks.clear();
+            while (!ready.empty() && ready.begin()->first == nextDelivery) {
+                process(ready.begin()->second);
+                ready.erase(ready.begin());
+                ++nextDelivery;
+            }
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    void ParseNdjson(const char * data, size_t size, const TJNdjsonCallback & callback, const TJNdjsonOptions & options) {
+        TJThreadPool pool(options.threads);
+        TJNdjsonReader(pool, options).Read(data, size, callback);
+    }
+
+    void ParseNdjsonFile(const string_t & path, const TJNdjsonCallback & callback, const TJNdjsonOptions & options) {
+        TJMappedFile file(path);
+        ParseNdjson(file.Data(), file.Size(), callback, options);
+    }
+}
@@ -0,0 +1,583 @@
+#include "jvalue.h"
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace NJValue {
+
+    namespace {
+
+        inline bool IsDigit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        // Same set as isspace() in the C locale
+        inline bool IsSpace(char c) {
+            return c == ' ' || (c >= '\t' && c <= '\r');
+        }
+
+        inline size_t SkipSpace(const char * data, size_t size) {
+            size_t i = 0;
+            while (i < size && IsSpace(data[i])) {
+                ++i;
+            }
+            return i;
+        }
+
+        inline bool MatchNoCase(const char * data, size_t size, size_t pos, const char * word) {
+            for (; *word != 0; ++word, ++pos) {
+                if (pos >= size || (data[pos] | 0x20) != *word) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Powers of ten that a double holds exactly
+        const double EXACT_POWERS[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        const size_t MAX_DIGITS = 19;               // always fit in uint64_t
+        const uint64_t MAX_EXACT_MANTISSA = uint64_t(1) << 53;
+        const long MAX_EXPONENT = 100000;           // far beyond any finite or subnormal double
+
+        // Grisu2 (Loitsch, "Printing Floating-Point Numbers Quickly and Accurately
+        // with Integers"): shortest digits in nearly all cases, always round-trips.
+        struct TDiyFp {
+            uint64_t f;
+            int e;
+
+            TDiyFp(uint64_t f, int e) : f(f), e(e) { }
+
+            inline TDiyFp Sub(const TDiyFp & y) const { return TDiyFp(f - y.f, e); }
+
+            inline TDiyFp Mul(const TDiyFp & y) const {
+                unsigned __int128 p = static_cast<unsigned __int128>(f) * y.f;
+                uint64_t hi = static_cast<uint64_t>(p >> 64);
+                uint64_t lo = static_cast<uint64_t>(p);
+                return TDiyFp(hi + (lo >> 63), e + y.e + 64);
+            }
+
+            inline TDiyFp Normalize() const {
+                TDiyFp x = *this;
+                while ((x.f >> 63) == 0) {
+                    x.f <<= 1;
+                    --x.e;
+                }
+                return x;
+            }
+        };
+
+        struct TCachedPower {
+            uint64_t f;
+            int e;
+            int k;
+        };
+
+        // Normalized 10^k for k = -300, -292, ..., 324
+        const TCachedPower CACHED_POWERS[] = {
+            { 0xAB70FE17C79AC6CAULL, -1060, -300 },
+            { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+            { 0xBE5691EF416BD60CULL, -1007, -284 },
+            { 0x8DD01FAD907FFC3CULL,  -980, -276 },
+            { 0xD3515C2831559A83ULL,  -954, -268 },
+            { 0x9D71AC8FADA6C9B5ULL,  -927, -260 },
+            { 0xEA9C227723EE8BCBULL,  -901, -252 },
+            { 0xAECC49914078536DULL,  -874, -244 },
+            { 0x823C12795DB6CE57ULL,  -847, -236 },
+            { 0xC21094364DFB5637ULL,  -821, -228 },
+            { 0x9096EA6F3848984FULL,  -794, -220 },
+            { 0xD77485CB25823AC7ULL,  -768, -212 },
+            { 0xA086CFCD97BF97F4ULL,  -741, -204 },
+            { 0xEF340A98172AACE5ULL,  -715, -196 },
+            { 0xB23867FB2A35B28EULL,  -688, -188 },
+            { 0x84C8D4DFD2C63F3BULL,  -661, -180 },
+            { 0xC5DD44271AD3CDBAULL,  -635, -172 },
+            { 0x936B9FCEBB25C996ULL,  -608, -164 },
+            { 0xDBAC6C247D62A584ULL,  -582, -156 },
+            { 0xA3AB66580D5FDAF6ULL,  -555, -148 },
+            { 0xF3E2F893DEC3F126ULL,  -529, -140 },
+            { 0xB5B5ADA8AAFF80B8ULL,  -502, -132 },
+            { 0x87625F056C7C4A8BULL,  -475, -124 },
+            { 0xC9BCFF6034C13053ULL,  -449, -116 },
+            { 0x964E858C91BA2655ULL,  -422, -108 },
+            { 0xDFF9772470297EBDULL,  -396, -100 },
+            { 0xA6DFBD9FB8E5B88FULL,  -369,  -92 },
+            { 0xF8A95FCF88747D94ULL,  -343,  -84 },
+            { 0xB94470938FA89BCFULL,  -316,  -76 },
+            { 0x8A08F0F8BF0F156BULL,  -289,  -68 },
+            { 0xCDB02555653131B6ULL,  -263,  -60 },
+            { 0x993FE2C6D07B7FACULL,  -236,  -52 },
+            { 0xE45C10C42A2B3B06ULL,  -210,  -44 },
+            { 0xAA242499697392D3ULL,  -183,  -36 },
+            { 0xFD87B5F28300CA0EULL,  -157,  -28 },
+            { 0xBCE5086492111AEBULL,  -130,  -20 },
+            { 0x8CBCCC096F5088CCULL,  -103,  -12 },
+            { 0xD1B71758E219652CULL,   -77,   -4 },
+            { 0x9C40000000000000ULL,   -50,    4 },
+            { 0xE8D4A51000000000ULL,   -24,   12 },
+            { 0xAD78EBC5AC620000ULL,     3,   20 },
+            { 0x813F3978F8940984ULL,    30,   28 },
+            { 0xC097CE7BC90715B3ULL,    56,   36 },
+            { 0x8F7E32CE7BEA5C70ULL,    83,   44 },
+            { 0xD5D238A4ABE98068ULL,   109,   52 },
+            { 0x9F4F2726179A2245ULL,   136,   60 },
+            { 0xED63A231D4C4FB27ULL,   162,   68 },
+            { 0xB0DE65388CC8ADA8ULL,   189,   76 },
+            { 0x83C7088E1AAB65DBULL,   216,   84 },
+            { 0xC45D1DF942711D9AULL,   242,   92 },
+            { 0x924D692CA61BE758ULL,   269,  100 },
+            { 0xDA01EE641A708DEAULL,   295,  108 },
+            { 0xA26DA3999AEF774AULL,   322,  116 },
+            { 0xF209787BB47D6B85ULL,   348,  124 },
+            { 0xB454E4A179DD1877ULL,   375,  132 },
+            { 0x865B86925B9BC5C2ULL,   402,  140 },
+            { 0xC83553C5C8965D3DULL,   428,  148 },
+            { 0x952AB45CFA97A0B3ULL,   455,  156 },
+            { 0xDE469FBD99A05FE3ULL,   481,  164 },
+            { 0xA59BC234DB398C25ULL,   508,  172 },
+            { 0xF6C69A72A3989F5CULL,   534,  180 },
+            { 0xB7DCBF5354E9BECEULL,   561,  188 },
+            { 0x88FCF317F22241E2ULL,   588,  196 },
+            { 0xCC20CE9BD35C78A5ULL,   614,  204 },
+            { 0x98165AF37B2153DFULL,   641,  212 },
+            { 0xE2A0B5DC971F303AULL,   667,  220 },
+            { 0xA8D9D1535CE3B396ULL,   694,  228 },
+            { 0xFB9B7CD9A4A7443CULL,   720,  236 },
+            { 0xBB764C4CA7A44410ULL,   747,  244 },
+            { 0x8BAB8EEFB6409C1AULL,   774,  252 },
+            { 0xD01FEF10A657842CULL,   800,  260 },
+            { 0x9B10A4E5E9913129ULL,   827,  268 },
+            { 0xE7109BFBA19C0C9DULL,   853,  276 },
+            { 0xAC2820D9623BF429ULL,   880,  284 },
+            { 0x80444B5E7AA7CF85ULL,   907,  292 },
+            { 0xBF21E44003ACDD2DULL,   933,  300 },
+            { 0x8E679C2F5E44FF8FULL,   960,  308 },
+            { 0xD433179D9C8CB841ULL,   986,  316 },
+            { 0x9E19DB92B4E31BA9ULL,  1013,  324 }
+        };
+
+        const int CACHED_POWERS_MIN_K = -300;
+        const int CACHED_POWERS_STEP = 8;
+        const int ALPHA = -60;
+        const int GAMMA = -32;
+
+        // Cached power c = f * 2^e with ALPHA <= e + binary exponent + 64 <= GAMMA
+        inline const TCachedPower & CachedPowerFor(int e) {
+            int f = ALPHA - e - 1;
+            int k = (f * 78913) / (1 << 18) + (f > 0);
+            int index = (-CACHED_POWERS_MIN_K + k + (CACHED_POWERS_STEP - 1)) / CACHED_POWERS_STEP;
+            return CACHED_POWERS[index];
+        }
+
+        inline int LargestPow10(uint32_t n, uint32_t & pow10) {
+            static const uint32_t POWERS[] = {
+                1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+            };
+            int digits = 10;
+            while (digits > 1 && n < POWERS[digits - 1]) {
+                --digits;
+            }
+            pow10 = POWERS[digits - 1];
+            return digits;
+        }
+
+        inline void RoundWeed(char * buffer, int length, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t tenK) {
+            while (rest < dist && delta - rest >= tenK && (rest + tenK < dist || dist - rest > rest + tenK - dist)) {
+                --buffer[length - 1];
+                rest += tenK;
+            }
+        }
+
+        void DigitGen(char * buffer, int & length, int & exponent, const TDiyFp & low, const TDiyFp & w, const TDiyFp & high) {
+            uint64_t delta = high.Sub(low).f;
+            uint64_t dist = high.Sub(w).f;
+            const TDiyFp one(uint64_t(1) << -high.e, high.e);
+
+            uint32_t p1 = static_cast<uint32_t>(high.f >> -one.e);
+            uint64_t p2 = high.f & (one.f - 1);
+
+            uint32_t pow10;
+            int n = LargestPow10(p1, pow10);
+            while (n > 0) {
+                uint32_t d = p1 / pow10;
+                p1 %= pow10;
+                buffer[length++] = static_cast<char>('0' + d);
+                --n;
+                uint64_t rest = (static_cast<uint64_t>(p1) << -one.e) + p2;
+                if (rest <= delta) {
+                    exponent += n;
+                    RoundWeed(buffer, length, dist, delta, rest, static_cast<uint64_t>(pow10) << -one.e);
+                    return;
+                }
+                pow10 /= 10;
+            }
+
+            int m = 0;
+            for (;;) {
+                p2 *= 10;
+                buffer[length++] = static_cast<char>('0' + (p2 >> -one.e));
+                p2 &= one.f - 1;
+                ++m;
+                delta *= 10;
+                dist *= 10;
+                if (p2 <= delta) {
+                    break;
+                }
+            }
+            exponent -= m;
+            RoundWeed(buffer, length, dist, delta, p2, one.f);
+        }
+
+        // Shortest digits of a finite positive value: value = digits * 10^exponent
+        void Grisu2(double_t value, char * buffer, int & length, int & exponent) {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            const uint64_t hiddenBit = uint64_t(1) << 52;
+            uint64_t fraction = bits & (hiddenBit - 1);
+            int biased = static_cast<int>(bits >> 52);
+
+            TDiyFp v = biased == 0 ? TDiyFp(fraction, 1 - 1075) : TDiyFp(fraction + hiddenBit, biased - 1075);
+            bool lowerCloser = fraction == 0 && biased > 1;
+            TDiyFp high = TDiyFp(2 * v.f + 1, v.e - 1).Normalize();
+            TDiyFp low = lowerCloser ? TDiyFp(4 * v.f - 1, v.e - 2) : TDiyFp(2 * v.f - 1, v.e - 1);
+            low = TDiyFp(low.f << (low.e - high.e), high.e);
+            v = v.Normalize();
+
+            const TCachedPower & cached = CachedPowerFor(high.e);
+            const TDiyFp c(cached.f, cached.e);
+            TDiyFp w = v.Mul(c);
+            TDiyFp wLow = low.Mul(c);
+            TDiyFp wHigh = high.Mul(c);
+
+            length = 0;
+            exponent = -cached.k;
+            DigitGen(buffer, length, exponent, TDiyFp(wLow.f + 1, wLow.e), w, TDiyFp(wHigh.f - 1, wHigh.e));
+        }
+
+        const char DIGIT_PAIRS[] =
+            "00010203040506070809"
+            "10111213141516171819"
+            "20212223242526272829"
+            "30313233343536373839"
+            "40414243444546474849"
+            "50515253545556575859"
+            "60616263646566676869"
+            "70717273747576777879"
+            "80818283848586878889"
+            "90919293949596979899";
+
+        // Writes the digits of value right-aligned, ending just before end
+        inline char * WriteDigitsBackward(char * end, uint64_t value) {
+            while (value >= 100) {
+                const char * pair = DIGIT_PAIRS + (value % 100) * 2;
+                value /= 100;
+                *--end = pair[1];
+                *--end = pair[0];
+            }
+            if (value >= 10) {
+                const char * pair = DIGIT_PAIRS + value * 2;
+                *--end = pair[1];
+                *--end = pair[0];
+            } else {
+                *--end = static_cast<char>('0' + value);
+            }
+            return end;
+        }
+
+        inline size_t CountDigits(uint64_t value) {
+            size_t digits = 1;
+            for (;;) {
+                if (value < 10) return digits;
+                if (value < 100) return digits + 1;
+                if (value < 1000) return digits + 2;
+                if (value < 10000) return digits + 3;
+                value /= 10000;
+                digits += 4;
+            }
+        }
+
+        // Places digits * 10^exponent as plain decimal or in scientific notation.
+        // Integral values keep a ".0" so they read back as doubles.
+        char * FormatDecimal(char * out, const char * digits, int length, int exponent) {
+            const int point = length + exponent;    // position of the decimal point
+
+            if (length <= point && point <= 21) {
+                std::memcpy(out, digits, length);
+                std::memset(out + length, '0', point - length);
+                out += point;
+                *out++ = '.';
+                *out++ = '0';
+                return out;
+            }
+            if (0 < point && point <= 21) {
+                std::memcpy(out, digits, point);
+                out[point] = '.';
+                std::memcpy(out + point + 1, digits + point, length - point);
+                return out + length + 1;
+            }
+            if (-6 < point && point <= 0) {
+                *out++ = '0';
+                *out++ = '.';
+                std::memset(out, '0', -point);
+                out += -point;
+                std::memcpy(out, digits, length);
+                return out + length;
+            }
+
+            *out++ = digits[0];
+            if (length > 1) {
+                *out++ = '.';
+                std::memcpy(out, digits + 1, length - 1);
+                out += length - 1;
+            }
+            *out++ = 'e';
+            int e = point - 1;
+            if (e < 0) {
+                *out++ = '-';
+                e = -e;
+            } else {
+                *out++ = '+';
+            }
+            char * end = out + CountDigits(e);
+            WriteDigitsBackward(end, e);
+            return end;
+        }
+    }
+
+    EJNumberStatus ParseInteger(const char * data, size_t size, integer_t & value, size_t * consumed) {
+        size_t i = SkipSpace(data, size);
+        bool negative = false;
+        if (i < size && (data[i] == '-' || data[i] == '+')) {
+            negative = data[i] == '-';
+            ++i;
+        }
+
+        value = 0;
+        if (i >= size || !IsDigit(data[i])) {
+            if (consumed != nullptr) {
+                *consumed = 0;
+            }
+            return JNUMBER_INVALID;
+        }
+
+        // Accumulate negatively so LONG_MIN is representable
+        bool overflow = false;
+        integer_t acc = 0;
+        for (; i < size && IsDigit(data[i]); ++i) {
+            integer_t digit = data[i] - '0';
+            if (overflow || acc < (LONG_MIN + digit) / 10) {
+                overflow = true;
+                continue;
+            }
+            acc = acc * 10 - digit;
+        }
+
+        if (consumed != nullptr) {
+            *consumed = i;
+        }
+        if (!overflow && !negative && acc == LONG_MIN) {
+            overflow = true;
+        }
+        if (overflow) {
+            value = negative ? LONG_MIN : LONG_MAX;
+            return JNUMBER_RANGE;
+        }
+        value = negative ? acc : -acc;
+        return i == size ? JNUMBER_OK : JNUMBER_PARTIAL;
+    }
+
+    EJNumberStatus ParseDouble(const char * data, size_t size, double_t & value, size_t * consumed) {
+        size_t i = SkipSpace(data, size);
+        bool negative = false;
+        if (i < size && (data[i] == '-' || data[i] == '+')) {
+            negative = data[i] == '-';
+            ++i;
+        }
+
+        value = 0.0;
+        if (consumed != nullptr) {
+            *consumed = 0;
+        }
+
+        if (i < size && !IsDigit(data[i]) && data[i] != '.') {
+            double_t special;
+            if (MatchNoCase(data, size, i, "infinity")) {
+                special = std::numeric_limits<double_t>::infinity();
+                i += 8;
+            } else if (MatchNoCase(data, size, i, "inf")) {
+                special = std::numeric_limits<double_t>::infinity();
+                i += 3;
+            } else if (MatchNoCase(data, size, i, "nan")) {
+                special = std::numeric_limits<double_t>::quiet_NaN();
+                i += 3;
+            } else {
+                return JNUMBER_INVALID;
+            }
+            value = negative ? -special : special;
+            if (consumed != nullptr) {
+                *consumed = i;
+            }
+            return i == size ? JNUMBER_OK : JNUMBER_PARTIAL;
+        }
+
+        // Significant digits go to mantissa while they fit, the rest only shift the exponent
+        const size_t digitsStart = i;
+        uint64_t mantissa = 0;
+        size_t significant = 0;
+        bool truncated = false;
+        long exponent = 0;
+        bool anyDigit = false;
+
+        for (; i < size && IsDigit(data[i]); ++i) {
+            anyDigit = true;
+            if (significant < MAX_DIGITS) {
+                mantissa = mantissa * 10 + (data[i] - '0');
+                significant += (mantissa != 0);
+            } else {
+                truncated = truncated || data[i] != '0';
+                ++exponent;
+            }
+        }
+        if (i < size && data[i] == '.') {
+            size_t dot = i++;
+            for (; i < size && IsDigit(data[i]); ++i) {
+                anyDigit = true;
+                if (significant < MAX_DIGITS) {
+                    mantissa = mantissa * 10 + (data[i] - '0');
+                    significant += (mantissa != 0);
+                    --exponent;
+                } else {
+                    truncated = truncated || data[i] != '0';
+                }
+            }
+            if (!anyDigit) {
+                i = dot;
+            }
+        }
+        if (!anyDigit) {
+            return JNUMBER_INVALID;
+        }
+        const size_t digitsEnd = i;
+
+        long explicitExponent = 0;
+        if (i < size && (data[i] == 'e' || data[i] == 'E')) {
+            size_t j = i + 1;
+            bool negativeExponent = false;
+            if (j < size && (data[j] == '-' || data[j] == '+')) {
+                negativeExponent = data[j] == '-';
+                ++j;
+            }
+            if (j < size && IsDigit(data[j])) {
+                for (; j < size && IsDigit(data[j]); ++j) {
+                    if (explicitExponent < MAX_EXPONENT) {
+                        explicitExponent = explicitExponent * 10 + (data[j] - '0');
+                    }
+                }
+                if (negativeExponent) {
+                    explicitExponent = -explicitExponent;
+                }
+                i = j;
+            }
+        }
+        exponent += explicitExponent;
+
+        if (consumed != nullptr) {
+            *consumed = i;
+        }
+        EJNumberStatus status = i == size ? JNUMBER_OK : JNUMBER_PARTIAL;
+
+        if (mantissa == 0 && !truncated) {
+            value = negative ? -0.0 : 0.0;
+            return status;
+        }
+
+        // Exact mantissa and power of ten: one correctly rounded operation
+        if (!truncated && mantissa <= MAX_EXACT_MANTISSA && exponent >= -22 && exponent <= 22) {
+            double_t result = static_cast<double_t>(mantissa);
+            result = exponent < 0 ? result / EXACT_POWERS[-exponent] : result * EXACT_POWERS[exponent];
+            value = negative ? -result : result;
+            return status;
+        }
+
+        // Otherwise strtod rounds correctly. It gets the digits without a decimal point,
+        // which keeps it independent of the locale: [-]digits e exponent
+        char buffer[128];
+        std::string heap;
+        char * out = buffer;
+        if (digitsEnd - digitsStart + 32 > sizeof(buffer)) {
+            heap.resize(digitsEnd - digitsStart + 32);
+            out = &heap[0];
+        }
+        char * text = out;
+        if (negative) {
+            *out++ = '-';
+        }
+        long fractionDigits = 0;
+        bool fraction = false;
+        for (size_t j = digitsStart; j < digitsEnd; ++j) {
+            if (data[j] == '.') {
+                fraction = true;
+                continue;
+            }
+            *out++ = data[j];
+            fractionDigits += fraction;
+        }
+        std::snprintf(out, 24, "e%ld", explicitExponent - fractionDigits);
+
+        errno = 0;
+        value = std::strtod(text, nullptr);
+        // Subnormal results also set ERANGE, but they are exact enough
+        if (errno == ERANGE && (value == 0.0 || std::isinf(value))) {
+            return JNUMBER_RANGE;
+        }
+        return status;
+    }
+
+    char * FormatInteger(char * out, integer_t value) {
+        uint64_t magnitude = static_cast<uint64_t>(value);
+        if (value < 0) {
+            *out++ = '-';
+            magnitude = 0 - magnitude;
+        }
+        char * end = out + CountDigits(magnitude);
+        WriteDigitsBackward(end, magnitude);
+        return end;
+    }
+
+    char * FormatDouble(char * out, double_t value, EJDoubleFormat format) {
+        if (format == JDOUBLE_FIXED) {
+            // What std::to_string() printed
+            return out + std::snprintf(out, FORMAT_FIXED_MAX, "%f", value);
+        }
+
+        if (std::isnan(value)) {
+            std::memcpy(out, "nan", 3);
+            return out + 3;
+        }
+        if (std::signbit(value)) {
+            *out++ = '-';
+            value = -value;
+        }
+        if (std::isinf(value)) {
+            std::memcpy(out, "inf", 3);
+            return out + 3;
+        }
+        if (value == 0.0) {
+            std::memcpy(out, "0.0", 3);
+            return out + 3;
+        }
+
+        char digits[18];
+        int length;
+        int exponent;
+        Grisu2(value, digits, length, exponent);
+        return FormatDecimal(out, digits, length, exponent);
+    }
+}
@@ -0,0 +1,689 @@
+#include "jvalue_numeric.h"
+#include <cmath>
+#include <limits>
+#include <immintrin.h>
+
+namespace NJValue {
+
+    namespace {
+
+        const double_t INF = std::numeric_limits<double_t>::infinity();
+        const integer_t INTEGER_MIN = std::numeric_limits<integer_t>::min();
+        const integer_t INTEGER_MAX = std::numeric_limits<integer_t>::max();
+
+        // Doubles with no fraction below this convert to integers through the mantissa
+        const double_t EXACT_LIMIT = 2251799813685248.0;           // 2^51
+        const double_t EXACT_MAGIC = 6755399441055744.0;           // 2^52 + 2^51
+
+        inline EJSimdKernel Resolve(EJSimdKernel kernel) {
+            return kernel == JKERNEL_AUTO ? DetectKernel() : kernel;
+        }
+
+        template<class T>
+        inline bool Compare(T value, EJCompare op, T operand) {
+            switch (op) {
+                case JCOMPARE_LESS: return value < operand;
+                case JCOMPARE_LESS_EQUAL: return value <= operand;
+                case JCOMPARE_GREATER: return value > operand;
+                case JCOMPARE_GREATER_EQUAL: return value >= operand;
+                case JCOMPARE_EQUAL: return value == operand;
+                default: return value != operand;
+            }
+        }
+
+        template<class T>
+        size_t CountScalar(const T * data, size_t size, EJCompare op, T operand) {
+            size_t count = 0;
+            for (size_t i = 0; i < size; ++i) {
+                count += Compare(data[i], op, operand) ? 1 : 0;
+            }
+            return count;
+        }
+
+        // Sums
+
+        // Every kernel keeps eight running sums, folded in this order
+        inline double_t FoldSums(const double_t * lanes, const double_t * tail, size_t size) {
+            double_t sum = ((lanes[0] + lanes[4]) + (lanes[2] + lanes[6])) + ((lanes[1] + lanes[5]) + (lanes[3] + lanes[7]));
+            for (size_t i = 0; i < size; ++i) {
+                sum += tail[i];
+            }
+            return sum;
+        }
+
+        double_t SumScalar(const double_t * data, size_t size) {
+            double_t lanes[8] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8) {
+                for (size_t j = 0; j < 8; ++j) {
+                    lanes[j] += data[i + j];
+                }
+            }
+            return FoldSums(lanes, data + i, size - i);
+        }
+
+        __attribute__((target("sse4.2")))
+        double_t SumSse42(const double_t * data, size_t size) {
+            __m128d r0 = _mm_setzero_pd();
+            __m128d r1 = _mm_setzero_pd();
+            __m128d r2 = _mm_setzero_pd();
+            __m128d r3 = _mm_setzero_pd();
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8) {
+                r0 = _mm_add_pd(r0, _mm_loadu_pd(data + i));
+                r1 = _mm_add_pd(r1, _mm_loadu_pd(data + i + 2));
+                r2 = _mm_add_pd(r2, _mm_loadu_pd(data + i + 4));
+                r3 = _mm_add_pd(r3, _mm_loadu_pd(data + i + 6));
+            }
+            double_t lanes[8];
+            _mm_storeu_pd(lanes, r0);
+            _mm_storeu_pd(lanes + 2, r1);
+            _mm_storeu_pd(lanes + 4, r2);
+            _mm_storeu_pd(lanes + 6, r3);
+            return FoldSums(lanes, data + i, size - i);
+        }
+
+        __attribute__((target("avx2")))
+        double_t SumAvx2(const double_t * data, size_t size) {
+            __m256d r0 = _mm256_setzero_pd();
+            __m256d r1 = _mm256_setzero_pd();
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8) {
+                r0 = _mm256_add_pd(r0, _mm256_loadu_pd(data + i));
+                r1 = _mm256_add_pd(r1, _mm256_loadu_pd(data + i + 4));
+            }
+            double_t lanes[8];
+            _mm256_storeu_pd(lanes, r0);
+            _mm256_storeu_pd(lanes + 4, r1);
+            return FoldSums(lanes, data + i, size - i);
+        }
+
+        // Unsigned, so overflow wraps instead of being undefined
+        integer_t SumScalar(const integer_t * data, size_t size) {
+            uint64_t sum = 0;
+            for (size_t i = 0; i < size; ++i) {
+                sum += static_cast<uint64_t>(data[i]);
+            }
+            return static_cast<integer_t>(sum);
+        }
+
+        __attribute__((target("sse4.2")))
+        integer_t SumSse42(const integer_t * data, size_t size) {
+            __m128i r0 = _mm_setzero_si128();
+            __m128i r1 = _mm_setzero_si128();
+            size_t i = 0;
+            for (; i + 4 <= size; i += 4) {
+                r0 = _mm_add_epi64(r0, _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)));
+                r1 = _mm_add_epi64(r1, _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 2)));
+            }
+            uint64_t lanes[2];
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), _mm_add_epi64(r0, r1));
+            return static_cast<integer_t>(lanes[0] + lanes[1] + static_cast<uint64_t>(SumScalar(data + i, size - i)));
+        }
+
+        __attribute__((target("avx2")))
+        integer_t SumAvx2(const integer_t * data, size_t size) {
+            __m256i r0 = _mm256_setzero_si256();
+            __m256i r1 = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8) {
+                r0 = _mm256_add_epi64(r0, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)));
+                r1 = _mm256_add_epi64(r1, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 4)));
+            }
+            uint64_t lanes[4];
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), _mm256_add_epi64(r0, r1));
+            return static_cast<integer_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]
+                + static_cast<uint64_t>(SumScalar(data + i, size - i)));
+        }
+
+        // Minimum and maximum. The doubles ones keep the running value when
+        // comparing with a NaN, as minpd/maxpd do with it as second operand.
+
+        template<bool IS_MAX>
+        integer_t ExtremeScalar(const integer_t * data, size_t size, integer_t extreme) {
+            for (size_t i = 0; i < size; ++i) {
+                if (IS_MAX ? data[i] > extreme : data[i] < extreme) {
+                    extreme = data[i];
+                }
+            }
+            return extreme;
+        }
+
+        template<bool IS_MAX>
+        double_t ExtremeScalar(const double_t * data, size_t size, double_t extreme) {
+            for (size_t i = 0; i < size; ++i) {
+                if (IS_MAX ? data[i] > extreme : data[i] < extreme) {
+                    extreme = data[i];
+                }
+            }
+            return extreme;
+        }
+
+        template<bool IS_MAX>
+        __attribute__((target("sse4.2")))
+        integer_t ExtremeSse42(const integer_t * data, size_t size) {
+            __m128i extreme = _mm_set1_epi64x(IS_MAX ? INTEGER_MIN : INTEGER_MAX);
+            size_t i = 0;
+            for (; i + 2 <= size; i += 2) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                __m128i better = IS_MAX ? _mm_cmpgt_epi64(v, extreme) : _mm_cmpgt_epi64(extreme, v);
+                extreme = _mm_blendv_epi8(extreme, v, better);
+            }
+            integer_t lanes[2];
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), extreme);
+            return ExtremeScalar<IS_MAX>(data + i, size - i, ExtremeScalar<IS_MAX>(lanes + 1, 1, lanes[0]));
+        }
+
+        template<bool IS_MAX>
+        __attribute__((target("avx2")))
+        integer_t ExtremeAvx2(const integer_t * data, size_t size) {
+            __m256i extreme = _mm256_set1_epi64x(IS_MAX ? INTEGER_MIN : INTEGER_MAX);
+            size_t i = 0;
+            for (; i + 4 <= size; i += 4) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                __m256i better = IS_MAX ? _mm256_cmpgt_epi64(v, extreme) : _mm256_cmpgt_epi64(extreme, v);
+                extreme = _mm256_blendv_epi8(extreme, v, better);
+            }
+            integer_t lanes[4];
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), extreme);
+            return ExtremeScalar<IS_MAX>(data + i, size - i, ExtremeScalar<IS_MAX>(lanes + 1, 3, lanes[0]));
+        }
+
+        template<bool IS_MAX>
+        __attribute__((target("sse4.2")))
+        double_t ExtremeSse42(const double_t * data, size_t size) {
+            __m128d extreme = _mm_set1_pd(IS_MAX ? -INF : INF);
+            size_t i = 0;
+            for (; i + 2 <= size; i += 2) {
+                __m128d v = _mm_loadu_pd(data + i);
+                extreme = IS_MAX ? _mm_max_pd(v, extreme) : _mm_min_pd(v, extreme);
+            }
+            double_t lanes[2];
+            _mm_storeu_pd(lanes, extreme);
+            return ExtremeScalar<IS_MAX>(data + i, size - i, ExtremeScalar<IS_MAX>(lanes + 1, 1, lanes[0]));
+        }
+
+        template<bool IS_MAX>
+        __attribute__((target("avx2")))
+        double_t ExtremeAvx2(const double_t * data, size_t size) {
+            __m256d extreme = _mm256_set1_pd(IS_MAX ? -INF : INF);
+            size_t i = 0;
+            for (; i + 4 <= size; i += 4) {
+                __m256d v = _mm256_loadu_pd(data + i);
+                extreme = IS_MAX ? _mm256_max_pd(v, extreme) : _mm256_min_pd(v, extreme);
+            }
+            double_t lanes[4];
+            _mm256_storeu_pd(lanes, extreme);
+            return ExtremeScalar<IS_MAX>(data + i, size - i, ExtremeScalar<IS_MAX>(lanes + 1, 3, lanes[0]));
+        }
+
+        template<bool IS_MAX>
+        integer_t Extreme(TJSpan<integer_t> values, EJSimdKernel kernel) {
+            switch (Resolve(kernel)) {
+                case JKERNEL_AVX2:
+                    return ExtremeAvx2<IS_MAX>(values.data(), values.size());
+                case JKERNEL_SSE42:
+                    return ExtremeSse42<IS_MAX>(values.data(), values.size());
+                default:
+                    return ExtremeScalar<IS_MAX>(values.data(), values.size(), IS_MAX ? INTEGER_MIN : INTEGER_MAX);
+            }
+        }
+
+        template<bool IS_MAX>
+        double_t Extreme(TJSpan<double_t> values, EJSimdKernel kernel) {
+            switch (Resolve(kernel)) {
+                case JKERNEL_AVX2:
+                    return ExtremeAvx2<IS_MAX>(values.data(), values.size());
+                case JKERNEL_SSE42:
+                    return ExtremeSse42<IS_MAX>(values.data(), values.size());
+                default:
+                    return ExtremeScalar<IS_MAX>(values.data(), values.size(), IS_MAX ? -INF : INF);
+            }
+        }
+
+        // Comparisons. Integers only need v > x, x > v and v == x, the other
+        // three are what is left of them.
+
+        enum ECount { COUNT_GREATER, COUNT_LESS, COUNT_EQUAL };
+
+        template<ECount KIND>
+        __attribute__((target("sse4.2")))
+        size_t CountSse42(const integer_t * data, size_t size, integer_t operand) {
+            const __m128i x = _mm_set1_epi64x(operand);
+            size_t count = 0;
+            size_t i = 0;
+            for (; i + 2 <= size; i += 2) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                __m128i hit = KIND == COUNT_GREATER ? _mm_cmpgt_epi64(v, x)
+                    : KIND == COUNT_LESS ? _mm_cmpgt_epi64(x, v)
+                    : _mm_cmpeq_epi64(v, x);
+                count += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(hit)));
+            }
+            EJCompare op = KIND == COUNT_GREATER ? JCOMPARE_GREATER : KIND == COUNT_LESS ? JCOMPARE_LESS : JCOMPARE_EQUAL;
+            return count + CountScalar(data + i, size - i, op, operand);
+        }
+
+        template<ECount KIND>
+        __attribute__((target("avx2")))
+        size_t CountAvx2(const integer_t * data, size_t size, integer_t operand) {
+            const __m256i x = _mm256_set1_epi64x(operand);
+            size_t count = 0;
+            size_t i = 0;
+            for (; i + 4 <= size; i += 4) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                __m256i hit = KIND == COUNT_GREATER ? _mm256_cmpgt_epi64(v, x)
+                    : KIND == COUNT_LESS ? _mm256_cmpgt_epi64(x, v)
+                    : _mm256_cmpeq_epi64(v, x);
+                count += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(hit)));
+            }
+            EJCompare op = KIND == COUNT_GREATER ? JCOMPARE_GREATER : KIND == COUNT_LESS ? JCOMPARE_LESS : JCOMPARE_EQUAL;
+            return count + CountScalar(data + i, size - i, op, operand);
+        }
+
+        template<ECount KIND>
+        size_t Count(TJSpan<integer_t> values, integer_t operand, EJSimdKernel kernel) {
+            switch (kernel) {
+                case JKERNEL_AVX2:
+                    return CountAvx2<KIND>(values.data(), values.size(), operand);
+                default:
+                    return CountSse42<KIND>(values.data(), values.size(), operand);
+            }
+        }
+
+        template<EJCompare OP>
+        inline __m128d CompareSse(__m128d v, __m128d x) {
+            switch (OP) {
+                case JCOMPARE_LESS: return _mm_cmplt_pd(v, x);
+                case JCOMPARE_LESS_EQUAL: return _mm_cmple_pd(v, x);
+                case JCOMPARE_GREATER: return _mm_cmpgt_pd(v, x);
+                case JCOMPARE_GREATER_EQUAL: return _mm_cmpge_pd(v, x);
+                case JCOMPARE_EQUAL: return _mm_cmpeq_pd(v, x);
+                default: return _mm_cmpneq_pd(v, x);
+            }
+        }
+
+        // Ordered predicates, except for not equal, to match the C++ operators on NaN
+        constexpr int Predicate(EJCompare op) {
+            return op == JCOMPARE_LESS ? _CMP_LT_OQ
+                : op == JCOMPARE_LESS_EQUAL ? _CMP_LE_OQ
+                : op == JCOMPARE_GREATER ? _CMP_GT_OQ
+                : op == JCOMPARE_GREATER_EQUAL ? _CMP_GE_OQ
+                : op == JCOMPARE_EQUAL ? _CMP_EQ_OQ
+                : _CMP_NEQ_UQ;
+        }
+
+        template<EJCompare OP>
+        __attribute__((target("sse4.2")))
+        size_t CountSse42(const double_t * data, size_t size, double_t operand) {
+            const __m128d x = _mm_set1_pd(operand);
+            size_t count = 0;
+            size_t i = 0;
+            for (; i + 2 <= size; i += 2) {
+                count += __builtin_popcount(_mm_movemask_pd(CompareSse<OP>(_mm_loadu_pd(data + i), x)));
+            }
+            return count + CountScalar(data + i, size - i, OP, operand);
+        }
+
+        template<EJCompare OP>
+        __attribute__((target("avx2")))
+        size_t CountAvx2(const double_t * data, size_t size, double_t operand) {
+            constexpr int predicate = Predicate(OP);
+            const __m256d x = _mm256_set1_pd(operand);
+            size_t count = 0;
+            size_t i = 0;
+            for (; i + 4 <= size; i += 4) {
+                count += __builtin_popcount(_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(data + i), x, predicate)));
+            }
+            return count + CountScalar(data + i, size - i, OP, operand);
+        }
+
+        template<EJCompare OP>
+        size_t Count(TJSpan<double_t> values, double_t operand, EJSimdKernel kernel) {
+            switch (kernel) {
+                case JKERNEL_AVX2:
+                    return CountAvx2<OP>(values.data(), values.size(), operand);
+                default:
+                    return CountSse42<OP>(values.data(), values.size(), operand);
+            }
+        }
+
+        // Conversions. Integers go through two exact doubles, the top 16 bits
+        // shifted in below 3 * 2^67 and the low 48 bits below 2^52, whose sum is
+        // then rounded once. Doubles take the magic number route when a whole
+        // vector is within EXACT_LIMIT after truncation, the cast otherwise.
+
+        inline void ConvertScalar(const integer_t * data, size_t size, double_t * out) {
+            for (size_t i = 0; i < size; ++i) {
+                out[i] = static_cast<double_t>(data[i]);
+            }
+        }
+
+        inline void ConvertScalar(const double_t * data, size_t size, integer_t * out) {
+            for (size_t i = 0; i < size; ++i) {
+                out[i] = (integer_t)data[i];
+            }
+        }
+
+        __attribute__((target("sse4.2")))
+        void ConvertSse42(const integer_t * data, size_t size, double_t * out) {
+            const __m128d high = _mm_set1_pd(442721857769029238784.0);             // 3 * 2^67
+            const __m128d bias = _mm_set1_pd(442726361368656609280.0);             // 3 * 2^67 + 2^52
+            const __m128i low = _mm_castpd_si128(_mm_set1_pd(4503599627370496.0)); // 2^52
+            size_t i = 0;
+            for (; i + 2 <= size; i += 2) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                __m128i h = _mm_blend_epi16(_mm_srai_epi32(v, 16), _mm_setzero_si128(), 0x33);
+                h = _mm_add_epi64(h, _mm_castpd_si128(high));
+                __m128i l = _mm_blend_epi16(v, low, 0x88);
+                __m128d f = _mm_sub_pd(_mm_castsi128_pd(h), bias);
+                _mm_storeu_pd(out + i, _mm_add_pd(f, _mm_castsi128_pd(l)));
+            }
+            ConvertScalar(data + i, size - i, out + i);
+        }
+
+        __attribute__((target("avx2")))
+        void ConvertAvx2(const integer_t * data, size_t size, double_t * out) {
+            const __m256d high = _mm256_set1_pd(442721857769029238784.0);
+            const __m256d bias = _mm256_set1_pd(442726361368656609280.0);
+            const __m256i low = _mm256_castpd_si256(_mm256_set1_pd(4503599627370496.0));
+            size_t i = 0;
+            for (; i + 4 <= size; i += 4) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                __m256i h = _mm256_blend_epi16(_mm256_srai_epi32(v, 16), _mm256_setzero_si256(), 0x33);
+                h = _mm256_add_epi64(h, _mm256_castpd_si256(high));
+                __m256i l = _mm256_blend_epi16(v, low, 0x88);
+                __m256d f = _mm256_sub_pd(_mm256_castsi256_pd(h), bias);
+                _mm256_storeu_pd(out + i, _mm256_add_pd(f, _mm256_castsi256_pd(l)));
+            }
+            ConvertScalar(data + i, size - i, out + i);
+        }
+
+        __attribute__((target("sse4.2")))
+        void ConvertSse42(const double_t * data, size_t size, integer_t * out) {
+            const __m128d limit = _mm_set1_pd(EXACT_LIMIT);
+            const __m128d magic = _mm_set1_pd(EXACT_MAGIC);
+            const __m128d sign = _mm_set1_pd(-0.0);
+            size_t i = 0;
+            for (; i + 2 <= size; i += 2) {
+                __m128d t = _mm_round_pd(_mm_loadu_pd(data + i), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+                if (_mm_movemask_pd(_mm_cmplt_pd(_mm_andnot_pd(sign, t), limit)) != 0x3) {
+                    ConvertScalar(data + i, 2, out + i);
+                    continue;
+                }
+                __m128i bits = _mm_sub_epi64(_mm_castpd_si128(_mm_add_pd(t, magic)), _mm_castpd_si128(magic));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), bits);
+            }
+            ConvertScalar(data + i, size - i, out + i);
+        }
+
+        __attribute__((target("avx2")))
+        void ConvertAvx2(const double_t * data, size_t size, integer_t * out) {
+            const __m256d limit = _mm256_set1_pd(EXACT_LIMIT);
+            const __m256d magic = _mm256_set1_pd(EXACT_MAGIC);
+            const __m256d sign = _mm256_set1_pd(-0.0);
+            size_t i = 0;
+            for (; i + 4 <= size; i += 4) {
+                __m256d t = _mm256_round_pd(_mm256_loadu_pd(data + i), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+                if (_mm256_movemask_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign, t), limit, _CMP_LT_OQ)) != 0xF) {
+                    ConvertScalar(data + i, 4, out + i);
+                    continue;
+                }
+                __m256i bits = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(t, magic)), _mm256_castpd_si256(magic));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), bits);
+            }
+            ConvertScalar(data + i, size - i, out + i);
+        }
+
+        // Array elements
+
+        inline size_t Elements(const IJSON_VALUE & value) {
+            return value.GetType() == JARRAY ? value.Size() : 0;
+        }
+
+        // Missing elements read as null
+        inline double_t ElementAsDouble(const IJSON_VALUE & value, size_t index) {
+            const IJValue * item = value.At(index);
+            return item == nullptr ? 0.0 : item->AsDouble();
+        }
+
+        // Doubles added one at a time in the order of the double Sum() kernels,
+        // so an array sums to the same value however it is stored
+        class TLaneSum {
+            double_t lanes[8] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+            double_t pending[8];
+            size_t count = 0;
+
+            public:
+            inline void Add(double_t value) {
+                pending[count++] = value;
+                if (count == 8) {
+                    for (size_t j = 0; j < 8; ++j) {
+                        lanes[j] += pending[j];
+                    }
+                    count = 0;
+                }
+            }
+
+            inline double_t Get() const { return FoldSums(lanes, pending, count); }
+        };
+
+        // Integers are summed as doubles, converted a chunk at a time
+        double_t SumAsDoubles(TJSpan<integer_t> values) {
+            const size_t CHUNK = 256;
+            double_t converted[CHUNK];
+            TLaneSum sum;
+            for (size_t i = 0; i < values.size(); i += CHUNK) {
+                size_t size = std::min(CHUNK, values.size() - i);
+                Convert(TJSpan<integer_t>(values.data() + i, size), converted);
+                for (size_t j = 0; j < size; ++j) {
+                    sum.Add(converted[j]);
+                }
+            }
+            return sum.Get();
+        }
+
+        // Integers are compared as the doubles they convert to, so a packed array
+        // counts what its nodes would; converted a chunk at a time
+        size_t CountAsDoubles(TJSpan<integer_t> values, EJCompare op, double_t operand) {
+            const size_t CHUNK = 256;
+            double_t converted[CHUNK];
+            size_t count = 0;
+            for (size_t i = 0; i < values.size(); i += CHUNK) {
+                size_t size = std::min(CHUNK, values.size() - i);
+                Convert(TJSpan<integer_t>(values.data() + i, size), converted);
+                count += CountIf(TJSpan<double_t>(converted, size), op, operand);
+            }
+            return count;
+        }
+    }
+
+    integer_t Sum(TJSpan<integer_t> values, EJSimdKernel kernel) {
+        switch (Resolve(kernel)) {
+            case JKERNEL_AVX2:
+                return SumAvx2(values.data(), values.size());
+            case JKERNEL_SSE42:
+                return SumSse42(values.data(), values.size());
+            default:
+                return SumScalar(values.data(), values.size());
+        }
+    }
+
+    double_t Sum(TJSpan<double_t> values, EJSimdKernel kernel) {
+        switch (Resolve(kernel)) {
+            case JKERNEL_AVX2:
+                return SumAvx2(values.data(), values.size());
+            case JKERNEL_SSE42:
+                return SumSse42(values.data(), values.size());
+            default:
+                return SumScalar(values.data(), values.size());
+        }
+    }
+
+    integer_t Min(TJSpan<integer_t> values, EJSimdKernel kernel) { return Extreme<false>(values, kernel); }
+    double_t Min(TJSpan<double_t> values, EJSimdKernel kernel) { return Extreme<false>(values, kernel); }
+    integer_t Max(TJSpan<integer_t> values, EJSimdKernel kernel) { return Extreme<true>(values, kernel); }
+    double_t Max(TJSpan<double_t> values, EJSimdKernel kernel) { return Extreme<true>(values, kernel); }
+
+    size_t CountIf(TJSpan<integer_t> values, EJCompare op, integer_t operand, EJSimdKernel kernel) {
+        kernel = Resolve(kernel);
+        if (kernel == JKERNEL_SCALAR) {
+            return CountScalar(values.data(), values.size(), op, operand);
+        }
+        switch (op) {
+            case JCOMPARE_LESS:
+                return Count<COUNT_LESS>(values, operand, kernel);
+            case JCOMPARE_LESS_EQUAL:
+                return values.size() - Count<COUNT_GREATER>(values, operand, kernel);
+            case JCOMPARE_GREATER:
+                return Count<COUNT_GREATER>(values, operand, kernel);
+            case JCOMPARE_GREATER_EQUAL:
+                return values.size() - Count<COUNT_LESS>(values, operand, kernel);
+            case JCOMPARE_EQUAL:
+                return Count<COUNT_EQUAL>(values, operand, kernel);
+            default:
+                return values.size() - Count<COUNT_EQUAL>(values, operand, kernel);
+        }
+    }
+
+    size_t CountIf(TJSpan<double_t> values, EJCompare op, double_t operand, EJSimdKernel kernel) {
+        kernel = Resolve(kernel);
+        if (kernel == JKERNEL_SCALAR) {
+            return CountScalar(values.data(), values.size(), op, operand);
+        }
+        switch (op) {
+            case JCOMPARE_LESS:
+                return Count<JCOMPARE_LESS>(values, operand, kernel);
+            case JCOMPARE_LESS_EQUAL:
+                return Count<JCOMPARE_LESS_EQUAL>(values, operand, kernel);
+            case JCOMPARE_GREATER:
+                return Count<JCOMPARE_GREATER>(values, operand, kernel);
+            case JCOMPARE_GREATER_EQUAL:
+                return Count<JCOMPARE_GREATER_EQUAL>(values, operand, kernel);
+            case JCOMPARE_EQUAL:
+                return Count<JCOMPARE_EQUAL>(values, operand, kernel);
+            default:
+                return Count<JCOMPARE_NOT_EQUAL>(values, operand, kernel);
+        }
+    }
+
+    void Convert(TJSpan<integer_t> values, double_t * out, EJSimdKernel kernel) {
+        switch (Resolve(kernel)) {
+            case JKERNEL_AVX2:
+                ConvertAvx2(values.data(), values.size(), out);
+                break;
+            case JKERNEL_SSE42:
+                ConvertSse42(values.data(), values.size(), out);
+                break;
+            default:
+                ConvertScalar(values.data(), values.size(), out);
+                break;
+        }
+    }
+
+    void Convert(TJSpan<double_t> values, integer_t * out, EJSimdKernel kernel) {
+        switch (Resolve(kernel)) {
+            case JKERNEL_AVX2:
+                ConvertAvx2(values.data(), values.size(), out);
+                break;
+            case JKERNEL_SSE42:
+                ConvertSse42(values.data(), values.size(), out);
+                break;
+            default:
+                ConvertScalar(values.data(), values.size(), out);
+                break;
+        }
+    }
+
+    double_t Sum(const IJValue & array) {
+        const IJSON_VALUE & value = array.GetValue();
+        if (value.IsPacked()) {
+            TJSpan<integer_t> integers = value.AsIntegerSpan();
+            return integers.empty() ? Sum(value.AsDoubleSpan()) : SumAsDoubles(integers);
+        }
+        TLaneSum sum;
+        for (size_t i = 0; i < Elements(value); ++i) {
+            sum.Add(ElementAsDouble(value, i));
+        }
+        return sum.Get();
+    }
+
+    // std::min() and std::max() keep their first argument against a NaN
+    double_t Min(const IJValue & array) {
+        const IJSON_VALUE & value = array.GetValue();
+        if (!value.AsIntegerSpan().empty()) {
+            return static_cast<double_t>(Min(value.AsIntegerSpan()));
+        }
+        if (value.IsPacked()) {
+            return Min(value.AsDoubleSpan());
+        }
+        double_t min = INF;
+        for (size_t i = 0; i < Elements(value); ++i) {
+            min = std::min(min, ElementAsDouble(value, i));
+        }
+        return min;
+    }
+
+    double_t Max(const IJValue & array) {
+        const IJSON_VALUE & value = array.GetValue();
+        if (!value.AsIntegerSpan().empty()) {
+            return static_cast<double_t>(Max(value.AsIntegerSpan()));
+        }
+        if (value.IsPacked()) {
+            return Max(value.AsDoubleSpan());
+        }
+        double_t max = -INF;
+        for (size_t i = 0; i < Elements(value); ++i) {
+            max = std::max(max, ElementAsDouble(value, i));
+        }
+        return max;
+    }
+
+    double_t Mean(const IJValue & array) {
+        size_t size = Elements(array.GetValue());
+        return size == 0 ? std::numeric_limits<double_t>::quiet_NaN() : Sum(array) / static_cast<double_t>(size);
+    }
+
+    size_t CountIf(const IJValue & array, EJCompare op, double_t operand) {
+        const IJSON_VALUE & value = array.GetValue();
+        if (value.IsPacked()) {
+            TJSpan<integer_t> integers = value.AsIntegerSpan();
+            return integers.empty() ? CountIf(value.AsDoubleSpan(), op, operand) : CountAsDoubles(integers, op, operand);
+        }
+        size_t count = 0;
+        for (size_t i = 0; i < Elements(value); ++i) {
+            count += Compare(ElementAsDouble(value, i), op, operand) ? 1 : 0;
+        }
+        return count;
+    }
+
+    void ToIntegers(const IJValue & array, std::vector<integer_t> & out) {
+        const IJSON_VALUE & value = array.GetValue();
+        TJSpan<integer_t> integers = value.AsIntegerSpan();
+        out.resize(Elements(value));
+        if (!integers.empty()) {
+            std::copy(integers.begin(), integers.end(), out.begin());
+        } else if (value.IsPacked()) {
+            Convert(value.AsDoubleSpan(), out.data());
+        } else {
+            for (size_t i = 0; i < out.size(); ++i) {
+                const IJValue * item = value.At(i);
+                out[i] = item == nullptr ? 0 : item->AsInteger();
+            }
+        }
+    }
+
+    void ToDoubles(const IJValue & array, std::vector<double_t> & out) {
+        const IJSON_VALUE & value = array.GetValue();
+        TJSpan<double_t> doubles = value.AsDoubleSpan();
+        out.resize(Elements(value));
+        if (!doubles.empty()) {
+            std::copy(doubles.begin(), doubles.end(), out.begin());
+        } else if (value.IsPacked()) {
+            Convert(value.AsIntegerSpan(), out.data());
+        } else {
+            for (size_t i = 0; i < out.size(); ++i) {
+                out[i] = ElementAsDouble(value, i);
+            }
+        }
+    }
+}
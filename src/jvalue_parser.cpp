@@ -0,0 +1,1011 @@
+#include "jvalue_parser.h"
+#include <climits>
+#include <cstdlib>
+#include <immintrin.h>
+
+namespace NJValue {
+
+    namespace {
+
+        // Per 64-byte block character classes, one bit per byte
+        struct TBlockMasks {
+            uint64_t quote;
+            uint64_t backslash;
+            uint64_t op;
+            uint64_t ws;
+        };
+
+        const size_t BLOCK_SIZE = 64;
+
+        void ClassifyScalar(const unsigned char * p, TBlockMasks & m) {
+            m.quote = m.backslash = m.op = m.ws = 0;
+            for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+                uint64_t bit = uint64_t(1) << i;
+                switch (p[i]) {
+                    case '"': m.quote |= bit; break;
+                    case '\\': m.backslash |= bit; break;
+                    case '{': case '}': case '[': case ']': case ':': case ',': m.op |= bit; break;
+                    case ' ': case '\t': case '\n': case '\r': m.ws |= bit; break;
+                    default: break;
+                }
+            }
+        }
+
+        // '[' | 0x20 == '{' and ']' | 0x20 == '}', so four compares cover the six operators
+
+        __attribute__((target("sse4.2")))
+        void ClassifySse42(const unsigned char * p, TBlockMasks & m) {
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i lower = _mm_set1_epi8(0x20);
+            const __m128i openBrace = _mm_set1_epi8('{');
+            const __m128i closeBrace = _mm_set1_epi8('}');
+            const __m128i colon = _mm_set1_epi8(':');
+            const __m128i comma = _mm_set1_epi8(',');
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i tab = _mm_set1_epi8('\t');
+            const __m128i lf = _mm_set1_epi8('\n');
+            const __m128i cr = _mm_set1_epi8('\r');
+
+            m.quote = m.backslash = m.op = m.ws = 0;
+            for (size_t i = 0; i < BLOCK_SIZE; i += 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+                __m128i folded = _mm_or_si128(v, lower);
+                __m128i op = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(folded, openBrace), _mm_cmpeq_epi8(folded, closeBrace)),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+                __m128i ws = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+
+                m.quote |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << i;
+                m.backslash |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)))) << i;
+                m.op |= uint64_t(uint16_t(_mm_movemask_epi8(op))) << i;
+                m.ws |= uint64_t(uint16_t(_mm_movemask_epi8(ws))) << i;
+            }
+        }
+
+        __attribute__((target("avx2")))
+        void ClassifyAvx2(const unsigned char * p, TBlockMasks & m) {
+            const __m256i quote = _mm256_set1_epi8('"');
+            const __m256i backslash = _mm256_set1_epi8('\\');
+            const __m256i lower = _mm256_set1_epi8(0x20);
+            const __m256i openBrace = _mm256_set1_epi8('{');
+            const __m256i closeBrace = _mm256_set1_epi8('}');
+            const __m256i colon = _mm256_set1_epi8(':');
+            const __m256i comma = _mm256_set1_epi8(',');
+            const __m256i space = _mm256_set1_epi8(' ');
+            const __m256i tab = _mm256_set1_epi8('\t');
+            const __m256i lf = _mm256_set1_epi8('\n');
+            const __m256i cr = _mm256_set1_epi8('\r');
+
+            m.quote = m.backslash = m.op = m.ws = 0;
+            for (size_t i = 0; i < BLOCK_SIZE; i += 32) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+                __m256i folded = _mm256_or_si256(v, lower);
+                __m256i op = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(folded, openBrace), _mm256_cmpeq_epi8(folded, closeBrace)),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma)));
+                __m256i ws = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, cr)));
+
+                m.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)))) << i;
+                m.backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)))) << i;
+                m.op |= uint64_t(uint32_t(_mm256_movemask_epi8(op))) << i;
+                m.ws |= uint64_t(uint32_t(_mm256_movemask_epi8(ws))) << i;
+            }
+        }
+
+        inline uint64_t PrefixXor(uint64_t x) {
+            x ^= x << 1;
+            x ^= x << 2;
+            x ^= x << 4;
+            x ^= x << 8;
+            x ^= x << 16;
+            x ^= x << 32;
+            return x;
+        }
+
+        // Bytes preceded by an odd run of backslashes. Backslashes are rare enough
+        // that walking them one by one is cheaper than the branch-free carry trick.
+        inline uint64_t FindEscaped(uint64_t backslash, uint64_t & prevEscaped) {
+            uint64_t escaped = prevEscaped;
+            prevEscaped = 0;
+            while (backslash) {
+                unsigned i = __builtin_ctzll(backslash);
+                backslash &= backslash - 1;
+                if (escaped & (uint64_t(1) << i)) {
+                    continue;
+                }
+                if (i == 63) {
+                    prevEscaped = 1;
+                } else {
+                    escaped |= uint64_t(1) << (i + 1);
+                }
+            }
+            return escaped;
+        }
+
+        typedef void (*TClassifier)(const unsigned char *, TBlockMasks &);
+
+        void FindStructuralsWith(TClassifier classify, const char * data, size_t size, std::vector<uint64_t> & index) {
+            uint64_t prevEscaped = 0;
+            uint64_t prevInString = 0;
+            uint64_t prevScalar = 0;
+            unsigned char tail[BLOCK_SIZE];
+
+            index.clear();
+            index.reserve(size / 8 + BLOCK_SIZE);
+
+            for (size_t base = 0; base < size; base += BLOCK_SIZE) {
+                const unsigned char * block = reinterpret_cast<const unsigned char *>(data + base);
+                if (size - base < BLOCK_SIZE) {
+                    std::memset(tail, ' ', BLOCK_SIZE);
+                    std::memcpy(tail, block, size - base);
+                    block = tail;
+                }
+
+                TBlockMasks m;
+                classify(block, m);
+
+                uint64_t escaped = FindEscaped(m.backslash, prevEscaped);
+                uint64_t quote = m.quote & ~escaped;
+                uint64_t inString = PrefixXor(quote) ^ prevInString;
+                prevInString = uint64_t(int64_t(inString) >> 63);
+
+                uint64_t scalar = ~(m.op | m.ws | quote) & ~inString;
+                uint64_t scalarStart = scalar & ~((scalar << 1) | prevScalar);
+                prevScalar = scalar >> 63;
+
+                uint64_t structurals = (m.op & ~inString) | (quote & inString) | scalarStart;
+
+                size_t count = index.size();
+                index.resize(count + __builtin_popcountll(structurals));
+                uint64_t * out = index.data() + count;
+                while (structurals) {
+                    *out++ = base + __builtin_ctzll(structurals);
+                    structurals &= structurals - 1;
+                }
+            }
+
+            if (prevInString) {
+                throw TJParseError("Unterminated string", size);
+            }
+        }
+
+        inline bool IsWsOrOp(char c) {
+            switch (c) {
+                case ' ': case '\t': case '\n': case '\r':
+                case '{': case '}': case '[': case ']': case ':': case ',':
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        inline void AppendUtf8(string_t & out, uint32_t cp) {
+            char buf[4];
+            out.append(buf, WriteUtf8(buf, cp) - buf);
+        }
+
+        // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+        bool IsValidNumber(const string_t & s, bool & isInteger) {
+            size_t i = 0;
+            size_t n = s.size();
+            isInteger = true;
+            if (i < n && s[i] == '-') ++i;
+            if (i >= n || s[i] < '0' || s[i] > '9') return false;
+            if (s[i] == '0') {
+                ++i;
+            } else {
+                while (i < n && s[i] >= '0' && s[i] <= '9') ++i;
+            }
+            if (i < n && s[i] == '.') {
+                isInteger = false;
+                if (++i >= n || s[i] < '0' || s[i] > '9') return false;
+                while (i < n && s[i] >= '0' && s[i] <= '9') ++i;
+            }
+            if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+                isInteger = false;
+                ++i;
+                if (i < n && (s[i] == '+' || s[i] == '-')) ++i;
+                if (i >= n || s[i] < '0' || s[i] > '9') return false;
+                while (i < n && s[i] >= '0' && s[i] <= '9') ++i;
+            }
+            return i == n;
+        }
+
+        inline bool IsNumberChar(char c) {
+            return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+        }
+
+        class TTreeBuilder {
+            const char * data;
+            size_t size;
+            const std::vector<uint64_t> & index;
+            size_t cur;
+            size_t end;
+            TJDocument & doc;
+            EJParseMode mode;
+            EJUtf8Mode utf8;
+            EJSimdKernel kernel;
+
+            struct TFrame {
+                size_t start;
+                bool isMap;
+            };
+
+            struct TKey {
+                const char * data;
+                size_t size;
+            };
+
+            // Pooled, so parsing into a reused document allocates nothing
+            std::vector<IJValue *, TJAllocator<IJValue *>> elements;
+            std::vector<TKey, TJAllocator<TKey>> keys;
+            std::vector<TFrame, TJAllocator<TFrame>> frames;
+
+            // Finds the end of the string at pos; true if its body has escapes
+            bool ScanString(size_t pos, TKey & body) const {
+                size_t begin = pos + 1;
+                size_t i = begin;
+                bool escaped = false;
+                for (;;) {
+                    if (i < size) {
+                        i += FindEscape(data + i, size - i, kernel);
+                    }
+                    if (i >= size) {
+                        throw TJParseError("Unterminated string", pos);
+                    }
+                    if (data[i] == '"') {
+                        break;
+                    }
+                    if (data[i] != '\\') {
+                        throw TJParseError("Control character in string", i);
+                    }
+                    escaped = true;
+                    i += 2;
+                }
+                body.data = data + begin;
+                body.size = i - begin;
+                // Escapes are ASCII, so checking the raw body checks the decoded one
+                if (utf8 == JUTF8_STRICT) {
+                    size_t bad = FindInvalidUtf8(body.data, body.size, kernel);
+                    if (bad != body.size) {
+                        throw TJParseError("Invalid UTF-8", begin + bad);
+                    }
+                }
+                return escaped;
+            }
+
+            // Unescaping never makes a string longer, so the raw size is enough
+            inline TKey Unescape(const TKey & body) {
+                char * buf = doc.AllocateString(body.size);
+                size_t n = UnescapeString(body.data, body.size, buf, body.data - data);
+                return TKey{ buf, n };
+            }
+
+            IJValue * ParseString(size_t pos) {
+                TKey body;
+                bool escaped = ScanString(pos, body);
+                if (mode == JPARSE_BORROW) {
+                    if (!escaped) {
+                        return doc.NewStringRef(body.data, body.size);
+                    }
+                    UnescapeString(body.data, body.size, nullptr, body.data - data);
+                    return doc.NewLazyString(body.data, body.size);
+                }
+                if (!escaped) {
+                    return doc.NewString(body.data, body.size);
+                }
+                TKey decoded = Unescape(body);
+                return doc.NewStringRef(decoded.data, decoded.size);
+            }
+
+            void ParseKey() {
+                size_t pos = Next("key");
+                if (data[pos] != '"') {
+                    throw TJParseError("Expected key", pos);
+                }
+                TKey key;
+                if (ScanString(pos, key)) {
+                    key = Unescape(key);
+                }
+                keys.push_back(key);
+
+                size_t colon = Next("':'");
+                if (data[colon] != ':') {
+                    throw TJParseError("Expected ':'", colon);
+                }
+            }
+
+            IJValue * CloseMap(size_t start) {
+                size_t count = elements.size() - start;
+                size_t keyStart = keys.size() - count;
+                map_t * map = doc.NewMapStorage(count);
+                for (size_t i = 0; i < count; ++i) {
+                    map->Set(keys[keyStart + i].data, keys[keyStart + i].size, elements[start + i]);
+                }
+                keys.resize(keyStart);
+                return doc.NewMap(map);
+            }
+
+            IJValue * ParseNumber(size_t pos) {
+                size_t i = pos;
+                bool negative = false;
+                bool isInteger = true;
+                integer_t value = 0;
+
+                if (data[i] == '-') {
+                    negative = true;
+                    ++i;
+                }
+                if (i >= size || data[i] < '0' || data[i] > '9') {
+                    throw TJParseError("Invalid number", pos);
+                }
+                if (data[i] == '0') {
+                    ++i;
+                } else {
+                    // Accumulate negatively so LONG_MIN is representable
+                    while (i < size && data[i] >= '0' && data[i] <= '9') {
+                        integer_t digit = data[i] - '0';
+                        if (isInteger && value < (LONG_MIN + digit) / 10) {
+                            isInteger = false;
+                        }
+                        if (isInteger) {
+                            value = value * 10 - digit;
+                        }
+                        ++i;
+                    }
+                }
+                if (i < size && data[i] == '.') {
+                    isInteger = false;
+                    ++i;
+                    if (i >= size || data[i] < '0' || data[i] > '9') {
+                        throw TJParseError("Invalid number", pos);
+                    }
+                    while (i < size && data[i] >= '0' && data[i] <= '9') {
+                        ++i;
+                    }
+                }
+                if (i < size && (data[i] == 'e' || data[i] == 'E')) {
+                    isInteger = false;
+                    ++i;
+                    if (i < size && (data[i] == '+' || data[i] == '-')) {
+                        ++i;
+                    }
+                    if (i >= size || data[i] < '0' || data[i] > '9') {
+                        throw TJParseError("Invalid number", pos);
+                    }
+                    while (i < size && data[i] >= '0' && data[i] <= '9') {
+                        ++i;
+                    }
+                }
+                CheckTokenEnd(i);
+
+                if (isInteger && (negative || value != LONG_MIN)) {
+                    return doc.NewInteger(negative ? value : -value);
+                }
+                double_t number;
+                ParseDouble(data + pos, i - pos, number);
+                return doc.NewDouble(number);
+            }
+
+            inline void CheckLiteral(size_t pos, const char * literal, size_t len) const {
+                if (size - pos < len || std::memcmp(data + pos, literal, len) != 0) {
+                    throw TJParseError("Invalid literal", pos);
+                }
+                CheckTokenEnd(pos + len);
+            }
+
+            inline void CheckTokenEnd(size_t pos) const {
+                if (pos < size && !IsWsOrOp(data[pos])) {
+                    throw TJParseError("Unexpected character", pos);
+                }
+            }
+
+            inline size_t Next(const char * expected) {
+                if (cur >= end) {
+                    throw TJParseError(string_t("Expected ") + expected, size);
+                }
+                return index[cur++];
+            }
+
+            public:
+            TTreeBuilder(const char * data, size_t size, const std::vector<uint64_t> & index, TJDocument & doc, EJParseMode mode,
+                         EJUtf8Mode utf8 = JUTF8_STRICT, EJSimdKernel kernel = JKERNEL_AUTO)
+                : data(data), size(size), index(index), cur(0), end(index.size()), doc(doc), mode(mode)
+                , utf8(utf8), kernel(kernel == JKERNEL_AUTO ? DetectKernel() : kernel)
+            { }
+
+            // Next Build() takes the structurals in [first, last) and no data past limit
+            inline void Restrict(size_t first, size_t last, size_t limit) {
+                cur = first;
+                end = last;
+                size = limit;
+            }
+
+            IJValue * ParseScalar(size_t pos) {
+                switch (data[pos]) {
+                    case '"': return ParseString(pos);
+                    case 't': CheckLiteral(pos, "true", 4); return doc.NewBool(true);
+                    case 'f': CheckLiteral(pos, "false", 5); return doc.NewBool(false);
+                    case 'n': CheckLiteral(pos, "null", 4); return doc.NewNull();
+                    case '[': case ']': case '{': case '}': case ',': case ':':
+                        throw TJParseError("Unexpected character", pos);
+                    default: return ParseNumber(pos);
+                }
+            }
+
+            // Decoded key of the string at pos
+            inline void ReadKey(size_t pos, const char *& key, size_t & keySize) {
+                if (data[pos] != '"') {
+                    throw TJParseError("Expected key", pos);
+                }
+                TKey body;
+                if (ScanString(pos, body)) {
+                    body = Unescape(body);
+                }
+                key = body.data;
+                keySize = body.size;
+            }
+
+            void Build() {
+                IJValue * node = nullptr;
+
+                for (;;) {
+                    size_t pos = Next("value");
+
+                    if (data[pos] == '[') {
+                        if (cur < end && data[index[cur]] == ']') {
+                            ++cur;
+                            node = doc.NewArray(nullptr, 0);
+                        } else {
+                            frames.push_back(TFrame{ elements.size(), false });
+                            continue;
+                        }
+                    } else if (data[pos] == '{') {
+                        if (cur < end && data[index[cur]] == '}') {
+                            ++cur;
+                            node = doc.NewMap(doc.NewMapStorage());
+                        } else {
+                            frames.push_back(TFrame{ elements.size(), true });
+                            ParseKey();
+                            continue;
+                        }
+                    } else if (data[pos] == ']' || data[pos] == ',' || data[pos] == ':' || data[pos] == '}') {
+                        throw TJParseError("Unexpected character", pos);
+                    } else {
+                        node = ParseScalar(pos);
+                    }
+
+                    // Attach the finished value, closing as many containers as the input does
+                    for (;;) {
+                        if (frames.empty()) {
+                            doc.SetRoot(node);
+                            if (cur != end) {
+                                throw TJParseError("Trailing characters", index[cur]);
+                            }
+                            return;
+                        }
+                        elements.push_back(node);
+
+                        TFrame frame = frames.back();
+                        size_t sep = Next("',' or closing bracket");
+                        if (data[sep] == ',') {
+                            if (frame.isMap) {
+                                ParseKey();
+                            }
+                            break;
+                        }
+                        if (data[sep] != (frame.isMap ? '}' : ']')) {
+                            throw TJParseError("Expected ',' or closing bracket", sep);
+                        }
+
+                        frames.pop_back();
+                        node = frame.isMap
+                            ? CloseMap(frame.start)
+                            : doc.NewArray(elements.data() + frame.start, elements.size() - frame.start);
+                        elements.resize(frame.start);
+                    }
+                }
+            }
+        };
+    }
+
+    TJEventReader::TJEventReader(size_t maxDepth, EJUtf8Mode utf8)
+        : data(nullptr), size(0), pos(0), consumed(0), closed(false), maxDepth(maxDepth), utf8(utf8)
+        , state(S_VALUE), isKey(false), escape(0), hexCount(0), hexValue(0), highSurrogate(0)
+        , literal(nullptr), literalSize(0)
+        , valueType(JUNDEFINED), boolValue(false), integerValue(0), doubleValue(0.0)
+    { }
+
+    void TJEventReader::Feed(const char * chunk, size_t chunkSize) {
+        if (closed) {
+            throw TJParseError("Feed after Close", GetOffset());
+        }
+        if (pos != size) {
+            throw TJParseError("Feed before the previous chunk is consumed", GetOffset());
+        }
+        consumed += pos;
+        data = chunk;
+        size = chunkSize;
+        pos = 0;
+    }
+
+    void TJEventReader::Close() {
+        closed = true;
+    }
+
+    void TJEventReader::Fail(const char * message) const {
+        throw TJParseError(message, GetOffset());
+    }
+
+    EJEvent TJEventReader::AfterValue(EJValueType type) {
+        valueType = type;
+        state = stack.empty() ? S_DONE : S_NEXT;
+        return type == JARRAY ? JEVENT_END_ARRAY : type == JMAP ? JEVENT_END_MAP : JEVENT_VALUE;
+    }
+
+    EJEvent TJEventReader::CloseContainer(unsigned char kind) {
+        if (stack.empty() || stack.back() != kind) {
+            Fail("Mismatched bracket");
+        }
+        stack.pop_back();
+        ++pos;
+        return AfterValue(static_cast<EJValueType>(kind));
+    }
+
+    EJEvent TJEventReader::StartValue(char c) {
+        switch (c) {
+            case '[':
+            case '{':
+                if (stack.size() >= maxDepth) {
+                    Fail("Nesting too deep");
+                }
+                stack.push_back(c == '[' ? JARRAY : JMAP);
+                state = c == '[' ? S_ARRAY_FIRST : S_MAP_FIRST;
+                ++pos;
+                return c == '[' ? JEVENT_START_ARRAY : JEVENT_START_MAP;
+            case '"':
+                token.clear();
+                isKey = false;
+                state = S_STRING;
+                ++pos;
+                return JEVENT_NEED_MORE;
+            case 't': literal = "true"; break;
+            case 'f': literal = "false"; break;
+            case 'n': literal = "null"; break;
+            default:
+                if (c == '-' || (c >= '0' && c <= '9')) {
+                    token.clear();
+                    state = S_NUMBER;
+                    return JEVENT_NEED_MORE;
+                }
+                Fail("Unexpected character");
+        }
+        literalSize = 0;
+        state = S_LITERAL;
+        return JEVENT_NEED_MORE;
+    }
+
+    void TJEventReader::FinishEscape(uint32_t cp) {
+        if (highSurrogate) {
+            if (cp < 0xDC00 || cp >= 0xE000) {
+                Fail("Invalid low surrogate");
+            }
+            cp = 0x10000 + ((highSurrogate - 0xD800) << 10) + (cp - 0xDC00);
+            highSurrogate = 0;
+        } else if (cp >= 0xD800 && cp < 0xDC00) {
+            highSurrogate = cp;
+            return;
+        } else if (cp >= 0xDC00 && cp < 0xE000) {
+            Fail("Unpaired surrogate");
+        }
+        AppendUtf8(token, cp);
+    }
+
+    // Consumes string bytes of the current chunk; true once the closing quote is reached
+    bool TJEventReader::ScanString() {
+        while (pos < size) {
+            if (escape == 0) {
+                size_t start = pos;
+                pos += FindEscape(data + pos, size - pos);
+                if (pos != start && highSurrogate) {
+                    Fail("Unpaired surrogate");
+                }
+                token.append(data + start, pos - start);
+                if (pos == size) {
+                    return false;
+                }
+                char c = data[pos++];
+                if (c == '"') {
+                    if (highSurrogate) {
+                        Fail("Unpaired surrogate");
+                    }
+                    // Checked whole, a sequence may be split between chunks
+                    if (utf8 == JUTF8_STRICT && !IsValidUtf8(token.data(), token.size())) {
+                        Fail("Invalid UTF-8");
+                    }
+                    return true;
+                }
+                if (c != '\\') {
+                    Fail("Control character in string");
+                }
+                escape = 1;
+            } else if (escape == 1) {
+                char c = data[pos++];
+                if (highSurrogate && c != 'u') {
+                    Fail("Unpaired surrogate");
+                }
+                escape = 0;
+                switch (c) {
+                    case '"': token += '"'; break;
+                    case '\\': token += '\\'; break;
+                    case '/': token += '/'; break;
+                    case 'b': token += '\b'; break;
+                    case 'f': token += '\f'; break;
+                    case 'n': token += '\n'; break;
+                    case 'r': token += '\r'; break;
+                    case 't': token += '\t'; break;
+                    case 'u':
+                        escape = 2;
+                        hexCount = 0;
+                        hexValue = 0;
+                        break;
+                    default:
+                        Fail("Invalid escape");
+                }
+            } else {
+                int d = HexDigit(data[pos]);
+                if (d < 0) {
+                    Fail("Invalid \\u escape");
+                }
+                ++pos;
+                hexValue = (hexValue << 4) | static_cast<uint32_t>(d);
+                if (++hexCount == 4) {
+                    escape = 0;
+                    FinishEscape(hexValue);
+                }
+            }
+        }
+        return false;
+    }
+
+    EJEvent TJEventReader::FinishNumber() {
+        bool isInteger;
+        if (!IsValidNumber(token, isInteger)) {
+            Fail("Invalid number");
+        }
+        if (isInteger && ParseInteger(token.data(), token.size(), integerValue) == JNUMBER_OK) {
+            return AfterValue(JINTEGER);
+        }
+        ParseDouble(token.data(), token.size(), doubleValue);
+        return AfterValue(JDOUBLE);
+    }
+
+    EJEvent TJEventReader::Next() {
+        for (;;) {
+            if (pos == size) {
+                if (!closed) {
+                    return JEVENT_NEED_MORE;
+                }
+                if (state == S_NUMBER) {
+                    return FinishNumber();
+                }
+                if (state != S_DONE) {
+                    Fail("Unexpected end of input");
+                }
+                return JEVENT_END;
+            }
+
+            char c = data[pos];
+            switch (state) {
+                case S_STRING:
+                    if (ScanString()) {
+                        if (isKey) {
+                            state = S_COLON;
+                            return JEVENT_KEY;
+                        }
+                        return AfterValue(JSTRING);
+                    }
+                    continue;
+
+                case S_NUMBER:
+                    if (IsNumberChar(c)) {
+                        size_t start = pos;
+                        while (pos < size && IsNumberChar(data[pos])) {
+                            ++pos;
+                        }
+                        token.append(data + start, pos - start);
+                        continue;
+                    }
+                    return FinishNumber();
+
+                case S_LITERAL:
+                    if (c != literal[literalSize]) {
+                        Fail("Invalid literal");
+                    }
+                    ++pos;
+                    if (literal[++literalSize] == '\0') {
+                        if (literal[0] == 'n') {
+                            return AfterValue(JNULL);
+                        }
+                        boolValue = literal[0] == 't';
+                        return AfterValue(JBOOL);
+                    }
+                    continue;
+
+                default:
+                    break;
+            }
+
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                ++pos;
+                continue;
+            }
+
+            EJEvent event = JEVENT_NEED_MORE;
+            switch (state) {
+                case S_ARRAY_FIRST:
+                    if (c == ']') {
+                        return CloseContainer(JARRAY);
+                    }
+                    event = StartValue(c);
+                    break;
+                case S_VALUE:
+                    event = StartValue(c);
+                    break;
+                case S_MAP_FIRST:
+                    if (c == '}') {
+                        return CloseContainer(JMAP);
+                    }
+                    // fallthrough
+                case S_KEY:
+                    if (c != '"') {
+                        Fail("Expected key");
+                    }
+                    token.clear();
+                    isKey = true;
+                    state = S_STRING;
+                    ++pos;
+                    break;
+                case S_COLON:
+                    if (c != ':') {
+                        Fail("Expected ':'");
+                    }
+                    state = S_VALUE;
+                    ++pos;
+                    break;
+                case S_NEXT:
+                    if (c == ',') {
+                        state = stack.back() == JARRAY ? S_VALUE : S_KEY;
+                        ++pos;
+                    } else if (c == ']') {
+                        return CloseContainer(JARRAY);
+                    } else if (c == '}') {
+                        return CloseContainer(JMAP);
+                    } else {
+                        Fail("Expected ',' or closing bracket");
+                    }
+                    break;
+                default:
+                    Fail("Trailing characters");
+            }
+            if (event != JEVENT_NEED_MORE) {
+                return event;
+            }
+        }
+    }
+
+    void TJEventParser::Drain() {
+        for (;;) {
+            switch (reader.Next()) {
+                case JEVENT_NEED_MORE:
+                case JEVENT_END:
+                    return;
+                case JEVENT_START_ARRAY: handler.OnStartArray(); break;
+                case JEVENT_END_ARRAY: handler.OnEndArray(); break;
+                case JEVENT_START_MAP: handler.OnStartMap(); break;
+                case JEVENT_END_MAP: handler.OnEndMap(); break;
+                case JEVENT_KEY: handler.OnKey(reader.GetString()); break;
+                case JEVENT_VALUE:
+                    switch (reader.GetValueType()) {
+                        case JNULL: handler.OnNull(); break;
+                        case JBOOL: handler.OnBool(reader.GetBool()); break;
+                        case JINTEGER: handler.OnInteger(reader.GetInteger()); break;
+                        case JDOUBLE: handler.OnDouble(reader.GetDouble()); break;
+                        case JSTRING: handler.OnString(reader.GetString()); break;
+                        default: break;
+                    }
+                    break;
+            }
+        }
+    }
+
+    TJLazyIndex::TJLazyIndex(TJMappedFile && mapped, const char * buffer, size_t bufferSize, EJSimdKernel kernel, EJUtf8Mode utf8)
+        : file(std::move(mapped)), data(buffer), size(bufferSize), root(nullptr)
+        , kernel(kernel == JKERNEL_AUTO ? DetectKernel() : kernel), utf8(utf8)
+    {
+        if (file.Data() != nullptr) {
+            data = file.Data();
+            size = file.Size();
+        }
+        FindStructurals(data, size, index, this->kernel);
+        if (index.empty()) {
+            throw TJParseError("Expected value", size);
+        }
+        MatchBrackets();
+        if (After(0) != index.size()) {
+            throw TJParseError("Trailing characters", index[After(0)]);
+        }
+        root = MakeNode(0);
+    }
+
+    void TJLazyIndex::MatchBrackets() {
+        ends.assign(index.size(), 0);
+        std::vector<size_t> open;
+        for (size_t i = 0; i < index.size(); ++i) {
+            char c = data[index[i]];
+            if (c == '[' || c == '{') {
+                open.push_back(i);
+            } else if (c == ']' || c == '}') {
+                if (open.empty() || data[index[open.back()]] != (c == ']' ? '[' : '{')) {
+                    throw TJParseError("Mismatched bracket", index[i]);
+                }
+                if (i - open.back() > UINT32_MAX) {
+                    throw std::length_error("Container is too large for the lazy index");
+                }
+                ends[open.back()] = static_cast<uint32_t>(i - open.back());
+                open.pop_back();
+            }
+        }
+        if (!open.empty()) {
+            throw TJParseError("Unterminated container", index[open.back()]);
+        }
+    }
+
+    IJValue * TJLazyIndex::MakeNode(size_t i) {
+        char c = data[index[i]];
+        if (c == '[' || c == '{') {
+            TJLazyContainer * lazy = doc.GetArena().New<TJLazyContainer>();
+            lazy->index = this;
+            lazy->start = i;
+            lazy->expanded = false;
+            lazy->items = nullptr;
+            lazy->size = 0;
+            lazy->map = nullptr;
+            return doc.NewLazyContainer(lazy, c == '{');
+        }
+        return TTreeBuilder(data, size, index, doc, JPARSE_BORROW, utf8, kernel).ParseScalar(index[i]);
+    }
+
+    void TJLazyIndex::Expand(const TJLazyContainer & container) {
+        bool isMap = data[index[container.start]] == '{';
+        size_t close = container.start + ends[container.start];
+        TTreeBuilder builder(data, size, index, doc, JPARSE_BORROW, utf8, kernel);
+
+        std::vector<IJValue *> nodes;
+        map_t * map = isMap ? doc.NewMapStorage() : nullptr;
+        for (size_t i = container.start + 1; i < close; ) {
+            const char * key = nullptr;
+            size_t keySize = 0;
+            if (isMap) {
+                builder.ReadKey(index[i], key, keySize);
+                if (++i == close || data[index[i]] != ':') {
+                    throw TJParseError("Expected ':'", index[i]);
+                }
+                ++i;
+            }
+            if (i == close) {
+                throw TJParseError("Expected value", index[i]);
+            }
+            IJValue * node = MakeNode(i);
+            if (isMap) {
+                map->Set(key, keySize, node);
+            } else {
+                nodes.push_back(node);
+            }
+
+            i = After(i);
+            if (i != close) {
+                if (data[index[i]] != ',') {
+                    throw TJParseError("Expected ',' or closing bracket", index[i]);
+                }
+                if (++i == close) {
+                    throw TJParseError("Expected value", index[i]);
+                }
+            }
+        }
+
+        if (!nodes.empty()) {
+            container.items = doc.GetArena().NewArray<IJValue *>(nodes.size());
+            std::copy(nodes.begin(), nodes.end(), container.items);
+        }
+        container.size = isMap ? map->Size() : nodes.size();
+        container.map = map;
+        container.expanded = true;
+    }
+
+    void TJLazyContainer::Expand() const {
+        index->Expand(*this);
+    }
+
+    void FindStructurals(const char * data, size_t size, std::vector<uint64_t> & index, EJSimdKernel kernel) {
+        if (kernel == JKERNEL_AUTO) {
+            kernel = DetectKernel();
+        }
+        switch (kernel) {
+            case JKERNEL_AVX2:
+                FindStructuralsWith(ClassifyAvx2, data, size, index);
+                break;
+            case JKERNEL_SSE42:
+                FindStructuralsWith(ClassifySse42, data, size, index);
+                break;
+            default:
+                FindStructuralsWith(ClassifyScalar, data, size, index);
+                break;
+        }
+    }
+
+    void Parse(const char * data, size_t size, TJDocument & doc, EJParseMode mode, EJSimdKernel kernel, EJUtf8Mode utf8) {
+        std::vector<uint64_t> & index = doc.GetScratch();
+        FindStructurals(data, size, index, kernel);
+
+        doc.Reset();
+        TTreeBuilder(data, size, index, doc, mode, utf8, kernel).Build();
+    }
+
+    namespace {
+        void BuildLines(const char * data, size_t size, const std::vector<uint64_t> & index, TJDocument & doc,
+                        std::vector<const IJValue *> & roots, EJParseMode mode, EJUtf8Mode utf8, EJSimdKernel kernel) {
+            TTreeBuilder builder(data, size, index, doc, mode, utf8, kernel);
+            size_t cur = 0;
+            for (size_t lineStart = 0; lineStart < size; ) {
+                const char * newline = static_cast<const char *>(std::memchr(data + lineStart, '\n', size - lineStart));
+                size_t lineEnd = newline == nullptr ? size : newline - data;
+                size_t last = cur;
+                while (last < index.size() && index[last] < lineEnd) {
+                    ++last;
+                }
+                if (last != cur) {
+                    builder.Restrict(cur, last, lineEnd);
+                    builder.Build();
+                    roots.push_back(&doc.Root());
+                }
+                cur = last;
+                lineStart = lineEnd + 1;
+            }
+        }
+    }
+
+    void ParseLines(const char * data, size_t size, TJDocument & doc, std::vector<const IJValue *> & roots, EJParseMode mode, EJSimdKernel kernel, EJUtf8Mode utf8) {
+        std::vector<uint64_t> & index = doc.GetScratch();
+        try {
+            FindStructurals(data, size, index, kernel);
+        } catch (const TJParseError &) {
+            // A stray quote throws the index off past its line, so go line by line
+            // to report the line it is on
+            for (size_t lineStart = 0; lineStart < size; ) {
+                const char * newline = static_cast<const char *>(std::memchr(data + lineStart, '\n', size - lineStart));
+                size_t lineEnd = newline == nullptr ? size : newline - data;
+                try {
+                    FindStructurals(data + lineStart, lineEnd - lineStart, index, kernel);
+                    BuildLines(data + lineStart, lineEnd - lineStart, index, doc, roots, mode, utf8, kernel);
+                } catch (const TJParseError & e) {
+                    throw TJParseError(e.GetMessage(), e.GetOffset() + lineStart);
+                }
+                lineStart = lineEnd + 1;
+            }
+            return;
+        }
+        BuildLines(data, size, index, doc, roots, mode, utf8, kernel);
+    }
+
+    TJDocument Parse(const char * data, size_t size, EJSimdKernel kernel) {
+        TJDocument doc;
+        Parse(data, size, doc, JPARSE_COPY, kernel);
+        return doc;
+    }
+}
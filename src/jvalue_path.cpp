@@ -0,0 +1,192 @@
+#include "jvalue_path.h"
+#include <algorithm>
+#include <climits>
+
+namespace NJValue {
+
+    namespace {
+
+        inline bool IsDigits(const char * data, size_t size) {
+            for (size_t i = 0; i < size; ++i) {
+                if (data[i] < '0' || data[i] > '9') {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Array index as RFC 6901 has it: no sign, no leading zeros
+        inline bool IsIndex(const string_t & segment) {
+            return !segment.empty() && IsDigits(segment.data(), segment.size())
+                && (segment.size() == 1 || segment[0] != '0');
+        }
+
+        inline bool IsSliceBound(const char * data, size_t size) {
+            if (size != 0 && data[0] == '-') {
+                ++data;
+                --size;
+                return size != 0 && IsDigits(data, size);
+            }
+            return IsDigits(data, size);
+        }
+
+        // Bound of an optional slice part; out of range numbers saturate
+        inline long SliceBound(const char * data, size_t size) {
+            integer_t value = 0;
+            if (ParseInteger(data, size, value) == JNUMBER_RANGE) {
+                value = data[0] == '-' ? LONG_MIN : LONG_MAX;
+            }
+            return value;
+        }
+
+        inline size_t ClampBound(long bound, size_t size) {
+            if (bound < 0) {
+                return static_cast<size_t>(-(bound + 1)) >= size ? 0 : size - static_cast<size_t>(-(bound + 1)) - 1;
+            }
+            return std::min(static_cast<size_t>(bound), size);
+        }
+    }
+
+    TJPath::TJPath(const string_t & expression)
+        : expression(expression), singular(true)
+    {
+        if (expression.empty()) {
+            return;
+        }
+        if (expression[0] != '/') {
+            throw TJParseError("Expected '/'", 0);
+        }
+
+        size_t pos = 1;
+        for (;;) {
+            size_t end = std::min(expression.find('/', pos), expression.size());
+            string_t raw = expression.substr(pos, end - pos);
+
+            TStep step;
+            step.index = 0;
+            step.end = 0;
+            step.hasStart = false;
+            step.hasEnd = false;
+            for (size_t i = 0; i < raw.size(); ++i) {
+                if (raw[i] != '~') {
+                    step.key += raw[i];
+                } else if (i + 1 < raw.size() && (raw[i + 1] == '0' || raw[i + 1] == '1')) {
+                    step.key += raw[++i] == '0' ? '~' : '/';
+                } else {
+                    throw TJParseError("Invalid escape", pos + i);
+                }
+            }
+            step.hash = TJMap::Hash(step.key.data(), step.key.size());
+
+            size_t colon = raw.find(':');
+            if (raw == "*") {
+                step.kind = STEP_WILDCARD;
+            } else if (IsIndex(raw)) {
+                step.kind = STEP_INDEX;
+                step.index = SliceBound(raw.data(), raw.size());
+            } else if (colon != string_t::npos && raw.find(':', colon + 1) == string_t::npos
+                       && IsSliceBound(raw.data(), colon) && IsSliceBound(raw.data() + colon + 1, raw.size() - colon - 1)) {
+                step.kind = STEP_SLICE;
+                step.hasStart = colon != 0;
+                step.hasEnd = colon + 1 != raw.size();
+                step.index = step.hasStart ? SliceBound(raw.data(), colon) : 0;
+                step.end = step.hasEnd ? SliceBound(raw.data() + colon + 1, raw.size() - colon - 1) : 0;
+            } else {
+                step.kind = STEP_KEY;
+            }
+            singular = singular && (step.kind == STEP_KEY || step.kind == STEP_INDEX);
+            steps.push_back(step);
+
+            if (end == expression.size()) {
+                break;
+            }
+            pos = end + 1;
+        }
+    }
+
+    void TJPath::Walk(const IJValue & node, size_t depth, std::vector<const IJValue *> & out, bool first) const {
+        if (depth == steps.size()) {
+            out.push_back(&node);
+            return;
+        }
+
+        const TStep & step = steps[depth];
+        const IJSON_VALUE & value = node.GetValue();
+        if (value.GetType() == JMAP) {
+            const map_t * map = value.GetMap();
+            if (map == nullptr) {
+                return;
+            }
+            if (step.kind == STEP_WILDCARD) {
+                for (const map_t::TEntry & entry : *map) {
+                    if (entry.value != nullptr) {
+                        Walk(*entry.value, depth + 1, out, first);
+                        if (first && !out.empty()) {
+                            return;
+                        }
+                    }
+                }
+            } else {
+                const IJValue * child = map->Find(step.key.data(), step.key.size(), step.hash);
+                if (child != nullptr) {
+                    Walk(*child, depth + 1, out, first);
+                }
+            }
+            return;
+        }
+
+        if (value.GetType() != JARRAY || step.kind == STEP_KEY) {
+            return;
+        }
+        size_t size = value.Size();
+        size_t begin = 0;
+        size_t end = size;
+        if (step.kind == STEP_INDEX) {
+            if (static_cast<size_t>(step.index) >= size) {
+                return;
+            }
+            begin = step.index;
+            end = begin + 1;
+        } else if (step.kind == STEP_SLICE) {
+            begin = step.hasStart ? ClampBound(step.index, size) : 0;
+            end = step.hasEnd ? ClampBound(step.end, size) : size;
+        }
+        for (size_t i = begin; i < end; ++i) {
+            const IJValue * child = value.At(i);
+            if (child != nullptr) {
+                Walk(*child, depth + 1, out, first);
+                if (first && !out.empty()) {
+                    return;
+                }
+            }
+        }
+    }
+
+    void TJPath::Select(const IJValue & root, std::vector<const IJValue *> & out) const {
+        Walk(root, 0, out, false);
+    }
+
+    const IJValue * TJPath::SelectFirst(const IJValue & root) const {
+        if (singular) {
+            // One candidate per level, no need to branch
+            const IJValue * node = &root;
+            for (size_t depth = 0; depth < steps.size() && node != nullptr; ++depth) {
+                const TStep & step = steps[depth];
+                const IJSON_VALUE & value = node->GetValue();
+                if (value.GetType() == JMAP) {
+                    const map_t * map = value.GetMap();
+                    node = map == nullptr ? nullptr : map->Find(step.key.data(), step.key.size(), step.hash);
+                } else if (value.GetType() == JARRAY && step.kind == STEP_INDEX && static_cast<size_t>(step.index) < value.Size()) {
+                    node = value.At(step.index);
+                } else {
+                    node = nullptr;
+                }
+            }
+            return node;
+        }
+
+        std::vector<const IJValue *> out;
+        Walk(root, 0, out, true);
+        return out.empty() ? nullptr : out.front();
+    }
+}
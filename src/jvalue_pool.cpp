@@ -0,0 +1,126 @@
+#include "jvalue_pool.h"
+#include <new>
+
+namespace NJValue {
+
+    const size_t TJPool::MAX_SIZE;
+    const size_t TJPool::MAX_CACHED;
+
+    namespace {
+        const size_t SMALL_MAX = 256;
+        const size_t SMALL_CLASSES = SMALL_MAX / 16;
+        const size_t CLASSES = SMALL_CLASSES + 12;     // 512 .. 1M
+        static_assert(TJPool::MAX_SIZE == size_t(SMALL_MAX) << (CLASSES - SMALL_CLASSES), "one class per power of two");
+
+        struct TFreeBlock {
+            TFreeBlock * next;
+        };
+
+        // Plain data, so it stays usable after the thread's destructors ran:
+        // blocks freed that late go straight to the heap
+        struct TCache {
+            TFreeBlock * heads[CLASSES];
+            size_t bytes[CLASSES];
+            TJPoolStats stats;
+            bool registered;
+            bool closed;
+        };
+
+        thread_local TCache Cache;
+
+        // Empties the cache when the thread exits; set up on the first heap allocation
+        // or the first block cached, whichever comes first
+        struct TReaper {
+            bool active = false;
+
+            ~TReaper() {
+                TJPool::Trim();
+                Cache.closed = true;
+            }
+        };
+
+        thread_local TReaper Reaper;
+
+        inline void Register(TCache & cache) {
+            if (!cache.registered && !cache.closed) {
+                Reaper.active = true;
+                cache.registered = true;
+            }
+        }
+
+        inline size_t ClassOf(size_t size) {
+            if (size <= SMALL_MAX) {
+                return size == 0 ? 0 : (size - 1) >> 4;
+            }
+            return SMALL_CLASSES + (64 - __builtin_clzll(size - 1)) - 9;
+        }
+
+        inline size_t ClassSize(size_t cls) {
+            return cls < SMALL_CLASSES ? (cls + 1) << 4 : SMALL_MAX << (cls - SMALL_CLASSES + 1);
+        }
+    }
+
+    void * TJPool::Allocate(size_t size) {
+        TCache & cache = Cache;
+        if (size > MAX_SIZE) {
+            ++cache.stats.misses;
+            return ::operator new(size);
+        }
+        size_t cls = ClassOf(size);
+        TFreeBlock * block = cache.heads[cls];
+        if (block != nullptr) {
+            cache.heads[cls] = block->next;
+            cache.bytes[cls] -= ClassSize(cls);
+            cache.stats.cachedBytes -= ClassSize(cls);
+            ++cache.stats.hits;
+            return block;
+        }
+        Register(cache);
+        ++cache.stats.misses;
+        return ::operator new(ClassSize(cls));
+    }
+
+    void TJPool::Deallocate(void * p, size_t size) noexcept {
+        if (p == nullptr) {
+            return;
+        }
+        TCache & cache = Cache;
+        size_t cls = size > MAX_SIZE ? CLASSES : ClassOf(size);
+        if (cls == CLASSES || cache.closed || cache.bytes[cls] + ClassSize(cls) > MAX_CACHED) {
+            ++cache.stats.released;
+            ::operator delete(p);
+            return;
+        }
+        // A thread that only frees, such as a consumer of documents built
+        // elsewhere, empties its cache on exit too
+        Register(cache);
+        TFreeBlock * block = static_cast<TFreeBlock *>(p);
+        block->next = cache.heads[cls];
+        cache.heads[cls] = block;
+        cache.bytes[cls] += ClassSize(cls);
+        cache.stats.cachedBytes += ClassSize(cls);
+    }
+
+    void TJPool::Trim() noexcept {
+        TCache & cache = Cache;
+        for (size_t cls = 0; cls < CLASSES; ++cls) {
+            while (cache.heads[cls] != nullptr) {
+                TFreeBlock * block = cache.heads[cls];
+                cache.heads[cls] = block->next;
+                ::operator delete(block);
+            }
+            cache.bytes[cls] = 0;
+        }
+        cache.stats.cachedBytes = 0;
+    }
+
+    TJPoolStats TJPool::GetStats() {
+        return Cache.stats;
+    }
+
+    void TJPool::ResetStats() {
+        size_t cachedBytes = Cache.stats.cachedBytes;
+        Cache.stats = TJPoolStats();
+        Cache.stats.cachedBytes = cachedBytes;
+    }
+}
@@ -0,0 +1,81 @@
+#include "jvalue_thread_pool.h"
+#include <algorithm>
+
+namespace NJValue {
+
+    TJThreadPool::TJThreadPool(size_t threads)
+        : queued(0), nextQueue(0), stopping(false)
+    {
+        if (threads == 0) {
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        for (size_t i = 0; i < threads; ++i) {
+            queues.emplace_back(new TQueue());
+        }
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back(&TJThreadPool::Run, this, i);
+        }
+    }
+
+    TJThreadPool::~TJThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread & worker : workers) {
+            worker.join();
+        }
+    }
+
+    void TJThreadPool::Submit(std::function<void()> task) {
+        {
+            // Counted first so it never drops below zero, and under the lock so a
+            // worker about to sleep cannot miss the wake-up
+            std::lock_guard<std::mutex> guard(lock);
+            queued.fetch_add(1, std::memory_order_relaxed);
+        }
+        TQueue & queue = *queues[nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size()];
+        {
+            std::lock_guard<std::mutex> guard(queue.lock);
+            queue.tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    bool TJThreadPool::Take(size_t self, std::function<void()> & task) {
+        for (size_t i = 0; i < queues.size(); ++i) {
+            TQueue & queue = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            if (queue.tasks.empty()) {
+                continue;
+            }
+            if (i == 0) {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            } else {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void TJThreadPool::Run(size_t self) {
+        std::function<void()> task;
+        for (;;) {
+            if (Take(self, task)) {
+                task();
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this]() { return stopping || queued.load(std::memory_order_relaxed) != 0; });
+            if (stopping && queued.load(std::memory_order_relaxed) == 0) {
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,338 @@
+#include "jvalue.h"
+#include <immintrin.h>
+
+namespace NJValue {
+
+    namespace {
+
+        inline EJSimdKernel Resolve(EJSimdKernel kernel) {
+            return kernel == JKERNEL_AUTO ? DetectKernel() : kernel;
+        }
+
+        using NPrivate::SHORT_RUN;
+
+        // Escapes
+
+        inline bool NeedsEscape(unsigned char c) {
+            return c < 0x20 || c == '"' || c == '\\';
+        }
+
+        size_t FindEscapeScalar(const unsigned char * data, size_t i, size_t size) {
+            while (i < size && !NeedsEscape(data[i])) {
+                ++i;
+            }
+            return i;
+        }
+
+        // A byte is a control character when min(v, 0x1F) == v
+        __attribute__((target("sse4.2")))
+        size_t FindEscapeSse42(const unsigned char * data, size_t size) {
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i control = _mm_set1_epi8(0x1F);
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                __m128i hit = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                    _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+                int mask = _mm_movemask_epi8(hit);
+                if (mask != 0) {
+                    return i + __builtin_ctz(mask);
+                }
+            }
+            return FindEscapeScalar(data, i, size);
+        }
+
+        __attribute__((target("avx2")))
+        size_t FindEscapeAvx2(const unsigned char * data, size_t size) {
+            const __m256i quote = _mm256_set1_epi8('"');
+            const __m256i backslash = _mm256_set1_epi8('\\');
+            const __m256i control = _mm256_set1_epi8(0x1F);
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                __m256i hit = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+                    _mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v));
+                uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+                if (mask != 0) {
+                    return i + __builtin_ctz(mask);
+                }
+            }
+            // The tail in 16 bytes with the same encoding: no switch to legacy SSE code
+            if (i + 16 <= size) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                __m128i hit = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, _mm256_castsi256_si128(quote)), _mm_cmpeq_epi8(v, _mm256_castsi256_si128(backslash))),
+                    _mm_cmpeq_epi8(_mm_min_epu8(v, _mm256_castsi256_si128(control)), v));
+                int mask = _mm_movemask_epi8(hit);
+                if (mask != 0) {
+                    return i + __builtin_ctz(mask);
+                }
+                i += 16;
+            }
+            return FindEscapeScalar(data, i, size);
+        }
+
+        // UTF-8
+
+        // Well-formed sequences per RFC 3629, table 3-7 of the Unicode standard
+        size_t FindInvalidScalar(const unsigned char * data, size_t i, size_t size) {
+            while (i < size) {
+                if (i + 8 <= size) {
+                    uint64_t word;
+                    std::memcpy(&word, data + i, sizeof(word));
+                    if ((word & 0x8080808080808080ULL) == 0) {
+                        i += 8;
+                        continue;
+                    }
+                }
+                unsigned char c = data[i];
+                if (c < 0x80) {
+                    ++i;
+                    continue;
+                }
+                size_t length;
+                unsigned char low = 0x80;
+                unsigned char high = 0xBF;
+                if (c >= 0xC2 && c <= 0xDF) {
+                    length = 2;
+                } else if (c >= 0xE0 && c <= 0xEF) {
+                    length = 3;
+                    low = c == 0xE0 ? 0xA0 : 0x80;      // overlong
+                    high = c == 0xED ? 0x9F : 0xBF;     // surrogates
+                } else if (c >= 0xF0 && c <= 0xF4) {
+                    length = 4;
+                    low = c == 0xF0 ? 0x90 : 0x80;      // overlong
+                    high = c == 0xF4 ? 0x8F : 0xBF;     // above U+10FFFF
+                } else {
+                    return i;
+                }
+                if (length > size - i || data[i + 1] < low || data[i + 1] > high) {
+                    return i;
+                }
+                for (size_t k = 2; k < length; ++k) {
+                    if ((data[i + k] & 0xC0) != 0x80) {
+                        return i;
+                    }
+                }
+                i += length;
+            }
+            return size;
+        }
+
+        // Where the scalar check picks up from the vector one at pos, whose
+        // bytes before are well-formed: the lead byte of a sequence pos may be
+        // in the middle of, pos otherwise
+        inline size_t SequenceStart(const unsigned char * data, size_t pos) {
+            for (size_t back = 1; back <= 3 && back <= pos; ++back) {
+                unsigned char c = data[pos - back];
+                if (c >= 0xC0) {
+                    return pos - back;
+                }
+                if (c < 0x80) {
+                    break;
+                }
+            }
+            return pos;
+        }
+
+        // Vector check after Keiser and Lemire, "Validating UTF-8 in less than
+        // one instruction per byte". Each byte is classified by the high nibble
+        // of the byte before it, the low nibble of that one and its own high
+        // nibble through three 16-entry tables; the bits the three agree on are
+        // the errors a two-byte window can show. Third and fourth bytes of longer
+        // sequences are checked against the bytes two and three back.
+        const uint8_t TOO_SHORT = 1 << 0;       // lead byte not followed by a continuation
+        const uint8_t TOO_LONG = 1 << 1;        // continuation after an ASCII byte
+        const uint8_t OVERLONG_3 = 1 << 2;
+        const uint8_t TOO_LARGE = 1 << 3;
+        const uint8_t SURROGATE = 1 << 4;
+        const uint8_t OVERLONG_2 = 1 << 5;
+        const uint8_t TOO_LARGE_1000 = 1 << 6;
+        const uint8_t OVERLONG_4 = 1 << 6;
+        const uint8_t TWO_CONTS = 1 << 7;       // continuation after a continuation
+        const uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+#define JVALUE_UTF8_BYTE_1_HIGH \
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, \
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS, \
+        TOO_SHORT | OVERLONG_2, \
+        TOO_SHORT, \
+        TOO_SHORT | OVERLONG_3 | SURROGATE, \
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+
+#define JVALUE_UTF8_BYTE_1_LOW \
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, \
+        CARRY | OVERLONG_2, \
+        CARRY, \
+        CARRY, \
+        CARRY | TOO_LARGE, \
+        CARRY | TOO_LARGE | TOO_LARGE_1000, \
+        CARRY | TOO_LARGE | TOO_LARGE_1000, \
+        CARRY | TOO_LARGE | TOO_LARGE_1000, \
+        CARRY | TOO_LARGE | TOO_LARGE_1000, \
+        CARRY | TOO_LARGE | TOO_LARGE_1000, \
+        CARRY | TOO_LARGE | TOO_LARGE_1000, \
+        CARRY | TOO_LARGE | TOO_LARGE_1000, \
+        CARRY | TOO_LARGE | TOO_LARGE_1000, \
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE, \
+        CARRY | TOO_LARGE | TOO_LARGE_1000, \
+        CARRY | TOO_LARGE | TOO_LARGE_1000
+
+#define JVALUE_UTF8_BYTE_2_HIGH \
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, \
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4, \
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE, \
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE, \
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE, \
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+
+// Bytes at the end of a block that start a sequence the block does not finish
+#define JVALUE_UTF8_INCOMPLETE \
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1
+
+        __attribute__((target("sse4.2")))
+        inline __m128i Nibbles(__m128i v) {
+            return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F));
+        }
+
+        __attribute__((target("sse4.2")))
+        inline __m128i CheckSse42(__m128i input, __m128i previous) {
+            const __m128i byte1High = _mm_setr_epi8(JVALUE_UTF8_BYTE_1_HIGH);
+            const __m128i byte1Low = _mm_setr_epi8(JVALUE_UTF8_BYTE_1_LOW);
+            const __m128i byte2High = _mm_setr_epi8(JVALUE_UTF8_BYTE_2_HIGH);
+
+            __m128i prev1 = _mm_alignr_epi8(input, previous, 15);
+            __m128i special = _mm_and_si128(
+                _mm_and_si128(_mm_shuffle_epi8(byte1High, Nibbles(prev1)),
+                              _mm_shuffle_epi8(byte1Low, _mm_and_si128(prev1, _mm_set1_epi8(0x0F)))),
+                _mm_shuffle_epi8(byte2High, Nibbles(input)));
+
+            // 0x80 where the byte two back starts a 3-byte sequence or three back a 4-byte one
+            __m128i prev2 = _mm_alignr_epi8(input, previous, 14);
+            __m128i prev3 = _mm_alignr_epi8(input, previous, 13);
+            __m128i must23 = _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(char(0xE0 - 0x80))),
+                                          _mm_subs_epu8(prev3, _mm_set1_epi8(char(0xF0 - 0x80))));
+            return _mm_xor_si128(_mm_and_si128(must23, _mm_set1_epi8(char(0x80))), special);
+        }
+
+        __attribute__((target("sse4.2")))
+        size_t FindInvalidSse42(const unsigned char * data, size_t size) {
+            const __m128i incompleteMax = _mm_setr_epi8(JVALUE_UTF8_INCOMPLETE);
+            __m128i previous = _mm_setzero_si128();
+            __m128i incomplete = _mm_setzero_si128();
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16) {
+                __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                __m128i error;
+                if (_mm_movemask_epi8(input) == 0) {
+                    // ASCII: fine unless the block before left a sequence open
+                    error = incomplete;
+                    incomplete = _mm_setzero_si128();
+                } else {
+                    error = CheckSse42(input, previous);
+                    incomplete = _mm_subs_epu8(input, incompleteMax);
+                }
+                if (!_mm_testz_si128(error, error)) {
+                    break;
+                }
+                previous = input;
+            }
+            return FindInvalidScalar(data, SequenceStart(data, i), size);
+        }
+
+        __attribute__((target("avx2")))
+        inline __m256i Nibbles(__m256i v) {
+            return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+        }
+
+        // The bytes N back of every position; the 128-bit lanes shift on their
+        // own, so the high half of the previous block is put under the input first
+        template<int N>
+        __attribute__((target("avx2")))
+        inline __m256i Previous(__m256i input, __m256i previous) {
+            return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - N);
+        }
+
+        __attribute__((target("avx2")))
+        inline __m256i CheckAvx2(__m256i input, __m256i previous) {
+            const __m256i byte1High = _mm256_setr_epi8(JVALUE_UTF8_BYTE_1_HIGH, JVALUE_UTF8_BYTE_1_HIGH);
+            const __m256i byte1Low = _mm256_setr_epi8(JVALUE_UTF8_BYTE_1_LOW, JVALUE_UTF8_BYTE_1_LOW);
+            const __m256i byte2High = _mm256_setr_epi8(JVALUE_UTF8_BYTE_2_HIGH, JVALUE_UTF8_BYTE_2_HIGH);
+
+            __m256i prev1 = Previous<1>(input, previous);
+            __m256i special = _mm256_and_si256(
+                _mm256_and_si256(_mm256_shuffle_epi8(byte1High, Nibbles(prev1)),
+                                 _mm256_shuffle_epi8(byte1Low, _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)))),
+                _mm256_shuffle_epi8(byte2High, Nibbles(input)));
+
+            __m256i must23 = _mm256_or_si256(_mm256_subs_epu8(Previous<2>(input, previous), _mm256_set1_epi8(char(0xE0 - 0x80))),
+                                             _mm256_subs_epu8(Previous<3>(input, previous), _mm256_set1_epi8(char(0xF0 - 0x80))));
+            return _mm256_xor_si256(_mm256_and_si256(must23, _mm256_set1_epi8(char(0x80))), special);
+        }
+
+        __attribute__((target("avx2")))
+        size_t FindInvalidAvx2(const unsigned char * data, size_t size) {
+            const __m256i incompleteMax = _mm256_setr_epi8(
+                char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF),
+                char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF),
+                JVALUE_UTF8_INCOMPLETE);
+            __m256i previous = _mm256_setzero_si256();
+            __m256i incomplete = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32) {
+                __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                __m256i error;
+                if (_mm256_movemask_epi8(input) == 0) {
+                    error = incomplete;
+                    incomplete = _mm256_setzero_si256();
+                } else {
+                    error = CheckAvx2(input, previous);
+                    incomplete = _mm256_subs_epu8(input, incompleteMax);
+                }
+                if (!_mm256_testz_si256(error, error)) {
+                    break;
+                }
+                previous = input;
+            }
+            // The compiler leaves the upper halves dirty on a tail call, which
+            // costs every SSE instruction after it
+            _mm256_zeroupper();
+            return FindInvalidScalar(data, SequenceStart(data, i), size);
+        }
+
+#undef JVALUE_UTF8_BYTE_1_HIGH
+#undef JVALUE_UTF8_BYTE_1_LOW
+#undef JVALUE_UTF8_BYTE_2_HIGH
+#undef JVALUE_UTF8_INCOMPLETE
+    }
+
+    size_t NPrivate::FindInvalidUtf8Kernel(const char * data, size_t size, EJSimdKernel kernel) {
+        const unsigned char * bytes = reinterpret_cast<const unsigned char *>(data);
+        if (size < SHORT_RUN) {
+            return FindInvalidScalar(bytes, 0, size);
+        }
+        switch (Resolve(kernel)) {
+            case JKERNEL_AVX2:
+                return FindInvalidAvx2(bytes, size);
+            case JKERNEL_SSE42:
+                return FindInvalidSse42(bytes, size);
+            default:
+                return FindInvalidScalar(bytes, 0, size);
+        }
+    }
+
+    size_t NPrivate::FindEscapeKernel(const char * data, size_t size, EJSimdKernel kernel) {
+        const unsigned char * bytes = reinterpret_cast<const unsigned char *>(data);
+        switch (Resolve(kernel)) {
+            case JKERNEL_AVX2:
+                return FindEscapeAvx2(bytes, size);
+            case JKERNEL_SSE42:
+                return FindEscapeSse42(bytes, size);
+            default:
+                return FindEscapeScalar(bytes, 0, size);
+        }
+    }
+}
@@ -0,0 +1,299 @@
+#include "jvalue_writer.h"
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <system_error>
+#include <unistd.h>
+
+namespace NJValue {
+
+    namespace {
+
+        const size_t MIN_BUFFER_SIZE = 1024;
+
+        // Second character of the escape sequence, 'u' for \u00XX, 0 if c goes as is
+        struct TEscapeTable {
+            char escape[256];
+
+            TEscapeTable() {
+                std::memset(escape, 0, sizeof(escape));
+                for (int c = 0; c < 0x20; ++c) {
+                    escape[c] = 'u';
+                }
+                escape[static_cast<unsigned char>('"')] = '"';
+                escape[static_cast<unsigned char>('\\')] = '\\';
+                escape[static_cast<unsigned char>('\b')] = 'b';
+                escape[static_cast<unsigned char>('\f')] = 'f';
+                escape[static_cast<unsigned char>('\n')] = 'n';
+                escape[static_cast<unsigned char>('\r')] = 'r';
+                escape[static_cast<unsigned char>('\t')] = 't';
+            }
+        };
+
+        const TEscapeTable ESCAPES;
+
+        const IJSON_VALUE NULL_VALUE(JNULL);
+    }
+
+    void TJFileSink::Write(const char * data, size_t size) {
+        if (std::fwrite(data, 1, size, file) != size) {
+            throw std::system_error(errno, std::system_category(), "fwrite");
+        }
+    }
+
+    void TJFileSink::Flush() {
+        if (std::fflush(file) != 0) {
+            throw std::system_error(errno, std::system_category(), "fflush");
+        }
+    }
+
+    void TJFdSink::Write(const char * data, size_t size) {
+        struct iovec iov;
+        iov.iov_base = const_cast<char *>(data);
+        iov.iov_len = size;
+        WriteV(&iov, 1);
+    }
+
+    void TJFdSink::WriteV(const struct iovec * iov, size_t count) {
+        std::vector<struct iovec> pending(iov, iov + count);
+        size_t first = 0;
+        while (first < pending.size()) {
+            if (pending[first].iov_len == 0) {
+                ++first;
+                continue;
+            }
+            int batch = static_cast<int>(std::min(pending.size() - first, static_cast<size_t>(IOV_MAX)));
+            ssize_t written = ::writev(fd, &pending[first], batch);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::system_category(), "writev");
+            }
+
+            size_t left = static_cast<size_t>(written);
+            while (left > 0) {
+                struct iovec & piece = pending[first];
+                if (left >= piece.iov_len) {
+                    left -= piece.iov_len;
+                    ++first;
+                } else {
+                    piece.iov_base = static_cast<char *>(piece.iov_base) + left;
+                    piece.iov_len -= left;
+                    left = 0;
+                }
+            }
+        }
+    }
+
+    TJWriter::TJWriter(IJSink & sink, EJWriteStyle style, size_t bufferSize)
+        : sink(sink), style(style), indent(4), doubleFormat(JDOUBLE_SHORTEST), utf8(JUTF8_LENIENT)
+        , buffer(std::max(bufferSize, MIN_BUFFER_SIZE)), used(0), written(0)
+    { }
+
+    void TJWriter::FlushBuffer() {
+        if (used != 0) {
+            sink.Write(buffer.data(), used);
+            written += used;
+            used = 0;
+        }
+    }
+
+    void TJWriter::PutSlow(const char * data, size_t size) {
+        if (size >= LARGE_PIECE) {
+            struct iovec iov[2];
+            iov[0].iov_base = buffer.data();
+            iov[0].iov_len = used;
+            iov[1].iov_base = const_cast<char *>(data);
+            iov[1].iov_len = size;
+            sink.WriteV(used == 0 ? iov + 1 : iov, used == 0 ? 1 : 2);
+            written += used + size;
+            used = 0;
+            return;
+        }
+        while (size > 0) {
+            if (used == buffer.size()) {
+                FlushBuffer();
+            }
+            size_t chunk = std::min(size, buffer.size() - used);
+            std::memcpy(buffer.data() + used, data, chunk);
+            used += chunk;
+            data += chunk;
+            size -= chunk;
+        }
+    }
+
+    void TJWriter::NewLine(size_t depth) {
+        if (style != JWRITE_PRETTY) {
+            return;
+        }
+        Put('\n');
+        for (size_t i = depth * indent; i > 0; --i) {
+            Put(' ');
+        }
+    }
+
+    void TJWriter::WriteString(const char * data, size_t size) {
+        if (utf8 == JUTF8_STRICT) {
+            size_t bad = FindInvalidUtf8(data, size);
+            if (bad != size) {
+                throw TJParseError("Invalid UTF-8", bad);
+            }
+        }
+        Put('"');
+        size_t run = 0;
+        for (size_t i = FindEscape(data, size); i < size; i = run + FindEscape(data + run, size - run)) {
+            if (i - run >= LARGE_PIECE) {
+                PutSlow(data + run, i - run);
+            } else {
+                Put(data + run, i - run);
+            }
+            run = i + 1;
+
+            char escape = ESCAPES.escape[static_cast<unsigned char>(data[i])];
+            char seq[6] = { '\\', escape, '0', '0', 0, 0 };
+            if (escape == 'u') {
+                static const char HEX[] = "0123456789abcdef";
+                seq[4] = HEX[(data[i] >> 4) & 0xF];
+                seq[5] = HEX[data[i] & 0xF];
+                Put(seq, 6);
+            } else {
+                Put(seq, 2);
+            }
+        }
+        if (size - run >= LARGE_PIECE) {
+            PutSlow(data + run, size - run);
+        } else {
+            Put(data + run, size - run);
+        }
+        Put('"');
+    }
+
+    void TJWriter::WriteInteger(integer_t value) {
+        if (buffer.size() - used < FORMAT_INTEGER_MAX) {
+            FlushBuffer();
+        }
+        used = FormatInteger(buffer.data() + used, value) - buffer.data();
+    }
+
+    void TJWriter::WriteDouble(double_t value) {
+        if (!std::isfinite(value)) {
+            Put("null", 4);
+            return;
+        }
+        if (buffer.size() - used < FORMAT_FIXED_MAX) {
+            FlushBuffer();
+        }
+        used = FormatDouble(buffer.data() + used, value, doubleFormat) - buffer.data();
+    }
+
+    void TJWriter::WriteScalar(const IJSON_VALUE & value) {
+        switch (value.GetType()) {
+            case JBOOL:
+                if (value.AsBool()) {
+                    Put("true", 4);
+                } else {
+                    Put("false", 5);
+                }
+                return;
+            case JINTEGER:
+                WriteInteger(value.AsInteger());
+                return;
+            case JDOUBLE:
+                WriteDouble(value.AsDouble());
+                return;
+            case JSTRING: {
+                TJStringView str = value.AsStringView();
+                WriteString(str.data(), str.size());
+                return;
+            }
+            default:
+                Put("null", 4);
+                return;
+        }
+    }
+
+    void TJWriter::Write(const IJSON_VALUE & root) {
+        stack.clear();
+        const IJSON_VALUE * value = &root;
+
+        while (value != nullptr) {
+            EJValueType type = value->GetType();
+            if (type == JARRAY || type == JMAP) {
+                if (value->Size() == 0) {
+                    Put(type == JARRAY ? "[]" : "{}", 2);
+                } else {
+                    Put(type == JARRAY ? '[' : '{');
+                    TFrame frame;
+                    frame.container = value;
+                    frame.index = 0;
+                    if (type == JMAP) {
+                        frame.entry = value->GetMap()->begin();
+                    }
+                    stack.push_back(frame);
+                }
+            } else {
+                WriteScalar(*value);
+            }
+
+            // Next value to write, closing every container that is done
+            value = nullptr;
+            while (!stack.empty()) {
+                TFrame & frame = stack.back();
+                bool isMap = frame.container->GetType() == JMAP;
+                if (frame.index == frame.container->Size()) {
+                    stack.pop_back();
+                    NewLine(stack.size());
+                    Put(isMap ? '}' : ']');
+                    continue;
+                }
+
+                if (frame.index != 0) {
+                    Put(',');
+                }
+                NewLine(stack.size());
+                // Packed numbers are written as they are, without nodes
+                if (frame.container->IsPacked()) {
+                    TJSpan<integer_t> integers = frame.container->AsIntegerSpan();
+                    if (integers.empty()) {
+                        WriteDouble(frame.container->AsDoubleSpan()[frame.index]);
+                    } else {
+                        WriteInteger(integers[frame.index]);
+                    }
+                    ++frame.index;
+                    continue;
+                }
+
+                const IJValue * item;
+                if (isMap) {
+                    WriteString(frame.entry->key, frame.entry->size);
+                    Put(':');
+                    if (style == JWRITE_PRETTY) {
+                        Put(' ');
+                    }
+                    item = frame.entry->value;
+                    ++frame.entry;
+                } else {
+                    item = frame.container->At(frame.index);
+                }
+                ++frame.index;
+                value = item == nullptr ? &NULL_VALUE : &item->GetValue();
+                break;
+            }
+        }
+        Flush();
+    }
+
+    void TJWriter::Flush() {
+        FlushBuffer();
+        sink.Flush();
+    }
+
+    string_t ToJson(const IJValue & value, EJWriteStyle style) {
+        string_t out;
+        TJStringSink sink(out);
+        TJWriter writer(sink, style, MIN_BUFFER_SIZE);
+        writer.Write(value);
+        return out;
+    }
+}